@@ -10,6 +10,10 @@ Item {
     property alias play: _play
     property alias pause: _pause
     property alias stop: _stop
+    property alias stepForward: _stepForward
+    property alias stepBackward: _stepBackward
+    property alias reversePlayback: _reversePlayback
+    property alias resumePlayback: _resumePlayback
     property alias mute: _mute
     property alias subtitle: _subtitle
     property alias previous: _previous
@@ -47,6 +51,18 @@ Item {
     property alias timedPause: _timedPause
     property alias attention: _attention
     property alias danmuSwitch:_danmuSwitch
+    property alias ffmpegBackend: _ffmpegBackend
+    property alias qualityDecode: _qualityDecode
+    property alias balancedDecode: _balancedDecode
+    property alias lowPowerDecode: _lowPowerDecode
+    property alias playbackStats: _playbackStats
+    property alias dumpStats: _dumpStats
+    property alias normalizeUrls: _normalizeUrls
+    property alias fuzzySearch: _fuzzySearch
+    property alias openPlaylist: _openPlaylist
+    property alias savePlaylist: _savePlaylist
+    property alias addFolder: _addFolder
+    property alias watchFolders: _watchFolders
 
     Action{
         id:_danmuSwitch
@@ -63,6 +79,24 @@ Item {
         shortcut: StandardKey.Open
     }
 
+    Action {
+        id: _addFolder
+        text: qsTr("Add &Folder...")
+        icon.name: "folder-open"
+    }
+
+    Action {
+        id: _openPlaylist
+        text: qsTr("Open &Playlist...")
+        icon.name: "document-open"
+    }
+
+    Action {
+        id: _savePlaylist
+        text: qsTr("Save Playlist As...")
+        icon.name: "document-save-as"
+    }
+
     Action {
         id: _openUrl
         text: qsTr("Open &URL...")
@@ -112,6 +146,67 @@ Item {
         icon.name: "media-playback-stop"
     }
 
+    Action {
+        id: _stepForward
+        text: qsTr("Next Frame")
+        icon.name: "go-next"
+        shortcut: "."
+    }
+
+    Action {
+        id: _stepBackward
+        text: qsTr("Previous Frame")
+        icon.name: "go-previous"
+        shortcut: ","
+    }
+
+    Action {
+        id: _reversePlayback
+        text: qsTr("Reverse Playback")
+        icon.name: "media-seek-backward"
+        shortcut: "Ctrl+R"
+        checkable: true
+    }
+
+    Action {
+        id: _resumePlayback
+        text: qsTr("Resume Where Left Off")
+        icon.name: "media-playback-start"
+        checkable: true
+    }
+
+    Action {
+        id: _normalizeUrls
+        text: qsTr("Merge Duplicate Paths")
+        checkable: true
+    }
+
+    Action {
+        id: _watchFolders
+        text: qsTr("Watch Added Folders")
+        checkable: true
+    }
+
+    Action {
+        id: _fuzzySearch
+        text: qsTr("Fuzzy Playlist Search")
+        checkable: true
+    }
+
+    Action {
+        id: _playbackStats
+        text: qsTr("Playback Statistics")
+        icon.name: "view-statistics"
+        shortcut: "Ctrl+I"
+        checkable: true
+    }
+
+    Action {
+        id: _dumpStats
+        text: qsTr("Save Statistics as JSON")
+        icon.name: "document-save"
+    }
+
     Action {
         id: _mute
         text: qsTr("&Mute")
@@ -145,6 +240,28 @@ Item {
         icon.name: "help-about"
     }
 
+    Action {
+        id: _ffmpegBackend
+        text: qsTr("FFmpeg Pipeline")
+        icon.name: "video-x-generic"
+        checkable: true
+    }
+
+    Action {
+        id: _qualityDecode
+        text: qsTr("Quality")
+    }
+
+    Action {
+        id: _balancedDecode
+        text: qsTr("Balanced")
+    }
+
+    Action {
+        id: _lowPowerDecode
+        text: qsTr("Low Power")
+    }
+
     Action {
         id: _zeroPointFiveRate
         text: qsTr("0.5x")
@@ -3,7 +3,6 @@ import QtQuick.Controls
 import QtQuick.Layouts
 import VideoPlayer
 import Qt.labs.folderlistmodel
-import "DanmuRender.js" as DanmuRender
 
 Item {
     id:content
@@ -16,10 +15,10 @@ Item {
     property alias player: _player
     property alias controlBar: _controlBar
     property alias danmuManager: _danmuManager
-    property alias danmuTimer: _danmuTimer
-    property alias danmuGenerater: _danmuGenerater
+    property alias danmuView: _danmuView
     property alias downloadManager: _downloadManager
     property alias folderListModel: folderListModel
+    property alias searchModel: searchlistModel
 
     // 双击全屏
     TapHandler {
@@ -135,30 +134,23 @@ Item {
         }
     }
 
-    //弹幕渲染,由弹幕管理器，弹幕计时器（定时读取弹幕），弹幕生成器,弹幕渲染器配合完成
+    //弹幕渲染,由弹幕管理器（调度弹幕）和弹幕视图（逐帧取弹幕并绘制）配合完成
     DanmuManager{
         id: _danmuManager
     }
 
-    Timer{
-        id:_danmuTimer
-        running:mediaEngine.playing && !actions.danmuSwitch.checked && captureManager.playerLayout !== CaptureManager.NotVideo
-        repeat: true
-        interval: 1000
-        onTriggered: {
-            if(DanmuRender.count > 0){
-                DanmuRender.danmusRender(danmuManager.danmus(parent.width, DanmuRender.count, mediaEngine.position))
-            }
-        }
-    }
-
-    Repeater{
-        id:_danmuGenerater
+    // 全部弹幕在一个场景图节点中绘制，随播放时钟逐帧调度和移动
+    DanmuView{
+        id:_danmuView
         property var previousState: undefined
-        visible: mediaEngine.playing
         anchors.fill: parent
-        model:100
-        delegate: Danmu{}
+        manager: _danmuManager
+        visible: !actions.danmuSwitch.checked
+        position: mediaEngine.position
+        playbackRate: mediaEngine.playbackRate
+        running: mediaEngine.playing
+        fontFamily: danmuManager.fontName
+        fontSize: danmuManager.fontSize
     }
 
     Connections {
@@ -167,13 +159,13 @@ Item {
         function onPlayerLayoutChanged() {
             if (captureManager.playerLayout === CaptureManager.NotVideo) {
                 // 保存当前弹幕开关状态
-                _danmuGenerater.previousState = actions.danmuSwitch.checked
+                _danmuView.previousState = actions.danmuSwitch.checked
                 // 强制关闭弹幕
                 actions.danmuSwitch.checked = true
-            } else if (_danmuGenerater.previousState !== undefined) {
+            } else if (_danmuView.previousState !== undefined) {
                 // 恢复之前的弹幕开关状态
-                actions.danmuSwitch.checked = _danmuGenerater.previousState
-                _danmuGenerater.previousState = undefined
+                actions.danmuSwitch.checked = _danmuView.previousState
+                _danmuView.previousState = undefined
             }
         }
     }
@@ -192,9 +184,9 @@ Item {
         focus: true
 
         Keys.onPressed: function (event){
-            //确保输入合法
-            if(!/[a-zA-Z0-9]/.test(event.text) && event.key !== Qt.Key_Delete&&event.key !== Qt.Key_Backspace){
-                event.accepted=true
+            //单行输入，中日韩文字和符号都可以搜索
+            if(event.key === Qt.Key_Return || event.key === Qt.Key_Enter || event.key === Qt.Key_Tab){
+                event.accepted = true
             }
             //确保输入内容的大小
             if(length >= 10 && event.key !== Qt.Key_Delete&&event.key !== Qt.Key_Backspace){
@@ -203,17 +195,14 @@ Item {
         }
 
         onTextChanged: {
-            //根据搜索框的状态改变列表视图
-            if(length === 0 && searchlistModel.currentIndex !== -1){
-                playlist.visible = true
-                content.playlistModel.currentIndex = content.playlistModel.indexByUrl(searchlistModel.getUrl(searchlistModel.currentIndex))
+            //根据搜索框的状态改变列表视图，搜索结果直接过滤播放列表
+            searchlistModel.query = text
+            if(length === 0){
+                playlist.visible = searchBox.visible
                 searchList.visible = false
             }else{
                 playlist.visible = false
                 searchList.visible = true
-                searchlistModel.clear()
-                searchlistModel.currentIndex = -1
-                searchlistModel.addMedias(playlistModel.search(text))
             }
         }
 
@@ -240,6 +229,7 @@ Item {
         }
         visible: false
         playlist: searchlistModel
+        reorderable: false
         onVisibleChanged: {
             if(!visible){
                 searchBox.clear()
@@ -247,26 +237,10 @@ Item {
         }
     }
 
-    //搜索播放列表的数据项
-    PlaylistModel{
+    //搜索播放列表的数据项：播放列表上的过滤代理，选中后切换播放列表的当前项
+    PlaylistSearchModel{
         id: searchlistModel
-        onCurrentIndexChanged: {
-            if (searchlistModel.currentIndex >= 0) {
-                var mediaUrl = getUrl(currentIndex)
-                if (mediaUrl) {
-                    mediaEngine.setMedia(mediaUrl)
-                    mediaEngine.play()
-                    var title = searchlistModel.data(searchlistModel.index(searchlistModel.currentIndex, 0), PlaylistModel.TitleRole)
-                    if (title) {
-                        window.title = "Video Player - " + title
-                    }
-                    //初始化弹幕
-                    danmuManager.initDanmus(title)
-                    danmuManager.initTracks(content.height * (1/4))
-                    DanmuRender.endDanmus()
-                }
-            }
-        }
+        sourceModel: content.playlistModel
     }
 
     //播放列表的底层
@@ -311,7 +285,7 @@ Item {
         id:folderListModel
         showFiles: true
         showDirs: false
-        nameFilters: ["*.mp4","*.avi","*.mkv","*.mov","*.wmv","*.ogg","*.mp3","*.wav","*.flac","*.ogg","*.wav"]
+        nameFilters: MediaFormats.nameFilters
         onFolderChanged: {
             if (folder.toString() !== "") {
                 //初始化当前文件夹的所有文件的url
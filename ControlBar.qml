@@ -1,7 +1,6 @@
 import QtQuick
 import QtQuick.Controls
 import QtQuick.Layouts
-import "DanmuRender.js" as DanmuRender
 
 Rectangle {
     property MediaEngine mediaEngine
@@ -33,6 +32,7 @@ Rectangle {
 
                 property bool isDragging: false // 是否在拖拽
                 property real dragValue: 0
+                property real previewValue: 0 // 缩略图对应的位置
 
                 value: {
                     if (isDragging) {
@@ -46,7 +46,8 @@ Rectangle {
                     if (pressed) { // 开始拖拽
                         isDragging = true
                         dragValue = value
-                        thumbnailImage.source = mediaEngine.getFrameAtPosition(positionSlider.dragValue); // 生成缩略图
+                        previewValue = dragValue
+                        mediaEngine.requestFrameAtPosition(positionSlider.dragValue) // 异步生成缩略图
                         thumbnailPopup.open() // 打开缩略图
                     } else { // 结束拖拽
                         isDragging = false
@@ -55,27 +56,51 @@ Rectangle {
                         }
                         thumbnailPopup.close() // 关闭缩略图
                         thumbnailImage.source = "" // 丢弃之前的缩略图
-
-                        DanmuRender.endDanmus()//松开刷新弹幕
-                        content.danmuManager.initDanmus(window.title.replace(/^[^-]*-\x20/,""))//通过正则表达式处理窗口标题得到正在播放的视频的标题
-                        content.danmuManager.initTracks(content.height*(1/4))
+                        // 弹幕视图检测到位置跳转后自行清屏并重置调度，不需要重新打开弹幕库
                     }
                 }
 
                 onMoved: {
                     if (isDragging) {
                         dragValue = positionSlider.value
-                        thumbnailImage.source = mediaEngine.getFrameAtPosition(positionSlider.dragValue); // 生成缩略图
+                        previewValue = dragValue
+                        mediaEngine.requestFrameAtPosition(positionSlider.dragValue) // 异步生成缩略图
+                    }
+                }
+
+                // 鼠标悬停在进度条上时预览对应位置（优先使用预览图集）
+                HoverHandler {
+                    id: sliderHover
+                    acceptedDevices: PointerDevice.Mouse
+                    onPointChanged: {
+                        if (!hovered || positionSlider.isDragging || !mediaEngine || mediaEngine.duration <= 0) return
+                        var ratio = (point.position.x - positionSlider.leftPadding) / positionSlider.availableWidth
+                        positionSlider.previewValue = Math.max(0, Math.min(1, ratio)) * mediaEngine.duration
+                        mediaEngine.requestFrameAtPosition(positionSlider.previewValue)
+                    }
+                    onHoveredChanged: {
+                        if (!hovered && !positionSlider.isDragging) {
+                            thumbnailImage.source = ""
+                        }
+                    }
+                }
+
+                // 接收异步生成的缩略图
+                Connections {
+                    target: mediaEngine
+                    function onFrameAtPositionReady(position, frame) {
+                        if (positionSlider.isDragging || sliderHover.hovered) {
+                            thumbnailImage.source = frame
+                        }
                     }
                 }
 
                 // 缩略图弹出窗口
                 Popup {
                     id: thumbnailPopup
-                    parent: positionSlider.handle
-                    visible: positionSlider.pressed
+                    visible: positionSlider.pressed || (sliderHover.hovered && mediaEngine && mediaEngine.isLocal && mediaEngine.duration > 0)
                     y: -height - 5
-                    x: -width / 2
+                    x: positionSlider.leftPadding + positionSlider.availableWidth * (positionSlider.to > 0 ? positionSlider.previewValue / positionSlider.to : 0) - width / 2
                     width: 160
                     height: 90
                     closePolicy: Popup.CloseOnReleaseOutside
@@ -96,7 +121,7 @@ Rectangle {
                         anchors.bottom: parent.bottom
                         anchors.horizontalCenter: parent.horizontalCenter
                         color: "white"
-                        text: formatTime(Math.floor(positionSlider.dragValue / 1000))
+                        text: formatTime(Math.floor(positionSlider.previewValue / 1000))
 
                         function formatTime(seconds) {
                             var minutes = Math.floor(seconds / 60)
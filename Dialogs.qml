@@ -11,6 +11,9 @@ Item {
     property DanmuManager danmuManager
     property DownloadManager downloadManager
     property alias fileOpen: _fileOpen
+    property alias folderOpen: _folderOpen
+    property alias playlistOpen: _playlistOpen
+    property alias playlistSave: _playlistSave
     property alias urlInputDialog: _urlInputDialog
     property alias about: _about
     property alias previewDialog: _previewDialog
@@ -29,12 +32,56 @@ Item {
         id: _fileOpen
         title: "Open Video Files"
         currentFolder: StandardPaths.standardLocations(StandardPaths.MoviesLocation)[0]
-        nameFilters: ["All AV files(*.mp4 *.avi *.mkv *.mov *.wmv *.ogg *.mp3 *.wav *.flac)",
-                        "Video files (*.mp4 *.avi *.mkv *.mov *.wmv)",
-                        "Music files (*.ogg *.mp3 *.wav *.flac)"]
+        nameFilters: ["All AV files (" + MediaFormats.nameFilters.join(" ") + ")",
+                        "Video files (" + MediaFormats.videoNameFilters.join(" ") + ")",
+                        "Music files (" + MediaFormats.audioNameFilters.join(" ") + ")",
+                        "All files (*)"] // 没有扩展名的文件打开后按内容识别
         fileMode: FileDialog.OpenFiles
     }
 
+    // 递归添加文件夹中的音视频文件
+    FolderDialog {
+        id: _folderOpen
+        title: "Add Folder"
+        currentFolder: StandardPaths.standardLocations(StandardPaths.MoviesLocation)[0]
+        onAccepted: playlistModel.addFolder(selectedFolder)
+    }
+
+    // 播放列表导入导出，按扩展名选择格式
+    FileDialog {
+        id: _playlistOpen
+        title: "Open Playlist"
+        currentFolder: StandardPaths.standardLocations(StandardPaths.MoviesLocation)[0]
+        nameFilters: ["All playlists (*.vppl *.m3u *.m3u8 *.xspf)",
+                        "Video Player playlist (*.vppl)",
+                        "M3U playlist (*.m3u *.m3u8)",
+                        "XSPF playlist (*.xspf)"]
+        fileMode: FileDialog.OpenFile
+        onAccepted: {
+            if (!playlistModel.loadPlaylist(selectedFile)) {
+                _errorDialog.text = "Failed to open playlist";
+                _errorDialog.open();
+            }
+        }
+    }
+
+    FileDialog {
+        id: _playlistSave
+        title: "Save Playlist"
+        currentFolder: StandardPaths.standardLocations(StandardPaths.MoviesLocation)[0]
+        nameFilters: ["Video Player playlist (*.vppl)",
+                        "M3U8 playlist (*.m3u8)",
+                        "XSPF playlist (*.xspf)"]
+        defaultSuffix: "vppl"
+        fileMode: FileDialog.SaveFile
+        onAccepted: {
+            if (!playlistModel.savePlaylist(selectedFile)) {
+                _errorDialog.text = "Failed to save playlist";
+                _errorDialog.open();
+            }
+        }
+    }
+
     Dialog {
         id: _urlInputDialog
         title: "Open Network URL"
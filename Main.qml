@@ -4,7 +4,6 @@ import QtQuick.Layouts
 import QtMultimedia
 import VideoPlayer
 import QtQuick.Dialogs
-import "DanmuRender.js" as DanmuRender
 
 ApplicationWindow {
     id: window
@@ -12,21 +11,32 @@ ApplicationWindow {
     height: 600
     visible: !content.player.smallWindowMode // 当小窗口显示时，大窗口不显示
     title: "Video Player"
+
+    property int preparedIndex: -1 // 已交给mediaEngine预先打开的下一项
+    property bool playRecorded: false // 当前媒体是否已经写入历史记录
+    property string openedMedia: ""   // 播放列表上一次打开的媒体，只有行号变化时不重新打开
+    property int recentCount: 10   // "最近打开"菜单里显示的历史项数
+    property var recentHistory: [] // 历史日志保存的项较多，菜单只取最前面几项，不为每一项创建菜单
     color: "black"
 
     // 媒体引擎
     MediaEngine {
         id: mediaEngine
+        smallWindow: content.player.smallWindowMode // 小窗播放时按解码配置降低分辨率
         onHasSubtitleChanged: {
             actions.subtitle.enabled = mediaEngine.hasSubtitle
             actions.subtitle.checked = mediaEngine.subtitleVisible
         }
-        onPlayingChanged: {
-            if (mediaEngine.playing && playlistModel.currentIndex >= 0) {
-                var mediaUrl = playlistModel.getUrl(playlistModel.currentIndex)
-                if (mediaUrl) {
-                    histroyListModel.setHistroy(mediaUrl)
-                }
+        onNextMediaRequested: { // 当前媒体即将结束，提前确定并打开下一项
+            preparedIndex = nextPlaylistIndex()
+            mediaEngine.setNextMedia(preparedIndex >= 0 ? playlistModel.getUrl(preparedIndex) : "")
+        }
+        onCurrentMediaChanged: playRecorded = false
+        onPlayingChanged: { // 每次打开媒体只记录一次播放，暂停后继续不算
+            // 无缝切换时播放列表还没跟上，记录引擎实际打开的媒体
+            if (mediaEngine.playing && !playRecorded && mediaEngine.currentMedia.toString() !== "") {
+                histroyListModel.setHistroy(mediaEngine.currentMedia)
+                playRecorded = true
             }
         }
     }
@@ -35,9 +45,14 @@ ApplicationWindow {
     PlaylistModel {
         id: playlistModel
         onCurrentIndexChanged: {
+            preparedIndex = -1
             if (playlistModel.currentIndex >= 0) {
                 var mediaUrl = getUrl(currentIndex)
+                // 删除前面的行只会让行号变化，正在播放的媒体不重新打开
+                if (mediaUrl && mediaUrl.toString() === openedMedia && !mediaEngine.playbackFinished())
+                    return
                 if (mediaUrl) {
+                    openedMedia = mediaUrl.toString()
                     mediaEngine.setMedia(mediaUrl)
                     mediaEngine.play()
                     var title = playlistModel.data(playlistModel.index(playlistModel.currentIndex,0),PlaylistModel.TitleRole)
@@ -46,10 +61,17 @@ ApplicationWindow {
                     }
                     content.danmuManager.initDanmus(title)
                     content.danmuManager.initTracks(content.height*(1/4))
-                    DanmuRender.endDanmus()
+                    content.danmuView.clear()
                 }
             }
         }
+        // 切换时标题可能还是文件名，后台读到元数据里的标题后重新载入弹幕
+        onCurrentTitleChanged: function (title) {
+            window.title = "Video Player - " + title
+            content.danmuManager.initDanmus(title)
+            content.danmuManager.initTracks(content.height*(1/4))
+            content.danmuView.clear()
+        }
     }
 
     //历史记录的数据项
@@ -58,6 +80,10 @@ ApplicationWindow {
         Component.onCompleted: {
             histroy()
         }
+        onRowCountChanged: refreshRecentHistory()
+        onRowsMoved: refreshRecentHistory()
+        onDataChanged: refreshRecentHistory()
+        onModelReset: refreshRecentHistory()
     }
 
     CaptureManager {
@@ -116,8 +142,14 @@ ApplicationWindow {
             title: qsTr("File")
             MenuItem { action: actions.open }
             MenuItem { action: actions.openUrl }
+            MenuItem { action: actions.addFolder }
+            MenuItem { action: actions.openPlaylist }
+            MenuItem { action: actions.savePlaylist }
             MenuSeparator {}
             MenuItem { action: actions.download }
+            MenuItem { action: actions.normalizeUrls }
+            MenuItem { action: actions.watchFolders }
+            MenuItem { action: actions.fuzzySearch }
             MenuSeparator {}
             MenuItem { action: actions.close }
             MenuSeparator {}
@@ -126,18 +158,18 @@ ApplicationWindow {
                 MenuItem { action: actions.clearHistory }
                 MenuSeparator {}
                 Repeater{
-                    model: histroyListModel
+                    model: window.recentHistory
                     delegate: MenuItem{
                         action: Action {
                             id: _histroy
-                            property string url: model.url
+                            property string url: modelData.url
                             text: qsTr("")
                             onTriggered: {
                                 let urls=[url]
                                 playlistModel.addMedias(urls)
                             }
                         }
-                        text: model.title
+                        text: modelData.title
                     }
                 }
             }
@@ -149,6 +181,12 @@ ApplicationWindow {
             MenuItem { action: actions.play}
             MenuItem { action: actions.pause }
             MenuItem { action: actions.stop }
+            MenuSeparator {}
+            MenuItem { action: actions.stepBackward }
+            MenuItem { action: actions.stepForward }
+            MenuItem { action: actions.reversePlayback }
+            MenuItem { action: actions.resumePlayback }
+            MenuSeparator {}
 
             Menu {
                 title: qsTr("Rate")
@@ -172,6 +210,23 @@ ApplicationWindow {
             MenuItem { action: actions.randomPlayback }
             MenuSeparator {}
             MenuItem { action: actions.timedPause }
+            MenuSeparator {}
+            MenuItem { action: actions.ffmpegBackend }
+            Menu {
+                title: qsTr("Decode Profile")
+                MenuItem { action: actions.qualityDecode }
+                MenuItem { action: actions.balancedDecode }
+                MenuItem { action: actions.lowPowerDecode }
+                MenuSeparator {}
+                MenuItem { // 解码耗时和丢帧数，只有自研管线提供
+                    enabled: false
+                    text: mediaEngine.backend === MediaEngine.FFmpegPipeline
+                          ? qsTr("Decode %1 ms, dropped %2")
+                            .arg(Number(mediaEngine.pipelineStats.videoDecodeMs || 0).toFixed(1))
+                            .arg(mediaEngine.pipelineStats.droppedFrames || 0)
+                          : qsTr("Decode stats need FFmpeg Pipeline")
+                }
+            }
         }
 
         Menu {
@@ -181,6 +236,9 @@ ApplicationWindow {
             MenuSeparator {}
             MenuItem { action: actions.smallWindowMode }
             MenuSeparator {}
+            MenuItem { action: actions.playbackStats }
+            MenuItem { action: actions.dumpStats }
+            MenuSeparator {}
             Menu {
                 title: qsTr("Video Scale")
                 MenuItem { action: actions.originalAspectRatio }
@@ -240,6 +298,10 @@ ApplicationWindow {
         id: actions
         open.onTriggered: content.dialogs.fileOpen.open()
         openUrl.onTriggered: content.dialogs.urlInputDialog.open()
+        addFolder.onTriggered: content.dialogs.folderOpen.open()
+        openPlaylist.onTriggered: content.dialogs.playlistOpen.open()
+        savePlaylist.enabled: playlistModel.rowCount > 0
+        savePlaylist.onTriggered: content.dialogs.playlistSave.open()
         download.enabled: mediaEngine && !mediaEngine.isLocal && mediaEngine.currentMedia.toString() !== ""
         download.onTriggered: content.downloadManager.nowDownload();
         close.onTriggered: closeVideo()
@@ -247,6 +309,12 @@ ApplicationWindow {
         play.onTriggered: mediaEngine.play()
         pause.onTriggered: mediaEngine.pause()
         stop.onTriggered: mediaEngine.stop()
+        stepForward.onTriggered: mediaEngine.stepForward()
+        stepBackward.onTriggered: mediaEngine.stepBackward()
+        reversePlayback.checked: mediaEngine.reversePlayback
+        reversePlayback.onTriggered: mediaEngine.reversePlayback = reversePlayback.checked
+        resumePlayback.checked: mediaEngine.resumePlayback
+        resumePlayback.onTriggered: mediaEngine.resumePlayback = resumePlayback.checked
         mute.onTriggered: {
             if (content.mediaEngine) {
                 content.mediaEngine.setMuted(mute.checked)
@@ -278,6 +346,21 @@ ApplicationWindow {
         oneRate.onTriggered: mediaEngine.setPlaybackRate(1)
         onePointFiveRate.onTriggered: mediaEngine.setPlaybackRate(1.5)
         twoRate.onTriggered: mediaEngine.setPlaybackRate(2)
+        ffmpegBackend.checked: mediaEngine.backend === MediaEngine.FFmpegPipeline
+        qualityDecode.onTriggered: mediaEngine.decodeProfile.applyPreset(DecodeProfile.Quality)
+        balancedDecode.onTriggered: mediaEngine.decodeProfile.applyPreset(DecodeProfile.Balanced)
+        lowPowerDecode.onTriggered: mediaEngine.decodeProfile.applyPreset(DecodeProfile.LowPower)
+        normalizeUrls.checked: playlistModel.normalizeUrls
+        normalizeUrls.onTriggered: playlistModel.normalizeUrls = normalizeUrls.checked
+        watchFolders.checked: playlistModel.watchFolders
+        watchFolders.onTriggered: playlistModel.watchFolders = watchFolders.checked
+        fuzzySearch.checked: content.searchModel.fuzzy
+        fuzzySearch.onTriggered: content.searchModel.fuzzy = fuzzySearch.checked
+        playbackStats.checked: mediaEngine.telemetry.enabled
+        playbackStats.onTriggered: mediaEngine.telemetry.enabled = playbackStats.checked
+        dumpStats.onTriggered: mediaEngine.telemetry.dump()
+        ffmpegBackend.onTriggered: mediaEngine.setBackend(ffmpegBackend.checked ? MediaEngine.FFmpegPipeline
+                                                                                : MediaEngine.QtMultimedia)
         screenshotWindow.onTriggered: {
             mediaEngine.pause()
             window.takeScreenshot(CaptureManager.WindowCapture)
@@ -348,15 +431,13 @@ ApplicationWindow {
         aspectRatio4_3. onTriggered: content.player.targetAspectRatio = 4/3
         smallWindowMode.onTriggered: content.player.smallWindowMode = true
         smallDanmu.onTriggered:{
-            DanmuRender.smallDanmu()
-            DanmuRender.endDanmus()
+            content.danmuView.clear()
             content.danmuManager.initDanmus(window.title.replace(/^[^-]*-\x20/,""))
             content.danmuManager.fontSize=20
             content.danmuManager.initTracks(content.height*(1/4))
         }
         bigDanmu.onTriggered:{
-            DanmuRender.bigDanmu()
-            DanmuRender.endDanmus()
+            content.danmuView.clear()
             content.danmuManager.initDanmus(window.title.replace(/^[^-]*-\x20/,""))
             content.danmuManager.fontSize=40
             content.danmuManager.initTracks(content.height*(1/4))
@@ -364,7 +445,7 @@ ApplicationWindow {
         timedPause.onTriggered: content.dialogs.timedPauseDialog.open()
         danmuSwitch.onCheckedChanged:{
             if(actions.danmuSwitch.checked===true){
-                DanmuRender.endDanmus()
+                content.danmuView.clear()
             }
         }
     }
@@ -386,16 +467,12 @@ ApplicationWindow {
             if (mediaEngine.playbackFinished) { // 检查视频结束
                 switch(mediaEngine.playbackMode) { // 检查视频的播放模式
                     case MediaEngine.Sequential: // 顺序播放
-                        var newIndex = playlistModel.currentIndex + 1;
-                        if (newIndex > 0 && newIndex < playlistModel.rowCount) {
-                            playlistModel.currentIndex = newIndex;
-                        }
-                        break;
                     case MediaEngine.Random: // 随机播放
-                        var count = playlistModel.rowCount
-                        if (count > 1) {
-                            var index = playlistModel.getRandomIndex(0, count)
-                            playlistModel.currentIndex = index
+                        // 优先使用预先打开的那一项，与mediaEngine已切换的媒体保持一致
+                        var newIndex = preparedIndex >= 0 && preparedIndex < playlistModel.rowCount
+                                ? preparedIndex : nextPlaylistIndex()
+                        if (newIndex >= 0) {
+                            playlistModel.currentIndex = newIndex
                         }
                         break;
                     case MediaEngine.Loop: // 循环播放
@@ -420,7 +497,32 @@ ApplicationWindow {
         }
     }
 
+    // 按播放模式计算下一项，没有下一项时返回-1
+    function nextPlaylistIndex() {
+        var count = playlistModel.rowCount
+        switch (mediaEngine.playbackMode) {
+            case MediaEngine.Sequential:
+                var next = playlistModel.currentIndex + 1
+                return next > 0 && next < count ? next : -1
+            case MediaEngine.Random:
+                return count > 1 ? playlistModel.getRandomIndex(0, count) : -1
+            default:
+                return -1
+        }
+    }
+
+    function refreshRecentHistory() {
+        var items = []
+        var count = Math.min(histroyListModel.rowCount, recentCount)
+        for (var i = 0; i < count; i++) {
+            items.push({ url: histroyListModel.getUrl(i),
+                         title: histroyListModel.data(histroyListModel.index(i, 0), PlaylistModel.TitleRole) })
+        }
+        recentHistory = items
+    }
+
     function closeVideo() {
+        openedMedia = ""
         mediaEngine.stop()
         playlistModel.clear()
         title = "Video Player"
@@ -454,6 +556,13 @@ ApplicationWindow {
         onFilesDropped: function (urls) {
             playlistModel.addMedias(urls)
         }
+        onFoldersDropped: function (urls) {
+            for (var i = 0; i < urls.length; i++) playlistModel.addFolder(urls[i])
+        }
+        onDropRejected: {
+            content.dialogs.errorDialog.text = "拖入的文件不是可以播放的音视频文件"
+            content.dialogs.errorDialog.open()
+        }
 
         Component.onCompleted: setWindow(window)
     }
@@ -470,7 +579,7 @@ ApplicationWindow {
 
         Label {
             anchors.centerIn: parent
-            text: "拖放音视频文件到此处"
+            text: "拖放音视频文件或文件夹到此处"
             font.pixelSize: 28
             color: "white"
         }
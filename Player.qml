@@ -60,8 +60,8 @@ Item {
     Image {
         id: coverArtImage
         anchors.fill: parent
-        visible: mediaEngine.coverArtBase64 !== "" && captureManager.playerLayout === CaptureManager.LayoutNull
-        source: mediaEngine.coverArtBase64 ? "data:image/png;base64," + mediaEngine.coverArtBase64 : ""
+        visible: mediaEngine.coverArtSource !== "" && captureManager.playerLayout === CaptureManager.LayoutNull
+        source: mediaEngine.coverArtSource
         fillMode: Image.PreserveAspectFit
         cache: false
         asynchronous: true // 异步加载
@@ -205,6 +205,70 @@ Item {
         }
     }
 
+    // 播放性能统计叠加层
+    Rectangle {
+        id: statsOverlay
+        anchors {
+            top: parent.top
+            left: parent.left
+            margins: 10
+        }
+        width: statsText.implicitWidth + 16
+        height: statsText.implicitHeight + 12
+        radius: 4
+        color: "#a0000000"
+        visible: mediaEngine && mediaEngine.telemetry.enabled
+
+        Text {
+            id: statsText
+            property PlaybackTelemetry telemetry: mediaEngine ? mediaEngine.telemetry : null
+            anchors.centerIn: parent
+            color: "white"
+            font.family: "monospace"
+            font.pixelSize: 12
+            // p95和直方图按桶上界显示，最后一个桶没有上界
+            function p95Text(ms, histogram) {
+                if (!histogram || histogram.length === 0 || ms === 0) return qsTr("n/a")
+                if (ms < 0) return "> " + histogram[histogram.length - 2].upToMs + " ms"
+                return "<= " + ms + " ms"
+            }
+            function histogramText(histogram) {
+                if (!histogram || histogram.length === 0) return qsTr("n/a")
+                var parts = []
+                for (var i = 0; i < histogram.length; i++) {
+                    var bucket = histogram[i]
+                    var label = bucket.upToMs < 0 ? ">" + histogram[i - 1].upToMs : "<=" + bucket.upToMs
+                    parts.push(label + ":" + bucket.count)
+                }
+                return parts.join(" ")
+            }
+            text: {
+                if (!telemetry) return ""
+                var lines = []
+                lines.push(qsTr("Frames: %1 rendered, %2 dropped, %3 fps")
+                           .arg(telemetry.renderedFrames)
+                           .arg(telemetry.droppedFrames < 0 ? qsTr("n/a") : telemetry.droppedFrames)
+                           .arg(telemetry.renderedFps.toFixed(1)))
+                lines.push(qsTr("Decode: %1").arg(telemetry.decodeMs < 0 ? qsTr("n/a")
+                                                                          : telemetry.decodeMs.toFixed(2) + " ms"))
+                lines.push(qsTr("  p95 %1  [%2]").arg(p95Text(telemetry.decodeP95Ms, telemetry.decodeHistogram))
+                                                  .arg(histogramText(telemetry.decodeHistogram)))
+                lines.push(qsTr("Present latency: %1").arg(telemetry.presentLatencyMs < 0 ? qsTr("n/a")
+                                                                                          : telemetry.presentLatencyMs.toFixed(2) + " ms"))
+                lines.push(qsTr("  p95 %1  [%2]").arg(p95Text(telemetry.presentP95Ms, telemetry.presentHistogram))
+                                                  .arg(histogramText(telemetry.presentHistogram)))
+                lines.push(qsTr("Buffer: %1").arg(telemetry.bufferFill < 0 ? qsTr("n/a")
+                                                                           : Math.round(telemetry.bufferFill * 100) + "%"))
+                lines.push(qsTr("A/V drift: %1").arg(telemetry.hasAvDrift ? telemetry.avDriftMs.toFixed(1) + " ms"
+                                                                          : qsTr("n/a")))
+                lines.push(qsTr("Bitrate: %1").arg(telemetry.bitrateKbps < 0 ? qsTr("n/a")
+                                                                             : Math.round(telemetry.bitrateKbps) + " kbps"))
+                if (telemetry.lastDumpPath !== "") lines.push(qsTr("Saved: %1").arg(telemetry.lastDumpPath))
+                return lines.join("\n")
+            }
+        }
+    }
+
     Connections {
         target: mediaEngine
 
@@ -232,8 +296,8 @@ Item {
         }
 
         function onCoverImageChanged() {
-            if (mediaEngine.coverArtBase64) {
-                coverArtImage.source = "data:image/png;base64," + mediaEngine.coverArtBase64
+            if (mediaEngine.coverArtSource) {
+                coverArtImage.source = mediaEngine.coverArtSource
             }
         }
     }
@@ -278,8 +342,8 @@ Item {
             Image {
                 id: smallArtImage
                 anchors.fill: parent
-                visible: mediaEngine.coverArtBase64 !== ""
-                source: mediaEngine.coverArtBase64 ? "data:image/png;base64," + mediaEngine.coverArtBase64 : ""
+                visible: mediaEngine.coverArtSource !== ""
+                source: mediaEngine.coverArtSource
                 fillMode: Image.PreserveAspectFit
                 cache: false
                 asynchronous: true // 异步加载
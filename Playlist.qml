@@ -4,13 +4,32 @@ import QtQuick.Controls
 //播放列表
 ScrollView {
     id:scoll
-    property PlaylistModel playlist
+    property var playlist                 // PlaylistModel或PlaylistSearchModel
+    property bool reorderable: true       // 搜索结果不允许拖拽排序
     width: parent.width * (1/3)      //位于播放器右侧
     height: parent.height
     visible: false
+    onVisibleChanged: if (visible) visibleRangeTimer.restart()
     anchors.right: parent.right
     clip: true
 
+    // 时长 · 分辨率 · 编码 · 大小，还没读取的部分不显示
+    function detailText(duration, resolution, codec, fileSize) {
+        var parts = []
+        if (duration > 0) {
+            var seconds = Math.floor(duration / 1000)
+            var h = Math.floor(seconds / 3600), m = Math.floor(seconds % 3600 / 60), s = seconds % 60
+            parts.push((h > 0 ? h + ":" + String(m).padStart(2, "0") : m) + ":" + String(s).padStart(2, "0"))
+        }
+        if (resolution) parts.push(resolution)
+        if (codec) parts.push(codec)
+        if (fileSize > 0) {
+            var units = ["B", "KB", "MB", "GB", "TB"], i = 0, size = fileSize
+            while (size >= 1024 && i < units.length - 1) { size /= 1024; i++ }
+            parts.push(size.toFixed(i > 1 ? 1 : 0) + " " + units[i])
+        }
+        return parts.join(" · ")
+    }
 
     ListView {
         id: listView
@@ -19,6 +38,49 @@ ScrollView {
         clip: true
         currentIndex:playlist.currentIndex
 
+        // 滚动停下后把可见范围告诉模型，附加信息只为这些行读取
+        onContentYChanged: visibleRangeTimer.restart()
+        onHeightChanged: visibleRangeTimer.restart()
+        onCountChanged: visibleRangeTimer.restart()
+        Timer {
+            id: visibleRangeTimer
+            interval: 50
+            onTriggered: {
+                if (!scoll.visible || listView.count === 0) return
+                var first = Math.floor(listView.contentY / 50)
+                var last = Math.floor((listView.contentY + listView.height - 1) / 50)
+                playlist.setVisibleRange(first, last)
+            }
+        }
+
+        // 后台读取元数据的进度，可取消
+        footerPositioning: ListView.OverlayFooter
+        footer: Rectangle {
+            width: scoll.width
+            height: playlist.importing === true ? 36 : 0
+            visible: playlist.importing === true
+            color: "white"
+            z: 3
+            Row {
+                anchors.fill: parent
+                anchors.margins: 6
+                spacing: 6
+                ProgressBar {
+                    width: parent.width - cancelImport.width - parent.spacing
+                    anchors.verticalCenter: parent.verticalCenter
+                    from: 0
+                    to: Math.max(1, playlist.importTotal)
+                    value: playlist.importDone
+                }
+                Button {
+                    id: cancelImport
+                    anchors.verticalCenter: parent.verticalCenter
+                    text: qsTr("Cancel")
+                    onClicked: playlist.cancelImport()
+                }
+            }
+        }
+
         // 添加位移过渡动画：使所有项都有平滑动画
         displaced: Transition {
             NumberAnimation {
@@ -35,11 +97,36 @@ ScrollView {
             color:index ===listView.currentIndex? "skyblue" : "white"  //当前视图项变蓝
             opacity: 0.8
             property int preIndex: -1
-            Label{
-                color: "black"
-                verticalAlignment: Text.AlignVCenter
-                anchors.fill: parent
-                text: model.title
+            Image {
+                id: thumbnail
+                width: model.thumbnail ? 80 : 0
+                height: 45
+                anchors.left: parent.left
+                anchors.verticalCenter: parent.verticalCenter
+                anchors.leftMargin: model.thumbnail ? 2 : 0
+                fillMode: Image.PreserveAspectFit
+                asynchronous: true
+                source: model.thumbnail ? model.thumbnail : ""
+            }
+            Column {
+                anchors.left: thumbnail.right
+                anchors.right: parent.right
+                anchors.leftMargin: 4
+                anchors.verticalCenter: parent.verticalCenter
+                Label{
+                    width: parent.width
+                    color: "black"
+                    elide: Text.ElideRight
+                    text: model.title
+                }
+                Label{
+                    width: parent.width
+                    visible: text !== ""
+                    color: "gray"
+                    font.pointSize: 8
+                    elide: Text.ElideRight
+                    text: scoll.detailText(model.duration, model.resolution, model.codec, model.fileSize)
+                }
             }
 
             //鼠标点击时的处理
@@ -55,7 +142,7 @@ ScrollView {
             DragHandler{
                 id:itemDrag
                 target: parent
-                enabled: true
+                enabled: scoll.reorderable
                 xAxis.enabled:false
                 yAxis.minimum: 0
                 yAxis.maximum: (listView.count-1) * 50
@@ -0,0 +1,10 @@
+#pragma once
+
+#include <QCoreApplication>
+#include <QSettings>
+
+// 设置保存在"Video-Player/Video Player"下。组织名只在这里传给QSettings，
+// 不调用QCoreApplication::setOrganizationName：那会让AppDataLocation多出一层目录，
+// 已有的历史记录、弹幕和缓存都会找不到
+inline constexpr char kSettingsOrganization[] = "Video-Player";
+
@@ -0,0 +1,128 @@
+// PlaylistModel在1万、5万、10万项下的添加、删除、移动和按url查找的耗时，按规模对比每次操作的纳秒数
+// 构建：cmake -DVIDEOPLAYER_BUILD_BENCHMARKS=ON，运行playlistmodel_bench
+// 只使用网络URL，不触发后台探测，测到的是模型本身和url索引的开销
+
+#include "playlistmodel.h"
+
+#include <QCoreApplication>
+#include <QElapsedTimer>
+#include <QRandomGenerator>
+#include <cstdio>
+#include <functional>
+
+namespace {
+constexpr int kSizes[] = {10000, 50000, 100000};
+constexpr int kMoves = 1000;
+constexpr int kRemoves = 1000;
+
+QUrl urlAt(int i)
+{
+    return QUrl(QString("http://bench.invalid/media/%1/video%2.mp4").arg(i % 997).arg(i));
+}
+
+// 规范化后与urlAt(i)相同的另一种写法
+QUrl aliasAt(int i)
+{
+    return QUrl(QString("http://bench.invalid/media/%1/./video%2.mp4/").arg(i % 997).arg(i));
+}
+
+void measure(const char *name, int ops, const std::function<void()> &body)
+{
+    QElapsedTimer timer;
+    timer.start();
+    body();
+    const qint64 ns = timer.nsecsElapsed();
+    std::printf("%-32s %8d ops %10.2f ms %10.0f ns/op\n", name, ops, ns / 1e6, double(ns) / ops);
+}
+
+// url索引的约定：每一行的url都能查到，并且查到的是同一个键的最后一行
+bool checkIndex(const PlaylistModel &model)
+{
+    const int rows = model.rowCount();
+    for (int i = 0; i < rows; i++) {
+        const int row = model.indexByUrl(model.getUrl(i));
+        if (row < i || model.indexByUrl(model.getUrl(row)) != row) {
+            std::printf("index check failed at row %d (indexByUrl = %d)\n", i, row);
+            return false;
+        }
+    }
+    return true;
+}
+
+void randomMoves(PlaylistModel &model, QRandomGenerator &random)
+{
+    for (int i = 0; i < kMoves; i++) {
+        const int rows = model.rowCount();
+        const int num = (i % 10 == 0) ? 10 : 1;
+        const int from = random.bounded(rows - num);
+        const int to = random.bounded(rows - num);
+        model.move(from, to, num);
+    }
+}
+
+bool run(int rows, bool normalize)
+{
+    std::printf("-- %d rows, normalizeUrls %s\n", rows, normalize ? "on" : "off");
+    const int batchRemove = rows / 10;
+    QRandomGenerator random(42);
+    bool ok = true;
+
+    PlaylistModel model;
+    model.setNormalizeUrls(normalize);
+
+    measure("addMedia", rows, [&]() {
+        for (int i = 0; i < rows; i++) model.addMedia(urlAt(i));
+    });
+    // 每10项加一个重复项：关闭规范化时是同一个url，打开时是写法不同的同一个路径
+    measure("addMedia (duplicates)", rows / 10, [&]() {
+        for (int i = 0; i < rows; i += 10) model.addMedia(normalize ? aliasAt(i) : urlAt(i));
+    });
+    ok &= checkIndex(model);
+
+    QList<QUrl> lookups;
+    lookups.reserve(rows);
+    for (int i = 0; i < rows; i++) lookups.append(urlAt(random.bounded(rows)));
+    int found = 0;
+    measure("indexByUrl", rows, [&]() {
+        for (const QUrl &url : std::as_const(lookups)) found += model.indexByUrl(url) >= 0;
+    });
+    if (found != rows) {
+        std::printf("indexByUrl missed %d urls\n", rows - found);
+        ok = false;
+    }
+
+    measure("move", kMoves, [&]() { randomMoves(model, random); });
+    ok &= checkIndex(model);
+
+    measure("removeMedia", kRemoves, [&]() {
+        for (int i = 0; i < kRemoves; i++) model.removeMedia(random.bounded(model.rowCount()));
+    });
+    ok &= checkIndex(model);
+
+    QList<QUrl> batch;
+    for (int i = 0; i < batchRemove; i++) batch.append(urlAt(random.bounded(rows)));
+    measure("removeMedias", batchRemove, [&]() { model.removeMedias(batch); });
+    ok &= checkIndex(model);
+
+    model.clear();
+    QList<QUrl> urls;
+    urls.reserve(rows);
+    for (int i = 0; i < rows; i++) urls.append(urlAt(i));
+    measure("addMedias (one batch)", rows, [&]() { model.addMedias(urls); });
+    ok &= checkIndex(model);
+    return ok;
+}
+} // namespace
+
+int main(int argc, char *argv[])
+{
+    QCoreApplication app(argc, argv);
+    app.setApplicationName("Video Player Benchmark"); // 设置单独保存，不改动播放器自己的设置
+
+    bool ok = true;
+    for (int rows : kSizes) {
+        ok &= run(rows, false);
+        ok &= run(rows, true);
+    }
+    return ok ? 0 : 1;
+}
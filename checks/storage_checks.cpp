@@ -0,0 +1,318 @@
+// 播放列表文件、搜索、弹幕库/日志和续播位置存储的正确性检查
+// 构建：cmake -DVIDEOPLAYER_BUILD_CHECKS=ON，运行storage_checks或ctest，有检查失败时返回非0
+// 全部在临时目录和测试模式的数据目录中进行，不改动播放器自己的文件
+
+#include "danmujournal.h"
+#include "danmustore.h"
+#include "fuzzymatcher.h"
+#include "mediacache.h"
+#include "playlistfile.h"
+#include "resumestore.h"
+#include "searchindex.h"
+
+#include <QCoreApplication>
+#include <QCryptographicHash>
+#include <QFile>
+#include <QFileInfo>
+#include <QStandardPaths>
+#include <QTemporaryDir>
+#include <QThread>
+#include <cstdio>
+
+namespace {
+int failures = 0;
+
+void check(bool ok, const char *expression, int line)
+{
+    if (ok) return;
+    std::printf("  FAILED line %d: %s\n", line, expression);
+    failures++;
+}
+
+#define CHECK(condition) check((condition), #condition, __LINE__)
+
+void writeText(const QString &filePath, const QByteArray &text)
+{
+    QFile file(filePath);
+    if (file.open(QIODevice::WriteOnly)) file.write(text);
+}
+
+QList<PlaylistEntry> readAll(const QString &filePath)
+{
+    QList<PlaylistEntry> entries;
+    PlaylistIO::read(filePath, [&entries](const PlaylistEntry &entry) {
+        entries.append(entry);
+        return true;
+    });
+    return entries;
+}
+
+// full为false时只比较M3U/XSPF能保存的url、标题和时长
+bool sameEntries(const QList<PlaylistEntry> &a, const QList<PlaylistEntry> &b, bool full)
+{
+    if (a.size() != b.size()) return false;
+    for (int i = 0; i < a.size(); i++) {
+        if (a[i].url != b[i].url || a[i].title != b[i].title || a[i].duration != b[i].duration) return false;
+        if (full && (a[i].metadata != b[i].metadata || a[i].thumbnail != b[i].thumbnail)) return false;
+    }
+    return true;
+}
+
+void checkPlaylistFiles()
+{
+    std::printf("-- PlaylistFile / PlaylistIO\n");
+    QTemporaryDir dir;
+    CHECK(dir.isValid());
+
+    // 文件名中的#和?在M3U里是普通字符，在XSPF的URI里必须保持编码
+    const QList<PlaylistEntry> entries{
+        {QUrl::fromLocalFile(dir.filePath("clip #1?.mp4")), "片段 #1, 导演剪辑版", "mp4 h264 1920x1080", "0123abcd", 61000},
+        {QUrl::fromLocalFile(dir.filePath("sub/视频 100%.mkv")), QString(), "matroska\n第一章", QString(), -1},
+        {QUrl("https://example.com/live/stream.m3u8?token=abc&id=7"), "直播", QString(), QString(), 0},
+    };
+    const auto entryAt = [&entries](int i) { return entries[i]; };
+
+    CHECK(PlaylistIO::formatOf("a.vppl") == PlaylistIO::Binary);
+    CHECK(PlaylistIO::formatOf("a.M3U8") == PlaylistIO::M3U);
+    CHECK(PlaylistIO::formatOf("a.xspf") == PlaylistIO::XSPF);
+    CHECK(PlaylistIO::formatOf("a.txt") == PlaylistIO::Unknown);
+
+    const QString binaryPath = dir.filePath("list.vppl");
+    CHECK(PlaylistIO::write(binaryPath, entries.size(), entryAt));
+    CHECK(sameEntries(readAll(binaryPath), entries, true));
+    PlaylistFile playlist;
+    CHECK(playlist.open(binaryPath));
+    CHECK(playlist.count() == entries.size());
+    CHECK(playlist.entry(1).metadata == entries[1].metadata);
+    CHECK(playlist.entry(entries.size()).url.isEmpty());
+    playlist.close();
+
+    const QString m3uPath = dir.filePath("list.m3u8");
+    CHECK(PlaylistIO::write(m3uPath, entries.size(), entryAt));
+    CHECK(sameEntries(readAll(m3uPath), entries, false));
+
+    const QString xspfPath = dir.filePath("list.xspf");
+    CHECK(PlaylistIO::write(xspfPath, entries.size(), entryAt));
+    CHECK(sameEntries(readAll(xspfPath), entries, false));
+
+    // 相对路径按播放列表所在目录解析
+    const QString relativePath = dir.filePath("relative.m3u");
+    writeText(relativePath, "#EXTM3U\n#EXTINF:5,相对路径\nsub/rel #2.mp4\n");
+    const QList<PlaylistEntry> relative = readAll(relativePath);
+    CHECK(relative.size() == 1 && relative[0].url == QUrl::fromLocalFile(dir.filePath("sub/rel #2.mp4")));
+    CHECK(relative.size() == 1 && relative[0].duration == 5000 && relative[0].title == "相对路径");
+
+    const QString xspfRelative = dir.filePath("relative.xspf");
+    writeText(xspfRelative, "<?xml version=\"1.0\"?><playlist version=\"1\" xmlns=\"http://xspf.org/ns/0/\"><trackList>"
+                            "<track><location>sub/rel%20%232.mp4</location></track></trackList></playlist>");
+    const QList<PlaylistEntry> xspf = readAll(xspfRelative);
+    CHECK(xspf.size() == 1 && xspf[0].url == QUrl::fromLocalFile(dir.filePath("sub/rel #2.mp4")));
+
+    // 回调返回false时停止读取
+    int visited = 0;
+    CHECK(PlaylistIO::read(m3uPath, [&visited](const PlaylistEntry &) { return ++visited < 2; }));
+    CHECK(visited == 2);
+
+    // 损坏的二进制文件打不开
+    const QString brokenPath = dir.filePath("broken.vppl");
+    writeText(brokenPath, "VPPL but not really a playlist");
+    CHECK(!playlist.open(brokenPath));
+}
+
+void checkSearch()
+{
+    std::printf("-- SearchIndex / FuzzyMatcher\n");
+    CHECK(SearchIndex::normalize("ＡＢＣ Café") == "abc cafe");
+    CHECK(SearchIndex::normalize("が") == "が"); // 日文浊点不能去掉
+    CHECK(SearchIndex::normalize("が") != SearchIndex::normalize("か"));
+
+    SearchIndex index;
+    index.insert("a", "Big Buck Bunny.mp4");
+    index.insert("b", "Café au lait.mkv");
+    index.insert("c", "東京物語.mp4");
+    CHECK(index.size() == 3);
+    CHECK(index.search(SearchIndex::normalize("CAFE")) == QSet<QString>{"b"});
+    CHECK(index.search(SearchIndex::normalize("東京")) == QSet<QString>{"c"}); // 短查询走单字索引
+    CHECK(index.search(SearchIndex::normalize(".mp4")) == (QSet<QString>{"a", "c"}));
+    CHECK(index.search("bunny buck").isEmpty()); // 词都在，但不是连续的子串
+    CHECK(index.matches("a", "buck"));
+
+    const auto before = index.snapshot();
+    index.insert("a", "Big Buck Bunny.mp4");
+    CHECK(index.snapshot() == before); // 文本没变，快照继续有效
+    index.insert("a", "Sintel.mkv");
+    CHECK(index.search("bunny").isEmpty());
+    CHECK(index.search("sintel") == QSet<QString>{"a"});
+    index.remove("b");
+    CHECK(!index.contains("b") && index.search("cafe").isEmpty());
+    index.insert("d", "Café noir.mp4"); // 复用释放的文档id
+    CHECK(index.search("cafe") == QSet<QString>{"d"});
+    CHECK(index.snapshot()->size() == 3);
+
+    using FuzzyMatcher::kNoMatch;
+    using FuzzyMatcher::score;
+    CHECK(score("big buck bunny", "bbb") != kNoMatch);
+    CHECK(score("big buck bunny", "xyz") == kNoMatch);
+    CHECK(score("big buck bunny", "bukc") != kNoMatch);  // 四个字符允许一个错字
+    CHECK(score("big buck bunny", "bkxz") == kNoMatch);  // 两个错字太多
+    CHECK(score("big buck bunny", "buck") > score("bat unicorn kicks", "buck"));
+    CHECK(score("buck\nother", "buck") > score("other\nbuck", "buck")); // 标题里的命中靠前
+    CHECK(score("buck", "buck") > score("buck bunny collection", "buck"));
+}
+
+void checkDanmuStore()
+{
+    std::printf("-- DanmuStore\n");
+    QTemporaryDir dir;
+    CHECK(dir.isValid());
+
+    // 第2个时间桶(20~30秒)是空的
+    const QList<DanmuRecord> records{{500, "第一条"}, {9999, "hello world"}, {10000, "边界"}, {35000, "最后 一条"}};
+    const QString storePath = dir.filePath("a.vpdm");
+    CHECK(DanmuStore::save(storePath, records.size(), [&records](int i) { return records[i]; }));
+
+    DanmuStore store;
+    CHECK(store.open(storePath));
+    CHECK(store.count() == records.size());
+    CHECK(store.bucketCount() == 4);
+    CHECK(store.bucketOf(9999) == 0 && store.bucketOf(10000) == 1 && store.bucketOf(-5) == 0);
+    CHECK(store.bucket(0).size() == 2);
+    CHECK(store.bucket(1).size() == 1 && store.bucket(1)[0].content == "边界");
+    CHECK(store.bucket(2).isEmpty());
+    CHECK(store.bucket(3).size() == 1 && store.bucket(3)[0].time == 35000);
+    CHECK(store.bucket(4).isEmpty());
+    for (int i = 0; i < records.size(); i++) {
+        CHECK(store.record(i).time == records[i].time && store.record(i).content == records[i].content);
+    }
+    store.close();
+
+    const QString emptyPath = dir.filePath("empty.vpdm");
+    CHECK(DanmuStore::save(emptyPath, 0, [](int) { return DanmuRecord{}; }));
+    CHECK(store.open(emptyPath) && store.count() == 0);
+    store.close();
+
+    const QString textPath = dir.filePath("a.txt");
+    writeText(textPath, "1500 hello world\nnot-a-time 1\n\n2000 带 空格\n");
+    const QList<DanmuRecord> text = DanmuStore::readText(textPath);
+    CHECK(text.size() == 2);
+    CHECK(text.size() == 2 && text[0].content == "hello world" && text[1].time == 2000);
+
+    writeText(storePath, "VPDM");
+    CHECK(!store.open(storePath));
+}
+
+void checkDanmuJournal()
+{
+    std::printf("-- DanmuJournal\n");
+    QTemporaryDir dir;
+    CHECK(dir.isValid());
+    const QString storePath = dir.filePath("a.vpdm");
+    const QString journalPath = dir.filePath("a.journal");
+
+    // 析构时写出待写的弹幕并等后台完成，但不合并
+    {
+        DanmuJournal journal;
+        journal.open(storePath, journalPath, QString());
+        journal.append({1000, "一"});
+        journal.append({2000, "two"});
+        journal.append({3000, "写到一半"});
+    }
+    QList<DanmuRecord> records = DanmuJournal::readJournal(journalPath);
+    CHECK(records.size() == 3 && records[2].content == "写到一半");
+
+    // 模拟写最后一条时断电：读取时丢掉它并截断文件
+    const qint64 fullSize = QFileInfo(journalPath).size();
+    CHECK(QFile::resize(journalPath, fullSize - 3));
+    records = DanmuJournal::readJournal(journalPath);
+    CHECK(records.size() == 2 && records[1].content == "two");
+    const qint64 truncatedSize = QFileInfo(journalPath).size();
+    CHECK(truncatedSize < fullSize - 3);
+
+    // 截断后追加的记录能对齐读出
+    {
+        DanmuJournal journal;
+        journal.open(storePath, journalPath, QString());
+        journal.append({2500, "之后追加"});
+    }
+    records = DanmuJournal::readJournal(journalPath);
+    CHECK(records.size() == 3 && records[2].time == 2500 && records[2].content == "之后追加");
+
+    // 只有文件头的一部分时整个日志作废
+    const QString brokenPath = dir.filePath("broken.journal");
+    writeText(brokenPath, "VPD");
+    CHECK(DanmuJournal::readJournal(brokenPath).isEmpty());
+    CHECK(!QFile::exists(brokenPath));
+
+    // 关闭时把日志按时间归并进弹幕库并删除日志
+    {
+        DanmuJournal journal;
+        journal.open(storePath, journalPath, QString());
+        journal.append({12000, "新的一桶"});
+        journal.close();
+    }
+    CHECK(!QFile::exists(journalPath));
+    DanmuStore store;
+    CHECK(store.open(storePath));
+    CHECK(store.count() == 4);
+    CHECK(store.record(0).time == 1000 && store.record(1).time == 2000 && store.record(2).time == 2500);
+    CHECK(store.bucket(1).size() == 1 && store.bucket(1)[0].content == "新的一桶");
+}
+
+QByteArray keyAt(int i)
+{
+    return QCryptographicHash::hash(QByteArray::number(i), QCryptographicHash::Sha1);
+}
+
+void checkResumeStore()
+{
+    std::printf("-- ResumeStore\n");
+    // 测试模式的数据目录，先删掉上次运行留下的记录
+    QFile::remove(MediaCache::cacheDir("Video-Player_Resume").filePath("positions.log"));
+    ResumeStore &store = ResumeStore::instance();
+
+    CHECK(ResumeStore::keyFor(QUrl("https://example.com/a.mp4")).size() == 20);
+    CHECK(ResumeStore::keyFor(QUrl::fromLocalFile("/nonexistent/video.mp4")).isEmpty());
+
+    store.setPosition(keyAt(0), 1234);
+    CHECK(store.position(keyAt(0)) == 1234);
+    store.setPosition("short key", 1);
+    CHECK(store.position("short key") == -1);
+    store.remove(keyAt(0));
+    CHECK(store.position(keyAt(0)) == -1);
+
+    // 超出上限一成后只保留最近更新的5万项
+    constexpr int kOld = 6000;
+    constexpr int kNew = 50000;
+    for (int i = 0; i < kOld; i++) store.setPosition(keyAt(i), i + 1);
+    QThread::msleep(20); // 让两批的更新时间一定不同
+    for (int i = kOld; i < kOld + kNew; i++) store.setPosition(keyAt(i), i + 1);
+    store.flush();
+
+    int oldLeft = 0;
+    for (int i = 0; i < kOld; i++) oldLeft += store.position(keyAt(i)) >= 0;
+    int newLeft = 0;
+    for (int i = kOld; i < kOld + kNew; i++) newLeft += store.position(keyAt(i)) == i + 1;
+    CHECK(oldLeft == 0);
+    CHECK(newLeft == kNew);
+}
+} // namespace
+
+int main(int argc, char *argv[])
+{
+    QCoreApplication app(argc, argv);
+    app.setApplicationName("Video Player Checks");
+    QStandardPaths::setTestModeEnabled(true);
+
+    checkPlaylistFiles();
+    checkSearch();
+    checkDanmuStore();
+    checkDanmuJournal();
+    checkResumeStore();
+
+    if (failures > 0) {
+        std::printf("%d checks failed\n", failures);
+        return 1;
+    }
+    std::printf("all checks passed\n");
+    return 0;
+}
@@ -13,5 +13,4 @@ public:
 private:
     qint64 m_sendTime;
     QString m_content;
-    bool m_isAllocate = false;
 };
@@ -0,0 +1,219 @@
+#include "danmujournal.h"
+
+#include <QDebug>
+#include <QFile>
+#include <QPointer>
+#include <QtEndian>
+#include <algorithm>
+
+#ifdef Q_OS_WIN
+#include <io.h>
+#else
+#include <unistd.h>
+#endif
+
+namespace {
+constexpr quint32 kJournalMagic = 0x5650444A; // "VPDJ"
+constexpr quint32 kJournalVersion = 1;
+constexpr int kHeaderSize = 8;
+constexpr int kRecordHeaderSize = 12;        // time + 内容长度
+constexpr int kFlushInterval = 1000;         // 一秒内发送的弹幕合并成一次写入和一次fsync
+constexpr qint64 kCompactThreshold = 4096;   // 日志超过这么多条时合并进弹幕库
+
+QByteArray header()
+{
+    char buffer[kHeaderSize];
+    qToLittleEndian<quint32>(kJournalMagic, buffer);
+    qToLittleEndian<quint32>(kJournalVersion, buffer + 4);
+    return QByteArray(buffer, kHeaderSize);
+}
+
+void syncFile(QFile &file)
+{
+    file.flush();
+#ifdef Q_OS_WIN
+    _commit(file.handle());
+#else
+    ::fsync(file.handle());
+#endif
+}
+} // namespace
+
+DanmuJournal::DanmuJournal(QObject *parent)
+    : QObject(parent)
+    , m_journalRecords{0}
+    , m_nextSequence{1}
+    , m_generation{0}
+{
+    m_writer.setMaxThreadCount(1);
+    m_flushTimer = new QTimer(this);
+    m_flushTimer->setSingleShot(true);
+    m_flushTimer->setInterval(kFlushInterval);
+    connect(m_flushTimer, &QTimer::timeout, this, &DanmuJournal::flush);
+}
+
+DanmuJournal::~DanmuJournal()
+{
+    flush();
+    m_writer.waitForDone();
+}
+
+void DanmuJournal::open(const QString &storePath, const QString &journalPath, const QString &legacyTextPath)
+{
+    close();
+    m_storePath = storePath;
+    m_journalPath = journalPath;
+    const quint64 generation = ++m_generation;
+
+    QPointer<DanmuJournal> self(this);
+    m_writer.start([self, generation, storePath, journalPath, legacyTextPath]() {
+        // 旧版本的文本文件只在第一次打开时转换
+        if (!QFile::exists(storePath) && QFile::exists(legacyTextPath)) {
+            const QList<DanmuRecord> records = DanmuStore::readText(legacyTextPath);
+            if (DanmuStore::save(storePath, records.size(), [&records](int i) { return records[i]; })) {
+                QFile::remove(legacyTextPath);
+            } else {
+                qWarning() << "DanmuJournal: failed to migrate" << legacyTextPath;
+            }
+        }
+
+        const QList<DanmuRecord> records = readJournal(journalPath);
+        QMetaObject::invokeMethod(
+            self, [self, generation, records]() {
+                if (!self || generation != self->m_generation) return;
+                const quint64 first = self->m_nextSequence;
+                self->m_nextSequence += records.size();
+                self->m_journalRecords += records.size();
+                emit self->opened(first, records);
+            }, Qt::QueuedConnection);
+    });
+}
+
+void DanmuJournal::close()
+{
+    if (m_journalPath.isEmpty()) return;
+    flush();
+    if (m_journalRecords > 0) compact(); //切换视频时把日志并入弹幕库，下次打开不用再读日志
+    ++m_generation;
+    m_journalRecords = 0;
+    m_storePath.clear();
+    m_journalPath.clear();
+}
+
+quint64 DanmuJournal::append(const DanmuRecord &record)
+{
+    m_pending.append(record);
+    if (!m_flushTimer->isActive()) m_flushTimer->start();
+    return m_nextSequence++;
+}
+
+void DanmuJournal::flush()
+{
+    m_flushTimer->stop();
+    if (m_pending.isEmpty() || m_journalPath.isEmpty()) return;
+
+    const QList<DanmuRecord> records = std::exchange(m_pending, {});
+    const QString journalPath = m_journalPath;
+    m_writer.start([journalPath, records]() { appendRecords(journalPath, records); });
+    m_journalRecords += records.size();
+    if (m_journalRecords > kCompactThreshold) compact();
+}
+
+void DanmuJournal::compact()
+{
+    // 排在前面的追加都已写入，这之前分配的序号全部在日志文件中
+    const quint64 sequence = m_nextSequence - 1;
+    const quint64 generation = m_generation;
+    const QString storePath = m_storePath;
+    const QString journalPath = m_journalPath;
+    m_journalRecords = 0;
+
+    QPointer<DanmuJournal> self(this);
+    m_writer.start([self, generation, sequence, storePath, journalPath]() {
+        if (!compactFiles(storePath, journalPath)) return;
+        QMetaObject::invokeMethod(
+            self, [self, generation, sequence]() {
+                if (self && generation == self->m_generation) emit self->compacted(sequence);
+            }, Qt::QueuedConnection);
+    });
+}
+
+void DanmuJournal::appendRecords(const QString &journalPath, const QList<DanmuRecord> &records)
+{
+    QByteArray data;
+    for (const DanmuRecord &record : records) {
+        const QByteArray utf8 = record.content.toUtf8();
+        char buffer[kRecordHeaderSize];
+        qToLittleEndian<qint64>(record.time, buffer);
+        qToLittleEndian<quint32>(quint32(utf8.size()), buffer + 8);
+        data.append(buffer, kRecordHeaderSize);
+        data.append(utf8);
+    }
+
+    QFile file(journalPath);
+    if (!file.open(QIODevice::WriteOnly | QIODevice::Append)) {
+        qWarning() << "DanmuJournal: cannot open" << journalPath << file.errorString();
+        return;
+    }
+    if (file.size() == 0) data.prepend(header());
+    if (file.write(data) != data.size()) qWarning() << "DanmuJournal: failed to append" << journalPath;
+    syncFile(file); //一批只同步一次
+}
+
+bool DanmuJournal::compactFiles(const QString &storePath, const QString &journalPath)
+{
+    QList<DanmuRecord> journal = readJournal(journalPath);
+    if (journal.isEmpty()) return true;
+    std::stable_sort(journal.begin(), journal.end(),
+                     [](const DanmuRecord &a, const DanmuRecord &b) { return a.time < b.time; });
+
+    // 弹幕库和日志都按时间排序，归并后整体写出
+    QList<DanmuRecord> records;
+    {
+        DanmuStore store;
+        if (store.open(storePath)) {
+            records.reserve(store.count() + journal.size());
+            for (int i = 0; i < store.count(); i++) records.append(store.record(i));
+        }
+    }
+    const qsizetype existing = records.size();
+    records.append(journal);
+    std::inplace_merge(records.begin(), records.begin() + existing, records.end(),
+                       [](const DanmuRecord &a, const DanmuRecord &b) { return a.time < b.time; });
+
+    // Windows上界面仍映射着弹幕库时替换会失败，日志保留到切换视频时再合并
+    if (!DanmuStore::save(storePath, records.size(), [&records](int i) { return records[i]; })) {
+        qWarning() << "DanmuJournal: failed to compact" << storePath;
+        return false;
+    }
+    QFile::remove(journalPath);
+    return true;
+}
+
+QList<DanmuRecord> DanmuJournal::readJournal(const QString &journalPath)
+{
+    QList<DanmuRecord> records;
+    QFile file(journalPath);
+    if (!file.open(QIODevice::ReadOnly)) return records;
+    const QByteArray data = file.readAll();
+    file.close();
+    if (data.size() < kHeaderSize || qFromLittleEndian<quint32>(data.constData()) != kJournalMagic
+        || qFromLittleEndian<quint32>(data.constData() + 4) != kJournalVersion) {
+        qWarning() << "DanmuJournal: invalid journal" << journalPath;
+        QFile::remove(journalPath);
+        return records;
+    }
+
+    qint64 offset = kHeaderSize;
+    while (offset + kRecordHeaderSize <= data.size()) {
+        const qint64 time = qFromLittleEndian<qint64>(data.constData() + offset);
+        const quint32 length = qFromLittleEndian<quint32>(data.constData() + offset + 8);
+        if (offset + kRecordHeaderSize + qint64(length) > data.size()) break;
+        records.append(DanmuRecord{time, QString::fromUtf8(data.constData() + offset + kRecordHeaderSize, length)});
+        offset += kRecordHeaderSize + length;
+    }
+
+    // 截掉末尾写到一半的记录，之后追加的记录才能对齐
+    if (offset != data.size()) QFile::resize(journalPath, offset);
+    return records;
+}
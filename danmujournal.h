@@ -0,0 +1,47 @@
+#pragma once
+
+#include <QList>
+#include <QObject>
+#include <QThreadPool>
+#include <QTimer>
+
+#include "danmustore.h"
+
+// 新发送弹幕的追加日志(<title>danmu.journal)：
+// 发送时只放进内存中的待写列表，后台线程每批追加一次并fsync一次，发送的代价与已有弹幕数无关；
+// 日志超过一定条数或切换视频时，后台把日志合并进弹幕库后删除日志
+// 打开、追加和合并都在同一个单线程池中排队执行，互相之间不需要加锁
+class DanmuJournal : public QObject
+{
+    Q_OBJECT
+public:
+    explicit DanmuJournal(QObject *parent = nullptr);
+    ~DanmuJournal() override; // 写出还没落盘的弹幕
+
+    // 关闭当前的日志(需要时合并)，在后台转换旧版本文本文件并读取新日志，完成后发出opened
+    void open(const QString &storePath, const QString &journalPath, const QString &legacyTextPath);
+    void close();
+    quint64 append(const DanmuRecord &record); // 返回这条弹幕的序号
+    void flush();                              // 立即把待写的弹幕交给后台
+
+    static QList<DanmuRecord> readJournal(const QString &journalPath); // 末尾写到一半的记录会被截掉
+
+signals:
+    void opened(quint64 firstSequence, const QList<DanmuRecord> &records); // 日志中已有的弹幕，序号从firstSequence开始连续
+    void compacted(quint64 sequence); // 序号不大于sequence的弹幕已经在弹幕库中
+
+private:
+    void compact(); // 在后台合并当前日志
+
+    static void appendRecords(const QString &journalPath, const QList<DanmuRecord> &records);
+    static bool compactFiles(const QString &storePath, const QString &journalPath);
+
+    QString m_storePath;
+    QString m_journalPath;
+    QList<DanmuRecord> m_pending; // 还没交给后台的弹幕
+    qint64 m_journalRecords;      // 日志文件中的记录条数
+    quint64 m_nextSequence;
+    quint64 m_generation;         // 每次open递增，丢弃旧文件的回调
+    QTimer *m_flushTimer;
+    QThreadPool m_writer;
+};
@@ -4,39 +4,88 @@
 #include <QFont>
 #include <QFontMetrics>
 #include <algorithm>
+#include <limits>
 #include <QStandardPaths>
 
-DanmuManager::DanmuManager(QObject *parent) : QObject{parent}, m_speed{0.1}
+namespace {
+constexpr qint64 kNoCursor = std::numeric_limits<qint64>::min();
+constexpr int kNoBucket = std::numeric_limits<int>::min();
+constexpr qint64 kMaxGap = 2000; // 两次调度的播放时间相差超过2秒(跳转、关闭弹幕期间)时按跳转处理
+} // namespace
+
+DanmuManager::DanmuManager(QObject *parent)
+    : QObject{parent}
+    , m_speed{0.1}
+    , m_cursor{kNoCursor}
+    , m_lastBucket{kNoBucket}
+    , _font{new Font{}}
+    , m_fontMetrics{QFont{_font->m_font, _font->m_size}}
 {
-    _font = new Font{};
+    m_journal = new DanmuJournal(this);
+    connect(m_journal, &DanmuJournal::opened, this, &DanmuManager::onJournalOpened);
+    connect(m_journal, &DanmuJournal::compacted, this, &DanmuManager::onJournalCompacted);
 }
 
 void DanmuManager::initDanmus(
     QString title)
 {
-    //清空弹幕列表和改变title
-    m_danmus.clear();
+    //同一个视频(切换字号)只重置调度状态，已解码的时间桶继续使用
+    seek();
+    if (title == m_title && !m_title.isEmpty()) return;
+
+    //弹幕库在日志读完后才打开，上一个视频的日志在后台合并
+    m_store.close();
+    m_buckets.clear();
+    m_lastBucket = kNoBucket;
+    m_journalled.clear();
     m_title = title;
+    m_journal->open(storePath(), generateFilePath().filePath(m_title + "danmu.journal"),
+                    generateFilePath().filePath(m_title + "danmu.txt"));
+}
+
+QString DanmuManager::storePath() const
+{
+    return generateFilePath().filePath(m_title + "danmu.vpdm");
+}
+
+void DanmuManager::onJournalOpened(
+    quint64 firstSequence, const QList<DanmuRecord> &records)
+{
+    //此时旧版本文件的转换和之前排队的合并都已完成
+    m_store.open(storePath()); //还没有弹幕时文件不存在
+    for (int i = 0; i < records.size(); i++) m_journalled.insert(firstSequence + i, records[i]);
+    m_buckets.clear();
+    m_lastBucket = kNoBucket;
+    seek(); //打开之前调度时弹幕库还是空的，从当前画面重新开始
+}
 
-    QString filePath = generateFilePath().filePath(m_title + "danmu.txt");
-
-    //从文件读入弹幕
-    QFile file(filePath);
-    if (!file.open(QIODevice::ReadOnly | QIODevice::Text)) { return; }
-    QTextStream in(&file);
-    while (!in.atEnd()) {
-        qint64 startTime = 0;
-        QString content;
-        QString line = in.readLine();
-
-        //读入每行的开始时间和内容
-        bool ok;
-        startTime = line.section(" ", 0, 0).toLongLong(&ok);
-        if (!ok) { continue; }
-        content = line.section(" ", 1, 1);
-        m_danmus.append(Danmu{startTime, content});
+void DanmuManager::onJournalCompacted(
+    quint64 sequence)
+{
+    //重新映射合并后的弹幕库，已经并入的日志记录不再需要；已解码的时间桶内容不变
+    m_store.open(storePath());
+    for (auto it = m_journalled.begin(); it != m_journalled.end() && it.key() <= sequence;) it = m_journalled.erase(it);
+}
+
+QList<Danmu> &DanmuManager::loadBucket(
+    int index)
+{
+    auto it = m_buckets.find(index);
+    if (it != m_buckets.end()) return it.value();
+
+    QList<Danmu> danmus;
+    const QList<DanmuRecord> records = m_store.bucket(index);
+    danmus.reserve(records.size());
+    for (const DanmuRecord &record : records) danmus.append(Danmu{record.time, record.content});
+    //还没并入弹幕库的新弹幕
+    for (const DanmuRecord &record : std::as_const(m_journalled)) {
+        if (m_store.bucketOf(record.time) != index) continue;
+        auto pos = std::upper_bound(danmus.begin(), danmus.end(), record.time, [](qint64 a, const Danmu &b) {
+            return a < b.m_sendTime;
+        });
+        danmus.insert(pos, Danmu{record.time, record.content});
     }
-    file.close();
+    return m_buckets.insert(index, danmus).value();
 }
 
 void DanmuManager::initTracks(
@@ -44,9 +93,7 @@ void DanmuManager::initTracks(
 {
     m_danmuTracks.clear();
     //获取qml中显示的text的高度
-    QFont font{_font->m_font, _font->m_size};
-    QFontMetrics fontMetrics(font);
-    int height = fontMetrics.height();
+    int height = m_fontMetrics.height();
 
     //初始化轨道
     int n = high / height;
@@ -58,32 +105,34 @@ void DanmuManager::initTracks(
 void DanmuManager::addDanmu(
     qint64 startTime, QString content)
 {
-    Danmu danmu{startTime, content};
-
-    //寻找插入的位置
-    auto it = std::lower_bound(m_danmus.begin(), m_danmus.end(), startTime, [](Danmu &a, qint64 b) {
-        return a.m_sendTime < b;
-    });
-    //插入
-    m_danmus.insert(it, danmu);
+    //追加到日志，与已有弹幕的数量无关
+    const DanmuRecord record{startTime, content};
+    m_journalled.insert(m_journal->append(record), record);
+    //界面时钟在两次位置更新之间会略超前，游标已经越过的弹幕单独排进下一次调度
+    if (m_cursor != kNoCursor && startTime <= m_cursor) m_late.append(Danmu{startTime, content});
 
-    //保存弹幕
-    saveDanmu();
+    //已经解码的时间桶直接插入，下次分配时就能显示
+    auto it = m_buckets.find(m_store.bucketOf(startTime));
+    if (it != m_buckets.end()) {
+        QList<Danmu> &danmus = it.value();
+        auto pos = std::upper_bound(danmus.begin(), danmus.end(), startTime, [](qint64 a, const Danmu &b) {
+            return a < b.m_sendTime;
+        });
+        danmus.insert(pos, Danmu{startTime, content});
+    }
 }
 
 void DanmuManager::saveDanmu()
 {
-    QString filePath = generateFilePath().filePath(m_title + "danmu.txt");
+    m_journal->flush();
+}
 
-    QFile file(filePath);
-    if (!file.open(QIODevice::WriteOnly | QIODevice::Text | QIODevice::Truncate)) {
-        qDebug() << m_title + "danmu save failed";
-    }
-    QTextStream out(&file);
-    for (Danmu &i : m_danmus) {
-        out << QString::number(i.m_sendTime) << " " << i.m_content << "\n";
-    }
-    file.close();
+void DanmuManager::seek()
+{
+    //只重置内存中的游标和轨道，弹幕库和已解码的时间桶不动
+    m_cursor = kNoCursor;
+    m_late.clear();
+    for (DanmuTrack &track : m_danmuTracks) track.m_lastTime = std::numeric_limits<qint64>::min();
 }
 
 QList<QList<QVariant>> DanmuManager::danmus(
@@ -92,57 +141,70 @@ QList<QList<QVariant>> DanmuManager::danmus(
     //初始化返回数组
     QList<QList<QVariant>> ans;
 
-    //如果为空直接返回
-    if (m_danmus.size() == 0)
-        return ans;
+    //待调度范围为(from, currentTime]；跳转后从屏幕上应当出现的最早的弹幕开始
+    qint64 from = m_cursor;
+    if (m_cursor == kNoCursor || currentTime - m_cursor > kMaxGap || m_cursor - currentTime > kMaxGap) {
+        seek();
+        from = qMax<qint64>(-1, currentTime - qint64(width / m_speed));
+    } else if (currentTime <= m_cursor) {
+        return ans; //播放位置更新带来的小幅回退，等时钟追上游标
+    }
+    m_cursor = currentTime;
 
-    //初始化字体学（QFontMetrics）
-    QFont font{_font->m_font, _font->m_size};
-    QFontMetrics fontMetrics(font);
-
-    //初始化备选列表
-    QList<Danmu *> option;
-    auto it = std::lower_bound(m_danmus.begin(), //用二分查找寻找第一个大于等于当前时间的弹幕
-                               m_danmus.end(),
-                               currentTime + 1000,
-                               [](Danmu &a, qint64 b) { return a.m_sendTime < b; });
-    int right = std::distance(m_danmus.begin(), it); //获取备选的右边界
-
-    it = std::lower_bound(m_danmus.begin(),
-                          m_danmus.end(),
-                          currentTime - width / m_speed,
-                          [](Danmu &a, qint64 b) {
-                              return a.m_sendTime
-                                     < b; //currentTime-width/m_speed：屏幕出现的弹幕的最小开始时间
-                          });
-    int left = std::distance(m_danmus.begin(), it); //获取备选的左边界
-    for (int i = left; i < right; i++) {
-        option.append(&m_danmus[i]);
+    const int firstBucket = m_store.bucketOf(from + 1);
+    const int lastBucket = m_store.bucketOf(currentTime);
+    const bool sameBucket = firstBucket == lastBucket && lastBucket == m_lastBucket; //逐帧调度时的常见情况
+    if (num <= 0 && sameBucket) {
+        m_late.clear(); //同屏已满，和下面一样直接丢弃
+        return ans;
+    }
+    if (!sameBucket) {
+        //离开调度范围的时间桶释放掉，常驻内存只与范围大小有关
+        for (auto it = m_buckets.begin(); it != m_buckets.end();) {
+            if (it.key() < firstBucket - 1 || it.key() > lastBucket + 1) {
+                it = m_buckets.erase(it);
+            } else {
+                ++it;
+            }
+        }
+        m_lastBucket = lastBucket;
     }
-    //分配弹幕
-    for (Danmu *i : option) {
-        if (i->m_isAllocate)
-            continue;
+    const QFontMetrics &fontMetrics = m_fontMetrics;
+
+    auto allocate = [&](const Danmu &danmu) {
         for (DanmuTrack &j : m_danmuTracks) { //从列表里获取可置入的轨道
-            if (i->m_sendTime > j.m_lastTime) {
-                int fontWidth = fontMetrics.horizontalAdvance(i->m_content);
-                int x = width - (currentTime - i->m_sendTime) * m_speed;
-                j.m_lastTime = i->m_sendTime + fontWidth / m_speed
+            if (danmu.m_sendTime > j.m_lastTime) {
+                int fontWidth = fontMetrics.horizontalAdvance(danmu.m_content);
+                //按发送时间算出currentTime时刻的位置，不受调度时机影响
+                double x = width - (currentTime - danmu.m_sendTime) * m_speed;
+                j.m_lastTime = danmu.m_sendTime + fontWidth / m_speed
                                + 100; //更新轨道最后弹幕的结束时间,加100,增加弹幕之间的间隔
                 ans.append(QList<QVariant>{
                     QVariant{x},                        //弹幕的起始x坐标
-                    QVariant{j.m_y},                    //弹幕的x坐标
+                    QVariant{j.m_y},                    //弹幕的y坐标
                     QVariant{-fontWidth},               //结束位置
-                    QVariant{i->m_content},             //内容
+                    QVariant{danmu.m_content},          //内容
                     QVariant{(x + fontWidth) / m_speed} //持续时间
                 });
                 num--;
-                i->m_isAllocate = true;
-                if (num == 0)
-                    return ans; //分配了足够的弹幕，直接返回
-                break;
+                return;
             }
         }
+    };
+
+    //刚发送但时间已经落在游标之前的弹幕
+    for (const Danmu &danmu : std::as_const(m_late)) {
+        if (num > 0) allocate(danmu);
+    }
+    m_late.clear();
+
+    //分配弹幕：没有空闲轨道或同屏数量已满的弹幕直接丢弃，游标照常前进
+    for (int b = firstBucket; b <= lastBucket && num > 0; b++) {
+        const QList<Danmu> &danmus = loadBucket(b); //已解码时只是一次查找
+        auto it = std::upper_bound(danmus.cbegin(), danmus.cend(), from, [](qint64 a, const Danmu &d) {
+            return a < d.m_sendTime;
+        });
+        for (; it != danmus.cend() && it->m_sendTime <= currentTime && num > 0; ++it) allocate(*it);
     }
 
     return ans;
@@ -171,6 +233,11 @@ int DanmuManager::speed()
     return m_speed;
 }
 
+void DanmuManager::updateFontMetrics()
+{
+    m_fontMetrics = QFontMetrics(QFont{_font->m_font, _font->m_size});
+}
+
 void DanmuManager::setSpeed(
     int speed)
 {
@@ -185,7 +252,10 @@ QString DanmuManager::fontName()
 void DanmuManager::setFontName(
     QString name)
 {
+    if (_font->m_font == name) return;
     _font->m_font = name;
+    updateFontMetrics();
+    emit fontNameChanged();
 }
 
 int DanmuManager::fontSize()
@@ -196,5 +266,8 @@ int DanmuManager::fontSize()
 void DanmuManager::setFontSize(
     int size)
 {
+    if (_font->m_size == size) return;
     _font->m_size = size;
+    updateFontMetrics();
+    emit fontSizeChanged();
 }
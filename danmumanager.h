@@ -3,8 +3,13 @@
 #include <QObject>
 #include <QQmlEngine>
 #include <QDir>
+#include <QFontMetrics>
+#include <QHash>
+#include <QMap>
 
 #include "danmu.h"
+#include "danmujournal.h"
+#include "danmustore.h"
 #include "danmutrack.h"
 #include "font.h"
 
@@ -23,12 +28,13 @@ class DanmuManager : public QObject
 public:
     explicit DanmuManager(QObject *parent = nullptr);
 
-    Q_INVOKABLE void initDanmus(QString title);                   //从文件读入弹幕初始化弹幕列表
+    Q_INVOKABLE void initDanmus(QString title);                   //打开弹幕库；同一视频再次调用时只重置调度状态，不重新读文件
     Q_INVOKABLE void initTracks(int high);                        //初始化轨道
-    Q_INVOKABLE void addDanmu(qint64 startTime, QString content); //添加弹幕
-    Q_INVOKABLE void saveDanmu();                                 //写入文件，保存弹幕
+    Q_INVOKABLE void addDanmu(qint64 startTime, QString content); //添加弹幕，只追加到日志
+    Q_INVOKABLE void saveDanmu();                                 //立即把新发送的弹幕交给后台写入日志
+    Q_INVOKABLE void seek();                                      //跳转后重置游标和轨道，下次调度从新位置开始
     Q_INVOKABLE QList<QList<QVariant>> danmus(
-        int width, int num, qint64 currentTime); //根据提供的屏幕宽度和需要弹幕数量提供弹幕
+        int width, int num, qint64 currentTime); //返回上次调度之后到currentTime之间到期的弹幕，位置按currentTime计算
 
     Q_INVOKABLE QDir generateFilePath() const;
     Q_INVOKABLE QString danmuDirPath() const;
@@ -42,11 +48,24 @@ public:
     void setFontSize(int size);
 
 private:
+    QString storePath() const;                 //<title>danmu.vpdm
+    QList<Danmu> &loadBucket(int index);       //解码一个时间桶并缓存
+    void onJournalOpened(quint64 firstSequence, const QList<DanmuRecord> &records);
+    void onJournalCompacted(quint64 sequence);
+    void updateFontMetrics();                  //字体变化后重建，逐帧调度时不再创建QFont
+
     float m_speed;
     QString m_title;
-    QList<Danmu> m_danmus;
+    DanmuStore m_store;
+    QHash<int, QList<Danmu>> m_buckets; // 已解码的时间桶，只保留当前时间附近的几个
+    DanmuJournal *m_journal;
+    QMap<quint64, DanmuRecord> m_journalled; // 日志序号 -> 还没并入弹幕库的弹幕
     QList<DanmuTrack> m_danmuTracks;
+    QList<Danmu> m_late;                // 发送时已经在游标之前的新弹幕
+    qint64 m_cursor;                    // 发送时间不大于游标的弹幕已经调度过，跳转后无效，下次调度从当前画面重新开始
+    int m_lastBucket;                   // 上次调度范围的最后一个时间桶，范围没有进入新桶时不整理m_buckets
     Font *_font;
+    QFontMetrics m_fontMetrics;
 signals:
     void speedChanged();
     void fontNameChanged();
@@ -0,0 +1,206 @@
+#include "danmustore.h"
+
+#include <QDebug>
+#include <QSaveFile>
+#include <QTextStream>
+#include <QtEndian>
+#include <algorithm>
+
+namespace {
+constexpr quint32 kDanmuMagic = 0x5650444D; // "VPDM"
+constexpr quint32 kDanmuVersion = 1;
+constexpr qint64 kHeaderSize = 32;       // magic, version, count, bucketSize, bucketCount, reserved, stringsOffset
+constexpr qint64 kRecordSize = 16;       // time, stringOffset, stringLength
+constexpr quint32 kBucketSize = 10000;   // 10秒一个时间桶
+
+quint32 readU32(const uchar *p)
+{
+    return qFromLittleEndian<quint32>(p);
+}
+
+template<typename T>
+void appendLittleEndian(QByteArray &out, T value)
+{
+    char buffer[sizeof(T)];
+    qToLittleEndian(value, buffer);
+    out.append(buffer, sizeof(T));
+}
+} // namespace
+
+DanmuStore::~DanmuStore()
+{
+    close();
+}
+
+bool DanmuStore::open(const QString &filePath)
+{
+    close();
+    m_file.setFileName(filePath);
+    if (!m_file.open(QIODevice::ReadOnly)) return false;
+    m_size = m_file.size();
+    if (m_size < kHeaderSize) {
+        close();
+        return false;
+    }
+    m_data = m_file.map(0, m_size);
+    if (!m_data) {
+        close();
+        return false;
+    }
+
+    const quint32 magic = readU32(m_data);
+    const quint32 version = readU32(m_data + 4);
+    const quint32 count = readU32(m_data + 8);
+    const quint32 bucketSize = readU32(m_data + 12);
+    const quint32 bucketCount = readU32(m_data + 16);
+    const quint64 stringsOffset = qFromLittleEndian<quint64>(m_data + 24);
+    const quint64 recordsOffset = quint64(kHeaderSize) + (quint64(bucketCount) + 1) * 4;
+    if (magic != kDanmuMagic || version != kDanmuVersion || bucketSize == 0
+        || stringsOffset != recordsOffset + quint64(count) * kRecordSize || stringsOffset > quint64(m_size)
+        || readU32(m_data + kHeaderSize + qint64(bucketCount) * 4) != count) {
+        qWarning() << "DanmuStore: invalid danmu file" << filePath;
+        close();
+        return false;
+    }
+
+    m_count = int(count);
+    m_bucketSize = bucketSize;
+    m_bucketCount = int(bucketCount);
+    m_buckets = m_data + kHeaderSize;
+    m_records = m_data + recordsOffset;
+    m_strings = m_data + stringsOffset;
+    m_stringsSize = m_size - qint64(stringsOffset);
+    return true;
+}
+
+void DanmuStore::close()
+{
+    if (m_data) m_file.unmap(const_cast<uchar *>(m_data));
+    m_file.close();
+    m_data = nullptr;
+    m_size = 0;
+    m_count = 0;
+    m_bucketSize = 0;
+    m_bucketCount = 0;
+    m_buckets = nullptr;
+    m_records = nullptr;
+    m_strings = nullptr;
+    m_stringsSize = 0;
+}
+
+bool DanmuStore::isOpen() const
+{
+    return m_data != nullptr;
+}
+
+int DanmuStore::count() const
+{
+    return m_count;
+}
+
+qint64 DanmuStore::bucketSize() const
+{
+    return m_bucketSize > 0 ? m_bucketSize : kBucketSize;
+}
+
+int DanmuStore::bucketCount() const
+{
+    return m_bucketCount;
+}
+
+int DanmuStore::bucketOf(qint64 time) const
+{
+    return int(qMax<qint64>(0, time) / bucketSize());
+}
+
+QList<DanmuRecord> DanmuStore::bucket(int index) const
+{
+    QList<DanmuRecord> records;
+    if (index < 0 || index >= m_bucketCount) return records;
+    // 索引中的记录号不可信时截断到记录表范围内
+    const int first = int(qMin<quint32>(readU32(m_buckets + qint64(index) * 4), quint32(m_count)));
+    const int last = int(qMin<quint32>(readU32(m_buckets + qint64(index + 1) * 4), quint32(m_count)));
+    records.reserve(qMax(0, last - first));
+    for (int i = first; i < last; i++) records.append(record(i));
+    return records;
+}
+
+DanmuRecord DanmuStore::record(int i) const
+{
+    DanmuRecord record;
+    if (i < 0 || i >= m_count) return record;
+    const uchar *p = m_records + qint64(i) * kRecordSize;
+    record.time = qFromLittleEndian<qint64>(p);
+    record.content = string(readU32(p + 8), readU32(p + 12));
+    return record;
+}
+
+QString DanmuStore::string(quint32 offset, quint32 length) const
+{
+    if (quint64(offset) + length > quint64(m_stringsSize)) return QString();
+    return QString::fromUtf8(reinterpret_cast<const char *>(m_strings + offset), length);
+}
+
+bool DanmuStore::save(const QString &filePath, int count, const std::function<DanmuRecord(int)> &recordAt)
+{
+    QByteArray records;
+    QByteArray strings;
+    QList<quint32> bucketStarts{0}; // 第i个桶的起始记录号
+    records.reserve(qsizetype(count) * kRecordSize);
+    for (int i = 0; i < count; i++) {
+        const DanmuRecord record = recordAt(i);
+        const qint64 time = qMax<qint64>(0, record.time);
+        const qsizetype bucket = time / kBucketSize;
+        while (bucketStarts.size() <= bucket) bucketStarts.append(quint32(i));
+        const QByteArray utf8 = record.content.toUtf8();
+        appendLittleEndian<qint64>(records, time);
+        appendLittleEndian<quint32>(records, quint32(strings.size()));
+        appendLittleEndian<quint32>(records, quint32(utf8.size()));
+        strings.append(utf8);
+    }
+    const quint32 bucketCount = quint32(bucketStarts.size());
+    bucketStarts.append(quint32(count)); // 结尾哨兵
+
+    QByteArray index;
+    index.reserve(bucketStarts.size() * 4);
+    for (quint32 start : std::as_const(bucketStarts)) appendLittleEndian<quint32>(index, start);
+
+    QByteArray header;
+    appendLittleEndian<quint32>(header, kDanmuMagic);
+    appendLittleEndian<quint32>(header, kDanmuVersion);
+    appendLittleEndian<quint32>(header, quint32(count));
+    appendLittleEndian<quint32>(header, kBucketSize);
+    appendLittleEndian<quint32>(header, bucketCount);
+    appendLittleEndian<quint32>(header, 0);
+    appendLittleEndian<quint64>(header, quint64(kHeaderSize + index.size() + records.size()));
+
+    QSaveFile file(filePath);
+    if (!file.open(QIODevice::WriteOnly)) return false;
+    if (file.write(header) != header.size() || file.write(index) != index.size()
+        || file.write(records) != records.size() || file.write(strings) != strings.size()) {
+        file.cancelWriting();
+        return false;
+    }
+    return file.commit();
+}
+
+QList<DanmuRecord> DanmuStore::readText(const QString &filePath)
+{
+    QList<DanmuRecord> records;
+    QFile file(filePath);
+    if (!file.open(QIODevice::ReadOnly | QIODevice::Text)) return records;
+    QTextStream in(&file);
+    while (!in.atEnd()) {
+        const QString line = in.readLine();
+        const int space = line.indexOf(' ');
+        if (space <= 0) continue;
+        bool ok;
+        const qint64 time = line.left(space).toLongLong(&ok);
+        if (!ok) continue;
+        records.append(DanmuRecord{time, line.mid(space + 1)}); // 第一个空格之后全部是内容
+    }
+    // 旧文件按插入顺序基本有序，稳定排序保持同一时间弹幕的先后
+    std::stable_sort(records.begin(), records.end(),
+                     [](const DanmuRecord &a, const DanmuRecord &b) { return a.time < b.time; });
+    return records;
+}
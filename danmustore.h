@@ -0,0 +1,53 @@
+#pragma once
+
+#include <QFile>
+#include <QList>
+#include <QString>
+#include <functional>
+
+// 一条弹幕，time为相对视频开头的毫秒数
+struct DanmuRecord
+{
+    qint64 time = 0;
+    QString content;
+};
+
+// 版本化的二进制弹幕库(.vpdm)：文件头 + 时间桶索引 + 按时间排序的定长记录表 + UTF-8字符串区
+// 通过内存映射打开，只解码用到的时间桶，百万条弹幕的文件打开时也不读取内容
+class DanmuStore
+{
+public:
+    DanmuStore() = default;
+    ~DanmuStore();
+    DanmuStore(const DanmuStore &) = delete;
+    DanmuStore &operator=(const DanmuStore &) = delete;
+
+    bool open(const QString &filePath); // 映射文件并校验文件头和索引
+    void close();
+    bool isOpen() const;
+    int count() const;
+    qint64 bucketSize() const;          // 每个时间桶的毫秒数
+    int bucketCount() const;
+    int bucketOf(qint64 time) const;
+    QList<DanmuRecord> bucket(int index) const; // 只解码这一个时间桶
+    DanmuRecord record(int i) const;
+
+    // records必须已按时间排序
+    static bool save(const QString &filePath, int count, const std::function<DanmuRecord(int)> &recordAt);
+    // 读取旧版本的文本弹幕文件，每行"时间 内容"，内容中可以有空格
+    static QList<DanmuRecord> readText(const QString &filePath);
+
+private:
+    QString string(quint32 offset, quint32 length) const;
+
+    QFile m_file;
+    const uchar *m_data = nullptr;
+    qint64 m_size = 0;
+    int m_count = 0;
+    qint64 m_bucketSize = 0;
+    int m_bucketCount = 0;
+    const uchar *m_buckets = nullptr; // bucketCount + 1个起始记录号
+    const uchar *m_records = nullptr;
+    const uchar *m_strings = nullptr;
+    qint64 m_stringsSize = 0;
+};
@@ -1,3 +1,5 @@
 #include "danmutrack.h"
 
-DanmuTrack::DanmuTrack(int y) : m_y(y), m_lastTime{0} {}
+#include <limits>
+
+DanmuTrack::DanmuTrack(int y) : m_y(y), m_lastTime{std::numeric_limits<qint64>::min()} {}
@@ -0,0 +1,467 @@
+#include "danmuview.h"
+
+#include <QFontMetricsF>
+#include <QPainter>
+#include <QPainterPath>
+#include <QQuickWindow>
+#include <QSGGeometryNode>
+#include <QSGTextureMaterial>
+#include <QStringView>
+#include <QtMath>
+#include <cstring>
+#include <rhi/qrhi.h>
+
+namespace {
+constexpr int kAtlasWidth = 1024;
+constexpr int kAtlasInitialHeight = 256;
+constexpr int kAtlasMaxHeight = 4096; // 最多16MB，CJK大字号下也能放下几千个字形
+constexpr qreal kOutline = 1.5;       // 黑色描边宽度，浅色画面上也能看清
+constexpr int kMinCapacity = 256;     // 顶点缓冲初始可容纳的字形数
+constexpr qint64 kSeekThreshold = 1000; // 新的播放位置与插值时钟相差超过1秒时按跳转处理
+
+// 字形图集纹理：一直使用同一张GPU纹理，新字形只上传变化的区域；
+// 图集长高或重建时才重新创建纹理并整张上传
+class AtlasTexture : public QSGTexture
+{
+public:
+    ~AtlasTexture() override { delete m_texture; }
+
+    // 在渲染线程同步阶段调用，只复制变化的区域，之后GUI线程继续在图集上绘制不会触发整张复制
+    void update(const QImage &atlas, const QRect &dirty)
+    {
+        QRect rect = dirty & atlas.rect();
+        if (atlas.size() != m_size) {
+            m_size = atlas.size();
+            m_uploads.clear();
+            rect = atlas.rect();
+        }
+        if (!rect.isEmpty()) m_uploads.append({atlas.copy(rect), rect.topLeft()});
+    }
+
+    qint64 comparisonKey() const override { return qint64(quintptr(this)); }
+    QRhiTexture *rhiTexture() const override { return m_texture; }
+    QSize textureSize() const override { return m_size; }
+    bool hasAlphaChannel() const override { return true; }
+    bool hasMipmaps() const override { return false; }
+
+    void commitTextureOperations(QRhi *rhi, QRhiResourceUpdateBatch *resourceUpdates) override
+    {
+        if (m_size.isEmpty()) return;
+        if (!m_texture || m_texture->pixelSize() != m_size) {
+            if (m_texture) m_texture->deleteLater(); // 可能还在未完成的帧中使用
+            // ARGB32_Premultiplied在内存中是BGRA，支持时直接上传不做转换
+            m_bgra = rhi->isTextureFormatSupported(QRhiTexture::BGRA8);
+            m_texture = rhi->newTexture(m_bgra ? QRhiTexture::BGRA8 : QRhiTexture::RGBA8, m_size);
+            if (!m_texture->create()) {
+                delete m_texture;
+                m_texture = nullptr;
+                return;
+            }
+        }
+        for (const Upload &upload : std::as_const(m_uploads)) {
+            QRhiTextureSubresourceUploadDescription description(
+                m_bgra ? upload.image : upload.image.convertToFormat(QImage::Format_RGBA8888_Premultiplied));
+            description.setDestinationTopLeft(upload.position);
+            resourceUpdates->uploadTexture(m_texture, QRhiTextureUploadEntry(0, 0, description));
+        }
+        m_uploads.clear();
+    }
+
+private:
+    struct Upload
+    {
+        QImage image;
+        QPoint position;
+    };
+
+    QRhiTexture *m_texture = nullptr;
+    QSize m_size;
+    bool m_bgra = true;
+    QList<Upload> m_uploads; // 还没提交给GPU的区域
+};
+
+// 持有图集纹理的几何节点，顶点和索引缓冲按容量预先分配
+class DanmuNode : public QSGGeometryNode
+{
+public:
+    DanmuNode()
+        : geometry(QSGGeometry::defaultAttributes_TexturedPoint2D(), 0, 0, QSGGeometry::UnsignedIntType)
+    {
+        geometry.setDrawingMode(QSGGeometry::DrawTriangles);
+        geometry.setVertexDataPattern(QSGGeometry::DynamicPattern);
+        geometry.setIndexDataPattern(QSGGeometry::StaticPattern);
+        material.setFiltering(QSGTexture::Linear);
+        setGeometry(&geometry);
+        setMaterial(&material);
+    }
+    ~DanmuNode() override { delete texture; }
+
+    void reserve(int glyphs)
+    {
+        if (glyphs <= capacity) return;
+        int newCapacity = qMax(kMinCapacity, capacity);
+        while (newCapacity < glyphs) newCapacity *= 2;
+        geometry.allocate(newCapacity * 4, newCapacity * 6);
+        quint32 *indices = geometry.indexDataAsUInt();
+        for (int i = 0; i < newCapacity; i++) {
+            const quint32 v = quint32(i) * 4;
+            indices[i * 6 + 0] = v;
+            indices[i * 6 + 1] = v + 1;
+            indices[i * 6 + 2] = v + 2;
+            indices[i * 6 + 3] = v + 2;
+            indices[i * 6 + 4] = v + 1;
+            indices[i * 6 + 5] = v + 3;
+        }
+        std::memset(geometry.vertexData(), 0, size_t(newCapacity) * 4 * sizeof(QSGGeometry::TexturedPoint2D));
+        capacity = newCapacity;
+        used = 0;
+        markDirty(QSGNode::DirtyGeometry);
+    }
+
+    QSGGeometry geometry;
+    QSGTextureMaterial material;
+    AtlasTexture *texture = nullptr;
+    int capacity = 0; // 可容纳的字形数
+    int used = 0;     // 上一帧写入的字形数，多出的部分需要清零
+};
+} // namespace
+
+DanmuView::DanmuView(QQuickItem *parent)
+    : QQuickItem(parent)
+    , m_atlasX{0}
+    , m_atlasY{0}
+    , m_cellHeight{0}
+    , m_font{"DejaVu Sans Mono"}
+    , m_dpr{1.0}
+    , m_position{0}
+    , m_playbackRate{1.0}
+    , m_running{false}
+    , m_maxCount{5000}
+    , m_seeked{false}
+{
+    setFlag(ItemHasContents, true);
+    m_font.setPixelSize(20);
+    m_sincePosition.start();
+    resetAtlas();
+}
+
+void DanmuView::addDanmus(const QList<QList<QVariant>> &danmus)
+{
+    appendDanmus(danmus, clock());
+}
+
+void DanmuView::appendDanmus(const QList<QList<QVariant>> &danmus, double start)
+{
+    if (danmus.isEmpty()) return;
+    for (const QList<QVariant> &danmu : danmus) {
+        if (danmu.size() < 5 || m_active.size() >= m_maxCount) break;
+        ActiveDanmu item;
+        item.start = start;
+        item.startX = danmu[0].toFloat();
+        item.y = danmu[1].toFloat();
+        const float endX = danmu[2].toFloat();
+        const double duration = danmu[4].toDouble();
+        if (duration <= 0 || endX >= item.startX) continue;
+        item.speed = float((item.startX - endX) / duration);
+        item.width = 0;
+
+        bool complete = true;
+        const QString content = danmu[3].toString();
+        for (char32_t ch : QStringView(content).toUcs4()) {
+            const int glyph = glyphFor(ch);
+            if (glyph < 0) {
+                complete = false; // 图集已满并被重建
+                break;
+            }
+            item.glyphs.append(quint16(glyph));
+            item.width += m_glyphs[glyph].advance;
+        }
+        if (complete && !item.glyphs.isEmpty()) m_active.append(item);
+    }
+    update();
+}
+
+void DanmuView::clear()
+{
+    if (m_active.isEmpty()) return;
+    m_active.clear();
+    update();
+}
+
+int DanmuView::available() const
+{
+    return qMax(0, m_maxCount - int(m_active.size()));
+}
+
+double DanmuView::clock() const
+{
+    if (!m_running) return double(m_position);
+    return double(m_position) + double(m_sincePosition.elapsed()) * m_playbackRate;
+}
+
+void DanmuView::schedule()
+{
+    if (!isVisible() || width() <= 0) return;
+    if (m_manager) {
+        if (m_seeked) {
+            m_seeked = false;
+            m_manager->seek();
+        }
+
+        // 位置按这一帧的时钟计算，弹幕在两帧之间到期时也从正确的位置出现
+        const qint64 now = qint64(clock());
+        const int count = available();
+        if (count > 0) appendDanmus(m_manager->danmus(int(width()), count, now), double(now));
+    }
+    // 播放中每帧都要调度，即使屏幕上暂时没有弹幕；帧率由渲染循环的垂直同步决定
+    if (m_running && (m_manager || !m_active.isEmpty())) update();
+}
+
+int DanmuView::glyphFor(char32_t ch)
+{
+    auto it = m_glyphIndex.constFind(ch);
+    if (it != m_glyphIndex.cend()) return it.value();
+
+    const QString text = QString::fromUcs4(&ch, 1);
+    const QFontMetricsF metrics(m_font);
+    const qreal advance = metrics.horizontalAdvance(text);
+    const int width = qCeil((advance + 2 * kOutline) * m_dpr);
+    if (m_atlasX + width > m_atlas.width()) {
+        m_atlasX = 0;
+        m_atlasY += m_cellHeight + 1;
+    }
+    if (m_atlasY + m_cellHeight > m_atlas.height() && !growAtlas()) {
+        resetAtlas();
+        return -1;
+    }
+
+    // 描边后填充，每个字形只光栅化一次
+    QPainter painter(&m_atlas);
+    painter.setRenderHint(QPainter::Antialiasing);
+    painter.translate(m_atlasX, m_atlasY);
+    painter.scale(m_dpr, m_dpr);
+    QPainterPath path;
+    path.addText(QPointF(kOutline, kOutline + metrics.ascent()), m_font, text);
+    painter.strokePath(path, QPen(QColor(0, 0, 0, 200), kOutline * 2, Qt::SolidLine, Qt::RoundCap, Qt::RoundJoin));
+    painter.fillPath(path, Qt::white);
+    painter.end();
+
+    m_glyphs.append(Glyph{QRect(m_atlasX, m_atlasY, width, m_cellHeight), float(advance)});
+    m_atlasDirty |= m_glyphs.last().rect;
+    m_atlasX += width + 1;
+    const int index = m_glyphs.size() - 1;
+    m_glyphIndex.insert(ch, index);
+    return index;
+}
+
+bool DanmuView::growAtlas()
+{
+    // 只增加高度，已有字形的像素坐标不变
+    if (m_atlas.height() >= kAtlasMaxHeight) return false;
+    QImage grown(kAtlasWidth, m_atlas.height() * 2, QImage::Format_ARGB32_Premultiplied);
+    grown.fill(Qt::transparent);
+    QPainter painter(&grown);
+    painter.setCompositionMode(QPainter::CompositionMode_Source);
+    painter.drawImage(0, 0, m_atlas);
+    painter.end();
+    m_atlas = grown;
+    m_atlasDirty = m_atlas.rect();
+    return true;
+}
+
+void DanmuView::resetAtlas()
+{
+    m_active.clear();
+    m_glyphs.clear();
+    m_glyphIndex.clear();
+    m_atlas = QImage(kAtlasWidth, kAtlasInitialHeight, QImage::Format_ARGB32_Premultiplied);
+    m_atlas.fill(Qt::transparent);
+    m_atlasX = 0;
+    m_atlasY = 0;
+    m_cellHeight = qCeil((QFontMetricsF(m_font).height() + 2 * kOutline) * m_dpr);
+    m_atlasDirty = m_atlas.rect();
+    update();
+}
+
+QSGNode *DanmuView::updatePaintNode(QSGNode *oldNode, UpdatePaintNodeData *)
+{
+    auto *node = static_cast<DanmuNode *>(oldNode);
+    if (m_active.isEmpty() && (!node || node->used == 0)) return node;
+    if (!node) node = new DanmuNode;
+
+    if (!node->texture) {
+        node->texture = new AtlasTexture;
+        node->material.setTexture(node->texture);
+    }
+    if (!m_atlasDirty.isEmpty() || node->texture->textureSize() != m_atlas.size()) {
+        node->texture->update(m_atlas, m_atlasDirty);
+        node->markDirty(QSGNode::DirtyMaterial);
+        m_atlasDirty = QRect();
+    }
+
+    // 移出屏幕的弹幕与末尾交换后删除，不移动其它元素
+    const double now = clock();
+    int glyphCount = 0;
+    for (int i = 0; i < m_active.size();) {
+        const ActiveDanmu &item = m_active[i];
+        const float x = item.startX - float(now - item.start) * item.speed;
+        if (x + item.width + kOutline < 0) {
+            m_active.swapItemsAt(i, m_active.size() - 1);
+            m_active.removeLast();
+            continue;
+        }
+        glyphCount += item.glyphs.size();
+        i++;
+    }
+    node->reserve(glyphCount);
+
+    const float atlasWidth = m_atlas.width();
+    const float atlasHeight = m_atlas.height();
+    const float cellHeight = m_cellHeight / m_dpr;
+    QSGGeometry::TexturedPoint2D *vertex = node->geometry.vertexDataAsTexturedPoint2D();
+    for (const ActiveDanmu &item : std::as_const(m_active)) {
+        float x = item.startX - float(now - item.start) * item.speed - kOutline;
+        const float top = item.y - kOutline;
+        const float bottom = top + cellHeight;
+        for (quint16 index : item.glyphs) {
+            const Glyph &glyph = m_glyphs[index];
+            const float right = x + glyph.rect.width() / m_dpr;
+            const float u0 = glyph.rect.left() / atlasWidth;
+            const float u1 = (glyph.rect.left() + glyph.rect.width()) / atlasWidth;
+            const float v0 = glyph.rect.top() / atlasHeight;
+            const float v1 = (glyph.rect.top() + glyph.rect.height()) / atlasHeight;
+            vertex[0].set(x, top, u0, v0);
+            vertex[1].set(right, top, u1, v0);
+            vertex[2].set(x, bottom, u0, v1);
+            vertex[3].set(right, bottom, u1, v1);
+            vertex += 4;
+            x += glyph.advance;
+        }
+    }
+    // 上一帧多出的字形退化为面积为0的四边形
+    if (node->used > glyphCount) {
+        std::memset(static_cast<void *>(vertex), 0, size_t(node->used - glyphCount) * 4 * sizeof(QSGGeometry::TexturedPoint2D));
+    }
+    node->used = glyphCount;
+    node->markDirty(QSGNode::DirtyGeometry);
+    return node; // 下一帧由schedule()在动画阶段请求
+}
+
+void DanmuView::itemChange(ItemChange change, const ItemChangeData &value)
+{
+    if (change == ItemSceneChange) {
+        disconnect(m_animatingConnection);
+        if (value.window) m_animatingConnection = connect(value.window, &QQuickWindow::afterAnimating, this, &DanmuView::schedule);
+    }
+    if (change == ItemVisibleHasChanged && value.boolValue) update(); //重新显示时恢复逐帧调度
+    if (change == ItemDevicePixelRatioHasChanged || (change == ItemSceneChange && value.window)) {
+        const qreal dpr = window() ? window()->effectiveDevicePixelRatio() : 1.0;
+        if (!qFuzzyCompare(dpr, m_dpr)) {
+            m_dpr = dpr;
+            resetAtlas();
+        }
+    }
+    QQuickItem::itemChange(change, value);
+}
+
+qint64 DanmuView::position() const
+{
+    return m_position;
+}
+
+void DanmuView::setPosition(qint64 position)
+{
+    // 与插值时钟相差太多说明发生了跳转，屏幕上的弹幕已经不属于新位置
+    if (qAbs(double(position) - clock()) > kSeekThreshold) {
+        m_active.clear();
+        m_seeked = true;
+    }
+    m_sincePosition.restart();
+    if (m_position == position) return;
+    m_position = position;
+    update();
+    emit positionChanged();
+}
+
+qreal DanmuView::playbackRate() const
+{
+    return m_playbackRate;
+}
+
+void DanmuView::setPlaybackRate(qreal rate)
+{
+    if (qFuzzyCompare(m_playbackRate, rate)) return;
+    m_position = qint64(clock()); //先按旧速率推进到现在，再换新速率
+    m_sincePosition.restart();
+    m_playbackRate = rate;
+    emit playbackRateChanged();
+}
+
+bool DanmuView::running() const
+{
+    return m_running;
+}
+
+void DanmuView::setRunning(bool running)
+{
+    if (m_running == running) return;
+    m_position = qint64(clock());
+    m_sincePosition.restart();
+    m_running = running;
+    update();
+    emit runningChanged();
+}
+
+QString DanmuView::fontFamily() const
+{
+    return m_font.family();
+}
+
+void DanmuView::setFontFamily(const QString &family)
+{
+    if (family.isEmpty() || m_font.family() == family) return;
+    m_font.setFamily(family);
+    resetAtlas();
+    emit fontChanged();
+}
+
+int DanmuView::fontSize() const
+{
+    return m_font.pixelSize();
+}
+
+void DanmuView::setFontSize(int size)
+{
+    if (size <= 0 || m_font.pixelSize() == size) return;
+    m_font.setPixelSize(size);
+    resetAtlas();
+    emit fontChanged();
+}
+
+int DanmuView::maxCount() const
+{
+    return m_maxCount;
+}
+
+void DanmuView::setMaxCount(int count)
+{
+    count = qMax(1, count);
+    if (m_maxCount == count) return;
+    m_maxCount = count;
+    emit maxCountChanged();
+}
+
+DanmuManager *DanmuView::manager() const
+{
+    return m_manager;
+}
+
+void DanmuView::setManager(DanmuManager *manager)
+{
+    if (m_manager == manager) return;
+    m_manager = manager;
+    m_active.clear();
+    m_seeked = true;
+    update();
+    emit managerChanged();
+}
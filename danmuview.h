@@ -0,0 +1,109 @@
+#pragma once
+
+#include <QElapsedTimer>
+#include <QFont>
+#include <QHash>
+#include <QImage>
+#include <QList>
+#include <QPointer>
+#include <QQuickItem>
+#include <QRect>
+#include <QVarLengthArray>
+
+#include "danmumanager.h"
+
+// 弹幕渲染：全部弹幕合成一个QSGGeometryNode，文字取自共享的字形图集
+// 位置在updatePaintNode中按播放时钟(position + 距上次更新的时间 × 播放速率)计算，
+// 每帧只改写顶点数据，不创建对象；顶点缓冲只在弹幕数超过容量时翻倍扩大
+// 设置manager后，每帧动画阶段(afterAnimating)按同一个时钟向DanmuManager取到期的弹幕；
+// 播放位置与时钟相差过大时视为跳转，清空屏幕并只重置DanmuManager的游标和轨道
+class DanmuView : public QQuickItem
+{
+    Q_OBJECT
+    QML_ELEMENT
+    Q_PROPERTY(qint64 position READ position WRITE setPosition NOTIFY positionChanged)             // 播放位置(毫秒)
+    Q_PROPERTY(qreal playbackRate READ playbackRate WRITE setPlaybackRate NOTIFY playbackRateChanged)
+    Q_PROPERTY(bool running READ running WRITE setRunning NOTIFY runningChanged)                     // 是否正在播放
+    Q_PROPERTY(QString fontFamily READ fontFamily WRITE setFontFamily NOTIFY fontChanged)
+    Q_PROPERTY(int fontSize READ fontSize WRITE setFontSize NOTIFY fontChanged)                      // 像素
+    Q_PROPERTY(int maxCount READ maxCount WRITE setMaxCount NOTIFY maxCountChanged)                  // 同屏弹幕上限
+    Q_PROPERTY(DanmuManager *manager READ manager WRITE setManager NOTIFY managerChanged)             // 弹幕来源
+
+public:
+    explicit DanmuView(QQuickItem *parent = nullptr);
+
+    // 每项为[起始x, y, 结束x, 内容, 持续时间(毫秒)]，与DanmuManager::danmus的返回值一致
+    Q_INVOKABLE void addDanmus(const QList<QList<QVariant>> &danmus);
+    Q_INVOKABLE void clear();          // 清除屏幕上的全部弹幕
+    Q_INVOKABLE int available() const; // 还能放入的弹幕数
+
+    qint64 position() const;
+    void setPosition(qint64 position);
+    qreal playbackRate() const;
+    void setPlaybackRate(qreal rate);
+    bool running() const;
+    void setRunning(bool running);
+    QString fontFamily() const;
+    void setFontFamily(const QString &family);
+    int fontSize() const;
+    void setFontSize(int size);
+    int maxCount() const;
+    void setMaxCount(int count);
+    DanmuManager *manager() const;
+    void setManager(DanmuManager *manager);
+
+signals:
+    void positionChanged();
+    void playbackRateChanged();
+    void runningChanged();
+    void fontChanged();
+    void maxCountChanged();
+    void managerChanged();
+
+protected:
+    QSGNode *updatePaintNode(QSGNode *oldNode, UpdatePaintNodeData *data) override;
+    void itemChange(ItemChange change, const ItemChangeData &value) override;
+
+private:
+    struct Glyph
+    {
+        QRect rect;    // 图集中的像素区域(含描边)
+        float advance; // 逻辑像素
+    };
+    struct ActiveDanmu
+    {
+        double start;   // 出现时的播放时钟
+        float startX;
+        float y;
+        float speed;    // 每毫秒播放时间移动的逻辑像素
+        float width;
+        QVarLengthArray<quint16, 32> glyphs;
+    };
+
+    double clock() const; // 当前帧对应的播放时间
+    void appendDanmus(const QList<QList<QVariant>> &danmus, double start); // start为danmus中位置对应的播放时间
+    void schedule();      // 取出到期的弹幕，播放中保持逐帧调用
+    int glyphFor(char32_t ch);
+    bool growAtlas();
+    void resetAtlas();    // 字体或缩放变化后重建图集，屏幕上的弹幕一并清除
+
+    QList<ActiveDanmu> m_active;
+    QList<Glyph> m_glyphs;
+    QHash<char32_t, int> m_glyphIndex;
+    QImage m_atlas;
+    int m_atlasX;
+    int m_atlasY;
+    int m_cellHeight;   // 图集每行高度(物理像素)
+    QRect m_atlasDirty; // 图集中还没上传的区域，下一帧只上传这一块
+    QFont m_font;
+    qreal m_dpr;
+
+    qint64 m_position;
+    qreal m_playbackRate;
+    bool m_running;
+    int m_maxCount;
+    QElapsedTimer m_sincePosition; // 距上次position更新的时间，用于帧间插值
+    QPointer<DanmuManager> m_manager;
+    bool m_seeked;                 // 检测到跳转，下一帧重置DanmuManager
+    QMetaObject::Connection m_animatingConnection;
+};
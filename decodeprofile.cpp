@@ -0,0 +1,224 @@
+#include "decodeprofile.h"
+#include "appsettings.h"
+
+extern "C" {
+#include <libavcodec/avcodec.h>
+}
+
+namespace {
+constexpr int kMaxLowres = 3;
+constexpr int kMaxThreads = 64;
+
+int toAVDiscard(DecodeProfile::Discard discard)
+{
+    switch (discard) {
+    case DecodeProfile::DiscardNonRef:
+        return AVDISCARD_NONREF;
+    case DecodeProfile::DiscardBidir:
+        return AVDISCARD_BIDIR;
+    case DecodeProfile::DiscardNonIntra:
+        return AVDISCARD_NONINTRA;
+    case DecodeProfile::DiscardNonKey:
+        return AVDISCARD_NONKEY;
+    case DecodeProfile::DiscardAll:
+        return AVDISCARD_ALL;
+    default:
+        return AVDISCARD_DEFAULT;
+    }
+}
+} // namespace
+
+void DecodeSettings::apply(AVCodecContext *codecCtx) const
+{
+    switch (threadType) {
+    case DecodeProfile::FrameThreads:
+        codecCtx->thread_type = FF_THREAD_FRAME;
+        break;
+    case DecodeProfile::SliceThreads:
+        codecCtx->thread_type = FF_THREAD_SLICE;
+        break;
+    default:
+        codecCtx->thread_type = FF_THREAD_FRAME | FF_THREAD_SLICE;
+        break;
+    }
+    codecCtx->thread_count = threadCount;
+    codecCtx->skip_loop_filter = static_cast<AVDiscard>(skipLoopFilter);
+    codecCtx->skip_frame = static_cast<AVDiscard>(skipFrame);
+    // H.264/HEVC等解码器不支持lowres，按解码器上限截断
+    codecCtx->lowres = codecCtx->codec ? qMin(lowres, int(codecCtx->codec->max_lowres)) : 0;
+}
+
+bool DecodeSettings::needsReopen(const DecodeSettings &other) const
+{
+    return threadType != other.threadType || threadCount != other.threadCount || lowres != other.lowres;
+}
+
+DecodeProfile::DecodeProfile(QObject *parent)
+    : QObject{parent}
+    , m_threadType{AutoThreads}
+    , m_threadCount{0}
+    , m_skipLoopFilter{DiscardDefault}
+    , m_skipFrame{DiscardDefault}
+    , m_previewLowres{0}
+    , m_smallWindowLowres{0}
+{
+    load();
+}
+
+DecodeProfile::ThreadType DecodeProfile::threadType() const
+{
+    return m_threadType;
+}
+
+void DecodeProfile::setThreadType(ThreadType type)
+{
+    if (m_threadType == type) return;
+    m_threadType = type;
+    update();
+}
+
+int DecodeProfile::threadCount() const
+{
+    return m_threadCount;
+}
+
+void DecodeProfile::setThreadCount(int count)
+{
+    count = qBound(0, count, kMaxThreads);
+    if (m_threadCount == count) return;
+    m_threadCount = count;
+    update();
+}
+
+DecodeProfile::Discard DecodeProfile::skipLoopFilter() const
+{
+    return m_skipLoopFilter;
+}
+
+void DecodeProfile::setSkipLoopFilter(Discard discard)
+{
+    if (m_skipLoopFilter == discard) return;
+    m_skipLoopFilter = discard;
+    update();
+}
+
+DecodeProfile::Discard DecodeProfile::skipFrame() const
+{
+    return m_skipFrame;
+}
+
+void DecodeProfile::setSkipFrame(Discard discard)
+{
+    if (m_skipFrame == discard) return;
+    m_skipFrame = discard;
+    update();
+}
+
+int DecodeProfile::previewLowres() const
+{
+    return m_previewLowres;
+}
+
+void DecodeProfile::setPreviewLowres(int lowres)
+{
+    lowres = qBound(0, lowres, kMaxLowres);
+    if (m_previewLowres == lowres) return;
+    m_previewLowres = lowres;
+    update();
+}
+
+int DecodeProfile::smallWindowLowres() const
+{
+    return m_smallWindowLowres;
+}
+
+void DecodeProfile::setSmallWindowLowres(int lowres)
+{
+    lowres = qBound(0, lowres, kMaxLowres);
+    if (m_smallWindowLowres == lowres) return;
+    m_smallWindowLowres = lowres;
+    update();
+}
+
+void DecodeProfile::applyPreset(Preset preset)
+{
+    switch (preset) {
+    case Quality:
+        m_threadType = AutoThreads;
+        m_skipLoopFilter = DiscardDefault;
+        m_skipFrame = DiscardDefault;
+        m_previewLowres = 0;
+        m_smallWindowLowres = 0;
+        break;
+    case Balanced:
+        m_threadType = FrameThreads;
+        m_skipLoopFilter = DiscardNonRef;
+        m_skipFrame = DiscardDefault;
+        m_previewLowres = 1;
+        m_smallWindowLowres = 1;
+        break;
+    case LowPower:
+        m_threadType = FrameThreads;
+        m_skipLoopFilter = DiscardAll;
+        m_skipFrame = DiscardNonRef;
+        m_previewLowres = 2;
+        m_smallWindowLowres = 2;
+        break;
+    }
+    m_threadCount = 0;
+    update();
+}
+
+DecodeSettings DecodeProfile::playbackSettings(bool smallWindow) const
+{
+    DecodeSettings settings;
+    settings.threadType = m_threadType;
+    settings.threadCount = m_threadCount;
+    settings.skipLoopFilter = toAVDiscard(m_skipLoopFilter);
+    settings.skipFrame = toAVDiscard(m_skipFrame);
+    settings.lowres = smallWindow ? m_smallWindowLowres : 0;
+    return settings;
+}
+
+DecodeSettings DecodeProfile::previewSettings() const
+{
+    // 预览只解码关键帧，skip_frame由FrameDecoder自己设置
+    DecodeSettings settings;
+    settings.threadType = SliceThreads;
+    settings.threadCount = m_threadCount;
+    settings.skipLoopFilter = toAVDiscard(m_skipLoopFilter);
+    settings.lowres = m_previewLowres;
+    return settings;
+}
+
+void DecodeProfile::load()
+{
+    QSettings settings(kSettingsOrganization, QCoreApplication::applicationName());
+    settings.beginGroup("decode");
+    m_threadType = static_cast<ThreadType>(settings.value("threadType", m_threadType).toInt());
+    m_threadCount = qBound(0, settings.value("threadCount", m_threadCount).toInt(), kMaxThreads);
+    m_skipLoopFilter = static_cast<Discard>(settings.value("skipLoopFilter", m_skipLoopFilter).toInt());
+    m_skipFrame = static_cast<Discard>(settings.value("skipFrame", m_skipFrame).toInt());
+    m_previewLowres = qBound(0, settings.value("previewLowres", m_previewLowres).toInt(), kMaxLowres);
+    m_smallWindowLowres = qBound(0, settings.value("smallWindowLowres", m_smallWindowLowres).toInt(), kMaxLowres);
+    settings.endGroup();
+}
+
+void DecodeProfile::save()
+{
+    QSettings settings(kSettingsOrganization, QCoreApplication::applicationName());
+    settings.beginGroup("decode");
+    settings.setValue("threadType", int(m_threadType));
+    settings.setValue("threadCount", m_threadCount);
+    settings.setValue("skipLoopFilter", int(m_skipLoopFilter));
+    settings.setValue("skipFrame", int(m_skipFrame));
+    settings.setValue("previewLowres", m_previewLowres);
+    settings.setValue("smallWindowLowres", m_smallWindowLowres);
+    settings.endGroup();
+}
+
+void DecodeProfile::update()
+{
+    save();
+    emit changed();
+}
@@ -0,0 +1,94 @@
+#pragma once
+
+#include <QObject>
+#include <QQmlEngine>
+
+struct AVCodecContext;
+
+// 传给各解码器的参数快照，可在线程间拷贝
+struct DecodeSettings
+{
+    int threadType = 0;     // DecodeProfile::ThreadType
+    int threadCount = 0;    // 0为自动
+    int skipLoopFilter = 0; // AVDiscard
+    int skipFrame = 0;      // AVDiscard
+    int lowres = 0;         // 按2的幂缩小解码分辨率，解码器不支持时忽略
+
+    void apply(AVCodecContext *codecCtx) const; // 必须在avcodec_open2之前调用
+    bool needsReopen(const DecodeSettings &other) const; // 线程和lowres只能在打开解码器时设置
+    bool operator==(const DecodeSettings &other) const = default;
+};
+
+// 解码性能配置，在画质和CPU占用之间取舍，修改后立即保存
+class DecodeProfile : public QObject
+{
+    Q_OBJECT
+    QML_ELEMENT
+    QML_UNCREATABLE("DecodeProfile is owned by MediaEngine")
+    Q_PROPERTY(ThreadType threadType READ threadType WRITE setThreadType NOTIFY changed)       // 多线程方式
+    Q_PROPERTY(int threadCount READ threadCount WRITE setThreadCount NOTIFY changed)          // 线程数，0为自动
+    Q_PROPERTY(Discard skipLoopFilter READ skipLoopFilter WRITE setSkipLoopFilter NOTIFY changed) // 跳过去块滤波
+    Q_PROPERTY(Discard skipFrame READ skipFrame WRITE setSkipFrame NOTIFY changed)            // 跳过解码的帧
+    Q_PROPERTY(int previewLowres READ previewLowres WRITE setPreviewLowres NOTIFY changed)    // 缩略图和预览图集
+    Q_PROPERTY(int smallWindowLowres READ smallWindowLowres WRITE setSmallWindowLowres NOTIFY changed) // 小窗播放
+
+public:
+    explicit DecodeProfile(QObject *parent = nullptr);
+
+    enum ThreadType {
+        AutoThreads,  // 帧线程和片线程由解码器选择
+        FrameThreads, // 吞吐量高，但增加延迟
+        SliceThreads  // 延迟低，依赖码流的分片
+    };
+    Q_ENUM(ThreadType)
+
+    enum Discard {
+        DiscardDefault,  // 只跳过空包
+        DiscardNonRef,   // 跳过非参考帧
+        DiscardBidir,    // 跳过B帧
+        DiscardNonIntra, // 跳过非帧内编码帧
+        DiscardNonKey,   // 只保留关键帧
+        DiscardAll       // 全部跳过
+    };
+    Q_ENUM(Discard)
+
+    enum Preset {
+        Quality,  // 全部默认
+        Balanced, // 跳过非参考帧的去块滤波，预览降一级分辨率
+        LowPower  // 瘦客户端：不做去块滤波、丢弃非参考帧、预览和小窗降两级分辨率
+    };
+    Q_ENUM(Preset)
+
+    ThreadType threadType() const;
+    void setThreadType(ThreadType type);
+    int threadCount() const;
+    void setThreadCount(int count);
+    Discard skipLoopFilter() const;
+    void setSkipLoopFilter(Discard discard);
+    Discard skipFrame() const;
+    void setSkipFrame(Discard discard);
+    int previewLowres() const;
+    void setPreviewLowres(int lowres);
+    int smallWindowLowres() const;
+    void setSmallWindowLowres(int lowres);
+
+    Q_INVOKABLE void applyPreset(Preset preset);
+
+    DecodeSettings playbackSettings(bool smallWindow) const; // 正常播放或小窗播放
+    DecodeSettings previewSettings() const;                  // 缩略图、预览图集
+
+signals:
+    void changed();
+
+private:
+    void load();
+    void save();
+    void update(); // 保存并通知
+
+    ThreadType m_threadType;
+    int m_threadCount;
+    Discard m_skipLoopFilter;
+    Discard m_skipFrame;
+    int m_previewLowres;
+    int m_smallWindowLowres;
+};
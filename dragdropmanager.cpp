@@ -1,4 +1,5 @@
 #include "dragdropmanager.h"
+#include "mediasniffer.h"
 
 #include <QDebug>
 #include <QMimeData>
@@ -6,8 +7,18 @@
 #include <QDropEvent>
 #include <QDragEnterEvent>
 #include <QGuiApplication>
+#include <QPointer>
 
-DragDropManager::DragDropManager(QObject *parent) : QObject(parent), m_dragActive{false}, m_window{nullptr} {}
+DragDropManager::DragDropManager(QObject *parent) : QObject(parent), m_dragActive{false}, m_window{nullptr}
+{
+    m_pool.setMaxThreadCount(1); // 预读和判断按顺序执行
+}
+
+DragDropManager::~DragDropManager()
+{
+    m_pool.clear();
+    m_pool.waitForDone();
+}
 
 bool DragDropManager::dragActive() const
 {
@@ -31,13 +42,14 @@ bool DragDropManager::eventFilter(QObject *watched, QEvent *event)
     if (!m_window || watched != m_window) return false;
 
     switch (event->type()) {
-    // 拖动进入
+    // 拖动进入：只看URL，不访问文件系统，网络挂载很慢时悬停也不卡
     case QEvent::DragEnter: {
         QDragEnterEvent *dragEvent = static_cast<QDragEnterEvent *>(event);
         const QMimeData *mimeData = dragEvent->mimeData();
 
         if (mimeData->hasUrls()) {
             bool hasSupported = false;
+            QStringList localPaths;
             const auto urls = mimeData->urls();
             for (const QUrl &url : urls) {
                 // 检查是否是网络URL
@@ -45,23 +57,13 @@ bool DragDropManager::eventFilter(QObject *watched, QEvent *event)
                     hasSupported = true;
                     continue;
                 }
-
-                QString localPath = url.toLocalFile();
-                if (localPath.isEmpty()) continue;
-
-                QFileInfo fileInfo(localPath);
-                if (!fileInfo.exists() || !fileInfo.isFile()) continue;
-
-                QString ext = fileInfo.suffix().toLower();
-                static const QStringList supportedFormats{"mp4", "avi", "mkv", "mov", "wmv", "ogg", "mp3", "wav", "flac"};
-
-                if (supportedFormats.contains(ext)) {
-                    hasSupported = true;
-                    break;
-                }
+                if (!url.isLocalFile() || url.toLocalFile().isEmpty()) continue;
+                hasSupported = true; //文件和文件夹释放后才在工作线程判断
+                localPaths.append(url.toLocalFile());
             }
 
             if (hasSupported) {
+                prefetch(localPaths); //悬停期间先读文件头，释放时大多已在缓存中
                 dragEvent->acceptProposedAction();
                 m_dragActive = true;
                 emit dragActiveChanged();
@@ -77,31 +79,8 @@ bool DragDropManager::eventFilter(QObject *watched, QEvent *event)
         const QMimeData *mimeData = dropEvent->mimeData();
 
         if (mimeData->hasUrls()) {
-            QList<QUrl> supportedUrls;
-            const auto urls = mimeData->urls();
-            for (const QUrl &url : urls) {
-                // 检查是否是网络URL
-                if (url.scheme().startsWith("http")) {
-                    supportedUrls.append(url);
-                    continue;
-                }
-
-                QString localPath = url.toLocalFile();
-                if (localPath.isEmpty()) continue;
-
-                QFileInfo fileInfo(localPath);
-                if (!fileInfo.exists() || !fileInfo.isFile()) continue;
-
-                QString ext = fileInfo.suffix().toLower();
-                static const QStringList supportedFormats{"mp4", "avi", "mkv", "mov", "wmv", "ogg", "mp3", "wav", "flac"};
-
-                if (supportedFormats.contains(ext)) { supportedUrls.append(url); }
-            }
-
-            if (!supportedUrls.isEmpty()) {
-                dropEvent->acceptProposedAction();
-                emit filesDropped(supportedUrls);
-            }
+            dropEvent->acceptProposedAction();
+            classify(mimeData->urls());
         }
 
         m_dragActive = false;
@@ -130,3 +109,46 @@ bool DragDropManager::eventFilter(QObject *watched, QEvent *event)
 
     return QObject::eventFilter(watched, event);
 }
+
+void DragDropManager::prefetch(const QStringList &paths)
+{
+    if (paths.isEmpty()) return;
+    m_pool.start([paths]() {
+        for (const QString &path : paths) MediaSniffer::instance().sniff(path);
+    });
+}
+
+void DragDropManager::classify(const QList<QUrl> &urls)
+{
+    // 与预读在同一个单线程池中排队，预读的结果可以直接命中缓存
+    QPointer<DragDropManager> self(this);
+    m_pool.start([self, urls]() {
+        QList<QUrl> supportedUrls;
+        QList<QUrl> folderUrls;
+        for (const QUrl &url : urls) {
+            // 检查是否是网络URL
+            if (url.scheme().startsWith("http")) {
+                supportedUrls.append(url);
+                continue;
+            }
+
+            const QString localPath = url.toLocalFile();
+            if (localPath.isEmpty()) continue;
+
+            QFileInfo fileInfo(localPath);
+            if (fileInfo.isDir()) {
+                folderUrls.append(url);
+            } else if (MediaSniffer::instance().isMedia(localPath)) { //按内容判断，扩展名错误或没有扩展名的文件也能识别
+                supportedUrls.append(url);
+            }
+        }
+
+        QMetaObject::invokeMethod(
+            self, [self, supportedUrls, folderUrls]() {
+                if (!self) return;
+                if (supportedUrls.isEmpty() && folderUrls.isEmpty()) emit self->dropRejected();
+                if (!supportedUrls.isEmpty()) emit self->filesDropped(supportedUrls);
+                if (!folderUrls.isEmpty()) emit self->foldersDropped(folderUrls);
+            }, Qt::QueuedConnection);
+    });
+}
@@ -5,6 +5,7 @@
 #include <QUrl>
 #include <QWindow>
 #include <QEvent>
+#include <QThreadPool>
 
 class DragDropManager : public QObject
 {
@@ -13,6 +14,7 @@ class DragDropManager : public QObject
     Q_PROPERTY(bool dragActive READ dragActive NOTIFY dragActiveChanged) // 拖动状态
 public:
     explicit DragDropManager(QObject *parent = nullptr);
+    ~DragDropManager() override;
 
     bool dragActive() const;
 
@@ -21,11 +23,17 @@ public:
 signals:
     void dragActiveChanged();
     void filesDropped(const QList<QUrl> &urls);
+    void foldersDropped(const QList<QUrl> &urls); // 拖入的文件夹，由播放列表递归扫描
+    void dropRejected();                          // 拖入的内容里既没有音视频文件也没有文件夹
 
 protected:
     bool eventFilter(QObject *watched, QEvent *event) override; // 重写事件处理
 
 private:
+    void prefetch(const QStringList &paths);  // 悬停时在后台读取文件头
+    void classify(const QList<QUrl> &urls);   // 在后台区分文件夹和音视频文件，完成后发出信号
+
     bool m_dragActive;
     QWindow *m_window;
+    QThreadPool m_pool;
 };
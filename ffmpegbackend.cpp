@@ -0,0 +1,1043 @@
+#include "ffmpegbackend.h"
+
+#include <QDebug>
+#include <QMediaDevices>
+#include <QMutexLocker>
+#include <QStringList>
+#include <QtMath>
+#include <cstring>
+
+extern "C" {
+#include <libavcodec/avcodec.h>
+#include <libavfilter/avfilter.h>
+#include <libavfilter/buffersink.h>
+#include <libavfilter/buffersrc.h>
+#include <libavformat/avformat.h>
+#include <libavutil/channel_layout.h>
+#include <libavutil/opt.h>
+#include <libswscale/swscale.h>
+}
+
+namespace {
+constexpr int kPacketQueueCapacity = 1024;            // 每路包队列的最大包数
+constexpr int kEnoughPackets = 64;                    // 两路都达到该数量时暂停读取
+constexpr qint64 kMaxQueuedBytes = 16 * 1024 * 1024;  // 包队列总字节上限
+constexpr int kVideoFrameQueueCapacity = 8;           // 已解码视频帧
+constexpr int kAudioChunkQueueCapacity = 16;          // 已解码音频块，过多会推迟变速生效
+constexpr int kPresentInterval = 4;                   // 呈现检查间隔，毫秒
+constexpr qint64 kPositionInterval = 40;              // 位置通知的最小间隔，毫秒
+constexpr qint64 kAudioBufferUs = 100000;             // 声卡缓冲时长
+
+int interruptCallback(void *opaque)
+{
+    return static_cast<std::atomic_bool *>(opaque)->load() ? 1 : 0;
+}
+
+// 队列满时等待消费者，退出或该数据已因跳转失效时放弃
+template<typename T>
+bool pushWait(SpscQueue<T> &queue, T &item, const std::atomic_bool &abort, const std::atomic_int &serial)
+{
+    while (!queue.push(std::move(item))) {
+        if (abort.load() || item.serial != serial.load()) return false;
+        QThread::msleep(2);
+    }
+    return true;
+}
+
+void updateAverage(std::atomic<qint64> &average, qint64 sample)
+{
+    qint64 current = average.load(std::memory_order_relaxed);
+    average.store(current ? (current * 7 + sample) / 8 : sample, std::memory_order_relaxed);
+}
+
+// 帧时间戳换算为相对媒体开头的毫秒数，无时间戳时返回-1
+qint64 frameTime(const AVFrame *frame, const AVStream *stream, qint64 startTime)
+{
+    int64_t pts = frame->best_effort_timestamp;
+    if (pts == AV_NOPTS_VALUE) pts = frame->pts;
+    if (pts == AV_NOPTS_VALUE) return -1;
+    return av_rescale_q(pts, stream->time_base, AVRational{1, 1000}) - startTime;
+}
+} // namespace
+
+AudioQueueDevice::AudioQueueDevice(FFmpegBackend *backend) : QIODevice{backend}, m_backend{backend} {}
+
+qint64 AudioQueueDevice::readData(char *data, qint64 maxlen)
+{
+    return m_backend->readAudio(data, maxlen);
+}
+
+qint64 AudioQueueDevice::writeData(const char *data, qint64 len)
+{
+    Q_UNUSED(data)
+    Q_UNUSED(len)
+    return -1;
+}
+
+FFmpegBackend::FFmpegBackend(QObject *parent)
+    : PlayerBackend{parent}
+    , m_state{QMediaPlayer::StoppedState}
+    , m_status{QMediaPlayer::NoMedia}
+    , m_duration{0}
+    , m_position{0}
+    , m_rate{1.0}
+    , m_hasVideo{false}
+    , m_hasAudio{false}
+    , m_session{0}
+    , m_audioSink{nullptr}
+    , m_audioDevice{nullptr}
+    , m_clockBase{0}
+    , m_presentedSerial{-1}
+    , m_videoEndedSerial{-1}
+    , m_demuxThread{nullptr}
+    , m_videoThread{nullptr}
+    , m_audioThread{nullptr}
+    , m_abort{false}
+    , m_serial{0}
+    , m_seekRequest{false}
+    , m_seekTarget{0}
+    , m_targetRate{1.0}
+    , m_audioClock{0}
+    , m_audioClockSerial{-1}
+    , m_audioEndedSerial{-1}
+    , m_queuedBytes{0}
+    , m_skipLoopFilter{0}
+    , m_skipFrame{0}
+    , m_formatCtx{nullptr}
+    , m_videoCodecCtx{nullptr}
+    , m_audioCodecCtx{nullptr}
+    , m_videoStream{-1}
+    , m_audioStream{-1}
+    , m_swsCtx{nullptr}
+    , m_framePool{VideoFramePool::create()}
+    , m_filterGraph{nullptr}
+    , m_bufferSrc{nullptr}
+    , m_bufferSink{nullptr}
+    , m_filterRate{1.0}
+    , m_filterStart{-1}
+    , m_videoPackets{kPacketQueueCapacity}
+    , m_audioPackets{kPacketQueueCapacity}
+    , m_videoFrames{kVideoFrameQueueCapacity}
+    , m_audioChunks{kAudioChunkQueueCapacity}
+    , m_chunkOffset{0}
+    , m_videoDecodeUs{0}
+    , m_audioDecodeUs{0}
+    , m_decodedFrames{0}
+    , m_presentedFrames{0}
+    , m_droppedFrames{0}
+    , m_presentLateness{0}
+    , m_avDrift{0}
+    , m_hasAvDrift{false}
+    , m_bytesRead{0}
+{
+    m_audioDevice = new AudioQueueDevice(this);
+    m_presentTimer = new QTimer(this);
+    m_presentTimer->setTimerType(Qt::PreciseTimer);
+    m_presentTimer->setInterval(kPresentInterval);
+    connect(m_presentTimer, &QTimer::timeout, this, &FFmpegBackend::presentTick);
+}
+
+FFmpegBackend::~FFmpegBackend()
+{
+    closeInput();
+}
+
+void FFmpegBackend::setSource(const QUrl &url)
+{
+    closeInput();
+    setState(QMediaPlayer::StoppedState);
+    m_source = url;
+    ++m_session;
+    m_duration = 0;
+    m_position = 0;
+    emit durationChanged(0);
+    emit positionChanged(0);
+
+    if (url.isEmpty()) {
+        setStatus(QMediaPlayer::NoMedia);
+        return;
+    }
+
+    // 打开和解复用都在独立线程中进行，网络流的连接不会阻塞界面
+    setStatus(QMediaPlayer::LoadingMedia);
+    int session = m_session;
+    m_demuxThread = QThread::create([this, url, session]() { demuxLoop(url, session); });
+    m_demuxThread->start();
+}
+
+QUrl FFmpegBackend::source() const
+{
+    return m_source;
+}
+
+void FFmpegBackend::play()
+{
+    if (m_source.isEmpty() || m_status == QMediaPlayer::InvalidMedia) return;
+    if (m_status == QMediaPlayer::EndOfMedia) setPosition(0);
+    if (m_state == QMediaPlayer::PlayingState) return;
+
+    setState(QMediaPlayer::PlayingState);
+    if (m_status == QMediaPlayer::LoadingMedia) return; // 打开完成后自动开始
+
+    m_clockTimer.restart();
+    startAudio();
+    m_presentTimer->start();
+    setStatus(QMediaPlayer::BufferedMedia);
+}
+
+void FFmpegBackend::pause()
+{
+    if (m_state == QMediaPlayer::PausedState) return;
+    m_clockBase = masterClock();
+    if (m_audioSink) m_audioSink->suspend();
+    setState(QMediaPlayer::PausedState);
+}
+
+void FFmpegBackend::stop()
+{
+    if (m_state == QMediaPlayer::StoppedState) return;
+    if (m_audioSink) m_audioSink->suspend();
+    setState(QMediaPlayer::StoppedState);
+    setPosition(0);
+    if (m_status == QMediaPlayer::BufferedMedia) setStatus(QMediaPlayer::LoadedMedia);
+}
+
+void FFmpegBackend::setPosition(qint64 position)
+{
+    if (m_source.isEmpty()) return;
+    position = qMax<qint64>(0, position);
+    if (m_duration > 0) position = qMin(position, m_duration);
+
+    // 先登记跳转请求再递增序号，保证解复用线程不会给跳转前读到的包打上新序号
+    m_seekTarget.store(position);
+    m_seekRequest.store(true);
+    m_serial.fetch_add(1);
+
+    m_clockBase = position;
+    m_clockTimer.restart();
+    m_drainTimer.invalidate();
+    if (m_audioSink) {
+        m_audioSink->stop(); // 丢弃声卡中跳转前的数据
+        if (m_state == QMediaPlayer::PlayingState) startAudio();
+    }
+    if (m_status == QMediaPlayer::EndOfMedia) {
+        setStatus(m_state == QMediaPlayer::PlayingState ? QMediaPlayer::BufferedMedia : QMediaPlayer::LoadedMedia);
+    }
+    if (m_status != QMediaPlayer::LoadingMedia) m_presentTimer->start(); // 暂停时也呈现跳转后的一帧
+
+    m_position = position;
+    emit positionChanged(position);
+}
+
+qint64 FFmpegBackend::position() const
+{
+    return m_position;
+}
+
+qint64 FFmpegBackend::duration() const
+{
+    return m_duration;
+}
+
+void FFmpegBackend::setPlaybackRate(qreal rate)
+{
+    if (rate <= 0 || qFuzzyCompare(rate, m_rate)) return;
+    m_clockBase = masterClock();
+    m_clockTimer.restart();
+    m_rate = rate;
+    m_targetRate.store(rate); // 音频线程据此重建atempo滤镜
+    emit playbackRateChanged(rate);
+}
+
+qreal FFmpegBackend::playbackRate() const
+{
+    return m_rate;
+}
+
+QMediaPlayer::PlaybackState FFmpegBackend::playbackState() const
+{
+    return m_state;
+}
+
+QMediaPlayer::MediaStatus FFmpegBackend::mediaStatus() const
+{
+    return m_status;
+}
+
+bool FFmpegBackend::hasVideo() const
+{
+    return m_hasVideo;
+}
+
+void FFmpegBackend::setVideoSink(QVideoSink *sink)
+{
+    m_videoSink = sink;
+    // 预先打开时没有输出，接上输出后再呈现首帧
+    if (sink && m_hasVideo && m_presentedSerial != m_serial.load()) m_presentTimer->start();
+}
+
+void FFmpegBackend::setAudioOutput(QAudioOutput *output)
+{
+    if (m_audioOutput) m_audioOutput->disconnect(this);
+    m_audioOutput = output;
+    if (!output) return;
+
+    connect(output, &QAudioOutput::volumeChanged, this, [this](float volume) {
+        if (m_audioSink && !m_audioOutput->isMuted()) m_audioSink->setVolume(volume);
+    });
+    connect(output, &QAudioOutput::mutedChanged, this, [this](bool muted) {
+        if (m_audioSink) m_audioSink->setVolume(muted ? 0.0 : m_audioOutput->volume());
+    });
+    // 切换输出设备时重建QAudioSink
+    connect(output, &QAudioOutput::deviceChanged, this, [this]() {
+        if (!m_audioSink) return;
+        m_audioSink->stop();
+        delete m_audioSink;
+        m_audioSink = nullptr;
+        if (m_state == QMediaPlayer::PlayingState) startAudio();
+    });
+}
+
+void FFmpegBackend::setKeyframeIndex(std::shared_ptr<const KeyframeIndex> index)
+{
+    QMutexLocker locker(&m_indexMutex);
+    m_keyframeIndex = std::move(index);
+}
+
+void FFmpegBackend::setDecodeSettings(const DecodeSettings &settings)
+{
+    DecodeSettings old;
+    {
+        QMutexLocker locker(&m_indexMutex);
+        old = m_decodeSettings;
+        m_decodeSettings = settings;
+    }
+    m_skipLoopFilter.store(settings.skipLoopFilter);
+    m_skipFrame.store(settings.skipFrame);
+
+    // 线程和lowres只能在打开解码器时设置
+    if (settings.needsReopen(old) && m_videoCodecCtx && m_status != QMediaPlayer::LoadingMedia) reopen();
+}
+
+QVariantMap FFmpegBackend::stats() const
+{
+    QVariantMap stats;
+    stats["videoPackets"] = int(m_videoPackets.size());
+    stats["audioPackets"] = int(m_audioPackets.size());
+    stats["packetCapacity"] = kPacketQueueCapacity;
+    stats["videoFrames"] = int(m_videoFrames.size());
+    stats["videoFrameCapacity"] = kVideoFrameQueueCapacity;
+    stats["audioChunks"] = int(m_audioChunks.size());
+    stats["audioChunkCapacity"] = kAudioChunkQueueCapacity;
+    stats["queuedKB"] = m_queuedBytes.load() / 1024;
+    stats["videoDecodeMs"] = m_videoDecodeUs.load() / 1000.0;
+    stats["audioDecodeMs"] = m_audioDecodeUs.load() / 1000.0;
+    stats["decodedFrames"] = m_decodedFrames.load();
+    stats["presentedFrames"] = m_presentedFrames;
+    stats["droppedFrames"] = m_droppedFrames;
+    stats["presentLatencyMs"] = m_presentLateness;
+    stats["decodeHistogram"] = m_decodeHistogram.toVariantList();
+    stats["presentHistogram"] = m_presentHistogram.toVariantList();
+    stats["decodeP95Ms"] = m_decodeHistogram.percentile(0.95);
+    stats["presentP95Ms"] = m_presentHistogram.percentile(0.95);
+    stats["bytesRead"] = m_bytesRead.load();
+    // 缓冲水位取解码后帧队列的填充比例，队列见底时就会卡顿
+    if (m_hasVideo) {
+        stats["bufferFill"] = qreal(m_videoFrames.size()) / kVideoFrameQueueCapacity;
+    } else if (m_hasAudio) {
+        stats["bufferFill"] = qreal(m_audioChunks.size()) / kAudioChunkQueueCapacity;
+    }
+    if (m_hasAvDrift) stats["avDriftMs"] = m_avDrift;
+    if (m_audioSink) {
+        qint64 buffered = m_audioSink->bufferSize() - m_audioSink->bytesFree();
+        stats["audioLatencyMs"] = m_audioFormat.durationForBytes(buffered) / 1000;
+    }
+    stats.insert(m_framePool->stats().toVariantMap());
+    return stats;
+}
+
+void FFmpegBackend::demuxLoop(const QUrl &url, int session)
+{
+    bool ok = openInput(url);
+    qint64 duration = 0;
+    if (ok && m_formatCtx->duration != AV_NOPTS_VALUE) duration = m_formatCtx->duration / (AV_TIME_BASE / 1000);
+    QMetaObject::invokeMethod(
+        this, [this, session, ok, duration]() {
+            if (session != m_session) return;
+            m_duration = duration;
+            onInputOpened(session, ok);
+        }, Qt::QueuedConnection);
+    if (!ok) return;
+
+    AVPacket *packet = av_packet_alloc();
+    int eofSerial = -1;
+    while (!m_abort.load()) {
+        // 先读序号再检查跳转请求，与setPosition中的顺序配合
+        const int serial = m_serial.load();
+        if (m_seekRequest.exchange(false)) {
+            seekInput(m_seekTarget.load());
+            eofSerial = -1;
+            continue;
+        }
+        if (eofSerial == serial || enoughPackets()) {
+            QThread::msleep(5);
+            continue;
+        }
+
+        int ret = av_read_frame(m_formatCtx, packet);
+        if (ret < 0) {
+            if (ret == AVERROR_EOF || avio_feof(m_formatCtx->pb)) {
+                // 向解码线程发送空包，冲刷解码器中剩余的帧
+                if (m_videoCodecCtx) pushPacket(m_videoPackets, nullptr, serial);
+                if (m_audioCodecCtx) pushPacket(m_audioPackets, nullptr, serial);
+                eofSerial = serial;
+            } else {
+                QThread::msleep(10); // 网络流暂时没有数据
+            }
+            continue;
+        }
+
+        m_bytesRead += packet->size;
+        SpscQueue<PacketItem> *queue = nullptr;
+        if (packet->stream_index == m_videoStream) queue = &m_videoPackets;
+        else if (packet->stream_index == m_audioStream) queue = &m_audioPackets;
+        if (!queue) {
+            av_packet_unref(packet);
+            continue;
+        }
+        AVPacket *item = av_packet_alloc();
+        av_packet_move_ref(item, packet);
+        pushPacket(*queue, item, serial);
+    }
+    av_packet_free(&packet);
+}
+
+bool FFmpegBackend::openInput(const QUrl &url)
+{
+    m_formatCtx = avformat_alloc_context();
+    if (!m_formatCtx) return false;
+    m_formatCtx->interrupt_callback.callback = interruptCallback; // 关闭时中断阻塞的网络读取
+    m_formatCtx->interrupt_callback.opaque = &m_abort;
+
+    QByteArray location = url.isLocalFile() ? url.toLocalFile().toUtf8() : url.toString().toUtf8();
+    if (avformat_open_input(&m_formatCtx, location.constData(), nullptr, nullptr) < 0) {
+        qWarning() << "FFmpegBackend: failed to open" << url;
+        return false;
+    }
+    if (avformat_find_stream_info(m_formatCtx, nullptr) < 0) {
+        qWarning() << "FFmpegBackend: failed to find stream information";
+        return false;
+    }
+
+    // 音频文件中的封面图片流不作为视频
+    int video = av_find_best_stream(m_formatCtx, AVMEDIA_TYPE_VIDEO, -1, -1, nullptr, 0);
+    if (video >= 0 && !(m_formatCtx->streams[video]->disposition & AV_DISPOSITION_ATTACHED_PIC)
+        && openDecoder(video, &m_videoCodecCtx)) {
+        m_videoStream = video;
+    }
+    int audio = av_find_best_stream(m_formatCtx, AVMEDIA_TYPE_AUDIO, -1, m_videoStream, nullptr, 0);
+    if (audio >= 0 && openDecoder(audio, &m_audioCodecCtx)) m_audioStream = audio;
+
+    // 其余的流在解复用时直接丢弃
+    for (unsigned int i = 0; i < m_formatCtx->nb_streams; ++i) {
+        if (int(i) != m_videoStream && int(i) != m_audioStream) m_formatCtx->streams[i]->discard = AVDISCARD_ALL;
+    }
+    return m_videoCodecCtx || m_audioCodecCtx;
+}
+
+bool FFmpegBackend::openDecoder(int streamIndex, AVCodecContext **codecCtx)
+{
+    AVStream *stream = m_formatCtx->streams[streamIndex];
+    const AVCodec *codec = avcodec_find_decoder(stream->codecpar->codec_id);
+    if (!codec) return false;
+
+    AVCodecContext *ctx = avcodec_alloc_context3(codec);
+    if (!ctx || avcodec_parameters_to_context(ctx, stream->codecpar) < 0) {
+        avcodec_free_context(&ctx);
+        return false;
+    }
+    ctx->pkt_timebase = stream->time_base;
+    ctx->thread_count = 0; // 自动线程数
+    ctx->thread_type = FF_THREAD_FRAME | FF_THREAD_SLICE;
+    if (stream->codecpar->codec_type == AVMEDIA_TYPE_VIDEO) {
+        QMutexLocker locker(&m_indexMutex);
+        m_decodeSettings.apply(ctx);
+    }
+    if (avcodec_open2(ctx, codec, nullptr) < 0) {
+        qWarning() << "FFmpegBackend: failed to open decoder" << codec->name;
+        avcodec_free_context(&ctx);
+        return false;
+    }
+    *codecCtx = ctx;
+    return true;
+}
+
+void FFmpegBackend::seekInput(qint64 position)
+{
+    std::shared_ptr<const KeyframeIndex> index;
+    {
+        QMutexLocker locker(&m_indexMutex);
+        index = m_keyframeIndex;
+    }
+
+    // 有关键帧索引时直接定位到目标GOP的关键帧，省去解复用器自身的搜索
+    if (index && index->streamIndex() == m_videoStream) {
+        int i = index->indexBefore(position);
+        if (i >= 0 && av_seek_frame(m_formatCtx, m_videoStream, index->at(i).pts, AVSEEK_FLAG_BACKWARD) >= 0) return;
+    }
+
+    qint64 target = position * (AV_TIME_BASE / 1000);
+    if (m_formatCtx->start_time != AV_NOPTS_VALUE) target += m_formatCtx->start_time;
+    if (av_seek_frame(m_formatCtx, -1, target, AVSEEK_FLAG_BACKWARD) < 0) {
+        qWarning() << "FFmpegBackend: seek failed" << position;
+    }
+}
+
+bool FFmpegBackend::pushPacket(SpscQueue<PacketItem> &queue, AVPacket *packet, int serial)
+{
+    int size = packet ? packet->size : 0;
+    PacketItem item{packet, serial};
+    if (!pushWait(queue, item, m_abort, m_serial)) {
+        av_packet_free(&packet);
+        return false;
+    }
+    m_queuedBytes += size;
+    return true;
+}
+
+bool FFmpegBackend::enoughPackets() const
+{
+    if (m_queuedBytes.load() > kMaxQueuedBytes) return true;
+    bool videoEnough = !m_videoCodecCtx || m_videoPackets.size() >= kEnoughPackets;
+    bool audioEnough = !m_audioCodecCtx || m_audioPackets.size() >= kEnoughPackets;
+    return videoEnough && audioEnough;
+}
+
+void FFmpegBackend::videoDecodeLoop()
+{
+    AVStream *stream = m_formatCtx->streams[m_videoStream];
+    const qint64 startTime = m_formatCtx->start_time != AV_NOPTS_VALUE ? m_formatCtx->start_time / 1000 : 0;
+    AVFrame *frame = av_frame_alloc();
+    int serial = -1;
+    qint64 dropBefore = 0;
+    qint64 lastPts = 0;
+    PacketItem item;
+
+    while (!m_abort.load()) {
+        if (!m_videoPackets.pop(item)) {
+            QThread::msleep(2);
+            continue;
+        }
+        if (item.packet) m_queuedBytes -= item.packet->size;
+        if (!serialValid(item.serial)) {
+            av_packet_free(&item.packet);
+            continue;
+        }
+        if (item.serial != serial) {
+            avcodec_flush_buffers(m_videoCodecCtx);
+            serial = item.serial;
+            dropBefore = m_seekTarget.load();
+        }
+        m_videoCodecCtx->skip_loop_filter = static_cast<AVDiscard>(m_skipLoopFilter.load());
+        m_videoCodecCtx->skip_frame = static_cast<AVDiscard>(m_skipFrame.load());
+
+        QElapsedTimer timer;
+        timer.start();
+        const bool eof = !item.packet;
+        avcodec_send_packet(m_videoCodecCtx, item.packet);
+        av_packet_free(&item.packet);
+
+        while (avcodec_receive_frame(m_videoCodecCtx, frame) == 0) {
+            qint64 pts = frameTime(frame, stream, startTime);
+            if (pts < 0) pts = lastPts;
+            lastPts = pts;
+            // 从关键帧解码到跳转目标，目标之前的帧不呈现
+            if (pts < dropBefore) {
+                av_frame_unref(frame);
+                continue;
+            }
+
+            VideoFrameItem out;
+            out.frame = toVideoFrame(frame);
+            out.pts = pts;
+            out.serial = serial;
+            av_frame_unref(frame);
+            updateAverage(m_videoDecodeUs, timer.nsecsElapsed() / 1000);
+            m_decodeHistogram.add(timer.nsecsElapsed() / 1000);
+            ++m_decodedFrames;
+            if (!out.frame.isValid()) continue;
+            if (!pushWait(m_videoFrames, out, m_abort, m_serial)) break;
+            timer.restart();
+        }
+
+        if (eof) {
+            VideoFrameItem end;
+            end.serial = serial;
+            end.eof = true;
+            pushWait(m_videoFrames, end, m_abort, m_serial);
+        }
+    }
+    av_frame_free(&frame);
+}
+
+void FFmpegBackend::audioDecodeLoop()
+{
+    AVStream *stream = m_formatCtx->streams[m_audioStream];
+    const qint64 startTime = m_formatCtx->start_time != AV_NOPTS_VALUE ? m_formatCtx->start_time / 1000 : 0;
+    AVFrame *frame = av_frame_alloc();
+    int serial = -1;
+    qint64 dropBefore = 0;
+    qint64 nextPts = 0;
+    PacketItem item;
+
+    while (!m_abort.load()) {
+        if (!m_audioPackets.pop(item)) {
+            QThread::msleep(2);
+            continue;
+        }
+        if (item.packet) m_queuedBytes -= item.packet->size;
+        if (!serialValid(item.serial)) {
+            av_packet_free(&item.packet);
+            continue;
+        }
+        if (item.serial != serial) {
+            // 跳转后清空解码器和滤镜图中残留的数据
+            avcodec_flush_buffers(m_audioCodecCtx);
+            avfilter_graph_free(&m_filterGraph);
+            serial = item.serial;
+            dropBefore = m_seekTarget.load();
+        }
+
+        QElapsedTimer timer;
+        timer.start();
+        const bool eof = !item.packet;
+        avcodec_send_packet(m_audioCodecCtx, item.packet);
+        av_packet_free(&item.packet);
+
+        while (avcodec_receive_frame(m_audioCodecCtx, frame) == 0) {
+            qint64 pts = frameTime(frame, stream, startTime);
+            if (pts < 0) pts = nextPts;
+            nextPts = pts + qint64(frame->nb_samples) * 1000 / qMax(1, frame->sample_rate);
+            if (nextPts <= dropBefore) {
+                av_frame_unref(frame);
+                continue;
+            }
+            updateAverage(m_audioDecodeUs, timer.nsecsElapsed() / 1000);
+            filterAudio(frame, serial, pts);
+            av_frame_unref(frame);
+            timer.restart();
+        }
+
+        if (eof) {
+            filterAudio(nullptr, serial, nextPts); // 取出atempo中剩余的数据
+            AudioChunkItem end;
+            end.serial = serial;
+            end.eof = true;
+            pushWait(m_audioChunks, end, m_abort, m_serial);
+        }
+    }
+    av_frame_free(&frame);
+}
+
+QVideoFrame FFmpegBackend::toVideoFrame(AVFrame *frame)
+{
+    return m_framePool->toVideoFrame(frame, &m_swsCtx);
+}
+
+bool FFmpegBackend::configureAudioFilter(AVFrame *frame, qreal rate)
+{
+    avfilter_graph_free(&m_filterGraph);
+    m_filterGraph = avfilter_graph_alloc();
+    if (!m_filterGraph) return false;
+
+    AVChannelLayout layout;
+    if (frame->ch_layout.order == AV_CHANNEL_ORDER_UNSPEC) {
+        av_channel_layout_default(&layout, frame->ch_layout.nb_channels);
+    } else {
+        av_channel_layout_copy(&layout, &frame->ch_layout);
+    }
+    char layoutName[64] = {0};
+    av_channel_layout_describe(&layout, layoutName, sizeof(layoutName));
+    av_channel_layout_uninit(&layout);
+
+    QByteArray args = QString("time_base=1/%1:sample_rate=%1:sample_fmt=%2:channel_layout=%3")
+                          .arg(frame->sample_rate)
+                          .arg(av_get_sample_fmt_name(static_cast<AVSampleFormat>(frame->format)))
+                          .arg(layoutName)
+                          .toUtf8();
+    if (avfilter_graph_create_filter(
+            &m_bufferSrc, avfilter_get_by_name("abuffer"), "in", args.constData(), nullptr, m_filterGraph) < 0
+        || avfilter_graph_create_filter(
+               &m_bufferSink, avfilter_get_by_name("abuffersink"), "out", nullptr, nullptr, m_filterGraph) < 0) {
+        avfilter_graph_free(&m_filterGraph);
+        return false;
+    }
+
+    // 变速不变调，atempo单级只支持0.5倍以上，更慢的速率串联多级
+    QStringList filters;
+    qreal tempo = rate;
+    while (tempo < 0.5) {
+        filters << "atempo=0.5";
+        tempo /= 0.5;
+    }
+    filters << QString("atempo=%1").arg(tempo);
+    filters << QString("aformat=sample_fmts=flt:sample_rates=%1:channel_layouts=stereo").arg(m_audioFormat.sampleRate());
+    QByteArray spec = filters.join(',').toUtf8();
+
+    AVFilterInOut *outputs = avfilter_inout_alloc();
+    AVFilterInOut *inputs = avfilter_inout_alloc();
+    outputs->name = av_strdup("in");
+    outputs->filter_ctx = m_bufferSrc;
+    outputs->pad_idx = 0;
+    outputs->next = nullptr;
+    inputs->name = av_strdup("out");
+    inputs->filter_ctx = m_bufferSink;
+    inputs->pad_idx = 0;
+    inputs->next = nullptr;
+
+    int ret = avfilter_graph_parse_ptr(m_filterGraph, spec.constData(), &inputs, &outputs, nullptr);
+    if (ret >= 0) ret = avfilter_graph_config(m_filterGraph, nullptr);
+    avfilter_inout_free(&inputs);
+    avfilter_inout_free(&outputs);
+    if (ret < 0) {
+        qWarning() << "FFmpegBackend: failed to configure audio filter" << spec;
+        avfilter_graph_free(&m_filterGraph);
+        return false;
+    }
+
+    m_filterRate = rate;
+    m_filterStart = -1;
+    return true;
+}
+
+bool FFmpegBackend::filterAudio(AVFrame *frame, int serial, qint64 pts)
+{
+    const qreal rate = m_targetRate.load();
+    if (frame && (!m_filterGraph || !qFuzzyCompare(rate, m_filterRate))) {
+        if (!configureAudioFilter(frame, rate)) return false;
+    }
+    if (!m_filterGraph) return false;
+
+    if (frame) {
+        if (m_filterStart < 0) m_filterStart = pts;
+        frame->pts = av_rescale(pts, frame->sample_rate, 1000);
+        if (av_buffersrc_add_frame(m_bufferSrc, frame) < 0) return false;
+    } else {
+        av_buffersrc_add_frame(m_bufferSrc, nullptr);
+    }
+
+    AVFrame *filtered = av_frame_alloc();
+    const AVRational timeBase = av_buffersink_get_time_base(m_bufferSink);
+    while (av_buffersink_get_frame(m_bufferSink, filtered) >= 0) {
+        AudioChunkItem chunk;
+        chunk.serial = serial;
+        chunk.rate = m_filterRate;
+        // atempo输出的时间戳按输出采样数递增，需换算回媒体时间
+        qint64 outputTime = av_rescale_q(filtered->pts, timeBase, AVRational{1, 1000});
+        chunk.pts = m_filterStart + qint64((outputTime - m_filterStart) * m_filterRate);
+        chunk.data = QByteArray(reinterpret_cast<const char *>(filtered->data[0]),
+                                filtered->nb_samples * 2 * int(sizeof(float)));
+        av_frame_unref(filtered);
+        if (!pushWait(m_audioChunks, chunk, m_abort, m_serial)) break;
+    }
+    av_frame_free(&filtered);
+    return true;
+}
+
+void FFmpegBackend::onInputOpened(int session, bool ok)
+{
+    if (session != m_session) return;
+    if (!ok) {
+        setStatus(QMediaPlayer::InvalidMedia);
+        setState(QMediaPlayer::StoppedState);
+        emit errorOccurred(QMediaPlayer::FormatError, tr("Failed to open %1").arg(m_source.toString()));
+        return;
+    }
+
+    m_hasVideo = m_videoCodecCtx != nullptr;
+    m_hasAudio = m_audioCodecCtx != nullptr;
+    emit durationChanged(m_duration);
+
+    if (m_hasAudio) {
+        // 统一输出为设备首选采样率的float立体声，由aformat完成重采样
+        QAudioDevice device = m_audioOutput ? m_audioOutput->device() : QMediaDevices::defaultAudioOutput();
+        int sampleRate = device.preferredFormat().sampleRate();
+        m_audioFormat.setSampleRate(sampleRate > 0 ? sampleRate : m_audioCodecCtx->sample_rate);
+        m_audioFormat.setChannelCount(2);
+        m_audioFormat.setSampleFormat(QAudioFormat::Float);
+        m_audioThread = QThread::create([this]() { audioDecodeLoop(); });
+        m_audioThread->start();
+    }
+    if (m_hasVideo) {
+        m_videoThread = QThread::create([this]() { videoDecodeLoop(); });
+        m_videoThread->start();
+    }
+
+    setStatus(QMediaPlayer::LoadedMedia);
+    m_presentTimer->start(); // 呈现首帧
+    if (m_state == QMediaPlayer::PlayingState) {
+        m_clockTimer.restart();
+        startAudio();
+        setStatus(QMediaPlayer::BufferedMedia);
+    }
+}
+
+void FFmpegBackend::closeInput()
+{
+    m_abort.store(true);
+    for (QThread **thread : {&m_demuxThread, &m_videoThread, &m_audioThread}) {
+        if (!*thread) continue;
+        (*thread)->wait();
+        delete *thread;
+        *thread = nullptr;
+    }
+    m_abort.store(false);
+
+    m_presentTimer->stop();
+    if (m_audioSink) {
+        m_audioSink->stop();
+        delete m_audioSink;
+        m_audioSink = nullptr;
+    }
+
+    // 线程全部退出后由当前线程清空队列
+    PacketItem packet;
+    while (m_videoPackets.pop(packet)) av_packet_free(&packet.packet);
+    while (m_audioPackets.pop(packet)) av_packet_free(&packet.packet);
+    VideoFrameItem frame;
+    while (m_videoFrames.pop(frame)) {}
+    AudioChunkItem chunk;
+    while (m_audioChunks.pop(chunk)) {}
+    m_currentChunk = AudioChunkItem();
+    m_chunkOffset = 0;
+    m_queuedBytes.store(0);
+
+    if (m_swsCtx) {
+        sws_freeContext(m_swsCtx);
+        m_swsCtx = nullptr;
+    }
+    avfilter_graph_free(&m_filterGraph);
+    avcodec_free_context(&m_videoCodecCtx);
+    avcodec_free_context(&m_audioCodecCtx);
+    avformat_close_input(&m_formatCtx);
+    m_videoStream = -1;
+    m_audioStream = -1;
+    m_hasVideo = false;
+    m_hasAudio = false;
+    {
+        QMutexLocker locker(&m_indexMutex);
+        m_keyframeIndex.reset();
+    }
+
+    m_seekRequest.store(false);
+    m_seekTarget.store(0);
+    m_serial.fetch_add(1);
+    m_clockBase = 0;
+    m_drainTimer.invalidate();
+    m_presentedSerial = -1;
+    m_videoEndedSerial = -1;
+    m_audioClockSerial.store(-1);
+    m_audioEndedSerial.store(-1);
+    m_videoDecodeUs.store(0);
+    m_audioDecodeUs.store(0);
+    m_decodedFrames.store(0);
+    m_presentedFrames = 0;
+    m_droppedFrames = 0;
+    m_presentLateness = 0;
+    m_avDrift = 0;
+    m_hasAvDrift = false;
+    m_bytesRead.store(0);
+    m_decodeHistogram.reset();
+    m_presentHistogram.reset();
+}
+
+void FFmpegBackend::reopen()
+{
+    QUrl source = m_source;
+    qint64 position = m_position;
+    QMediaPlayer::PlaybackState state = m_state;
+    std::shared_ptr<const KeyframeIndex> index;
+    {
+        QMutexLocker locker(&m_indexMutex);
+        index = m_keyframeIndex;
+    }
+
+    setSource(source);
+    setKeyframeIndex(index);
+    setPosition(position);
+    if (state == QMediaPlayer::PlayingState) play();
+    else if (state == QMediaPlayer::PausedState) pause();
+}
+
+void FFmpegBackend::presentTick()
+{
+    const int serial = m_serial.load();
+    const bool playing = m_state == QMediaPlayer::PlayingState;
+    const qint64 clock = masterClock();
+
+    // 没有输出时保留首帧，等待setVideoSink
+    if (!playing && !m_videoSink) {
+        m_presentTimer->stop();
+        return;
+    }
+
+    // 呈现已到期的最新一帧，来不及呈现的帧直接丢弃
+    while (VideoFrameItem *item = m_videoFrames.front()) {
+        VideoFrameItem current;
+        if (item->serial != serial) {
+            m_videoFrames.pop(current);
+            continue;
+        }
+        if (item->eof) {
+            m_videoFrames.pop(current);
+            m_videoEndedSerial = serial;
+            break;
+        }
+        if (playing ? item->pts > clock : m_presentedSerial == serial) break;
+
+        m_videoFrames.pop(current);
+        VideoFrameItem *next = m_videoFrames.front();
+        if (playing && next && next->serial == serial && !next->eof && next->pts <= clock) {
+            ++m_droppedFrames;
+            continue;
+        }
+        if (m_videoSink) m_videoSink->setVideoFrame(current.frame);
+        ++m_presentedFrames;
+        if (playing) {
+            m_presentLateness = (m_presentLateness * 7 + (clock - current.pts)) / 8;
+            m_presentHistogram.add(qAbs(clock - current.pts) * 1000);
+            // 音画偏差按声卡实际播放到的位置计算，不用可能来自系统时钟的主时钟
+            if (const std::optional<qint64> audio = audioClock()) {
+                const qint64 drift = current.pts - *audio;
+                m_avDrift = m_hasAvDrift ? (m_avDrift * 7 + drift) / 8 : drift;
+                m_hasAvDrift = true;
+            }
+        }
+        m_presentedSerial = serial;
+        break;
+    }
+
+    if (!playing) {
+        // 暂停时只需呈现跳转后的一帧
+        if (!m_hasVideo || m_presentedSerial == serial || m_videoEndedSerial == serial) m_presentTimer->stop();
+        return;
+    }
+
+    qint64 position = qMax<qint64>(0, clock);
+    if (m_duration > 0) position = qMin(position, m_duration);
+    if (qAbs(position - m_position) >= kPositionInterval) {
+        m_position = position;
+        emit positionChanged(position);
+    }
+
+    // 两路都收到结束标记，且声卡中的数据播放完毕后结束
+    bool videoDone = !m_hasVideo || m_videoEndedSerial == serial;
+    bool audioDone = !m_hasAudio || m_audioEndedSerial.load() == serial;
+    if (m_hasAudio && audioDone && !m_drainTimer.isValid()) m_drainTimer.start();
+    if (videoDone && audioDone && (!m_hasAudio || m_drainTimer.elapsed() >= kAudioBufferUs / 1000)) {
+        finishPlayback();
+    }
+}
+
+void FFmpegBackend::startAudio()
+{
+    if (!m_hasAudio) return;
+    if (!m_audioSink) {
+        QAudioDevice device = m_audioOutput ? m_audioOutput->device() : QMediaDevices::defaultAudioOutput();
+        m_audioSink = new QAudioSink(device, m_audioFormat, this);
+        m_audioSink->setBufferSize(m_audioFormat.bytesForDuration(kAudioBufferUs));
+        if (m_audioOutput) m_audioSink->setVolume(m_audioOutput->isMuted() ? 0.0 : m_audioOutput->volume());
+    }
+
+    if (m_audioSink->state() == QAudio::SuspendedState) {
+        m_audioSink->resume();
+    } else if (m_audioSink->state() == QAudio::StoppedState) {
+        if (!m_audioDevice->isOpen()) m_audioDevice->open(QIODevice::ReadOnly);
+        m_audioSink->start(m_audioDevice);
+    }
+}
+
+void FFmpegBackend::finishPlayback()
+{
+    m_presentTimer->stop();
+    if (m_audioSink) m_audioSink->suspend();
+    m_clockBase = m_duration;
+    m_position = m_duration;
+    emit positionChanged(m_duration);
+    setState(QMediaPlayer::StoppedState);
+    setStatus(QMediaPlayer::EndOfMedia);
+}
+
+void FFmpegBackend::setState(QMediaPlayer::PlaybackState state)
+{
+    if (m_state == state) return;
+    m_state = state;
+    emit playbackStateChanged(state);
+}
+
+void FFmpegBackend::setStatus(QMediaPlayer::MediaStatus status)
+{
+    if (m_status == status) return;
+    m_status = status;
+    emit mediaStatusChanged(status);
+}
+
+qint64 FFmpegBackend::masterClock()
+{
+    if (m_state != QMediaPlayer::PlayingState) return m_clockBase;
+
+    qint64 clock = m_clockBase + qint64(m_clockTimer.elapsed() * m_rate);
+    // 有音频时以声卡的播放进度为准，并把系统时钟重新锚定到音频时钟
+    if (const std::optional<qint64> audio = audioClock()) {
+        clock = *audio;
+        m_clockBase = clock;
+        m_clockTimer.restart();
+    }
+    return clock;
+}
+
+std::optional<qint64> FFmpegBackend::audioClock() const
+{
+    const int serial = m_serial.load();
+    if (!m_audioSink || m_audioClockSerial.load() != serial || m_audioEndedSerial.load() == serial) return std::nullopt;
+    // 声卡已取走的位置减去还在声卡缓冲里没有播出的部分
+    qint64 buffered = m_audioSink->bufferSize() - m_audioSink->bytesFree();
+    return m_audioClock.load() - qint64(m_audioFormat.durationForBytes(buffered) / 1000 * m_rate);
+}
+
+qint64 FFmpegBackend::readAudio(char *data, qint64 maxlen)
+{
+    const int serial = m_serial.load();
+    const qint64 bytesPerSecond = m_audioFormat.bytesForDuration(1000000);
+    qint64 written = 0;
+
+    while (written < maxlen) {
+        if (m_currentChunk.serial != serial || m_chunkOffset >= m_currentChunk.data.size()) {
+            AudioChunkItem next;
+            if (!m_audioChunks.pop(next)) break;
+            if (next.serial != serial) continue;
+            if (next.eof) {
+                m_audioEndedSerial.store(serial);
+                continue;
+            }
+            m_currentChunk = std::move(next);
+            m_chunkOffset = 0;
+            continue;
+        }
+
+        qint64 n = qMin(maxlen - written, m_currentChunk.data.size() - m_chunkOffset);
+        std::memcpy(data + written, m_currentChunk.data.constData() + m_chunkOffset, n);
+        written += n;
+        m_chunkOffset += n;
+        // 已交给声卡的数据对应的媒体时间
+        m_audioClock.store(m_currentChunk.pts + qint64(m_chunkOffset * 1000 * m_currentChunk.rate / bytesPerSecond));
+        m_audioClockSerial.store(serial);
+    }
+
+    // 队列暂时为空时填充静音，保持声卡持续拉取
+    if (written < maxlen) {
+        std::memset(data + written, 0, maxlen - written);
+        written = maxlen;
+    }
+    return written;
+}
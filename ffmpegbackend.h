@@ -0,0 +1,210 @@
+#pragma once
+
+#include <QAudioDevice>
+#include <QAudioFormat>
+#include <QAudioSink>
+#include <QByteArray>
+#include <QElapsedTimer>
+#include <QIODevice>
+#include <QMutex>
+#include <QPointer>
+#include <QThread>
+#include <QTimer>
+#include <QVideoFrame>
+#include <atomic>
+#include <optional>
+
+#include "playerbackend.h"
+#include "spscqueue.h"
+#include "videoframepool.h"
+#include "latencyhistogram.h"
+
+struct AVFormatContext;
+struct AVCodecContext;
+struct AVFrame;
+struct AVPacket;
+struct AVFilterGraph;
+struct AVFilterContext;
+struct SwsContext;
+
+// 解复用线程送往解码线程的数据包，packet为空表示流结束
+struct PacketItem
+{
+    AVPacket *packet = nullptr;
+    int serial = 0; // 跳转序号，解码线程据此丢弃跳转前的数据
+};
+
+// 视频解码线程送往呈现端的帧
+struct VideoFrameItem
+{
+    QVideoFrame frame;
+    qint64 pts = 0; // 毫秒
+    int serial = 0;
+    bool eof = false;
+};
+
+// 音频解码线程送往声卡的PCM数据（交错float立体声）
+struct AudioChunkItem
+{
+    QByteArray data;
+    qint64 pts = 0;   // 首个采样对应的媒体时间，毫秒
+    qreal rate = 1.0; // 生成该数据时的播放速率
+    int serial = 0;
+    bool eof = false;
+};
+
+class FFmpegBackend;
+
+// QAudioSink拉模式的数据源，直接从音频队列中取PCM
+class AudioQueueDevice : public QIODevice
+{
+    Q_OBJECT
+public:
+    explicit AudioQueueDevice(FFmpegBackend *backend);
+
+    bool isSequential() const override { return true; }
+
+protected:
+    qint64 readData(char *data, qint64 maxlen) override;
+    qint64 writeData(const char *data, qint64 len) override;
+
+private:
+    FFmpegBackend *m_backend;
+};
+
+// 自研解码管线：解复用、视频解码、音频解码各占一个线程，线程之间通过有界无锁队列连接
+// 视频帧在GUI线程按主时钟送入QVideoSink，音频经QAudioSink输出并作为主时钟
+class FFmpegBackend : public PlayerBackend
+{
+    Q_OBJECT
+public:
+    explicit FFmpegBackend(QObject *parent = nullptr);
+    ~FFmpegBackend() override;
+
+    void setSource(const QUrl &url) override;
+    QUrl source() const override;
+    void play() override;
+    void pause() override;
+    void stop() override;
+    void setPosition(qint64 position) override;
+    qint64 position() const override;
+    qint64 duration() const override;
+    void setPlaybackRate(qreal rate) override;
+    qreal playbackRate() const override;
+    QMediaPlayer::PlaybackState playbackState() const override;
+    QMediaPlayer::MediaStatus mediaStatus() const override;
+    bool hasVideo() const override;
+    void setVideoSink(QVideoSink *sink) override;
+    void setAudioOutput(QAudioOutput *output) override;
+    void setKeyframeIndex(std::shared_ptr<const KeyframeIndex> index) override;
+    void setDecodeSettings(const DecodeSettings &settings) override;
+    QVariantMap stats() const override;
+
+private:
+    friend class AudioQueueDevice;
+
+    // 以下在解复用线程中运行
+    void demuxLoop(const QUrl &url, int session);
+    bool openInput(const QUrl &url);
+    bool openDecoder(int streamIndex, AVCodecContext **codecCtx);
+    void seekInput(qint64 position);
+    bool pushPacket(SpscQueue<PacketItem> &queue, AVPacket *packet, int serial);
+    bool enoughPackets() const;
+
+    // 以下在解码线程中运行
+    void videoDecodeLoop();
+    void audioDecodeLoop();
+    QVideoFrame toVideoFrame(AVFrame *frame);
+    bool configureAudioFilter(AVFrame *frame, qreal rate);
+    bool filterAudio(AVFrame *frame, int serial, qint64 pts);
+
+    // 以下在GUI线程中运行
+    void onInputOpened(int session, bool ok);
+    void closeInput();
+    void reopen(); // 重新打开当前媒体并恢复进度和播放状态
+    void presentTick();
+    void startAudio();
+    void finishPlayback();
+    void setState(QMediaPlayer::PlaybackState state);
+    void setStatus(QMediaPlayer::MediaStatus status);
+    qint64 masterClock();
+    std::optional<qint64> audioClock() const; // 声卡正在播放的媒体时间，当前序号还没有音频时为空
+
+    qint64 readAudio(char *data, qint64 maxlen); // 声卡线程读取PCM
+    bool serialValid(int serial) const { return serial == m_serial.load(std::memory_order_acquire); }
+
+    QUrl m_source;
+    QMediaPlayer::PlaybackState m_state;
+    QMediaPlayer::MediaStatus m_status;
+    qint64 m_duration;
+    qint64 m_position; // 最近一次通知的播放位置
+    qreal m_rate;
+    bool m_hasVideo;
+    bool m_hasAudio;
+    int m_session; // 每次切换媒体加一，丢弃旧会话的回调
+
+    QPointer<QVideoSink> m_videoSink;
+    QPointer<QAudioOutput> m_audioOutput;
+    QAudioSink *m_audioSink;
+    AudioQueueDevice *m_audioDevice;
+    QAudioFormat m_audioFormat;
+    QTimer *m_presentTimer; // 视频呈现与位置更新
+
+    qint64 m_clockBase; // 主时钟锚点，毫秒
+    QElapsedTimer m_clockTimer;
+    QElapsedTimer m_drainTimer; // 收到音频结束标记后等待声卡缓冲播放完
+    int m_presentedSerial; // 已呈现过画面的跳转序号，暂停时跳转只呈现一帧
+    int m_videoEndedSerial;
+
+    QThread *m_demuxThread;
+    QThread *m_videoThread;
+    QThread *m_audioThread;
+    std::atomic_bool m_abort;
+    std::atomic_int m_serial;           // 跳转序号
+    std::atomic_bool m_seekRequest;     // 解复用线程待处理的跳转
+    std::atomic<qint64> m_seekTarget;   // 跳转目标，解码线程丢弃此前的帧
+    std::atomic<qreal> m_targetRate;    // 音频线程据此重建atempo
+    std::atomic<qint64> m_audioClock;   // 声卡已取走数据对应的媒体时间
+    std::atomic_int m_audioClockSerial;
+    std::atomic_int m_audioEndedSerial;
+    std::atomic<qint64> m_queuedBytes;  // 包队列中的总字节数
+
+    QMutex m_indexMutex; // 保护关键帧索引和解码参数
+    std::shared_ptr<const KeyframeIndex> m_keyframeIndex;
+    DecodeSettings m_decodeSettings;
+    std::atomic_int m_skipLoopFilter; // 跳过级别可在播放中修改，由视频线程应用
+    std::atomic_int m_skipFrame;
+
+    AVFormatContext *m_formatCtx;
+    AVCodecContext *m_videoCodecCtx;
+    AVCodecContext *m_audioCodecCtx;
+    int m_videoStream;
+    int m_audioStream;
+    SwsContext *m_swsCtx;        // 仅视频线程使用，转换Qt不支持的像素格式
+    std::shared_ptr<VideoFramePool> m_framePool; // 视频帧零拷贝包装和复用
+    AVFilterGraph *m_filterGraph; // 仅音频线程使用
+    AVFilterContext *m_bufferSrc;
+    AVFilterContext *m_bufferSink;
+    qreal m_filterRate;
+    qint64 m_filterStart; // 滤镜图重建后首个输入的媒体时间
+
+    SpscQueue<PacketItem> m_videoPackets;
+    SpscQueue<PacketItem> m_audioPackets;
+    SpscQueue<VideoFrameItem> m_videoFrames;
+    SpscQueue<AudioChunkItem> m_audioChunks;
+    AudioChunkItem m_currentChunk; // 声卡正在读取的数据块
+    qint64 m_chunkOffset;
+
+    // 统计
+    std::atomic<qint64> m_videoDecodeUs; // 平均每帧解码耗时
+    std::atomic<qint64> m_audioDecodeUs;
+    std::atomic<qint64> m_decodedFrames;
+    qint64 m_presentedFrames;
+    qint64 m_droppedFrames;
+    qint64 m_presentLateness; // 呈现时刻相对帧时间戳的平均滞后，毫秒
+    qint64 m_avDrift;         // 呈现帧的时间戳减去当时的音频时钟，平均值，毫秒；正值为视频超前
+    bool m_hasAvDrift;        // 有音频时钟时才计算
+    std::atomic<qint64> m_bytesRead; // 解复用读取的总字节数，用于计算实际码率
+    LatencyHistogram m_decodeHistogram;  // 每帧视频解码耗时
+    LatencyHistogram m_presentHistogram; // 每帧呈现滞后
+};
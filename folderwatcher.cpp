@@ -0,0 +1,282 @@
+#include "folderwatcher.h"
+#include "mediasniffer.h"
+
+#include <QDebug>
+#include <QDir>
+#include <QFileInfo>
+#include <QPointer>
+#include <algorithm>
+
+namespace {
+constexpr int kScanBatch = 500;      // 扫描时每批送出的文件数
+constexpr int kChangeDelay = 300;    // 目录变化通知的合并时间(毫秒)
+
+bool isChildOf(const QString &path, const QString &dir)
+{
+    return path.size() > dir.size() && path.startsWith(dir) && path.at(dir.size()) == '/';
+}
+} // namespace
+
+FolderWatcher::FolderWatcher(QObject *parent)
+    : QObject(parent)
+    , m_watching{true}
+    , m_cancelled{std::make_shared<std::atomic_bool>(false)}
+    , m_generation{0}
+    , m_runningScans{0}
+{
+    m_pool.setMaxThreadCount(1); // 扫描受磁盘限制，多线程没有收益，也保证先添加的文件夹先出结果
+    m_watcher = new QFileSystemWatcher(this);
+    connect(m_watcher, &QFileSystemWatcher::directoryChanged, this, &FolderWatcher::onDirectoryChanged);
+
+    m_changeTimer = new QTimer(this);
+    m_changeTimer->setSingleShot(true);
+    m_changeTimer->setInterval(kChangeDelay);
+    connect(m_changeTimer, &QTimer::timeout, this, &FolderWatcher::applyChanges);
+}
+
+FolderWatcher::~FolderWatcher()
+{
+    m_cancelled->store(true);
+    m_pool.clear();
+    m_pool.waitForDone();
+}
+
+void FolderWatcher::addFolder(const QString &path)
+{
+    const QString root = QDir::cleanPath(QFileInfo(path).absoluteFilePath());
+    if (!QFileInfo(root).isDir()) return;
+    // 已经在某个添加过的文件夹里时不重复扫描
+    for (const QString &folder : std::as_const(m_folders)) {
+        if (root == folder || isChildOf(root, folder)) return;
+    }
+    m_folders.append(root);
+    scan(root);
+}
+
+void FolderWatcher::clear()
+{
+    m_cancelled->store(true);
+    m_cancelled = std::make_shared<std::atomic_bool>(false);
+    ++m_generation;
+    m_pool.clear();
+
+    m_changeTimer->stop();
+    m_dirtyDirs.clear();
+    m_snapshot.clear();
+    m_folders.clear();
+    const QStringList watched = m_watcher->directories();
+    if (!watched.isEmpty()) m_watcher->removePaths(watched);
+
+    if (m_runningScans == 0) return;
+    m_runningScans = 0;
+    emit scanningChanged();
+}
+
+QStringList FolderWatcher::folders() const
+{
+    return m_folders;
+}
+
+bool FolderWatcher::watching() const
+{
+    return m_watching;
+}
+
+void FolderWatcher::setWatching(bool watching)
+{
+    if (m_watching == watching) return;
+    m_watching = watching;
+    if (watching) {
+        if (!m_snapshot.isEmpty()) m_watcher->addPaths(m_snapshot.keys());
+    } else {
+        const QStringList watched = m_watcher->directories();
+        if (!watched.isEmpty()) m_watcher->removePaths(watched);
+        m_changeTimer->stop();
+        m_dirtyDirs.clear();
+    }
+}
+
+bool FolderWatcher::scanning() const
+{
+    return m_runningScans > 0;
+}
+
+void FolderWatcher::scan(const QString &path)
+{
+    const quint64 generation = m_generation;
+    const std::shared_ptr<std::atomic_bool> cancelled = m_cancelled;
+    QPointer<FolderWatcher> self(this);
+    if (m_runningScans++ == 0) emit scanningChanged();
+
+    m_pool.start([=]() {
+        ScanBatch batch;
+        auto post = [&]() {
+            if (batch.dirs.isEmpty() && batch.files.isEmpty()) return;
+            QMetaObject::invokeMethod(
+                self, [self, generation, batch]() {
+                    if (self) self->onScanBatch(generation, batch);
+                }, Qt::QueuedConnection);
+            batch = ScanBatch();
+        };
+
+        // 深度优先，每个目录内按名称排序，播放列表的顺序与文件管理器一致
+        QStringList stack{path};
+        while (!stack.isEmpty() && !cancelled->load()) {
+            const QString dir = stack.takeLast();
+            batch.dirs.append(dir);
+            const QFileInfoList entries = QDir(dir).entryInfoList(QDir::Files | QDir::Dirs | QDir::NoDotAndDotDot | QDir::Readable,
+                                                                  QDir::Name | QDir::DirsLast);
+            QStringList subdirs;
+            for (const QFileInfo &info : entries) {
+                if (info.isDir()) {
+                    if (!info.isSymLink()) subdirs.append(info.absoluteFilePath()); //不跟随符号链接，避免循环
+                } else if (MediaSniffer::instance().isMedia(info.absoluteFilePath(), true)) {
+                    batch.files.append(info.absoluteFilePath());
+                }
+            }
+            std::reverse(subdirs.begin(), subdirs.end());
+            stack.append(subdirs);
+            if (batch.files.size() >= kScanBatch || batch.dirs.size() >= kScanBatch) post();
+        }
+        post();
+        QMetaObject::invokeMethod(
+            self, [self, generation]() {
+                if (self) self->onScanFinished(generation);
+            }, Qt::QueuedConnection);
+    });
+}
+
+void FolderWatcher::onScanBatch(quint64 generation, const ScanBatch &batch)
+{
+    if (generation != m_generation) return;
+
+    QStringList newDirs;
+    for (const QString &dir : batch.dirs) {
+        if (m_snapshot.contains(dir)) continue;
+        m_snapshot.insert(dir, QSet<QString>());
+        newDirs.append(dir);
+    }
+    if (m_watching && !newDirs.isEmpty()) {
+        const QStringList failed = m_watcher->addPaths(newDirs);
+        if (!failed.isEmpty()) qWarning() << "FolderWatcher: cannot watch" << failed.size() << "directories (inotify limit?)";
+    }
+
+    QList<QUrl> added;
+    for (const QString &file : batch.files) {
+        const int slash = file.lastIndexOf('/');
+        QSet<QString> &names = m_snapshot[file.left(slash)];
+        const QString name = file.mid(slash + 1);
+        if (names.contains(name)) continue;
+        names.insert(name);
+        added.append(QUrl::fromLocalFile(file));
+    }
+    if (!added.isEmpty()) emit filesAdded(added);
+}
+
+void FolderWatcher::onScanFinished(quint64 generation)
+{
+    if (generation != m_generation || m_runningScans == 0) return;
+    if (--m_runningScans == 0) emit scanningChanged();
+}
+
+void FolderWatcher::onDirectoryChanged(const QString &path)
+{
+    m_dirtyDirs.insert(QDir::cleanPath(path));
+    if (!m_changeTimer->isActive()) m_changeTimer->start();
+}
+
+void FolderWatcher::applyChanges()
+{
+    if (m_dirtyDirs.isEmpty()) return;
+    const QStringList dirs(m_dirtyDirs.cbegin(), m_dirtyDirs.cend());
+    m_dirtyDirs.clear();
+
+    const quint64 generation = m_generation;
+    const std::shared_ptr<std::atomic_bool> cancelled = m_cancelled;
+    QPointer<FolderWatcher> self(this);
+    m_pool.start([=]() {
+        QList<DirListing> listings;
+        for (const QString &dir : dirs) {
+            if (cancelled->load()) return;
+            listings.append(listDir(dir));
+        }
+        QMetaObject::invokeMethod(
+            self, [self, generation, listings]() {
+                if (self) self->onDirsListed(generation, listings);
+            }, Qt::QueuedConnection);
+    });
+}
+
+FolderWatcher::DirListing FolderWatcher::listDir(const QString &dir)
+{
+    DirListing listing;
+    listing.dir = dir;
+    QDir qdir(dir);
+    listing.exists = qdir.exists();
+    if (!listing.exists) return listing;
+
+    const QFileInfoList entries = qdir.entryInfoList(QDir::Files | QDir::Dirs | QDir::NoDotAndDotDot | QDir::Readable, QDir::Name);
+    for (const QFileInfo &info : entries) {
+        if (info.isDir()) {
+            if (!info.isSymLink()) listing.subdirs.append(info.absoluteFilePath());
+        } else if (MediaSniffer::instance().isMedia(info.absoluteFilePath(), true)) {
+            listing.files.append(info.fileName());
+        }
+    }
+    return listing;
+}
+
+void FolderWatcher::onDirsListed(quint64 generation, const QList<DirListing> &listings)
+{
+    if (generation != m_generation) return;
+
+    QList<QUrl> added;
+    QList<QUrl> removed;
+    for (const DirListing &listing : listings) {
+        const QString &dir = listing.dir;
+        if (!m_snapshot.contains(dir)) continue; // 已经随上级目录移除
+        if (!listing.exists) {
+            removeDir(dir, removed);
+            continue;
+        }
+
+        // 与快照比较
+        QSet<QString> &known = m_snapshot[dir];
+        const QSet<QString> current(listing.files.cbegin(), listing.files.cend());
+        for (const QString &name : listing.files) {
+            if (!known.contains(name)) added.append(QUrl::fromLocalFile(dir + '/' + name));
+        }
+        for (const QString &name : std::as_const(known)) {
+            if (!current.contains(name)) removed.append(QUrl::fromLocalFile(dir + '/' + name));
+        }
+        known = current;
+
+        // 新建或移入的子目录递归扫描，删除或移走的子目录连同其中的文件一起移除
+        const QSet<QString> subdirs(listing.subdirs.cbegin(), listing.subdirs.cend());
+        for (const QString &subdir : listing.subdirs) {
+            if (!m_snapshot.contains(subdir)) scan(subdir);
+        }
+        QStringList goneDirs;
+        for (auto it = m_snapshot.cbegin(); it != m_snapshot.cend(); ++it) {
+            const QString &key = it.key();
+            if (isChildOf(key, dir) && key.indexOf('/', dir.size() + 1) < 0 && !subdirs.contains(key)) goneDirs.append(key);
+        }
+        for (const QString &gone : std::as_const(goneDirs)) removeDir(gone, removed);
+    }
+
+    if (!removed.isEmpty()) emit filesRemoved(removed);
+    if (!added.isEmpty()) emit filesAdded(added);
+}
+
+void FolderWatcher::removeDir(const QString &dir, QList<QUrl> &removed)
+{
+    QStringList keys;
+    for (auto it = m_snapshot.cbegin(); it != m_snapshot.cend(); ++it) {
+        if (it.key() == dir || isChildOf(it.key(), dir)) keys.append(it.key());
+    }
+    for (const QString &key : std::as_const(keys)) {
+        for (const QString &name : m_snapshot.value(key)) removed.append(QUrl::fromLocalFile(key + '/' + name));
+        m_snapshot.remove(key);
+    }
+    if (m_watching && !keys.isEmpty()) m_watcher->removePaths(keys);
+}
@@ -0,0 +1,73 @@
+#pragma once
+
+#include <QObject>
+#include <QFileSystemWatcher>
+#include <QHash>
+#include <QList>
+#include <QSet>
+#include <QStringList>
+#include <QThreadPool>
+#include <QTimer>
+#include <QUrl>
+#include <atomic>
+#include <memory>
+
+// 文件夹导入和监视：
+// 递归扫描在工作线程中进行，发现的文件分批通过filesAdded送出；
+// 扫描过的目录由QFileSystemWatcher(Linux上为inotify)监视，
+// 目录变化时只在工作线程列出这一个目录，和上次的快照比较后送出增加和删除的文件，不重新扫描整个文件夹
+// 常见扩展名直接判断，其它文件通过MediaSniffer读取文件头识别
+class FolderWatcher : public QObject
+{
+    Q_OBJECT
+public:
+    explicit FolderWatcher(QObject *parent = nullptr);
+    ~FolderWatcher() override;
+
+    void addFolder(const QString &path); // 递归扫描并开始监视
+    void clear();                        // 停止所有扫描和监视
+    QStringList folders() const;         // 通过addFolder添加的根目录
+    bool watching() const;
+    void setWatching(bool watching);     // 关闭后只扫描不监视
+    bool scanning() const;
+
+signals:
+    void filesAdded(const QList<QUrl> &urls);
+    void filesRemoved(const QList<QUrl> &urls);
+    void scanningChanged();
+
+private:
+    struct ScanBatch
+    {
+        QStringList dirs;  // 扫描到的目录(包括空目录)
+        QStringList files; // 扫描到的音视频文件的绝对路径
+    };
+    struct DirListing
+    {
+        QString dir;
+        bool exists = false;
+        QStringList files;   // 音视频文件名，按名称排序
+        QStringList subdirs; // 子目录的绝对路径
+    };
+
+    void scan(const QString &path);
+    void onScanBatch(quint64 generation, const ScanBatch &batch);
+    void onScanFinished(quint64 generation);
+    void onDirectoryChanged(const QString &path);
+    void applyChanges(); // 在工作线程列出合并后变化的目录
+    void onDirsListed(quint64 generation, const QList<DirListing> &listings);
+    static DirListing listDir(const QString &dir);
+    void removeDir(const QString &dir, QList<QUrl> &removed);
+
+    QFileSystemWatcher *m_watcher;
+    QHash<QString, QSet<QString>> m_snapshot; // 目录 -> 其中的音视频文件名
+    QStringList m_folders;
+    QSet<QString> m_dirtyDirs;
+    QTimer *m_changeTimer; // 一次复制或删除会产生很多通知，合并后再处理
+    bool m_watching;
+
+    QThreadPool m_pool;
+    std::shared_ptr<std::atomic_bool> m_cancelled;
+    quint64 m_generation;
+    int m_runningScans;
+};
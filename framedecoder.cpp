@@ -0,0 +1,294 @@
+#include "framedecoder.h"
+
+#include <QDebug>
+
+extern "C" {
+#include <libavformat/avformat.h>
+#include <libavcodec/avcodec.h>
+#include <libswscale/swscale.h>
+}
+
+namespace {
+constexpr int kMaxPacketsPerRequest = 600; // 单次解码最多读取的包数，防止损坏文件导致长时间阻塞
+constexpr int kMaxPacketsPerGop = 20000;   // 解码整个GOP时的上限
+}
+
+FrameDecoder::FrameDecoder()
+    : m_formatCtx{nullptr}
+    , m_codecCtx{nullptr}
+    , m_frame{nullptr}
+    , m_packet{nullptr}
+    , m_swsCtx{nullptr}
+    , m_streamIndex{-1}
+    , m_keyframesOnly{true}
+{}
+
+FrameDecoder::~FrameDecoder()
+{
+    close();
+}
+
+bool FrameDecoder::open(const QString &filePath)
+{
+    if (filePath == m_filePath && isOpen()) return true; // 同一媒体无需重新打开
+
+    close();
+    if (filePath.isEmpty()) return false;
+
+    if (avformat_open_input(&m_formatCtx, filePath.toUtf8().constData(), nullptr, nullptr) < 0) {
+        qWarning() << "FrameDecoder: failed to open" << filePath;
+        close();
+        return false;
+    }
+    if (avformat_find_stream_info(m_formatCtx, nullptr) < 0) {
+        qWarning() << "FrameDecoder: failed to find stream information";
+        close();
+        return false;
+    }
+
+    // 查找视频流（跳过音频文件中的封面图片流）
+    const AVCodec *codec = nullptr;
+    m_streamIndex = av_find_best_stream(m_formatCtx, AVMEDIA_TYPE_VIDEO, -1, -1, &codec, 0);
+    if (m_streamIndex < 0 || !codec
+        || (m_formatCtx->streams[m_streamIndex]->disposition & AV_DISPOSITION_ATTACHED_PIC)) {
+        close();
+        return false;
+    }
+
+    m_codecCtx = avcodec_alloc_context3(codec);
+    if (!m_codecCtx
+        || avcodec_parameters_to_context(m_codecCtx, m_formatCtx->streams[m_streamIndex]->codecpar) < 0) {
+        close();
+        return false;
+    }
+    m_settings.apply(m_codecCtx);
+    if (m_keyframesOnly) {
+        m_codecCtx->thread_type = FF_THREAD_SLICE; // 帧线程会增加首帧延迟，这里只用片线程
+        m_codecCtx->skip_frame = AVDISCARD_NONKEY; // 只解码关键帧
+    }
+    if (avcodec_open2(m_codecCtx, codec, nullptr) < 0) {
+        qWarning() << "FrameDecoder: failed to open decoder";
+        close();
+        return false;
+    }
+
+    m_frame = av_frame_alloc();
+    m_packet = av_packet_alloc();
+    m_filePath = filePath;
+    return true;
+}
+
+void FrameDecoder::close()
+{
+    if (m_swsCtx) {
+        sws_freeContext(m_swsCtx);
+        m_swsCtx = nullptr;
+    }
+    if (m_packet) av_packet_free(&m_packet);
+    if (m_frame) av_frame_free(&m_frame);
+    if (m_codecCtx) avcodec_free_context(&m_codecCtx);
+    if (m_formatCtx) avformat_close_input(&m_formatCtx);
+    m_streamIndex = -1;
+    m_filePath.clear();
+    m_keyframeIndex.reset();
+}
+
+bool FrameDecoder::isOpen() const
+{
+    return m_codecCtx != nullptr;
+}
+
+QString FrameDecoder::filePath() const
+{
+    return m_filePath;
+}
+
+qint64 FrameDecoder::duration() const
+{
+    if (!m_formatCtx || m_formatCtx->duration == AV_NOPTS_VALUE) return 0;
+    return m_formatCtx->duration / (AV_TIME_BASE / 1000);
+}
+
+void FrameDecoder::setKeyframeIndex(std::shared_ptr<const KeyframeIndex> index)
+{
+    m_keyframeIndex = std::move(index);
+}
+
+void FrameDecoder::setDecodeSettings(const DecodeSettings &settings)
+{
+    if (settings == m_settings) return;
+    m_settings = settings;
+    if (!isOpen()) return;
+
+    // 解码参数只在打开解码器时生效，重新打开当前媒体
+    QString filePath = m_filePath;
+    std::shared_ptr<const KeyframeIndex> index = m_keyframeIndex;
+    close();
+    if (open(filePath)) setKeyframeIndex(index);
+}
+
+void FrameDecoder::setKeyframesOnly(bool keyframesOnly)
+{
+    m_keyframesOnly = keyframesOnly;
+}
+
+QImage FrameDecoder::decodeAt(qint64 position, QSize size, QImage::Format format)
+{
+    if (!isOpen() || !decodeKeyframe(position)) return QImage();
+    QImage image = convertFrame(size, format);
+    av_frame_unref(m_frame);
+    return image;
+}
+
+qint64 FrameDecoder::decodeGop(qint64 position, const FrameCallback &onFrame, qint64 *nextKeyframe)
+{
+    if (nextKeyframe) *nextKeyframe = -1;
+    if (!isOpen() || !seekKeyframe(position)) return -1;
+    avcodec_flush_buffers(m_codecCtx);
+
+    qint64 gopStart = -1;
+    bool eof = false;
+    for (int read = 0; read < kMaxPacketsPerGop; ++read) {
+        if (!eof) {
+            if (av_read_frame(m_formatCtx, m_packet) < 0) {
+                eof = true;
+                avcodec_send_packet(m_codecCtx, nullptr); // 冲刷解码器
+            } else {
+                if (m_packet->stream_index == m_streamIndex) avcodec_send_packet(m_codecCtx, m_packet);
+                av_packet_unref(m_packet);
+            }
+        }
+
+        // 一个包可能输出多帧，全部取出
+        int ret;
+        while ((ret = avcodec_receive_frame(m_codecCtx, m_frame)) == 0) {
+            qint64 time = framePosition();
+            bool key = m_frame->flags & AV_FRAME_FLAG_KEY;
+            if (gopStart < 0) {
+                // 跳过关键帧之前无法正确解码的帧
+                if (key) gopStart = time;
+                if (!key || time < 0) {
+                    av_frame_unref(m_frame);
+                    continue;
+                }
+            } else if (key) {
+                if (nextKeyframe) *nextKeyframe = time; // 到达下一个GOP
+                av_frame_unref(m_frame);
+                return gopStart;
+            } else if (time < gopStart) {
+                av_frame_unref(m_frame); // 开放GOP中属于上一个GOP的前导B帧
+                continue;
+            }
+
+            bool more = onFrame(m_frame, time);
+            av_frame_unref(m_frame);
+            if (!more) {
+                if (nextKeyframe) *nextKeyframe = time + 1;
+                return gopStart;
+            }
+        }
+        if (ret != AVERROR(EAGAIN)) break; // 解码结束或出错
+    }
+    return gopStart;
+}
+
+bool FrameDecoder::seekKeyframe(qint64 position)
+{
+    AVStream *stream = m_formatCtx->streams[m_streamIndex];
+
+    // 有关键帧索引时通过二分查找得到目标GOP
+    if (m_keyframeIndex && m_keyframeIndex->streamIndex() == m_streamIndex) {
+        int i = m_keyframeIndex->indexBefore(position);
+        if (i >= 0) {
+            const KeyframeEntry &entry = m_keyframeIndex->at(i);
+            // 容器自带索引不足(无cues的MKV、TS等)时按字节偏移跳转，避免解复用器逐段搜索
+            bool poorIndex = avformat_index_get_entries_count(stream) < 2;
+            if (poorIndex && entry.pos >= 0 && !(m_formatCtx->iformat->flags & AVFMT_NO_BYTE_SEEK)
+                && av_seek_frame(m_formatCtx, -1, entry.pos, AVSEEK_FLAG_BYTE) >= 0) {
+                return true;
+            }
+            if (av_seek_frame(m_formatCtx, m_streamIndex, entry.pts, AVSEEK_FLAG_BACKWARD) >= 0) return true;
+        }
+    }
+
+    qint64 target = av_rescale_q(position, AVRational{1, 1000}, stream->time_base);
+    if (stream->start_time != AV_NOPTS_VALUE) target += stream->start_time;
+
+    // 跳转到目标位置之前最近的关键帧
+    return av_seek_frame(m_formatCtx, m_streamIndex, target, AVSEEK_FLAG_BACKWARD) >= 0;
+}
+
+bool FrameDecoder::decodeKeyframe(qint64 position)
+{
+    if (!seekKeyframe(position)) return false;
+    avcodec_flush_buffers(m_codecCtx);
+
+    bool eof = false;
+    for (int read = 0; read < kMaxPacketsPerRequest; ++read) {
+        if (!eof) {
+            if (av_read_frame(m_formatCtx, m_packet) < 0) {
+                eof = true;
+                avcodec_send_packet(m_codecCtx, nullptr); // 冲刷解码器
+            } else {
+                if (m_packet->stream_index == m_streamIndex) avcodec_send_packet(m_codecCtx, m_packet);
+                av_packet_unref(m_packet);
+            }
+        }
+
+        int ret = avcodec_receive_frame(m_codecCtx, m_frame);
+        if (ret == 0) return true;
+        if (ret != AVERROR(EAGAIN)) return false; // 解码结束或出错
+    }
+    return false;
+}
+
+qint64 FrameDecoder::framePosition() const
+{
+    AVStream *stream = m_formatCtx->streams[m_streamIndex];
+    int64_t pts = m_frame->best_effort_timestamp;
+    if (pts == AV_NOPTS_VALUE) pts = m_frame->pts;
+    if (pts == AV_NOPTS_VALUE) return -1;
+    if (stream->start_time != AV_NOPTS_VALUE) pts -= stream->start_time;
+    return av_rescale_q(pts, stream->time_base, AVRational{1, 1000});
+}
+
+QImage FrameDecoder::convertFrame(QSize size, QImage::Format format)
+{
+    if (m_frame->width <= 0 || m_frame->height <= 0) return QImage();
+
+    AVPixelFormat dstFormat;
+    switch (format) {
+    case QImage::Format_RGB16:
+        dstFormat = AV_PIX_FMT_RGB565;
+        break;
+    case QImage::Format_RGB32:
+    case QImage::Format_ARGB32:
+        dstFormat = AV_PIX_FMT_RGB32;
+        break;
+    default:
+        return QImage();
+    }
+
+    // 按比例缩放到给定尺寸以内
+    QSize target = QSize(m_frame->width, m_frame->height).scaled(size, Qt::KeepAspectRatio);
+    if (target.isEmpty()) return QImage();
+
+    m_swsCtx = sws_getCachedContext(m_swsCtx,
+                                    m_frame->width,
+                                    m_frame->height,
+                                    static_cast<AVPixelFormat>(m_frame->format),
+                                    target.width(),
+                                    target.height(),
+                                    dstFormat,
+                                    SWS_BILINEAR,
+                                    nullptr,
+                                    nullptr,
+                                    nullptr);
+    if (!m_swsCtx) return QImage();
+
+    QImage image(target, format);
+    uint8_t *dstData[4] = {image.bits(), nullptr, nullptr, nullptr};
+    int dstLinesize[4] = {static_cast<int>(image.bytesPerLine()), 0, 0, 0};
+    sws_scale(m_swsCtx, m_frame->data, m_frame->linesize, 0, m_frame->height, dstData, dstLinesize);
+    return image;
+}
@@ -0,0 +1,61 @@
+#pragma once
+
+#include <QImage>
+#include <QSize>
+#include <QString>
+#include <functional>
+#include <memory>
+
+#include "keyframeindex.h"
+#include "decodeprofile.h"
+
+struct AVFormatContext;
+struct AVCodecContext;
+struct AVFrame;
+struct AVPacket;
+struct SwsContext;
+
+// 基于libavformat/libavcodec的单帧解码器，打开后保持解复用器和解码器常开
+// 非线程安全，每个线程使用自己的实例
+class FrameDecoder
+{
+public:
+    FrameDecoder();
+    ~FrameDecoder();
+    FrameDecoder(const FrameDecoder &) = delete;
+    FrameDecoder &operator=(const FrameDecoder &) = delete;
+
+    bool open(const QString &filePath); // 打开媒体的视频流，没有视频流时返回false
+    void close();
+    bool isOpen() const;
+    QString filePath() const;
+    qint64 duration() const; // 媒体时长，单位为毫秒
+    void setKeyframeIndex(std::shared_ptr<const KeyframeIndex> index); // 设置后直接定位到目标GOP的关键帧
+    void setDecodeSettings(const DecodeSettings &settings); // 线程数、lowres等，已打开时重新打开解码器
+    void setKeyframesOnly(bool keyframesOnly);              // 默认只解码关键帧，逐帧浏览时关闭，需在open之前设置
+
+    // 解码position之前最近的关键帧，并按比例缩放到size以内
+    QImage decodeAt(qint64 position, QSize size, QImage::Format format = QImage::Format_RGB32);
+
+    // 按显示顺序解码position所在GOP的所有帧，每帧连同时间(毫秒)交给onFrame，onFrame返回false时提前结束
+    // 返回GOP关键帧的时间，nextKeyframe为下一个GOP的起点(到达文件结尾时为-1)，失败时返回-1
+    using FrameCallback = std::function<bool(const AVFrame *frame, qint64 position)>;
+    qint64 decodeGop(qint64 position, const FrameCallback &onFrame, qint64 *nextKeyframe = nullptr);
+
+private:
+    bool seekKeyframe(qint64 position);   // 跳转到position所在GOP的关键帧
+    bool decodeKeyframe(qint64 position); // 解码结果存放在m_frame中
+    QImage convertFrame(QSize size, QImage::Format format);
+    qint64 framePosition() const; // m_frame相对媒体开头的毫秒数
+
+    QString m_filePath;
+    AVFormatContext *m_formatCtx;
+    AVCodecContext *m_codecCtx;
+    AVFrame *m_frame;
+    AVPacket *m_packet;
+    SwsContext *m_swsCtx;
+    int m_streamIndex;
+    std::shared_ptr<const KeyframeIndex> m_keyframeIndex;
+    DecodeSettings m_settings;
+    bool m_keyframesOnly;
+};
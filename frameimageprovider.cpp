@@ -0,0 +1,85 @@
+#include "frameimageprovider.h"
+
+#include <QCryptographicHash>
+#include <QMutexLocker>
+
+namespace {
+constexpr qsizetype kDefaultMaxCost = 64 * 1024; // 默认缓存上限64MB
+}
+
+FrameCache::FrameCache() : m_cache{kDefaultMaxCost} {}
+
+FrameCache &FrameCache::instance()
+{
+    static FrameCache cache;
+    return cache;
+}
+
+QString FrameCache::mediaId(const QUrl &url)
+{
+    QByteArray hash = QCryptographicHash::hash(url.toEncoded(), QCryptographicHash::Md5);
+    return QString::fromLatin1(hash.toHex().left(16));
+}
+
+QString FrameCache::frameId(const QUrl &url, qint64 position)
+{
+    return mediaId(url) + "/" + QString::number(position);
+}
+
+QString FrameCache::coverId(const QUrl &url)
+{
+    return mediaId(url) + "/cover";
+}
+
+QString FrameCache::source(const QString &id)
+{
+    return "image://frames/" + id;
+}
+
+void FrameCache::insert(const QString &id, const QImage &image)
+{
+    if (image.isNull()) return;
+    QMutexLocker locker(&m_mutex);
+    m_cache.insert(id, new QImage(image), qMax<qsizetype>(1, image.sizeInBytes() / 1024));
+}
+
+QImage FrameCache::image(const QString &id) const
+{
+    QMutexLocker locker(&m_mutex);
+    const QImage *image = m_cache.object(id);
+    return image ? *image : QImage();
+}
+
+bool FrameCache::contains(const QString &id) const
+{
+    QMutexLocker locker(&m_mutex);
+    return m_cache.contains(id);
+}
+
+void FrameCache::removeMedia(const QUrl &url)
+{
+    const QString prefix = mediaId(url) + "/";
+    QMutexLocker locker(&m_mutex);
+    const QList<QString> keys = m_cache.keys();
+    for (const QString &key : keys) {
+        if (key.startsWith(prefix)) m_cache.remove(key);
+    }
+}
+
+void FrameCache::setMaxCost(qsizetype kilobytes)
+{
+    QMutexLocker locker(&m_mutex);
+    m_cache.setMaxCost(kilobytes);
+}
+
+FrameImageProvider::FrameImageProvider() : QQuickImageProvider(QQuickImageProvider::Image) {}
+
+QImage FrameImageProvider::requestImage(const QString &id, QSize *size, const QSize &requestedSize)
+{
+    QImage image = FrameCache::instance().image(id);
+    if (size) *size = image.size();
+    if (!image.isNull() && requestedSize.width() > 0 && requestedSize.height() > 0 && requestedSize != image.size()) {
+        return image.scaled(requestedSize, Qt::KeepAspectRatio, Qt::SmoothTransformation);
+    }
+    return image;
+}
@@ -0,0 +1,41 @@
+#pragma once
+
+#include <QCache>
+#include <QImage>
+#include <QMutex>
+#include <QQuickImageProvider>
+#include <QString>
+#include <QUrl>
+
+// 视频帧/封面的内存缓存，C++端放入QImage，QML端通过image://frames/<id>读取
+class FrameCache
+{
+public:
+    static FrameCache &instance();
+
+    static QString mediaId(const QUrl &url);                 // 媒体在缓存中的标识
+    static QString frameId(const QUrl &url, qint64 position); // <media>/<ms>
+    static QString coverId(const QUrl &url);                  // <media>/cover
+    static QString source(const QString &id);                 // 转为QML可用的image://frames/<id>
+
+    void insert(const QString &id, const QImage &image);
+    QImage image(const QString &id) const;
+    bool contains(const QString &id) const;
+    void removeMedia(const QUrl &url); // 移除某个媒体的全部缓存
+    void setMaxCost(qsizetype kilobytes);
+
+private:
+    FrameCache();
+
+    mutable QMutex m_mutex;
+    QCache<QString, QImage> m_cache; // 代价以KB计
+};
+
+// 注册到QQmlEngine的图片提供器，直接从FrameCache取出QImage，省去编码和base64往返
+class FrameImageProvider : public QQuickImageProvider
+{
+public:
+    FrameImageProvider();
+
+    QImage requestImage(const QString &id, QSize *size, const QSize &requestedSize) override;
+};
@@ -0,0 +1,421 @@
+#include "framestepper.h"
+#include "framedecoder.h"
+#include "videoframepool.h"
+
+extern "C" {
+#include <libavutil/frame.h>
+#include <libswscale/swscale.h>
+}
+
+namespace {
+constexpr qint64 kDefaultBudget = 512ll * 1024 * 1024; // 默认缓存上限
+constexpr int kReverseTickInterval = 5;                 // 倒放时检查下一帧的间隔(毫秒)
+} // namespace
+
+struct FrameStepper::Context
+{
+    Context() { decoder.setKeyframesOnly(false); }
+    ~Context() { sws_freeContext(swsCtx); }
+
+    FrameDecoder decoder;
+    std::shared_ptr<VideoFramePool> pool = VideoFramePool::create();
+    SwsContext *swsCtx = nullptr;
+};
+
+FrameStepper::FrameStepper(QObject *parent)
+    : QObject{parent}
+    , m_context{std::make_shared<Context>()}
+    , m_generation{0}
+    , m_bytes{0}
+    , m_budget{kDefaultBudget}
+    , m_active{false}
+    , m_position{0}
+    , m_pendingStep{0}
+    , m_waitingFor{-1}
+    , m_reverse{false}
+    , m_reverseRate{1.0}
+    , m_reverseStart{0}
+{
+    m_pool.setMaxThreadCount(1);
+    m_reverseTimer = new QTimer(this);
+    m_reverseTimer->setTimerType(Qt::PreciseTimer);
+    m_reverseTimer->setInterval(kReverseTickInterval);
+    connect(m_reverseTimer, &QTimer::timeout, this, &FrameStepper::reverseTick);
+}
+
+FrameStepper::~FrameStepper()
+{
+    ++m_generation;
+    m_pool.clear();
+    m_pool.waitForDone();
+}
+
+void FrameStepper::setMedia(const QString &filePath)
+{
+    end();
+    ++m_generation;
+    m_pool.clear();
+    m_segments.clear();
+    m_pending.clear();
+    m_bytes = 0;
+    m_index.reset();
+    m_filePath = filePath;
+
+    // 关闭上一个媒体的文件句柄
+    std::shared_ptr<Context> context = m_context;
+    if (filePath.isEmpty()) m_pool.start([context]() { context->decoder.close(); });
+}
+
+void FrameStepper::setKeyframeIndex(std::shared_ptr<const KeyframeIndex> index)
+{
+    m_index = std::move(index);
+}
+
+void FrameStepper::setDecodeSettings(const DecodeSettings &settings)
+{
+    m_settings = settings;
+    m_settings.skipFrame = 0; // AVDISCARD_DEFAULT，逐帧浏览不能跳过任何帧
+    m_settings.lowres = 0;
+}
+
+void FrameStepper::setVideoSink(QVideoSink *sink)
+{
+    m_videoSink = sink;
+}
+
+void FrameStepper::setMemoryBudget(qint64 bytes)
+{
+    m_budget = qMax<qint64>(bytes, 16 * 1024 * 1024);
+    evict();
+}
+
+void FrameStepper::begin(qint64 position)
+{
+    m_active = true;
+    m_position = position;
+    m_pendingStep = 0;
+    // 先把当前GOP解码到当前位置，之后向前向后都能直接命中
+    if (!segmentAt(position)) request(position, -1);
+}
+
+void FrameStepper::end()
+{
+    setReverse(false);
+    m_active = false;
+    m_pendingStep = 0;
+}
+
+bool FrameStepper::isActive() const
+{
+    return m_active;
+}
+
+qint64 FrameStepper::position() const
+{
+    return m_position;
+}
+
+void FrameStepper::stepForward()
+{
+    setReverse(false);
+    step(1);
+}
+
+void FrameStepper::stepBackward()
+{
+    setReverse(false);
+    step(-1);
+}
+
+void FrameStepper::setReverse(bool reverse, qreal rate)
+{
+    if (reverse && !m_active) return;
+    m_reverseRate = qMax<qreal>(rate, 0.1);
+    if (reverse) {
+        // 倍速变化时也重新计时
+        m_reverseStart = m_position;
+        m_reverseClock.restart();
+    }
+    if (m_reverse == reverse) return;
+
+    m_reverse = reverse;
+    if (reverse) {
+        m_pendingStep = 0;
+        m_reverseTimer->start();
+        prefetch(-1);
+    } else {
+        m_reverseTimer->stop();
+    }
+    emit reverseChanged();
+}
+
+bool FrameStepper::isReverse() const
+{
+    return m_reverse;
+}
+
+QVariantMap FrameStepper::stats() const
+{
+    qint64 frames = 0;
+    for (const auto &entry : m_segments) frames += entry.second->frames.size();
+
+    QVariantMap map;
+    map["stepSegments"] = int(m_segments.size());
+    map["stepFrames"] = frames;
+    map["stepCacheKB"] = m_bytes / 1024;
+    map["stepBudgetKB"] = m_budget / 1024;
+    map["stepPending"] = int(m_pending.size());
+    return map;
+}
+
+void FrameStepper::step(int direction)
+{
+    // 按住按键时等待当前解码完成，不堆积请求
+    if (!m_active || m_pendingStep != 0) return;
+
+    qint64 time = 0;
+    qint64 missing = -1;
+    QVideoFrame frame;
+    if (locate(direction, m_position, &time, &frame, &missing)) {
+        show(time, frame);
+        prefetch(direction);
+        return;
+    }
+    if (missing < 0) return; // 已到开头或结尾
+
+    m_pendingStep = direction;
+    m_waitingFor = missing;
+    request(missing, direction);
+}
+
+bool FrameStepper::locate(int direction, qint64 position, qint64 *time, QVideoFrame *frame, qint64 *missing) const
+{
+    *missing = -1;
+    const FrameSegment *segment = segmentAt(position);
+    if (!segment) {
+        *missing = position;
+        return false;
+    }
+
+    if (direction > 0) {
+        auto it = segment->frames.upper_bound(position);
+        if (it == segment->frames.end()) {
+            // 本段已到末尾，到下一段中找
+            const qint64 next = segment->to;
+            if (next < 0) return false; // 文件结尾
+            segment = segmentAt(next);
+            if (!segment) {
+                *missing = next;
+                return false;
+            }
+            it = segment->frames.upper_bound(position);
+            if (it == segment->frames.end()) return false;
+        }
+        *time = it->first;
+        *frame = it->second;
+        return true;
+    }
+
+    auto it = segment->frames.lower_bound(position);
+    if (it == segment->frames.begin()) {
+        // 本段已到开头，到上一段中找
+        if (segment->from <= 0) return false; // 媒体开头
+        const qint64 previous = segment->from - 1;
+        segment = segmentAt(previous);
+        if (!segment) {
+            *missing = previous;
+            return false;
+        }
+        it = segment->frames.lower_bound(position);
+        if (it == segment->frames.begin()) return false;
+    }
+    --it;
+    *time = it->first;
+    *frame = it->second;
+    return true;
+}
+
+const FrameSegment *FrameStepper::segmentAt(qint64 position) const
+{
+    auto it = m_segments.upper_bound(position);
+    if (it == m_segments.begin()) return nullptr;
+    --it;
+    const FrameSegment *segment = it->second.get();
+    if (segment->to >= 0 && position >= segment->to) return nullptr;
+    return segment;
+}
+
+void FrameStepper::show(qint64 time, const QVideoFrame &frame)
+{
+    m_position = time;
+    if (m_videoSink) m_videoSink->setVideoFrame(frame);
+    emit positionChanged(time);
+}
+
+void FrameStepper::request(qint64 position, int direction)
+{
+    if (position < 0 || m_filePath.isEmpty() || m_pending.count(position)) return;
+    m_pending.insert(position);
+
+    const quint64 generation = m_generation;
+    const QString filePath = m_filePath;
+    const std::shared_ptr<const KeyframeIndex> index = m_index;
+    const DecodeSettings settings = m_settings;
+    const qint64 budget = m_budget / 2; // 一段最多占一半预算，给相邻的GOP留出空间
+    const std::shared_ptr<Context> context = m_context;
+    QPointer<FrameStepper> self(this);
+
+    m_pool.start([=]() {
+        auto segment = std::make_shared<FrameSegment>();
+        FrameDecoder &decoder = context->decoder;
+        decoder.setDecodeSettings(settings);
+        if (decoder.open(filePath)) {
+            decoder.setKeyframeIndex(index);
+            std::map<qint64, qint64> frameBytes; // 每一帧计入segment->bytes的字节数，丢弃时减去同样的数
+            auto keep = [&](const AVFrame *avFrame, qint64 time) {
+                QVideoFrame frame = context->pool->toVideoFrame(avFrame, &context->swsCtx);
+                if (!frame.isValid()) return;
+                frame.setStartTime(time * 1000);
+                const qint64 bytes = VideoFramePool::frameBytes(avFrame);
+                qint64 &counted = frameBytes[time];
+                segment->bytes += bytes - counted; //同一时间的帧替换旧帧
+                counted = bytes;
+                segment->frames[time] = frame;
+            };
+
+            if (direction > 0) {
+                // 向后：保留position之后的帧，超出预算时截断，下次从截断处继续
+                qint64 nextKeyframe = -1;
+                qint64 stoppedAt = -1;
+                decoder.decodeGop(
+                    position,
+                    [&](const AVFrame *avFrame, qint64 time) {
+                        if (time < position) return true;
+                        if (segment->bytes >= budget) {
+                            stoppedAt = time;
+                            return false;
+                        }
+                        keep(avFrame, time);
+                        return true;
+                    },
+                    &nextKeyframe);
+                segment->from = position;
+                segment->to = stoppedAt >= 0 ? stoppedAt : nextKeyframe;
+            } else {
+                // 向前：保留position及之前的帧，超出预算时丢弃最早的帧
+                decoder.decodeGop(position, [&](const AVFrame *avFrame, qint64 time) {
+                    if (time > position) return false;
+                    keep(avFrame, time);
+                    while (segment->bytes > budget && segment->frames.size() > 1) {
+                        const qint64 earliest = segment->frames.begin()->first;
+                        segment->frames.erase(segment->frames.begin());
+                        segment->bytes -= frameBytes[earliest];
+                        frameBytes.erase(earliest);
+                    }
+                    return true;
+                });
+                if (!segment->frames.empty()) segment->from = segment->frames.begin()->first;
+                segment->to = position + 1;
+            }
+        }
+
+        QMetaObject::invokeMethod(
+            self, [self, generation, position, segment]() {
+                if (self) self->onSegmentDecoded(generation, position, segment);
+            }, Qt::QueuedConnection);
+    });
+}
+
+void FrameStepper::prefetch(int direction)
+{
+    const FrameSegment *segment = segmentAt(m_position);
+    if (!segment) return;
+    if (direction < 0) {
+        if (segment->from > 0 && !segmentAt(segment->from - 1)) request(segment->from - 1, -1);
+    } else if (segment->to >= 0 && !segmentAt(segment->to)) {
+        request(segment->to, 1);
+    }
+}
+
+void FrameStepper::onSegmentDecoded(quint64 generation, qint64 requested, std::shared_ptr<FrameSegment> segment)
+{
+    if (generation != m_generation) return;
+    m_pending.erase(requested);
+    if (!segment->frames.empty() && !m_segments.count(segment->from)) {
+        m_bytes += segment->bytes;
+        m_segments[segment->from] = std::move(segment);
+        evict();
+    }
+    if (m_reverse && !segmentAt(requested)) setReverse(false); // 解码不出更早的帧，停止倒放
+
+    // 继续等待中的步进
+    if (m_pendingStep == 0 || requested != m_waitingFor) return;
+    const int direction = m_pendingStep;
+    m_pendingStep = 0;
+
+    qint64 time = 0;
+    qint64 missing = -1;
+    QVideoFrame frame;
+    if (locate(direction, m_position, &time, &frame, &missing)) {
+        show(time, frame);
+        prefetch(direction);
+    } else if (missing >= 0 && missing != requested) {
+        // 刚解码的段没有覆盖目标位置时再请求一次，同一位置不重复请求
+        m_pendingStep = direction;
+        m_waitingFor = missing;
+        request(missing, direction);
+    }
+}
+
+void FrameStepper::evict()
+{
+    while (m_bytes > m_budget && m_segments.size() > 1) {
+        // 丢弃离当前位置最远的一段，当前段始终保留
+        auto farthest = m_segments.end();
+        qint64 farthestDistance = -1;
+        for (auto it = m_segments.begin(); it != m_segments.end(); ++it) {
+            const FrameSegment &segment = *it->second;
+            if (m_position >= segment.from && (segment.to < 0 || m_position < segment.to)) continue;
+            qint64 distance = m_position < segment.from ? segment.from - m_position
+                                                         : m_position - (segment.to < 0 ? segment.from : segment.to);
+            if (distance > farthestDistance) {
+                farthestDistance = distance;
+                farthest = it;
+            }
+        }
+        if (farthest == m_segments.end()) break;
+        m_bytes -= farthest->second->bytes;
+        m_segments.erase(farthest);
+    }
+}
+
+void FrameStepper::reverseTick()
+{
+    const qint64 clock = m_reverseStart - qint64(m_reverseClock.elapsed() * m_reverseRate);
+
+    qint64 time = 0;
+    qint64 missing = -1;
+    QVideoFrame frame;
+    if (!locate(-1, m_position, &time, &frame, &missing)) {
+        if (missing < 0) {
+            setReverse(false); // 到达开头
+            return;
+        }
+        // 上一个GOP还没解码完，等待期间暂停计时
+        request(missing, -1);
+        m_reverseStart = m_position;
+        m_reverseClock.restart();
+        return;
+    }
+    if (time < clock) return; // 还没到显示时间
+
+    // 落后时跳过已经过期的帧
+    qint64 earlierTime = 0;
+    QVideoFrame earlier;
+    while (locate(-1, time, &earlierTime, &earlier, &missing) && earlierTime >= clock) {
+        time = earlierTime;
+        frame = earlier;
+    }
+    show(time, frame);
+    prefetch(-1);
+}
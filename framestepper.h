@@ -0,0 +1,95 @@
+#pragma once
+
+#include <QObject>
+#include <QElapsedTimer>
+#include <QPointer>
+#include <QThreadPool>
+#include <QTimer>
+#include <QVariantMap>
+#include <QVideoFrame>
+#include <QVideoSink>
+#include <map>
+#include <memory>
+#include <set>
+
+#include "keyframeindex.h"
+#include "decodeprofile.h"
+
+// 一段连续解码出的帧，覆盖[from, to)，to为-1时表示到文件结尾
+struct FrameSegment
+{
+    qint64 from = -1;
+    qint64 to = -1;
+    std::map<qint64, QVideoFrame> frames; // 按显示时间(毫秒)排序
+    qint64 bytes = 0;
+};
+
+// 逐帧浏览和倒放：在后台从关键帧开始解码整个GOP，缓存解码后的帧
+// 走到当前GOP时就预先解码相邻的GOP，缓存总量超出内存预算时丢弃离当前位置最远的一段
+class FrameStepper : public QObject
+{
+    Q_OBJECT
+public:
+    explicit FrameStepper(QObject *parent = nullptr);
+    ~FrameStepper() override;
+
+    void setMedia(const QString &filePath); // 切换媒体并清空缓存，空路径表示关闭
+    void setKeyframeIndex(std::shared_ptr<const KeyframeIndex> index); // 用关键帧索引精确定位GOP
+    void setDecodeSettings(const DecodeSettings &settings);
+    void setVideoSink(QVideoSink *sink);
+    void setMemoryBudget(qint64 bytes);
+
+    void begin(qint64 position); // 从播放位置进入逐帧模式，开始解码当前GOP
+    void end();                  // 退出逐帧模式，缓存保留到切换媒体
+    bool isActive() const;
+    qint64 position() const;     // 当前显示帧的时间
+
+    void stepForward();
+    void stepBackward();
+    void setReverse(bool reverse, qreal rate = 1.0); // 按rate倍速倒放
+    bool isReverse() const;
+
+    QVariantMap stats() const; // 缓存段数、帧数、占用内存等
+
+signals:
+    void positionChanged(qint64 position);
+    void reverseChanged();
+
+private:
+    struct Context; // 解码线程独占的解码器和帧池
+
+    void step(int direction);
+    // 在缓存中查找position前后紧挨着的一帧，未命中时missing为需要解码的位置，到达开头或结尾时为-1
+    bool locate(int direction, qint64 position, qint64 *time, QVideoFrame *frame, qint64 *missing) const;
+    const FrameSegment *segmentAt(qint64 position) const;
+    void show(qint64 time, const QVideoFrame &frame);
+    void request(qint64 position, int direction); // 后台解码position所在的GOP
+    void prefetch(int direction);                 // 预先解码相邻的GOP
+    void onSegmentDecoded(quint64 generation, qint64 requested, std::shared_ptr<FrameSegment> segment);
+    void evict();
+    void reverseTick();
+
+    std::shared_ptr<Context> m_context;
+    QThreadPool m_pool; // 单线程，所有请求按顺序使用同一个解码器
+    quint64 m_generation;
+    QString m_filePath;
+    std::shared_ptr<const KeyframeIndex> m_index;
+    DecodeSettings m_settings;
+    QPointer<QVideoSink> m_videoSink;
+
+    std::map<qint64, std::shared_ptr<FrameSegment>> m_segments; // 按from排序
+    std::set<qint64> m_pending;                                 // 已提交还未完成的请求
+    qint64 m_bytes;
+    qint64 m_budget;
+
+    bool m_active;
+    qint64 m_position;
+    int m_pendingStep;  // 等待解码完成后继续的步进方向
+    qint64 m_waitingFor; // 步进等待的请求位置
+
+    bool m_reverse;
+    qreal m_reverseRate;
+    qint64 m_reverseStart;       // 倒放计时起点对应的媒体时间
+    QElapsedTimer m_reverseClock;
+    QTimer *m_reverseTimer;
+};
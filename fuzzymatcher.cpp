@@ -0,0 +1,96 @@
+#include "fuzzymatcher.h"
+
+#include <QVarLengthArray>
+
+namespace {
+constexpr int kMatchScore = 16;
+constexpr int kBoundaryBonus = 8;    // 单词开头
+constexpr int kConsecutiveBonus = 4; // 紧接上一个命中
+constexpr int kGapPenalty = 1;       // 每个跳过的字符
+constexpr int kMaxGapPenalty = 12;   // 一段间隔最多扣这么多
+constexpr int kMissPenalty = 24;     // 每个错字
+constexpr int kTitleBonus = 10;      // 命中都在标题(第一行)里
+constexpr int kSubstringBonus = 48;  // 查询整体作为子串出现
+
+bool isBoundary(const QString &text, int i)
+{
+    if (i == 0) return true;
+    const QChar prev = text.at(i - 1);
+    return !prev.isLetterOrNumber() || (prev.isLower() && text.at(i).isUpper());
+}
+} // namespace
+
+namespace FuzzyMatcher {
+
+int maxMisses(int queryLength)
+{
+    return queryLength < 4 ? 0 : queryLength / 4;
+}
+
+int score(const QString &text, const QString &query)
+{
+    if (query.isEmpty()) return 0;
+    const int n = text.size();
+    const int m = query.size();
+
+    // 正向贪心找到子序列，找不到的查询字符记为错字
+    QVarLengthArray<bool, 32> matched(m);
+    int misses = 0;
+    int end = -1;
+    int pos = 0;
+    for (int j = 0; j < m; j++) {
+        int found = text.indexOf(query.at(j), pos);
+        matched[j] = found >= 0;
+        if (found < 0) {
+            if (++misses > maxMisses(m)) return kNoMatch;
+            continue;
+        }
+        end = found;
+        pos = found + 1;
+    }
+    if (end < 0) return kNoMatch;
+
+    // 从结尾反向收紧起点，得到更短的匹配区间
+    int start = end;
+    int j = m - 1;
+    for (int i = end; i >= 0; i--) {
+        while (j >= 0 && !matched[j]) j--;
+        if (j < 0) break;
+        if (text.at(i) == query.at(j)) {
+            start = i;
+            j--;
+        }
+    }
+
+    // 在[start, end]内重新正向匹配并打分
+    int result = 0;
+    int last = -2;
+    int run = 0;
+    j = 0;
+    for (int i = start; i <= end; i++) {
+        while (j < m && !matched[j]) j++;
+        if (j >= m) break;
+        if (text.at(i) != query.at(j)) continue;
+        result += kMatchScore;
+        if (isBoundary(text, i)) result += kBoundaryBonus;
+        if (i == last + 1) {
+            run++;
+            result += kConsecutiveBonus * run;
+        } else {
+            run = 0;
+            if (last >= 0) result -= qMin(kMaxGapPenalty, (i - last - 1) * kGapPenalty);
+        }
+        last = i;
+        j++;
+    }
+    result -= misses * kMissPenalty;
+
+    const int lineEnd = text.indexOf('\n');
+    if (lineEnd < 0 || end < lineEnd) result += kTitleBonus;
+    if (misses == 0 && text.indexOf(query) >= 0) result += kSubstringBonus;
+    // 越短的文本越相关
+    result -= qMin(n, 200) / 20;
+    return qMax(0, result);
+}
+
+} // namespace FuzzyMatcher
@@ -0,0 +1,14 @@
+#pragma once
+
+#include <QString>
+
+// fzf式的模糊匹配打分：查询按顺序作为子序列出现即可匹配，
+// 连续命中、单词开头、标题内命中加分，中间跳过的字符扣分；
+// 允许少量查询字符找不到(输错字)，每个扣较多分
+// 文本和查询都应先经过SearchIndex::normalize
+namespace FuzzyMatcher {
+constexpr int kNoMatch = -1;
+
+int maxMisses(int queryLength); // 按查询长度允许的错字数
+int score(const QString &text, const QString &query); // 不匹配时返回kNoMatch，分数越高越靠前
+} // namespace FuzzyMatcher
@@ -0,0 +1,248 @@
+#include "historyjournal.h"
+
+#include <QDataStream>
+#include <QDateTime>
+#include <QDebug>
+#include <QSaveFile>
+#include <algorithm>
+
+namespace {
+constexpr quint32 kJournalMagic = 0x5650484A; // "VPHJ"
+constexpr quint32 kJournalVersion = 1;
+constexpr QDataStream::Version kStreamVersion = QDataStream::Qt_6_5; // 固定编码，升级Qt后仍能读取旧日志
+constexpr int kCompactSlack = 256; // 过期记录超过这个数量且多于有效项时才压缩
+
+void writeMedia(QDataStream &out, const PlaylistEntry &media)
+{
+    out << media.title << media.metadata << media.thumbnail << media.duration;
+}
+
+void readMedia(QDataStream &in, PlaylistEntry &media)
+{
+    in >> media.title >> media.metadata >> media.thumbnail >> media.duration;
+}
+} // namespace
+
+HistoryJournal::HistoryJournal(const QString &filePath, int maxEntries)
+    : m_filePath{filePath}
+    , m_maxEntries{qMax(1, maxEntries)}
+    , m_records{0}
+    , m_loaded{false}
+{}
+
+QList<HistoryEntry> HistoryJournal::load()
+{
+    m_file.close();
+    m_entries.clear();
+    m_records = 0;
+    m_loaded = true;
+
+    QFile file(m_filePath);
+    qint64 validEnd = 0;
+    qint64 fileSize = 0;
+    if (file.open(QIODevice::ReadOnly)) {
+        fileSize = file.size();
+        QDataStream in(&file);
+        in.setVersion(kStreamVersion);
+        quint32 magic = 0, version = 0;
+        in >> magic >> version;
+        if (in.status() == QDataStream::Ok && magic == kJournalMagic && version == kJournalVersion) {
+            validEnd = file.pos();
+            while (!in.atEnd()) {
+                quint8 op = 0;
+                QUrl url;
+                in >> op >> url;
+                HistoryEntry entry = m_entries.value(url);
+                entry.media.url = url;
+                if (op == Played) {
+                    qint64 playedAt = 0;
+                    readMedia(in, entry.media);
+                    in >> playedAt;
+                    entry.playCount++;
+                    entry.lastPlayed = playedAt;
+                } else if (op == Snapshot || op == Media) {
+                    readMedia(in, entry.media);
+                    if (op == Snapshot) in >> entry.playCount >> entry.lastPlayed;
+                } else {
+                    break; //未知记录，后面的内容不可信
+                }
+                if (in.status() != QDataStream::Ok) break; //写到一半的尾部记录
+                if (op != Media || m_entries.contains(url)) m_entries.insert(url, entry); //已经淘汰的项不因元数据复活
+                validEnd = file.pos();
+                m_records++;
+            }
+        } else if (fileSize > 0) {
+            qWarning() << "HistoryJournal: invalid journal" << m_filePath;
+        }
+        file.close();
+    }
+
+    // 截掉不完整的尾部，之后的追加从有效位置开始
+    if (validEnd < fileSize) {
+        if (validEnd == 0) QFile::remove(m_filePath);
+        else QFile::resize(m_filePath, validEnd);
+    }
+
+    QList<HistoryEntry> entries = sorted();
+    if (entries.size() < m_entries.size()) {
+        m_entries.clear();
+        for (const HistoryEntry &entry : std::as_const(entries)) m_entries.insert(entry.media.url, entry);
+    }
+    compactIfNeeded();
+    return entries;
+}
+
+HistoryEntry HistoryJournal::recordPlayed(const PlaylistEntry &media)
+{
+    if (!m_loaded) load();
+
+    const qint64 now = QDateTime::currentMSecsSinceEpoch();
+    HistoryEntry &entry = m_entries[media.url];
+    entry.media = media;
+    entry.playCount++;
+    entry.lastPlayed = now;
+    const HistoryEntry result = entry;
+
+    QByteArray record;
+    QDataStream out(&record, QIODevice::WriteOnly);
+    out.setVersion(kStreamVersion);
+    out << quint8(Played) << media.url;
+    writeMedia(out, media);
+    out << now;
+    append(record);
+
+    // 超出上限时丢掉最久没有播放的一项，文件里的旧记录在压缩时清除
+    if (m_entries.size() > m_maxEntries) {
+        auto oldest = std::min_element(m_entries.begin(), m_entries.end(), [](const HistoryEntry &a, const HistoryEntry &b) {
+            return a.lastPlayed < b.lastPlayed;
+        });
+        m_entries.erase(oldest);
+    }
+    compactIfNeeded();
+    return result;
+}
+
+void HistoryJournal::updateMedia(const PlaylistEntry &media)
+{
+    if (!m_loaded) load();
+    auto it = m_entries.find(media.url);
+    if (it == m_entries.end()) return; //只更新历史里有的文件
+    const PlaylistEntry &old = it->media;
+    if (old.title == media.title && old.metadata == media.metadata && old.thumbnail == media.thumbnail
+        && old.duration == media.duration) {
+        return;
+    }
+
+    it->media = media;
+    QByteArray record;
+    QDataStream out(&record, QIODevice::WriteOnly);
+    out.setVersion(kStreamVersion);
+    out << quint8(Media) << media.url;
+    writeMedia(out, media);
+    append(record);
+    compactIfNeeded();
+}
+
+void HistoryJournal::importEntries(const QList<PlaylistEntry> &entries)
+{
+    if (!m_loaded) load();
+    const qint64 now = QDateTime::currentMSecsSinceEpoch();
+    for (int i = 0; i < entries.size() && i < m_maxEntries; i++) {
+        if (m_entries.contains(entries[i].url)) continue;
+        HistoryEntry entry;
+        entry.media = entries[i];
+        entry.playCount = 1;
+        entry.lastPlayed = now - i; //保持原来的先后顺序
+        m_entries.insert(entry.media.url, entry);
+    }
+    compact();
+}
+
+void HistoryJournal::clear()
+{
+    m_file.close();
+    QFile::remove(m_filePath);
+    m_entries.clear();
+    m_records = 0;
+    m_loaded = true;
+}
+
+int HistoryJournal::maxEntries() const
+{
+    return m_maxEntries;
+}
+
+void HistoryJournal::setMaxEntries(int maxEntries)
+{
+    maxEntries = qMax(1, maxEntries);
+    if (m_maxEntries == maxEntries) return;
+    m_maxEntries = maxEntries;
+    if (!m_loaded || m_entries.size() <= m_maxEntries) return;
+
+    const QList<HistoryEntry> entries = sorted();
+    m_entries.clear();
+    for (const HistoryEntry &entry : entries) m_entries.insert(entry.media.url, entry);
+    compact();
+}
+
+QString HistoryJournal::filePath() const
+{
+    return m_filePath;
+}
+
+void HistoryJournal::append(const QByteArray &record)
+{
+    if (!m_file.isOpen()) {
+        m_file.setFileName(m_filePath);
+        if (!m_file.open(QIODevice::WriteOnly | QIODevice::Append)) {
+            qWarning() << "HistoryJournal: cannot open" << m_filePath << m_file.errorString();
+            return;
+        }
+        if (m_file.size() == 0) {
+            QDataStream out(&m_file);
+            out.setVersion(kStreamVersion);
+            out << kJournalMagic << kJournalVersion;
+        }
+    }
+    // 整条记录一次写入，崩溃时最多留下一条不完整的尾部记录
+    m_file.write(record);
+    m_file.flush();
+    m_records++;
+}
+
+void HistoryJournal::compactIfNeeded()
+{
+    if (m_records > 2 * m_entries.size() + kCompactSlack) compact();
+}
+
+void HistoryJournal::compact()
+{
+    m_file.close(); //Windows上不能替换仍然打开的文件
+
+    QSaveFile file(m_filePath);
+    if (!file.open(QIODevice::WriteOnly)) return;
+    QDataStream out(&file);
+    out.setVersion(kStreamVersion);
+    out << kJournalMagic << kJournalVersion;
+    const QList<HistoryEntry> entries = sorted();
+    for (const HistoryEntry &entry : entries) {
+        out << quint8(Snapshot) << entry.media.url;
+        writeMedia(out, entry.media);
+        out << entry.playCount << entry.lastPlayed;
+    }
+    if (out.status() != QDataStream::Ok || !file.commit()) {
+        qWarning() << "HistoryJournal: compaction failed" << m_filePath;
+        return;
+    }
+    m_records = entries.size();
+}
+
+QList<HistoryEntry> HistoryJournal::sorted() const
+{
+    QList<HistoryEntry> entries = m_entries.values();
+    std::sort(entries.begin(), entries.end(), [](const HistoryEntry &a, const HistoryEntry &b) {
+        return a.lastPlayed > b.lastPlayed;
+    });
+    if (entries.size() > m_maxEntries) entries.resize(m_maxEntries);
+    return entries;
+}
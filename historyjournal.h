@@ -0,0 +1,52 @@
+#pragma once
+
+#include <QFile>
+#include <QHash>
+#include <QList>
+#include <QString>
+#include <QUrl>
+
+#include "playlistfile.h"
+
+// 历史记录中的一项：缓存的元数据 + 播放统计
+struct HistoryEntry
+{
+    PlaylistEntry media;
+    int playCount = 0;
+    qint64 lastPlayed = 0;    // 最近一次播放的时间(ms since epoch)
+};
+
+// 只追加的历史记录日志：每次播放只在文件末尾追加一条记录，
+// 启动时重放日志得到当前状态；过期记录超过一定比例时整体重写(压缩)。
+// 写入不fsync，掉电最多丢失末尾几条，读取时截掉不完整的尾部记录。
+// 上次停止的位置由ResumeStore保存，日志里只有播放记录和元数据。
+class HistoryJournal
+{
+public:
+    explicit HistoryJournal(const QString &filePath, int maxEntries = 1000);
+
+    QList<HistoryEntry> load(); // 重放日志，按最近播放排序，最多maxEntries项
+    HistoryEntry recordPlayed(const PlaylistEntry &media); // 追加一次播放，返回更新后的项
+    void updateMedia(const PlaylistEntry &media);          // 后台探测完成后补上元数据，不计播放次数
+    void importEntries(const QList<PlaylistEntry> &entries); // 迁移旧格式的历史记录，按最近播放在前的顺序
+    void clear();               // 删除日志文件
+
+    int maxEntries() const;
+    void setMaxEntries(int maxEntries);
+    QString filePath() const;
+
+private:
+    enum Op : quint8 { Played = 1, Snapshot = 2, Media = 3 }; // Snapshot为压缩后每项一条的完整记录
+
+    void append(const QByteArray &record);
+    void compactIfNeeded();
+    void compact();
+    QList<HistoryEntry> sorted() const;
+
+    QString m_filePath;
+    QFile m_file;            // 以追加方式保持打开
+    int m_maxEntries;
+    QHash<QUrl, HistoryEntry> m_entries;
+    int m_records;           // 日志中的记录条数，用来判断是否需要压缩
+    bool m_loaded;
+};
@@ -0,0 +1,279 @@
+#include "keyframeindex.h"
+#include "mediacache.h"
+
+#include <QDataStream>
+#include <QDebug>
+#include <QElapsedTimer>
+#include <QFile>
+#include <QPointer>
+#include <QSaveFile>
+#include <algorithm>
+
+extern "C" {
+#include <libavformat/avformat.h>
+}
+
+namespace {
+constexpr quint32 kIndexMagic = 0x56504B46; // "VPKF"
+constexpr quint32 kIndexVersion = 1;
+
+// 只读取包不解码，记录视频流关键帧的pts和字节偏移
+KeyframeIndex scanKeyframes(const QString &filePath, const std::atomic_bool &cancelled, KeyframeIndexStats &stats)
+{
+    QElapsedTimer timer;
+    timer.start();
+
+    AVFormatContext *formatCtx = nullptr;
+    if (avformat_open_input(&formatCtx, filePath.toUtf8().constData(), nullptr, nullptr) < 0) {
+        qWarning() << "KeyframeIndexer: failed to open" << filePath;
+        return KeyframeIndex();
+    }
+    if (avformat_find_stream_info(formatCtx, nullptr) < 0) {
+        avformat_close_input(&formatCtx);
+        return KeyframeIndex();
+    }
+
+    int streamIndex = av_find_best_stream(formatCtx, AVMEDIA_TYPE_VIDEO, -1, -1, nullptr, 0);
+    if (streamIndex < 0 || (formatCtx->streams[streamIndex]->disposition & AV_DISPOSITION_ATTACHED_PIC)) {
+        avformat_close_input(&formatCtx);
+        return KeyframeIndex();
+    }
+
+    // 丢弃其他流，解复用器可以直接跳过它们的数据
+    for (unsigned int i = 0; i < formatCtx->nb_streams; ++i) {
+        if (static_cast<int>(i) != streamIndex) formatCtx->streams[i]->discard = AVDISCARD_ALL;
+    }
+
+    AVStream *stream = formatCtx->streams[streamIndex];
+    QList<KeyframeEntry> entries;
+    AVPacket *packet = av_packet_alloc();
+    while (!cancelled.load() && av_read_frame(formatCtx, packet) >= 0) {
+        ++stats.packets;
+        if (packet->stream_index == streamIndex && (packet->flags & AV_PKT_FLAG_KEY)) {
+            qint64 pts = packet->pts != AV_NOPTS_VALUE ? packet->pts : packet->dts;
+            if (pts != AV_NOPTS_VALUE) entries.append(KeyframeEntry{pts, packet->pos});
+        }
+        av_packet_unref(packet);
+    }
+    av_packet_free(&packet);
+
+    stats.bytes = formatCtx->pb ? avio_tell(formatCtx->pb) : 0;
+    stats.elapsed = timer.elapsed();
+    stats.keyframes = entries.size();
+
+    qint64 startTime = stream->start_time != AV_NOPTS_VALUE ? stream->start_time : 0;
+    KeyframeIndex index(streamIndex, stream->time_base.num, stream->time_base.den, startTime, entries);
+    avformat_close_input(&formatCtx);
+
+    if (cancelled.load()) return KeyframeIndex();
+    return index;
+}
+} // namespace
+
+KeyframeIndex::KeyframeIndex(
+    int streamIndex, int timeBaseNum, int timeBaseDen, qint64 startTime, QList<KeyframeEntry> entries)
+    : m_streamIndex{streamIndex}
+    , m_timeBaseNum{timeBaseNum}
+    , m_timeBaseDen{timeBaseDen > 0 ? timeBaseDen : 1}
+    , m_startTime{startTime}
+    , m_entries{std::move(entries)}
+{
+    // 大多数容器中关键帧已按顺序出现，这里保证有序并去重
+    std::sort(m_entries.begin(), m_entries.end(), [](const KeyframeEntry &a, const KeyframeEntry &b) {
+        return a.pts < b.pts;
+    });
+    m_entries.erase(std::unique(m_entries.begin(),
+                                m_entries.end(),
+                                [](const KeyframeEntry &a, const KeyframeEntry &b) { return a.pts == b.pts; }),
+                    m_entries.end());
+    m_entries.squeeze();
+}
+
+bool KeyframeIndex::isEmpty() const
+{
+    return m_entries.isEmpty();
+}
+
+int KeyframeIndex::size() const
+{
+    return m_entries.size();
+}
+
+int KeyframeIndex::streamIndex() const
+{
+    return m_streamIndex;
+}
+
+const KeyframeEntry &KeyframeIndex::at(int i) const
+{
+    return m_entries.at(i);
+}
+
+qint64 KeyframeIndex::toMs(qint64 pts) const
+{
+    return av_rescale_q(pts - m_startTime, AVRational{m_timeBaseNum, m_timeBaseDen}, AVRational{1, 1000});
+}
+
+qint64 KeyframeIndex::toPts(qint64 position) const
+{
+    return av_rescale_q(position, AVRational{1, 1000}, AVRational{m_timeBaseNum, m_timeBaseDen}) + m_startTime;
+}
+
+int KeyframeIndex::indexBefore(qint64 position) const
+{
+    qint64 pts = toPts(position);
+    auto it = std::upper_bound(m_entries.cbegin(), m_entries.cend(), pts, [](qint64 value, const KeyframeEntry &entry) {
+        return value < entry.pts;
+    });
+    return static_cast<int>(std::distance(m_entries.cbegin(), it)) - 1;
+}
+
+qint64 KeyframeIndex::keyframeBefore(qint64 position) const
+{
+    int i = indexBefore(position);
+    return i >= 0 ? toMs(m_entries.at(i).pts) : -1;
+}
+
+qint64 KeyframeIndex::keyframeAfter(qint64 position) const
+{
+    int i = indexBefore(position) + 1;
+    return i < m_entries.size() ? toMs(m_entries.at(i).pts) : -1;
+}
+
+bool KeyframeIndex::save(const QString &filePath) const
+{
+    QSaveFile file(filePath);
+    if (!file.open(QIODevice::WriteOnly)) return false;
+
+    QDataStream out(&file);
+    out << kIndexMagic << kIndexVersion << qint32(m_streamIndex) << qint32(m_timeBaseNum) << qint32(m_timeBaseDen)
+        << m_startTime << qint32(m_entries.size());
+    for (const KeyframeEntry &entry : m_entries) {
+        out << entry.pts << entry.pos;
+    }
+    return out.status() == QDataStream::Ok && file.commit();
+}
+
+KeyframeIndex KeyframeIndex::load(const QString &filePath)
+{
+    QFile file(filePath);
+    if (!file.open(QIODevice::ReadOnly)) return KeyframeIndex();
+
+    QDataStream in(&file);
+    quint32 magic, version;
+    qint32 streamIndex, timeBaseNum, timeBaseDen, count;
+    qint64 startTime;
+    in >> magic >> version >> streamIndex >> timeBaseNum >> timeBaseDen >> startTime >> count;
+    if (in.status() != QDataStream::Ok || magic != kIndexMagic || version != kIndexVersion || count < 0
+        || file.size() - file.pos() != qint64(count) * 16) {
+        return KeyframeIndex();
+    }
+
+    QList<KeyframeEntry> entries;
+    entries.reserve(count);
+    for (qint32 i = 0; i < count; ++i) {
+        KeyframeEntry entry;
+        in >> entry.pts >> entry.pos;
+        entries.append(entry);
+    }
+    if (in.status() != QDataStream::Ok) return KeyframeIndex();
+    return KeyframeIndex(streamIndex, timeBaseNum, timeBaseDen, startTime, std::move(entries));
+}
+
+double KeyframeIndexStats::mbPerSecond() const
+{
+    if (fromCache || elapsed <= 0) return 0; //读缓存时没有扫描媒体文件
+    return (bytes / (1024.0 * 1024.0)) / (elapsed / 1000.0);
+}
+
+QVariantMap KeyframeIndexStats::toVariantMap() const
+{
+    return QVariantMap{{"bytes", bytes},
+                       {"elapsed", elapsed},
+                       {"packets", packets},
+                       {"keyframes", keyframes},
+                       {"fromCache", fromCache},
+                       {"mbPerSecond", mbPerSecond()}};
+}
+
+KeyframeIndexer::KeyframeIndexer(QObject *parent)
+    : QObject{parent}
+    , m_cancelled{std::make_shared<std::atomic_bool>(false)}
+    , m_generation{0}
+{
+    m_pool.setMaxThreadCount(1);
+    m_pool.setThreadPriority(QThread::LowPriority);
+}
+
+KeyframeIndexer::~KeyframeIndexer()
+{
+    stop();
+}
+
+void KeyframeIndexer::start(const QString &filePath)
+{
+    if (filePath == m_filePath && m_index) return;
+    stop();
+
+    QString key = MediaCache::cacheKey(filePath);
+    if (key.isEmpty()) return;
+    m_filePath = filePath;
+
+    const QString cachePath = MediaCache::cacheDir("Video-Player_Index").filePath(key + ".kfi");
+    const quint64 generation = m_generation;
+    const std::shared_ptr<std::atomic_bool> cancelled = m_cancelled;
+    QPointer<KeyframeIndexer> self(this);
+
+    m_pool.start([=]() {
+        KeyframeIndexStats stats;
+        QElapsedTimer timer;
+        timer.start();
+
+        // 优先读取磁盘缓存
+        KeyframeIndex index = KeyframeIndex::load(cachePath);
+        if (!index.isEmpty()) {
+            stats.fromCache = true;
+            stats.elapsed = timer.elapsed();
+            stats.keyframes = index.size();
+        } else {
+            index = scanKeyframes(filePath, *cancelled, stats);
+            if (index.isEmpty()) return;
+            if (!index.save(cachePath)) qWarning() << "KeyframeIndexer: failed to save" << cachePath;
+        }
+
+        auto shared = std::make_shared<const KeyframeIndex>(std::move(index));
+        QMetaObject::invokeMethod(
+            self, [self, generation, shared, stats]() {
+                if (self) self->onIndexBuilt(generation, shared, stats);
+            }, Qt::QueuedConnection);
+    });
+}
+
+void KeyframeIndexer::stop()
+{
+    m_cancelled->store(true);
+    m_cancelled = std::make_shared<std::atomic_bool>(false);
+    ++m_generation;
+    m_pool.clear();
+    m_index.reset();
+    m_stats = KeyframeIndexStats();
+    m_filePath.clear();
+}
+
+std::shared_ptr<const KeyframeIndex> KeyframeIndexer::index() const
+{
+    return m_index;
+}
+
+KeyframeIndexStats KeyframeIndexer::stats() const
+{
+    return m_stats;
+}
+
+void KeyframeIndexer::onIndexBuilt(quint64 generation, std::shared_ptr<const KeyframeIndex> index, KeyframeIndexStats stats)
+{
+    if (generation != m_generation) return;
+    m_index = std::move(index);
+    m_stats = stats;
+    emit indexReady();
+}
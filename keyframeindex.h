@@ -0,0 +1,87 @@
+#pragma once
+
+#include <QObject>
+#include <QList>
+#include <QString>
+#include <QThreadPool>
+#include <QVariantMap>
+#include <atomic>
+#include <memory>
+
+// 关键帧位置，pts以视频流的time_base为单位，pos为文件中的字节偏移(未知时为-1)
+struct KeyframeEntry
+{
+    qint64 pts;
+    qint64 pos;
+};
+
+// 按pts排序的关键帧索引，创建后只读，可在多个线程间共享
+class KeyframeIndex
+{
+public:
+    KeyframeIndex() = default;
+    KeyframeIndex(int streamIndex, int timeBaseNum, int timeBaseDen, qint64 startTime, QList<KeyframeEntry> entries);
+
+    bool isEmpty() const;
+    int size() const;
+    int streamIndex() const;
+    const KeyframeEntry &at(int i) const;
+
+    qint64 toMs(qint64 pts) const;       // 流时间转为毫秒（相对于媒体开始）
+    qint64 toPts(qint64 position) const; // 毫秒转为流时间
+
+    int indexBefore(qint64 position) const;         // 二分查找position(毫秒)所在GOP的关键帧下标，没有时返回-1
+    qint64 keyframeBefore(qint64 position) const;   // position所在GOP的关键帧时间(毫秒)，没有时返回-1
+    qint64 keyframeAfter(qint64 position) const;    // position之后的下一个关键帧时间(毫秒)，没有时返回-1
+
+    bool save(const QString &filePath) const;
+    static KeyframeIndex load(const QString &filePath);
+
+private:
+    int m_streamIndex = -1;
+    int m_timeBaseNum = 1;
+    int m_timeBaseDen = 1000;
+    qint64 m_startTime = 0; // 流的起始pts
+    QList<KeyframeEntry> m_entries;
+};
+
+// 索引构建统计，用于检查网络挂载媒体库上的扫描速度
+struct KeyframeIndexStats
+{
+    qint64 bytes = 0;     // 扫描的字节数，读缓存时为0
+    qint64 elapsed = 0;   // 耗时，单位为毫秒
+    qint64 packets = 0;   // 读取的包数
+    int keyframes = 0;    // 关键帧数
+    bool fromCache = false;
+
+    double mbPerSecond() const; // 只统计实际扫描，读缓存时为0
+    QVariantMap toVariantMap() const;
+};
+
+// 后台关键帧索引器：只解复用不解码，结果按路径+大小+修改时间缓存在磁盘上
+class KeyframeIndexer : public QObject
+{
+    Q_OBJECT
+public:
+    explicit KeyframeIndexer(QObject *parent = nullptr);
+    ~KeyframeIndexer() override;
+
+    void start(const QString &filePath); // 开始为媒体构建索引，已缓存时直接加载
+    void stop();                         // 取消正在进行的扫描并清空当前索引
+
+    std::shared_ptr<const KeyframeIndex> index() const; // 当前媒体的索引，未就绪时为空指针
+    KeyframeIndexStats stats() const;
+
+signals:
+    void indexReady();
+
+private:
+    void onIndexBuilt(quint64 generation, std::shared_ptr<const KeyframeIndex> index, KeyframeIndexStats stats);
+
+    QThreadPool m_pool;
+    std::shared_ptr<std::atomic_bool> m_cancelled;
+    quint64 m_generation;
+    QString m_filePath;
+    std::shared_ptr<const KeyframeIndex> m_index;
+    KeyframeIndexStats m_stats;
+};
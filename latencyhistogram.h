@@ -0,0 +1,65 @@
+#pragma once
+
+#include <QVariantList>
+#include <QVariantMap>
+#include <array>
+#include <atomic>
+
+// 按2的幂分桶的耗时直方图，工作线程写入，界面线程读取，不加锁
+class LatencyHistogram
+{
+public:
+    static constexpr int kBuckets = 8;
+
+    void add(qint64 us)
+    {
+        int bucket = 0;
+        while (bucket < kBuckets - 1 && us > upperBoundMs(bucket) * 1000) ++bucket;
+        m_counts[bucket].fetch_add(1, std::memory_order_relaxed);
+    }
+
+    void reset()
+    {
+        for (std::atomic<qint64> &count : m_counts) count.store(0, std::memory_order_relaxed);
+    }
+
+    qint64 total() const
+    {
+        qint64 sum = 0;
+        for (const std::atomic<qint64> &count : m_counts) sum += count.load(std::memory_order_relaxed);
+        return sum;
+    }
+
+    // 达到比例p的桶的上界(毫秒)，没有样本时返回0，落在最后一个桶时返回-1
+    qint64 percentile(double p) const
+    {
+        qint64 sum = total();
+        if (sum == 0) return 0;
+        qint64 target = qint64(sum * p);
+        qint64 seen = 0;
+        for (int bucket = 0; bucket < kBuckets; ++bucket) {
+            seen += m_counts[bucket].load(std::memory_order_relaxed);
+            if (seen > target) return upperBoundMs(bucket);
+        }
+        return -1;
+    }
+
+    // [{upToMs, count}, ...]，最后一个桶的upToMs为-1
+    QVariantList toVariantList() const
+    {
+        QVariantList list;
+        for (int bucket = 0; bucket < kBuckets; ++bucket) {
+            QVariantMap entry;
+            entry["upToMs"] = upperBoundMs(bucket);
+            entry["count"] = m_counts[bucket].load(std::memory_order_relaxed);
+            list.append(entry);
+        }
+        return list;
+    }
+
+    // 1, 2, 4, 8, 16, 32, 64毫秒，最后一个桶不设上界
+    static qint64 upperBoundMs(int bucket) { return bucket < kBuckets - 1 ? qint64(1) << bucket : -1; }
+
+private:
+    std::array<std::atomic<qint64>, kBuckets> m_counts{};
+};
@@ -12,6 +12,8 @@
 #include <QQmlContext>
 #include <QIcon>
 
+#include "frameimageprovider.h"
+
 int main(int argc, char *argv[])
 {
     QGuiApplication app(argc, argv);
@@ -19,6 +21,7 @@ int main(int argc, char *argv[])
     app.setApplicationName("Video Player");
 
     QQmlApplicationEngine engine;
+    engine.addImageProvider("frames", new FrameImageProvider); // 缩略图和封面，引擎接管所有权
     QObject::connect(
         &engine,
         &QQmlApplicationEngine::objectCreationFailed,
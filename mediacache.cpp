@@ -0,0 +1,34 @@
+#include "mediacache.h"
+
+#include <QCryptographicHash>
+#include <QDateTime>
+#include <QFileInfo>
+#include <QStandardPaths>
+
+namespace MediaCache {
+
+QString cacheKey(const QString &filePath)
+{
+    QFileInfo fileInfo(filePath);
+    if (!fileInfo.exists() || !fileInfo.isFile()) return QString();
+
+    QCryptographicHash hash(QCryptographicHash::Sha1);
+    hash.addData(fileInfo.absoluteFilePath().toUtf8());
+    hash.addData(QByteArray::number(fileInfo.size()));
+    hash.addData(QByteArray::number(fileInfo.lastModified().toMSecsSinceEpoch()));
+    return QString::fromLatin1(hash.result().toHex());
+}
+
+QDir cacheDir(const QString &name)
+{
+    QString dirPath = QStandardPaths::writableLocation(QStandardPaths::AppDataLocation);
+    if (dirPath.isEmpty()) { dirPath = QDir::currentPath(); }
+    dirPath = QDir::cleanPath(dirPath);
+    if (!dirPath.endsWith(QDir::separator())) { dirPath += QDir::separator(); }
+    dirPath += name;
+    QDir dir(dirPath);
+    if (!dir.exists()) { dir.mkpath("."); }
+    return dir;
+}
+
+} // namespace MediaCache
@@ -0,0 +1,12 @@
+#pragma once
+
+#include <QDir>
+#include <QString>
+
+// 媒体文件派生数据（缩略图、索引等）的缓存位置
+namespace MediaCache {
+// 由路径+大小+修改时间生成的缓存键，文件不存在时返回空字符串
+QString cacheKey(const QString &filePath);
+// AppDataLocation下的缓存目录，与Video-Player_History/Video-Player_Danmu同级，不存在时自动创建
+QDir cacheDir(const QString &name);
+} // namespace MediaCache
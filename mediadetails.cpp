@@ -0,0 +1,137 @@
+#include "mediadetails.h"
+#include "framedecoder.h"
+#include "frameimageprovider.h"
+#include "mediaprobe.h"
+
+#include <QFileInfo>
+#include <QMutex>
+#include <QPointer>
+#include <QSet>
+
+namespace {
+constexpr int kWorkers = 2;              // 读取附加信息的线程数，不与播放抢解码资源
+const QSize kThumbnailSize(160, 90);
+}
+
+struct MediaDetailLoader::Queue
+{
+    QMutex mutex;
+    QList<QUrl> pending;  // 按优先级排列
+    QSet<QUrl> inFlight;  // 正在读取的项，不重复排队
+    int running = 0;
+    bool aborted = false;
+};
+
+MediaDetailLoader::MediaDetailLoader(QObject *parent)
+    : QObject(parent)
+    , m_queue{std::make_shared<Queue>()}
+{
+    qRegisterMetaType<MediaDetails>();
+    m_pool.setMaxThreadCount(kWorkers);
+    m_pool.setThreadPriority(QThread::LowPriority);
+}
+
+MediaDetailLoader::~MediaDetailLoader()
+{
+    {
+        QMutexLocker locker(&m_queue->mutex);
+        m_queue->aborted = true;
+        m_queue->pending.clear();
+    }
+    m_pool.waitForDone();
+}
+
+void MediaDetailLoader::request(const QList<QUrl> &urls)
+{
+    {
+        QMutexLocker locker(&m_queue->mutex);
+        m_queue->pending.clear();
+        for (const QUrl &url : urls) {
+            if (!m_queue->inFlight.contains(url)) m_queue->pending.append(url);
+        }
+    }
+    startWorkers();
+}
+
+void MediaDetailLoader::cancel()
+{
+    QMutexLocker locker(&m_queue->mutex);
+    m_queue->pending.clear();
+}
+
+void MediaDetailLoader::startWorkers()
+{
+    const std::shared_ptr<Queue> queue = m_queue;
+    QPointer<MediaDetailLoader> self(this);
+
+    QMutexLocker locker(&queue->mutex);
+    const int wanted = qMin<qsizetype>(kWorkers, queue->pending.size()) - queue->running;
+    for (int i = 0; i < wanted; i++) {
+        ++queue->running;
+        // 每个工作线程不断从队首取最优先的项，队列为空时退出
+        m_pool.start([queue, self]() {
+            for (;;) {
+                QUrl url;
+                {
+                    QMutexLocker locker(&queue->mutex);
+                    if (queue->aborted || queue->pending.isEmpty()) {
+                        --queue->running;
+                        return;
+                    }
+                    url = queue->pending.takeFirst();
+                    queue->inFlight.insert(url);
+                }
+                MediaDetails details = load(url);
+                {
+                    QMutexLocker locker(&queue->mutex);
+                    queue->inFlight.remove(url);
+                }
+                QMetaObject::invokeMethod(
+                    self, [self, url, details]() {
+                        if (self) emit self->detailsReady(url, details);
+                    }, Qt::QueuedConnection);
+            }
+        });
+    }
+}
+
+MediaDetails MediaDetailLoader::load(const QUrl &url)
+{
+    MediaDetails details;
+    const QString filePath = url.toLocalFile();
+    if (!url.isLocalFile() || filePath.isEmpty()) return details;
+
+    details.fileSize = QFileInfo(filePath).size();
+
+    // 标题探测时已经缓存，这里通常不再打开文件
+    MediaProbeResult result = MediaProbe::instance().probe(filePath);
+    if (!result.valid) return details;
+    details.duration = result.duration;
+    details.resolution = result.resolution();
+    for (const MediaStreamInfo &stream : std::as_const(result.streams)) {
+        if (stream.type == MediaStreamInfo::Video && details.videoCodec.isEmpty()) details.videoCodec = stream.codec;
+        if (stream.type == MediaStreamInfo::Audio && details.audioCodec.isEmpty()) details.audioCodec = stream.codec;
+    }
+
+    // 缩略图：视频取10%处的关键帧，音频用封面
+    const QString id = thumbnailId(url);
+    FrameCache &cache = FrameCache::instance();
+    if (!cache.contains(id)) {
+        QImage image;
+        if (!result.coverArt.isEmpty()) {
+            image = result.coverImage().scaled(kThumbnailSize, Qt::KeepAspectRatio, Qt::SmoothTransformation);
+        } else if (result.hasVideo()) {
+            FrameDecoder decoder;
+            if (decoder.open(filePath)) image = decoder.decodeAt(result.duration / 10, kThumbnailSize);
+        }
+        if (!image.isNull()) cache.insert(id, image);
+    }
+    if (cache.contains(id)) details.thumbnail = FrameCache::source(id);
+    return details;
+}
+
+QString MediaDetailLoader::thumbnailId(const QUrl &url)
+{
+    // 不放在<media>/前缀下，切换播放的媒体时FrameCache::removeMedia不会清掉列表缩略图
+    return "thumb-" + FrameCache::mediaId(url);
+}
@@ -0,0 +1,48 @@
+#pragma once
+
+#include <QObject>
+#include <QList>
+#include <QSize>
+#include <QString>
+#include <QThreadPool>
+#include <QUrl>
+#include <memory>
+
+// 播放列表行的附加信息，只在行进入视图时才读取
+struct MediaDetails
+{
+    qint64 fileSize = -1;
+    qint64 duration = -1; // 毫秒
+    QSize resolution;
+    QString videoCodec;
+    QString audioCodec;
+    QString thumbnail;    // image://frames/地址，没有画面时为空
+};
+Q_DECLARE_METATYPE(MediaDetails)
+
+// 按优先级读取附加信息的后台队列：
+// 每次request给出新的完整请求列表(最优先的在前)，替换还在排队的旧请求，
+// 滚出视图的行因此直接被丢弃；已经在读取的项读完后仍然送回，结果可以缓存
+class MediaDetailLoader : public QObject
+{
+    Q_OBJECT
+public:
+    explicit MediaDetailLoader(QObject *parent = nullptr);
+    ~MediaDetailLoader() override;
+
+    void request(const QList<QUrl> &urls);
+    void cancel();                             // 丢弃全部排队的请求
+    static MediaDetails load(const QUrl &url); // 在工作线程执行
+    static QString thumbnailId(const QUrl &url);
+
+signals:
+    void detailsReady(const QUrl &url, const MediaDetails &details);
+
+private:
+    struct Queue; // 与工作线程共享的队列
+
+    void startWorkers();
+
+    QThreadPool m_pool;
+    std::shared_ptr<Queue> m_queue;
+};
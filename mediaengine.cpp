@@ -1,4 +1,10 @@
 #include "mediaengine.h"
+#include "frameimageprovider.h"
+#include "qtplayerbackend.h"
+#include "ffmpegbackend.h"
+#include "mediaprobe.h"
+#include "mediasniffer.h"
+#include "appsettings.h"
 
 #include <QDebug>
 #include <QtMath>
@@ -8,17 +14,19 @@
 #include <QStringConverter>
 #include <QSize>
 #include <QVideoFrame>
-#include <QBuffer>
-#include <QEventLoop>
 #include <QTimer>
+#include <QPointer>
+#include <QThreadPool>
 
-extern "C" {
-#include <libavformat/avformat.h>
-#include <libavcodec/avcodec.h>
+namespace {
+constexpr qint64 kResumeMinDuration = 60 * 1000; // 短于1分钟的媒体不续播
+constexpr qint64 kResumeMargin = 10 * 1000;      // 开头和结尾10秒以内视为没看/看完
+constexpr int kResumeInterval = 10 * 1000;       // 播放中每10秒记录一次位置
 }
 
 MediaEngine::MediaEngine(QObject *parent)
     : QObject(parent)
+    , m_backend{QtMultimedia}
     , m_videoSink{nullptr}
     , m_lastVolume{0.5}
     , m_muted{false}
@@ -27,51 +35,84 @@ MediaEngine::MediaEngine(QObject *parent)
     , m_userMutedSubtitle{false}
     , m_playbackMode{Sequential}
     , m_playbackFinished{false}
-    , m_thumbnailPlayer{nullptr}
-    , m_thumbnailSink{nullptr}
     , m_islocal(true)
-    , m_coverArtBase64{""}
+    , m_coverArtSource{""}
+    , m_thumbnailEngine{nullptr}
+    , m_trickplay{nullptr}
+    , m_keyframeIndexer{nullptr}
+    , m_decodeProfile{nullptr}
+    , m_telemetry{nullptr}
+    , m_smallWindow{false}
+    , m_preloadSeconds{10}
+    , m_nextRequested{false}
+    , m_nextPlayer{nullptr}
+    , m_nextGeneration{0}
+    , m_stepper{nullptr}
+    , m_frameCacheBudget{512}
+    , m_resumeStore{nullptr}
+    , m_resumePlayback{true}
     , m_pauseTime{0}
     , m_pauseTimeRemaining{0}
 {
-    m_player = new QMediaPlayer(this);
+    m_player = createBackend(m_backend);
     m_audioOutput = new QAudioOutput(this);
     m_audioOutput->setVolume(m_lastVolume);
     m_player->setAudioOutput(m_audioOutput);
 
-    // 创建专用缩略图播放器
-    m_thumbnailPlayer = new QMediaPlayer(this);
-    m_thumbnailSink = new QVideoSink(this);
-    m_thumbnailPlayer->setVideoOutput(m_thumbnailSink);
-    m_thumbnailPlayer->setAudioOutput(nullptr); // 禁用缩略图播放器的音频输出
+    // 创建缩略图解码器（工作线程）
+    m_thumbnailEngine = new ThumbnailEngine(this);
+    connect(m_thumbnailEngine, &ThumbnailEngine::frameReady, this, &MediaEngine::onThumbnailReady);
+
+    // 本地视频加载完成后在后台生成进度条预览图集和关键帧索引
+    m_trickplay = new TrickplayGenerator(this);
+    m_keyframeIndexer = new KeyframeIndexer(this);
+    connect(m_keyframeIndexer, &KeyframeIndexer::indexReady, this, [this]() {
+        m_thumbnailEngine->setKeyframeIndex(m_keyframeIndexer->index());
+        m_trickplay->setKeyframeIndex(m_keyframeIndexer->index());
+        m_player->setKeyframeIndex(m_keyframeIndexer->index());
+        m_stepper->setKeyframeIndex(m_keyframeIndexer->index());
+        emit keyframeIndexChanged();
+    });
+
+    // 逐帧浏览时由FrameStepper直接向videoSink送帧
+    m_stepper = new FrameStepper(this);
+    connect(m_stepper, &FrameStepper::positionChanged, this, &MediaEngine::positionChanged);
+    connect(m_stepper, &FrameStepper::positionChanged, this, &MediaEngine::updateSubtitleState);
+    connect(m_stepper, &FrameStepper::reverseChanged, this, &MediaEngine::reversePlaybackChanged);
 
     m_timedPause = new QTimer(this);
     m_pauseCountdown = new QTimer(this);
     m_pauseCountdown->setInterval(1000);
 
-    connect(m_player, &QMediaPlayer::playbackStateChanged, this, &MediaEngine::playingChanged);
-    connect(m_player, &QMediaPlayer::positionChanged, this, &MediaEngine::positionChanged);
-    connect(m_player, &QMediaPlayer::durationChanged, this, &MediaEngine::durationChanged);
-    connect(m_player, &QMediaPlayer::mediaStatusChanged, this, [this](QMediaPlayer::MediaStatus status) {
-        emit mediaStatusChanged(static_cast<int>(status));
-    });
-    connect(m_player, &QMediaPlayer::errorOccurred, this, [this](QMediaPlayer::Error error, const QString &errorString) {
-        emit errorOccurred(static_cast<int>(error), errorString);
-    });
+    // 自研管线的统计和打开的性能遥测每500ms刷新一次
+    m_statsTimer = new QTimer(this);
+    m_statsTimer->setInterval(500);
+    connect(m_statsTimer, &QTimer::timeout, this, &MediaEngine::onStatsTimeout);
 
-    // 音量变化连接
-    connect(m_audioOutput, &QAudioOutput::volumeChanged, this, &MediaEngine::volumeChanged);
+    m_telemetry = new PlaybackTelemetry(this);
+    connect(m_telemetry, &PlaybackTelemetry::enabledChanged, this, &MediaEngine::updateStatsTimer);
 
-    // 音视频播放位置改变,字幕改变
-    connect(m_player, &QMediaPlayer::positionChanged, this, &MediaEngine::updateSubtitleState);
+    // 解码配置修改后立即生效
+    m_decodeProfile = new DecodeProfile(this);
+    connect(m_decodeProfile, &DecodeProfile::changed, this, &MediaEngine::applyDecodeProfile);
 
-    // 连接播放速率信号
-    connect(m_player, &QMediaPlayer::playbackRateChanged, this, &MediaEngine::playbackRateChanged);
+    // 续播位置在内存中合并，由ResumeStore定期在后台落盘；历史列表显示的位置也从这里读取
+    m_resumeStore = &ResumeStore::instance();
+    m_resumeTimer = new QTimer(this);
+    m_resumeTimer->setInterval(kResumeInterval);
+    connect(m_resumeTimer, &QTimer::timeout, this, &MediaEngine::saveResumePosition);
 
-    // 检查视频是否结束
-    connect(m_player, &QMediaPlayer::positionChanged, this, [this](qint64 position) {
-        if (position > 0 && position == m_player->duration()) { setPlaybackFinished(true); }
-    });
+    connectBackend();
+    applyDecodeProfile();
+
+    QSettings settings(kSettingsOrganization, QCoreApplication::applicationName());
+    m_resumePlayback = settings.value("playback/resume", m_resumePlayback).toBool();
+    m_preloadSeconds = qBound(0, settings.value("playback/preloadSeconds", m_preloadSeconds).toInt(), 60);
+    m_frameCacheBudget = qBound(64, settings.value("stepping/cacheBudget", m_frameCacheBudget).toInt(), 8192);
+    m_stepper->setMemoryBudget(qint64(m_frameCacheBudget) * 1024 * 1024);
+
+    // 音量变化连接
+    connect(m_audioOutput, &QAudioOutput::volumeChanged, this, &MediaEngine::volumeChanged);
 
     // 到设定的时间暂停
     connect(m_timedPause, &QTimer::timeout, this, [this]() {
@@ -87,6 +128,163 @@ MediaEngine::MediaEngine(QObject *parent)
     connect(m_pauseCountdown, &QTimer::timeout, this, &MediaEngine::updatePauseTimeRemaining);
 }
 
+MediaEngine::~MediaEngine()
+{
+    saveResumePosition();
+}
+
+void MediaEngine::connectBackend()
+{
+    connect(m_player, &PlayerBackend::mediaStatusChanged, this, [this](QMediaPlayer::MediaStatus status) {
+        if (status == QMediaPlayer::LoadedMedia && m_player->hasVideo() && isLocal()) {
+            m_trickplay->start(m_player->source().toLocalFile(), m_player->duration());
+            m_keyframeIndexer->start(m_player->source().toLocalFile());
+        }
+    });
+
+    connect(m_player, &PlayerBackend::playbackStateChanged, this, &MediaEngine::playingChanged);
+    connect(m_player, &PlayerBackend::playbackStateChanged, this, [this](QMediaPlayer::PlaybackState state) {
+        if (state == QMediaPlayer::PlayingState) {
+            m_resumeTimer->start();
+            return;
+        }
+        m_resumeTimer->stop();
+        saveResumePosition();
+    });
+    connect(m_player, &PlayerBackend::positionChanged, this, &MediaEngine::positionChanged);
+    connect(m_player, &PlayerBackend::durationChanged, this, &MediaEngine::durationChanged);
+    connect(m_player, &PlayerBackend::mediaStatusChanged, this, [this](QMediaPlayer::MediaStatus status) {
+        emit mediaStatusChanged(static_cast<int>(status));
+    });
+    connect(m_player, &PlayerBackend::errorOccurred, this, [this](QMediaPlayer::Error error, const QString &errorString) {
+        emit errorOccurred(static_cast<int>(error), errorString);
+    });
+
+    // 音视频播放位置改变,字幕改变
+    connect(m_player, &PlayerBackend::positionChanged, this, &MediaEngine::updateSubtitleState);
+
+    // 连接播放速率信号
+    connect(m_player, &PlayerBackend::playbackRateChanged, this, &MediaEngine::playbackRateChanged);
+
+    // 临近结束时预先打开下一个媒体，检查视频是否结束
+    connect(m_player, &PlayerBackend::positionChanged, this, [this](qint64 position) {
+        checkPreload(position);
+        if (position > 0 && position == m_player->duration()) { onMediaEnded(); }
+    });
+}
+
+PlayerBackend *MediaEngine::createBackend(Backend backend)
+{
+    if (backend == FFmpegPipeline) return new FFmpegBackend(this);
+    return new QtPlayerBackend(this);
+}
+
+MediaEngine::Backend MediaEngine::backend() const
+{
+    return m_backend;
+}
+
+void MediaEngine::setBackend(Backend backend)
+{
+    if (backend == m_backend) return;
+
+    // 切换后端时保留当前媒体、进度和播放状态
+    QUrl source = m_player->source();
+    qint64 position = this->position();
+    bool playing = isPlaying();
+    qreal rate = m_player->playbackRate();
+
+    leaveStepMode();
+    discardNextMedia();
+    m_nextRequested = false;
+    m_player->disconnect(this);
+    m_player->setVideoSink(nullptr);
+    delete m_player;
+
+    m_backend = backend;
+    m_player = createBackend(backend);
+    updateStatsTimer();
+    m_player->setAudioOutput(m_audioOutput);
+    m_player->setVideoSink(m_videoSink);
+    m_player->setPlaybackRate(rate);
+    m_player->setDecodeSettings(m_decodeProfile->playbackSettings(m_smallWindow));
+    connectBackend();
+
+    if (!source.isEmpty()) {
+        m_player->setSource(source);
+        m_player->setKeyframeIndex(m_keyframeIndexer->index());
+        m_player->setPosition(position);
+        if (playing) m_player->play();
+    }
+
+    emit backendChanged();
+    emit pipelineStatsChanged();
+    emit playingChanged();
+    emit playbackRateChanged();
+}
+
+QVariantMap MediaEngine::pipelineStats() const
+{
+    QVariantMap stats = m_player->stats();
+    stats.insert(m_stepper->stats());
+    return stats;
+}
+
+DecodeProfile *MediaEngine::decodeProfile() const
+{
+    return m_decodeProfile;
+}
+
+PlaybackTelemetry *MediaEngine::telemetry() const
+{
+    return m_telemetry;
+}
+
+void MediaEngine::updateStatsTimer()
+{
+    if (m_backend == FFmpegPipeline || m_telemetry->enabled()) {
+        m_statsTimer->start();
+    } else {
+        m_statsTimer->stop();
+    }
+}
+
+void MediaEngine::onStatsTimeout()
+{
+    if (m_backend == FFmpegPipeline) emit pipelineStatsChanged();
+    if (!m_telemetry->enabled()) return;
+
+    QVariantMap stats = pipelineStats();
+    stats["backend"] = m_backend == FFmpegPipeline ? "ffmpeg" : "qtmultimedia";
+    stats["media"] = m_player->source().toString();
+    stats["position"] = position();
+    stats["playbackRate"] = m_player->playbackRate();
+    m_telemetry->sample(stats);
+}
+
+bool MediaEngine::smallWindow() const
+{
+    return m_smallWindow;
+}
+
+void MediaEngine::setSmallWindow(bool smallWindow)
+{
+    if (m_smallWindow == smallWindow) return;
+    m_smallWindow = smallWindow;
+    m_player->setDecodeSettings(m_decodeProfile->playbackSettings(m_smallWindow));
+    if (m_nextPlayer) m_nextPlayer->setDecodeSettings(m_decodeProfile->playbackSettings(m_smallWindow));
+    emit smallWindowChanged();
+}
+
+void MediaEngine::applyDecodeProfile()
+{
+    m_player->setDecodeSettings(m_decodeProfile->playbackSettings(m_smallWindow));
+    if (m_nextPlayer) m_nextPlayer->setDecodeSettings(m_decodeProfile->playbackSettings(m_smallWindow));
+    m_stepper->setDecodeSettings(m_decodeProfile->playbackSettings(false));
+    m_thumbnailEngine->setDecodeSettings(m_decodeProfile->previewSettings());
+    m_trickplay->setDecodeSettings(m_decodeProfile->previewSettings());
+}
+
 QVideoSink *MediaEngine::videoSink() const
 {
     return m_videoSink;
@@ -95,8 +293,17 @@ QVideoSink *MediaEngine::videoSink() const
 void MediaEngine::setVideoSink(QVideoSink *sink)
 {
     if (m_videoSink != sink) {
+        // 以画面实际收到的帧计数，两种后端通用
+        if (m_videoSink) disconnect(m_videoSink, &QVideoSink::videoFrameChanged, m_telemetry, nullptr);
         m_videoSink = sink;
-        m_player->setVideoOutput(sink);
+        if (sink) {
+            PlaybackTelemetry *telemetry = m_telemetry;
+            connect(sink, &QVideoSink::videoFrameChanged, m_telemetry, [telemetry]() {
+                telemetry->frameRendered();
+            }, Qt::DirectConnection);
+        }
+        m_stepper->setVideoSink(sink);
+        if (!m_stepper->isActive()) m_player->setVideoSink(sink);
         emit videoSinkChanged();
     }
 }
@@ -108,6 +315,7 @@ bool MediaEngine::isPlaying() const
 
 qint64 MediaEngine::position() const
 {
+    if (m_stepper->isActive()) return m_stepper->position();
     return m_player->position();
 }
 
@@ -158,38 +366,179 @@ QUrl MediaEngine::currentMedia() const
 
 void MediaEngine::play()
 {
+    leaveStepMode();
     m_player->play();
 }
 
 void MediaEngine::pause()
 {
+    m_stepper->setReverse(false);
     m_player->pause();
     emit videoPause();
 }
 
 void MediaEngine::stop()
 {
+    saveResumePosition();
+    leaveStepMode();
     m_player->stop();
 }
 
 void MediaEngine::setPosition(qint64 position)
 {
+    leaveStepMode();
     m_player->setPosition(position);
 }
 
-void MediaEngine::setMedia(const QUrl &url)
+void MediaEngine::stepForward()
+{
+    if (enterStepMode()) m_stepper->stepForward();
+}
+
+void MediaEngine::stepBackward()
+{
+    if (enterStepMode()) m_stepper->stepBackward();
+}
+
+bool MediaEngine::stepping() const
+{
+    return m_stepper->isActive();
+}
+
+bool MediaEngine::reversePlayback() const
+{
+    return m_stepper->isReverse();
+}
+
+void MediaEngine::setReversePlayback(bool reverse)
+{
+    if (reverse == m_stepper->isReverse()) return;
+    if (!reverse) {
+        m_stepper->setReverse(false);
+        return;
+    }
+    if (enterStepMode()) m_stepper->setReverse(true, m_player->playbackRate());
+}
+
+int MediaEngine::frameCacheBudget() const
+{
+    return m_frameCacheBudget;
+}
+
+void MediaEngine::setFrameCacheBudget(int megabytes)
+{
+    megabytes = qBound(64, megabytes, 8192);
+    if (m_frameCacheBudget == megabytes) return;
+    m_frameCacheBudget = megabytes;
+    m_stepper->setMemoryBudget(qint64(megabytes) * 1024 * 1024);
+
+    QSettings settings(kSettingsOrganization, QCoreApplication::applicationName());
+    settings.setValue("stepping/cacheBudget", megabytes);
+    emit frameCacheBudgetChanged();
+}
+
+bool MediaEngine::resumePlayback() const
+{
+    return m_resumePlayback;
+}
+
+void MediaEngine::setResumePlayback(bool resume)
+{
+    if (m_resumePlayback == resume) return;
+    m_resumePlayback = resume;
+    if (!resume) m_resumeKey.clear();
+
+    QSettings settings(kSettingsOrganization, QCoreApplication::applicationName());
+    settings.setValue("playback/resume", resume);
+    emit resumePlaybackChanged();
+}
+
+void MediaEngine::saveResumePosition()
+{
+    // 停止后位置已经归零，由stop()在停止前记录
+    if (m_resumeKey.isEmpty() || m_player->playbackState() == QMediaPlayer::StoppedState) return;
+    const qint64 duration = m_player->duration();
+    if (duration <= 0) return; // 还没打开完成
+    const qint64 position = this->position();
+
+    if (duration < kResumeMinDuration || position < kResumeMargin || position > duration - kResumeMargin) {
+        m_resumeStore->remove(m_resumeKey);
+    } else {
+        m_resumeStore->setPosition(m_resumeKey, position);
+    }
+}
+
+void MediaEngine::restoreResumePosition(const QUrl &url)
+{
+    m_resumeKey = m_resumePlayback ? ResumeStore::keyFor(url) : QByteArray();
+    if (m_resumeKey.isEmpty()) return;
+    // 在play()之前跳转，后端从这个位置开始解码，不会先呈现开头的画面
+    const qint64 position = m_resumeStore->position(m_resumeKey);
+    if (position > 0) m_player->setPosition(position);
+}
+
+bool MediaEngine::enterStepMode()
+{
+    if (m_stepper->isActive()) return true;
+    if (!m_player->hasVideo() || !isLocal()) return false;
+
+    // 直接暂停播放后端，不发出videoPause
+    m_player->pause();
+    m_player->setVideoSink(nullptr);
+    m_stepper->begin(m_player->position());
+    emit steppingChanged();
+    return true;
+}
+
+void MediaEngine::leaveStepMode()
+{
+    if (!m_stepper->isActive()) return;
+    qint64 position = m_stepper->position();
+    m_stepper->end();
+    m_player->setVideoSink(m_videoSink);
+    m_player->setPosition(position);
+    emit steppingChanged();
+}
+
+void MediaEngine::resetMedia()
 {
     m_subtitles.clear();
     m_hasSubtitle = false;
     m_subtitleText = "";
-    m_coverArtBase64 = "";
+    FrameCache::instance().removeMedia(m_player->source()); // 释放上一个媒体的缩略图和封面
+    m_coverArtSource = "";
     emit coverImageChanged();
     emit hasSubtitleChanged();
     emit subtitleTextChanged();
 
+    m_trickplay->stop();
+    m_keyframeIndexer->stop();
+    emit keyframeIndexChanged();
+    m_telemetry->reset();
+}
+
+void MediaEngine::setMedia(const QUrl &url)
+{
+    // 无缝切换后播放列表跟着切换到同一项，此时媒体已经在播放
+    if (!url.isEmpty() && url == m_switchedMedia) {
+        m_switchedMedia.clear();
+        return;
+    }
+    m_switchedMedia.clear();
+    discardNextMedia();
+    m_nextRequested = false;
+    leaveStepMode();
+    saveResumePosition(); // 切走之前记下上一个媒体的位置
+
+    resetMedia();
     m_player->setSource(url);
+    restoreResumePosition(url);
     emit currentMediaChanged();
 
+    // 缩略图解码器和逐帧缓存只服务本地文件
+    m_thumbnailEngine->setMedia(url.isLocalFile() ? url.toLocalFile() : QString());
+    m_stepper->setMedia(url.isLocalFile() ? url.toLocalFile() : QString());
+
     if (url.isEmpty()) return;
 
     bool wasLocal = m_islocal;
@@ -219,6 +568,24 @@ void MediaEngine::loadSubtitle(const QUrl &mediaUrl)
     emit hasSubtitleChanged();
     emit subtitleTextChanged();
 
+    applySubtitles(readSubtitles(mediaUrl));
+}
+
+void MediaEngine::applySubtitles(const SubtitleMap &subtitles)
+{
+    m_subtitles = subtitles;
+    m_subtitleText = "";
+    m_hasSubtitle = !m_subtitles.isEmpty();
+    if (m_hasSubtitle && !m_userMutedSubtitle) { m_subtitleVisible = true; }
+
+    emit hasSubtitleChanged();
+    emit subtitleVisibleChanged();
+    emit subtitleTextChanged();
+}
+
+MediaEngine::SubtitleMap MediaEngine::readSubtitles(const QUrl &mediaUrl)
+{
+    SubtitleMap subtitles;
     QString mediaPath = mediaUrl.toLocalFile();
     QFileInfo mediaFileInfo(mediaPath);
     QString baseName = mediaFileInfo.completeBaseName();
@@ -233,25 +600,17 @@ void MediaEngine::loadSubtitle(const QUrl &mediaUrl)
         if (!files.isEmpty()) {
             QString subtitlePath = path + "/" + files.first();
             if (ext == ".lrc") {
-                parseLrcFile(subtitlePath);
+                parseLrcFile(subtitlePath, subtitles);
             } else {
-                parseSrtFile(subtitlePath);
+                parseSrtFile(subtitlePath, subtitles);
             }
             break;
         }
     }
-
-    if (!m_subtitles.isEmpty()) {
-        m_hasSubtitle = true;
-        if (!m_userMutedSubtitle) { m_subtitleVisible = true; }
-    }
-
-    emit hasSubtitleChanged();
-    emit subtitleVisibleChanged();
-    emit subtitleTextChanged();
+    return subtitles;
 }
 
-void MediaEngine::parseLrcFile(const QString &filePath)
+void MediaEngine::parseLrcFile(const QString &filePath, SubtitleMap &subtitles)
 {
     QFile file(filePath);
     if (!file.open(QIODevice::ReadOnly | QIODevice::Text)) {
@@ -310,11 +669,11 @@ void MediaEngine::parseLrcFile(const QString &filePath)
         qint64 endTime = (i < tempSubtitles.size() - 1) ? tempSubtitles[i + 1].first
                                                         : tempSubtitles[i].first + 5000; // 默认5秒
 
-        m_subtitles.insert(tempSubtitles[i].first, QPair<qint64, QString>(endTime, tempSubtitles[i].second));
+        subtitles.insert(tempSubtitles[i].first, QPair<qint64, QString>(endTime, tempSubtitles[i].second));
     }
 }
 
-void MediaEngine::parseSrtFile(const QString &filePath)
+void MediaEngine::parseSrtFile(const QString &filePath, SubtitleMap &subtitles)
 {
     QFile file(filePath);
     if (!file.open(QIODevice::ReadOnly | QIODevice::Text)) {
@@ -375,7 +734,7 @@ void MediaEngine::parseSrtFile(const QString &filePath)
             text += line;
         }
 
-        if (!text.isEmpty()) { m_subtitles.insert(startTime, QPair<qint64, QString>(endTime, text)); }
+        if (!text.isEmpty()) { subtitles.insert(startTime, QPair<qint64, QString>(endTime, text)); }
     }
 
     file.close();
@@ -458,16 +817,16 @@ qreal MediaEngine::playbackRate() const
 
 void MediaEngine::setPlaybackRate(qreal rate)
 {
+    if (m_stepper->isReverse()) m_stepper->setReverse(true, rate);
     m_player->setPlaybackRate(rate);
     emit playbackRateChanged();
 }
 
 qreal MediaEngine::videoAspectRatio() const
 {
-    if (m_player->videoOutput()) {
-        QVideoSink videoSink = m_player->videoOutput();
-        QSize size = videoSink.videoSize();
-        if (size.isValid()) return qreal(size.width() / size.height());
+    if (m_videoSink) {
+        QSize size = m_videoSink->videoSize();
+        if (size.isValid() && size.height() > 0) return qreal(size.width()) / size.height();
     }
     return 0;
 }
@@ -504,52 +863,39 @@ void MediaEngine::setPlaybackFinished(bool finished)
     }
 }
 
-QString MediaEngine::getFrameAtPosition(qint64 position)
+void MediaEngine::requestFrameAtPosition(qint64 position)
 {
-    if (!m_player->hasVideo()) return ""; // 检查是否有视频流
-    if (!isLocal()) return "";            // 检查是否是本地视频
-
-    // 设置缩略图播放器的源
-    m_thumbnailPlayer->setSource(m_player->source());
-
-    QEventLoop loop;
-    QTimer::singleShot(100, &loop, &QEventLoop::quit); // 超时保护，防止等待帧的时间过长而导致界面卡死
-    QObject::connect(m_thumbnailSink, &QVideoSink::videoFrameChanged, &loop, &QEventLoop::quit); // 连接信号以等待帧可用
-    m_thumbnailPlayer->setPosition(position);
-    m_thumbnailPlayer->play();
-    loop.exec(QEventLoop::ExcludeUserInputEvents); // 非阻塞式等待
-    QObject::disconnect(m_thumbnailSink, &QVideoSink::videoFrameChanged, &loop, &QEventLoop::quit);
-    QVideoFrame frame = m_thumbnailSink->videoFrame(); // 读取当前帧
-    m_thumbnailPlayer->pause();
-
-    if (!frame.isValid()) {
-        m_thumbnailPlayer->setSource(QUrl());
-        return "";
-    }
-
-    // 确保帧已映射
-    if (!frame.map(QVideoFrame::ReadOnly)) {
-        m_thumbnailPlayer->setSource(QUrl());
-        return "";
-    }
-
-    QImage image = frame.toImage(); // 转换为图像
-    frame.unmap();
-    if (image.isNull()) {
-        m_thumbnailPlayer->setSource(QUrl());
-        return "";
+    if (!m_player->hasVideo()) return; // 检查是否有视频流
+    if (!isLocal()) return;            // 检查是否是本地视频
+
+    // 同一GOP内的位置解码出的都是同一个关键帧，有索引时直接复用已缓存的结果
+    qint64 keyframe = keyframeBefore(position);
+    if (keyframe >= 0) {
+        position = keyframe;
+        QString id = FrameCache::frameId(m_player->source(), position);
+        if (FrameCache::instance().contains(id)) {
+            m_thumbnailEngine->cancel();
+            emit frameAtPositionReady(position, FrameCache::source(id));
+            return;
+        }
     }
 
-    // 转换为Base64字符串
-    QByteArray byteArray;
-    QBuffer buffer(&byteArray);
-    buffer.open(QIODevice::WriteOnly);
-    if (!image.save(&buffer, "JPEG")) {
-        m_thumbnailPlayer->setSource(QUrl());
-        return "";
+    // 优先使用已生成的预览图集，只有未覆盖的位置才需要解码
+    QImage tile = m_trickplay->tileAt(position);
+    if (!tile.isNull()) {
+        m_thumbnailEngine->cancel();
+        onThumbnailReady(position, tile.copy()); // 图块引用内存映射，缓存中需保存独立副本
+        return;
     }
+    m_thumbnailEngine->requestFrame(position);
+}
 
-    return "data:image/jpeg;base64," + byteArray.toBase64();
+void MediaEngine::onThumbnailReady(qint64 position, const QImage &image)
+{
+    // 放入帧缓存，QML通过image://frames/<media>/<ms>直接取用
+    QString id = FrameCache::frameId(m_player->source(), position);
+    FrameCache::instance().insert(id, image);
+    emit frameAtPositionReady(position, FrameCache::source(id));
 }
 
 void MediaEngine::timedPauseStart(int minutes)
@@ -578,66 +924,196 @@ int MediaEngine::pauseTimeRemaining() const
     return m_pauseTimeRemaining;
 }
 
-QString MediaEngine::coverArtBase64() const
+QVariantMap MediaEngine::keyframeIndexStats() const
+{
+    if (!m_keyframeIndexer->index()) return QVariantMap();
+    return m_keyframeIndexer->stats().toVariantMap();
+}
+
+qint64 MediaEngine::keyframeBefore(qint64 position) const
+{
+    std::shared_ptr<const KeyframeIndex> index = m_keyframeIndexer->index();
+    return index ? index->keyframeBefore(position) : -1;
+}
+
+qint64 MediaEngine::keyframeAfter(qint64 position) const
 {
-    return m_coverArtBase64;
+    std::shared_ptr<const KeyframeIndex> index = m_keyframeIndexer->index();
+    return index ? index->keyframeAfter(position) : -1;
+}
+
+QString MediaEngine::coverArtSource() const
+{
+    return m_coverArtSource;
 }
 
 bool MediaEngine::isAudioFile(const QUrl &url)
 {
-    QStringList audioExts = {".mp3", ".wav", ".ogg", ".flac", ".m4a", ".aac"};
-    QString path = url.toLocalFile();
-    for (const QString &ext : audioExts) {
-        if (path.endsWith(ext, Qt::CaseInsensitive)) return true;
-    }
-    return false;
+    const QString filePath = url.toLocalFile();
+    if (filePath.isEmpty()) return false;
+    if (MediaSniffer::isAudioSuffix(filePath)) return true;
+    return MediaSniffer::instance().sniff(filePath).audio; //扩展名错误或没有扩展名的音频文件
 }
 
 void MediaEngine::extractCoverArt(const QUrl &mediaUrl)
 {
-    QString mediaPath = mediaUrl.toLocalFile();
-    if (mediaPath.isEmpty()) return;
+    if (!mediaUrl.isLocalFile()) return;
+    applyCoverArt(mediaUrl, readCoverArt(mediaUrl));
+}
 
-    // 使用FFmpeg提取封面
-    AVFormatContext *fmt_ctx = NULL;
-    if (avformat_open_input(&fmt_ctx, mediaPath.toUtf8().constData(), NULL, NULL) < 0) {
-        qWarning() << "Failed to open file for cover art extraction";
-        return;
+void MediaEngine::applyCoverArt(const QUrl &mediaUrl, const QImage &image)
+{
+    if (image.isNull()) {
+        m_coverArtSource = ""; // 如果没有找到封面，确保设置为空字符串
+    } else {
+        // 放入帧缓存，避免PNG重新编码和base64字符串拷贝
+        QString id = FrameCache::coverId(mediaUrl);
+        FrameCache::instance().insert(id, image);
+        m_coverArtSource = FrameCache::source(id);
     }
+    emit coverImageChanged();
+}
 
-    if (avformat_find_stream_info(fmt_ctx, NULL) < 0) {
-        qWarning() << "Failed to find stream information";
-        avformat_close_input(&fmt_ctx);
-        return;
+QImage MediaEngine::readCoverArt(const QUrl &mediaUrl)
+{
+    QString mediaPath = mediaUrl.toLocalFile();
+    if (mediaPath.isEmpty()) return QImage();
+
+    // 封面和播放列表标题来自同一次探测，已知文件不再打开
+    return MediaProbe::instance().probe(mediaPath).coverImage();
+}
+
+int MediaEngine::preloadSeconds() const
+{
+    return m_preloadSeconds;
+}
+
+void MediaEngine::setPreloadSeconds(int seconds)
+{
+    seconds = qBound(0, seconds, 60);
+    if (m_preloadSeconds == seconds) return;
+    m_preloadSeconds = seconds;
+    if (seconds == 0) discardNextMedia();
+
+    QSettings settings(kSettingsOrganization, QCoreApplication::applicationName());
+    settings.setValue("playback/preloadSeconds", seconds);
+    emit preloadSecondsChanged();
+}
+
+void MediaEngine::checkPreload(qint64 position)
+{
+    if (m_nextRequested || m_preloadSeconds <= 0 || m_playbackMode == Loop) return;
+    qint64 duration = m_player->duration();
+    if (duration <= 0 || !isPlaying() || duration - position > m_preloadSeconds * 1000) return;
+
+    m_nextRequested = true;
+    emit nextMediaRequested();
+}
+
+void MediaEngine::setNextMedia(const QUrl &url)
+{
+    discardNextMedia();
+    if (url.isEmpty() || m_preloadSeconds <= 0) return;
+
+    // 第二个后端不接音视频输出，只完成打开、探测和首帧解码
+    m_nextPlayer = createBackend(m_backend);
+    m_nextPlayer->setDecodeSettings(m_decodeProfile->playbackSettings(m_smallWindow));
+    m_nextPlayer->setSource(url);
+    m_nextMedia.url = url;
+
+    // 字幕查找和封面提取需要读盘，放到后台完成
+    const quint64 generation = m_nextGeneration;
+    QPointer<MediaEngine> self(this);
+    QThreadPool::globalInstance()->start([=]() {
+        PreparedMedia prepared;
+        prepared.url = url;
+        if (url.isLocalFile()) prepared.subtitles = readSubtitles(url);
+        if (isAudioFile(url)) prepared.coverArt = readCoverArt(url);
+        prepared.ready = true;
+        QMetaObject::invokeMethod(
+            self, [self, generation, prepared]() {
+                if (self) self->onNextMediaPrepared(generation, prepared);
+            }, Qt::QueuedConnection);
+    });
+}
+
+void MediaEngine::onNextMediaPrepared(quint64 generation, const PreparedMedia &prepared)
+{
+    if (generation != m_nextGeneration || prepared.url != m_nextMedia.url) return;
+    m_nextMedia = prepared;
+}
+
+void MediaEngine::discardNextMedia()
+{
+    ++m_nextGeneration;
+    m_nextMedia = PreparedMedia();
+    if (!m_nextPlayer) return;
+    delete m_nextPlayer;
+    m_nextPlayer = nullptr;
+}
+
+void MediaEngine::onMediaEnded()
+{
+    if (!m_resumeKey.isEmpty()) m_resumeStore->remove(m_resumeKey); // 已经播完，下次从头播放
+    // 顺序和随机播放时先切到预先打开的媒体，播放列表随后调用setMedia时不再重新打开
+    if (m_playbackMode != Loop && switchToNextMedia()) m_switchedMedia = m_player->source();
+    setPlaybackFinished(true);
+}
+
+bool MediaEngine::switchToNextMedia()
+{
+    if (!m_nextPlayer) return false;
+    QMediaPlayer::MediaStatus status = m_nextPlayer->mediaStatus();
+    if (status != QMediaPlayer::LoadedMedia && status != QMediaPlayer::BufferedMedia) {
+        discardNextMedia(); // 还没打开完成，按原来的方式重新打开
+        return false;
     }
 
-    // 查找封面数据
-    bool coverFound = false;
-    for (unsigned int i = 0; i < fmt_ctx->nb_streams; i++) {
-        AVStream *stream = fmt_ctx->streams[i];
-        if (stream->disposition & AV_DISPOSITION_ATTACHED_PIC) {
-            // 找到封面数据
-            AVPacket cover = stream->attached_pic;
-            QImage image;
-            if (image.loadFromData(cover.data, cover.size)) {
-                // 转换为base64
-                QByteArray byteArray;
-                QBuffer buffer(&byteArray);
-                buffer.open(QIODevice::WriteOnly);
-                if (image.save(&buffer, "PNG")) {
-                    m_coverArtBase64 = QString::fromLatin1(byteArray.toBase64().data());
-                    coverFound = true;
-                }
-            }
-            break;
+    // 仍处于旧后端的positionChanged中，延后释放
+    qreal rate = m_player->playbackRate();
+    m_player->disconnect(this);
+    m_player->setVideoSink(nullptr);
+    m_player->setAudioOutput(nullptr);
+    resetMedia();
+    m_player->deleteLater();
+
+    m_player = m_nextPlayer;
+    m_nextPlayer = nullptr;
+    PreparedMedia prepared = m_nextMedia;
+    discardNextMedia();
+    m_nextRequested = false;
+
+    m_player->setAudioOutput(m_audioOutput);
+    m_player->setVideoSink(m_videoSink);
+    m_player->setPlaybackRate(rate);
+    connectBackend();
+    const QUrl url = m_player->source();
+    restoreResumePosition(url);
+    m_player->play();
+
+    m_thumbnailEngine->setMedia(url.isLocalFile() ? url.toLocalFile() : QString());
+    m_stepper->setMedia(url.isLocalFile() ? url.toLocalFile() : QString());
+    if (url.isLocalFile()) {
+        // 后台还没读完时在这里同步读取
+        applySubtitles(prepared.ready ? prepared.subtitles : readSubtitles(url));
+        if (isAudioFile(url)) applyCoverArt(url, prepared.ready ? prepared.coverArt : readCoverArt(url));
+        // LoadedMedia在预先打开时已经发出
+        if (m_player->hasVideo()) {
+            m_trickplay->start(url.toLocalFile(), m_player->duration());
+            m_keyframeIndexer->start(url.toLocalFile());
         }
     }
 
-    // 如果没有找到封面，确保设置为空字符串
-    if (!coverFound) { m_coverArtBase64 = ""; }
+    bool wasLocal = m_islocal;
+    m_islocal = url.isLocalFile();
+    if (m_islocal != wasLocal) emit localChanged();
 
-    avformat_close_input(&fmt_ctx);
-    emit coverImageChanged();
+    emit currentMediaChanged();
+    emit durationChanged();
+    emit positionChanged();
+    emit playingChanged();
+    emit subtitleVisibleChanged();
+    return true;
 }
 
 QString MediaEngine::pauseCountdown()
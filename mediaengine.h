@@ -8,6 +8,16 @@
 #include <QVideoSink>
 #include <QMap>
 #include <QPair>
+#include <QImage>
+
+#include "thumbnailengine.h"
+#include "trickplay.h"
+#include "keyframeindex.h"
+#include "playerbackend.h"
+#include "decodeprofile.h"
+#include "framestepper.h"
+#include "playbacktelemetry.h"
+#include "resumestore.h"
 
 class MediaEngine : public QObject
 {
@@ -37,10 +47,22 @@ class MediaEngine : public QObject
 
     Q_PROPERTY(bool isLocal READ isLocal NOTIFY localChanged)
     Q_PROPERTY(int pauseTimeRemaining READ pauseTimeRemaining NOTIFY pauseTimeRemainingChanged) // 定时暂停倒计时
-    Q_PROPERTY(QString coverArtBase64 READ coverArtBase64 NOTIFY coverImageChanged)             // 封面图片的base64数据
+    Q_PROPERTY(QString coverArtSource READ coverArtSource NOTIFY coverImageChanged)             // 封面图片的image://frames地址
+    Q_PROPERTY(QVariantMap keyframeIndexStats READ keyframeIndexStats NOTIFY keyframeIndexChanged) // 关键帧索引构建统计
+    Q_PROPERTY(Backend backend READ backend WRITE setBackend NOTIFY backendChanged)                 // 播放后端
+    Q_PROPERTY(QVariantMap pipelineStats READ pipelineStats NOTIFY pipelineStatsChanged)           // 解码管线队列深度和延迟
+    Q_PROPERTY(DecodeProfile *decodeProfile READ decodeProfile CONSTANT)                            // 解码性能配置
+    Q_PROPERTY(PlaybackTelemetry *telemetry READ telemetry CONSTANT)                                // 播放性能遥测
+    Q_PROPERTY(bool smallWindow READ smallWindow WRITE setSmallWindow NOTIFY smallWindowChanged)    // 小窗播放时使用低分辨率解码
+    Q_PROPERTY(int preloadSeconds READ preloadSeconds WRITE setPreloadSeconds NOTIFY preloadSecondsChanged) // 结束前多少秒预先打开下一个媒体，0为关闭
+    Q_PROPERTY(bool stepping READ stepping NOTIFY steppingChanged) // 是否处于逐帧浏览
+    Q_PROPERTY(bool reversePlayback READ reversePlayback WRITE setReversePlayback NOTIFY reversePlaybackChanged) // 倒放
+    Q_PROPERTY(int frameCacheBudget READ frameCacheBudget WRITE setFrameCacheBudget NOTIFY frameCacheBudgetChanged) // 逐帧缓存上限，单位MB
+    Q_PROPERTY(bool resumePlayback READ resumePlayback WRITE setResumePlayback NOTIFY resumePlaybackChanged) // 重新打开时从上次停止的位置继续
 
 public:
     explicit MediaEngine(QObject *parent = nullptr);
+    ~MediaEngine() override;
 
     enum PlaybackMode {
         Sequential, // 顺序播放
@@ -49,6 +71,12 @@ public:
     };
     Q_ENUM(PlaybackMode)
 
+    enum Backend {
+        QtMultimedia,  // QMediaPlayer
+        FFmpegPipeline // 自研FFmpeg解码管线
+    };
+    Q_ENUM(Backend)
+
     QVideoSink *videoSink() const;
     bool isPlaying() const;
     qint64 position() const;
@@ -67,8 +95,24 @@ public:
     PlaybackMode playbackMode() const;         // 返回视频播放模式
     bool isLocal();
     int pauseTimeRemaining() const; // 返回暂停倒计时
-    QString coverArtBase64() const; // 获取封面图片的base64数据
-    bool isAudioFile(const QUrl &url);
+    QString coverArtSource() const; // 获取封面图片的image://frames地址
+    QVariantMap keyframeIndexStats() const; // 关键帧索引的字节数、耗时、MB/s等
+    Backend backend() const;
+    QVariantMap pipelineStats() const; // 当前后端的队列深度、解码耗时、丢帧数等
+    DecodeProfile *decodeProfile() const;
+    PlaybackTelemetry *telemetry() const;
+    bool smallWindow() const;
+    void setSmallWindow(bool smallWindow);
+    int preloadSeconds() const;
+    void setPreloadSeconds(int seconds);
+    bool stepping() const;
+    bool reversePlayback() const;
+    void setReversePlayback(bool reverse);
+    int frameCacheBudget() const;
+    void setFrameCacheBudget(int megabytes);
+    bool resumePlayback() const;
+    void setResumePlayback(bool resume);
+    static bool isAudioFile(const QUrl &url); // 按内容判断，会读文件头(有缓存)
     void extractCoverArt(const QUrl &mediaUrl);
 
     Q_INVOKABLE bool playbackFinished() const; // 返回视频是否结束
@@ -76,16 +120,22 @@ public:
     Q_INVOKABLE void pause();
     Q_INVOKABLE void stop();
     Q_INVOKABLE void setPosition(qint64 position);
+    Q_INVOKABLE void stepForward();  // 暂停并显示下一帧
+    Q_INVOKABLE void stepBackward(); // 暂停并显示上一帧
     Q_INVOKABLE void setVolume(qreal volume);
     Q_INVOKABLE void setMedia(const QUrl &url);
+    Q_INVOKABLE void setNextMedia(const QUrl &url); // 预先打开下一个媒体，当前媒体结束时无缝切换
     Q_INVOKABLE void setMuted(bool muted);
     Q_INVOKABLE void setVideoSink(QVideoSink *sink);
     Q_INVOKABLE void loadSubtitle(const QUrl &mediaUrl);
     Q_INVOKABLE void setSubtitleVisible(bool visible);
     Q_INVOKABLE void setPlaybackRate(qreal rate); // 设置播放速率
     Q_INVOKABLE void setPlaybackMode(PlaybackMode mode); // 设置视频播放模式
+    Q_INVOKABLE void setBackend(Backend backend);        // 切换播放后端，保留当前媒体、进度和播放状态
     Q_INVOKABLE void setPlaybackFinished(bool finished); // 设置视频是否结束属性
-    Q_INVOKABLE QString getFrameAtPosition(qint64 position); // 返回相应位置的视频帧
+    Q_INVOKABLE void requestFrameAtPosition(qint64 position); // 异步请求相应位置的视频帧，结果由frameAtPositionReady送回
+    Q_INVOKABLE qint64 keyframeBefore(qint64 position) const; // position所在GOP的关键帧时间，索引未就绪时返回-1
+    Q_INVOKABLE qint64 keyframeAfter(qint64 position) const;  // position之后下一个关键帧的时间，索引未就绪时返回-1
     Q_INVOKABLE void timedPauseStart(int minutes); // 定时暂停开始
     Q_INVOKABLE int pauseTime();                   // 返回设置的暂停时间
     Q_INVOKABLE QString pauseCountdown();          // 以00：00：00形式返回暂停
@@ -113,15 +163,58 @@ signals:
     void timedPauseFinished();        // 定时暂停结束信号
     void coverImageChanged();         // 封面图片变化信号
     void videoPause();                // 视频暂停信号
+    void frameAtPositionReady(qint64 position, const QString &frame); // 缩略图就绪信号
+    void keyframeIndexChanged();      // 关键帧索引就绪
+    void backendChanged();            // 播放后端改变
+    void pipelineStatsChanged();      // 解码管线统计刷新
+    void smallWindowChanged();        // 小窗播放状态改变
+    void preloadSecondsChanged();     // 预加载时间改变
+    void nextMediaRequested();        // 当前媒体即将结束，需要通过setNextMedia给出下一个媒体
+    void steppingChanged();           // 进入或退出逐帧浏览
+    void reversePlaybackChanged();    // 倒放状态改变
+    void frameCacheBudgetChanged();   // 逐帧缓存上限改变
+    void resumePlaybackChanged();     // 续播开关改变
 
 private slots:
     void updatePauseTimeRemaining(); // 暂停倒计时减小
+    void onThumbnailReady(qint64 position, const QImage &image); // 缩略图解码完成
 
 private:
-    void parseLrcFile(const QString &filePath);
-    void parseSrtFile(const QString &filePath);
+    using SubtitleMap = QMap<qint64, QPair<qint64, QString>>;
+
+    // 后台预先读取的下一个媒体的字幕和封面
+    struct PreparedMedia
+    {
+        QUrl url;
+        SubtitleMap subtitles;
+        QImage coverArt;
+        bool ready = false;
+    };
+
+    static void parseLrcFile(const QString &filePath, SubtitleMap &subtitles);
+    static void parseSrtFile(const QString &filePath, SubtitleMap &subtitles);
+    static SubtitleMap readSubtitles(const QUrl &mediaUrl); // 查找并解析同名字幕文件
+    static QImage readCoverArt(const QUrl &mediaUrl);       // 读取内嵌封面，没有时返回空图
+    void applyCoverArt(const QUrl &mediaUrl, const QImage &image);
+    PlayerBackend *createBackend(Backend backend);
+    void connectBackend();      // 连接当前播放后端的信号
+    void applyDecodeProfile();  // 把解码配置下发到播放后端和预览解码器
+    void updateStatsTimer();    // 自研管线或遥测打开时才定时采样
+    void onStatsTimeout();
+    void resetMedia();          // 清除当前媒体的字幕、封面、预览图集和索引
+    void applySubtitles(const SubtitleMap &subtitles);
+    void checkPreload(qint64 position); // 临近结束时请求下一个媒体
+    void onMediaEnded();                // 当前媒体播放完毕
+    bool switchToNextMedia();           // 切换到预先打开的下一个媒体，未就绪时返回false
+    void discardNextMedia();
+    void onNextMediaPrepared(quint64 generation, const PreparedMedia &prepared);
+    bool enterStepMode(); // 暂停播放器，由FrameStepper接管画面，不能逐帧时返回false
+    void leaveStepMode(); // 把画面交还播放器并跳转到逐帧停留的位置
+    void saveResumePosition();              // 记下当前媒体的位置，开头、结尾附近和短媒体清除记录
+    void restoreResumePosition(const QUrl &url); // 在首帧呈现前跳到上次的位置
 
-    QMediaPlayer *m_player;
+    PlayerBackend *m_player;
+    Backend m_backend;
     QAudioOutput *m_audioOutput;
     QVideoSink *m_videoSink;
     qreal m_lastVolume;
@@ -129,15 +222,32 @@ private:
     QString m_subtitleText;
     bool m_hasSubtitle;
     bool m_subtitleVisible;
-    QMap<qint64, QPair<qint64, QString>> m_subtitles;
+    SubtitleMap m_subtitles;
     bool m_userMutedSubtitle;
     PlaybackMode m_playbackMode; // 视频播放模式
     bool m_playbackFinished;     // 视频是否结束
     bool m_islocal;
-    QString m_coverArtBase64; // 存储封面图片的base64数据
+    QString m_coverArtSource; // 封面图片在FrameCache中的地址
 
-    QMediaPlayer *m_thumbnailPlayer; // 缩略图专用播放器
-    QVideoSink *m_thumbnailSink;     // 缩略图专用视频接收器
+    ThumbnailEngine *m_thumbnailEngine; // 缩略图专用异步解码器
+    TrickplayGenerator *m_trickplay;    // 进度条预览图集生成器
+    KeyframeIndexer *m_keyframeIndexer; // 后台关键帧索引器
+    QTimer *m_statsTimer;               // 定时刷新解码管线统计
+    DecodeProfile *m_decodeProfile;     // 解码性能配置
+    PlaybackTelemetry *m_telemetry;     // 播放性能遥测
+    bool m_smallWindow;
+    int m_preloadSeconds;
+    bool m_nextRequested;            // 本次播放已请求过下一个媒体
+    PlayerBackend *m_nextPlayer;     // 预先打开的下一个媒体，不连接输出
+    PreparedMedia m_nextMedia;
+    quint64 m_nextGeneration;        // 丢弃过期的后台读取结果
+    QUrl m_switchedMedia;            // 无缝切换后播放列表会再调用一次setMedia，此时不必重新打开
+    FrameStepper *m_stepper;         // 逐帧浏览和倒放
+    int m_frameCacheBudget;
+    ResumeStore *m_resumeStore;      // 续播位置，全局共用一份
+    QByteArray m_resumeKey;          // 当前媒体在续播存储中的键
+    QTimer *m_resumeTimer;           // 播放中定时记录位置，不在每次positionChanged时写
+    bool m_resumePlayback;
     QTimer *m_timedPause;            // 定时暂停计时器
     int m_pauseTime;                 // 暂停时间，单位为分
     QTimer *m_pauseCountdown;        // 暂停倒计时器
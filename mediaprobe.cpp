@@ -0,0 +1,258 @@
+#include "mediaprobe.h"
+#include "mediacache.h"
+
+#include <QDataStream>
+#include <QDateTime>
+#include <QDebug>
+#include <QFile>
+#include <QMutexLocker>
+#include <QSaveFile>
+#include <QThreadPool>
+
+extern "C" {
+#include <libavformat/avformat.h>
+#include <libavcodec/avcodec.h>
+}
+
+namespace {
+constexpr quint32 kProbeMagic = 0x56504D50; // "VPMP"
+constexpr quint32 kProbeVersion = 2;                            // 2起固定QDataStream版本
+constexpr QDataStream::Version kStreamVersion = QDataStream::Qt_6_5; // 升级Qt后旧缓存仍能读取
+constexpr qsizetype kDefaultMaxCost = 16 * 1024; // 默认内存缓存上限16MB，主要是封面
+constexpr int kMaxDiskEntries = 50000;                 // 磁盘缓存最多保留的文件数
+constexpr qint64 kMaxDiskBytes = 512LL * 1024 * 1024;  // 磁盘缓存总大小上限，主要是封面
+constexpr int kPruneInterval = 256;                    // 每写入这么多次检查一次上限，启动后第一次写入时也检查
+constexpr qint64 kTouchInterval = 24 * 3600;           // 命中时最多每天更新一次修改时间，作为最近使用时间
+
+QString metadataValue(AVDictionary *metadata, const char *key)
+{
+    AVDictionaryEntry *tag = av_dict_get(metadata, key, nullptr, 0);
+    return tag && tag->value ? QString::fromUtf8(tag->value) : QString();
+}
+
+qint64 toMs(qint64 value, AVRational timeBase)
+{
+    return av_rescale_q(value, timeBase, AVRational{1, 1000});
+}
+} // namespace
+
+// 定义在全局命名空间，QList的流操作才能通过ADL找到
+static QDataStream &operator<<(QDataStream &out, const MediaStreamInfo &stream)
+{
+    return out << qint32(stream.type) << stream.codec << stream.language << qint32(stream.width)
+               << qint32(stream.height) << qint32(stream.sampleRate) << qint32(stream.channels) << stream.bitRate;
+}
+
+static QDataStream &operator>>(QDataStream &in, MediaStreamInfo &stream)
+{
+    qint32 type, width, height, sampleRate, channels;
+    in >> type >> stream.codec >> stream.language >> width >> height >> sampleRate >> channels >> stream.bitRate;
+    stream.type = MediaStreamInfo::Type(qBound(0, int(type), int(MediaStreamInfo::Other)));
+    stream.width = width;
+    stream.height = height;
+    stream.sampleRate = sampleRate;
+    stream.channels = channels;
+    return in;
+}
+
+static QDataStream &operator<<(QDataStream &out, const MediaChapter &chapter)
+{
+    return out << chapter.start << chapter.end << chapter.title;
+}
+
+static QDataStream &operator>>(QDataStream &in, MediaChapter &chapter)
+{
+    return in >> chapter.start >> chapter.end >> chapter.title;
+}
+
+bool MediaProbeResult::hasVideo() const
+{
+    for (const MediaStreamInfo &stream : streams) {
+        if (stream.type == MediaStreamInfo::Video) return true;
+    }
+    return false;
+}
+
+bool MediaProbeResult::hasAudio() const
+{
+    for (const MediaStreamInfo &stream : streams) {
+        if (stream.type == MediaStreamInfo::Audio) return true;
+    }
+    return false;
+}
+
+QSize MediaProbeResult::resolution() const
+{
+    for (const MediaStreamInfo &stream : streams) {
+        if (stream.type == MediaStreamInfo::Video) return QSize(stream.width, stream.height);
+    }
+    return QSize();
+}
+
+QImage MediaProbeResult::coverImage() const
+{
+    QImage image;
+    if (!coverArt.isEmpty()) image.loadFromData(coverArt);
+    return image;
+}
+
+MediaProbe::MediaProbe() : m_cache{kDefaultMaxCost}, m_saves{0}, m_pruning{false} {}
+
+MediaProbe &MediaProbe::instance()
+{
+    static MediaProbe probe;
+    return probe;
+}
+
+MediaProbeResult MediaProbe::probe(const QString &filePath)
+{
+    QString key = MediaCache::cacheKey(filePath);
+    if (key.isEmpty()) return MediaProbeResult();
+
+    {
+        QMutexLocker locker(&m_mutex);
+        if (const MediaProbeResult *cached = m_cache.object(key)) return *cached;
+    }
+
+    // 先读磁盘缓存，没有时才打开媒体文件
+    const QString cachePath = MediaCache::cacheDir("Video-Player_Probe").filePath(key + ".probe");
+    MediaProbeResult result = load(cachePath);
+    if (!result.valid) {
+        result = probeFile(filePath);
+        if (!result.valid) return result; // 打不开的文件不缓存，下次重试
+        if (!save(cachePath, result)) qWarning() << "MediaProbe: failed to save" << cachePath;
+        else if (m_saves.fetch_add(1) % kPruneInterval == 0) pruneDiskCache();
+    }
+
+    QMutexLocker locker(&m_mutex);
+    m_cache.insert(key, new MediaProbeResult(result), qMax<qsizetype>(1, result.coverArt.size() / 1024));
+    return result;
+}
+
+void MediaProbe::setMaxCost(qsizetype kilobytes)
+{
+    QMutexLocker locker(&m_mutex);
+    m_cache.setMaxCost(kilobytes);
+}
+
+void MediaProbe::pruneDiskCache()
+{
+    if (m_pruning.exchange(true)) return;
+    QThreadPool::globalInstance()->start([this]() {
+        // 按修改时间从新到旧，超出文件数或总大小的部分删除
+        const QDir dir = MediaCache::cacheDir("Video-Player_Probe");
+        const QFileInfoList files = dir.entryInfoList({"*.probe"}, QDir::Files, QDir::Time);
+        qint64 total = 0;
+        for (int i = 0; i < files.size(); i++) {
+            total += files[i].size();
+            if (i >= kMaxDiskEntries || total > kMaxDiskBytes) QFile::remove(files[i].filePath());
+        }
+        m_pruning.store(false);
+    });
+}
+
+MediaProbeResult MediaProbe::probeFile(const QString &filePath)
+{
+    MediaProbeResult result;
+    AVFormatContext *formatCtx = nullptr;
+    if (avformat_open_input(&formatCtx, filePath.toUtf8().constData(), nullptr, nullptr) < 0) {
+        qWarning() << "MediaProbe: failed to open" << filePath;
+        return result;
+    }
+    if (avformat_find_stream_info(formatCtx, nullptr) < 0) {
+        qWarning() << "MediaProbe: failed to find stream information" << filePath;
+        avformat_close_input(&formatCtx);
+        return result;
+    }
+
+    result.valid = true;
+    result.title = metadataValue(formatCtx->metadata, "title");
+    if (formatCtx->duration != AV_NOPTS_VALUE) result.duration = formatCtx->duration / (AV_TIME_BASE / 1000);
+    if (formatCtx->iformat) result.formatName = QString::fromLatin1(formatCtx->iformat->name);
+    result.bitRate = formatCtx->bit_rate;
+
+    for (unsigned int i = 0; i < formatCtx->nb_streams; ++i) {
+        AVStream *stream = formatCtx->streams[i];
+        // 封面以附加图片流的形式存在，不算作视频流
+        if (stream->disposition & AV_DISPOSITION_ATTACHED_PIC) {
+            if (result.coverArt.isEmpty()) {
+                const AVPacket &cover = stream->attached_pic;
+                result.coverArt = QByteArray(reinterpret_cast<const char *>(cover.data), cover.size);
+            }
+            continue;
+        }
+
+        const AVCodecParameters *par = stream->codecpar;
+        MediaStreamInfo info;
+        switch (par->codec_type) {
+        case AVMEDIA_TYPE_VIDEO:
+            info.type = MediaStreamInfo::Video;
+            info.width = par->width;
+            info.height = par->height;
+            break;
+        case AVMEDIA_TYPE_AUDIO:
+            info.type = MediaStreamInfo::Audio;
+            info.sampleRate = par->sample_rate;
+            info.channels = par->ch_layout.nb_channels;
+            break;
+        case AVMEDIA_TYPE_SUBTITLE:
+            info.type = MediaStreamInfo::Subtitle;
+            break;
+        default:
+            break;
+        }
+        info.codec = QString::fromLatin1(avcodec_get_name(par->codec_id));
+        info.language = metadataValue(stream->metadata, "language");
+        info.bitRate = par->bit_rate;
+        result.streams.append(info);
+    }
+
+    for (unsigned int i = 0; i < formatCtx->nb_chapters; ++i) {
+        const AVChapter *chapter = formatCtx->chapters[i];
+        MediaChapter info;
+        info.start = toMs(chapter->start, chapter->time_base);
+        info.end = toMs(chapter->end, chapter->time_base);
+        info.title = metadataValue(chapter->metadata, "title");
+        result.chapters.append(info);
+    }
+
+    avformat_close_input(&formatCtx);
+    return result;
+}
+
+bool MediaProbe::save(const QString &cachePath, const MediaProbeResult &result)
+{
+    QSaveFile file(cachePath);
+    if (!file.open(QIODevice::WriteOnly)) return false;
+
+    QDataStream out(&file);
+    out.setVersion(kStreamVersion);
+    out << kProbeMagic << kProbeVersion << result.title << result.duration << result.formatName << result.bitRate
+        << result.streams << result.chapters << result.coverArt;
+    return out.status() == QDataStream::Ok && file.commit();
+}
+
+MediaProbeResult MediaProbe::load(const QString &cachePath)
+{
+    QFile file(cachePath);
+    if (!file.open(QIODevice::ReadOnly)) return MediaProbeResult();
+
+    QDataStream in(&file);
+    in.setVersion(kStreamVersion);
+    quint32 magic, version;
+    in >> magic >> version;
+    if (in.status() != QDataStream::Ok || magic != kProbeMagic || version != kProbeVersion) return MediaProbeResult();
+
+    MediaProbeResult result;
+    in >> result.title >> result.duration >> result.formatName >> result.bitRate >> result.streams >> result.chapters
+        >> result.coverArt;
+    if (in.status() != QDataStream::Ok) return MediaProbeResult();
+    result.valid = true;
+
+    // 修改时间作为最近使用时间，淘汰时保留常用的项
+    const QDateTime now = QDateTime::currentDateTimeUtc();
+    if (file.fileTime(QFileDevice::FileModificationTime).secsTo(now) > kTouchInterval) {
+        file.setFileTime(now, QFileDevice::FileModificationTime);
+    }
+    return result;
+}
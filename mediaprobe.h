@@ -0,0 +1,77 @@
+#pragma once
+
+#include <QByteArray>
+#include <QCache>
+#include <QImage>
+#include <QList>
+#include <QMutex>
+#include <QSize>
+#include <QString>
+#include <atomic>
+
+// 媒体中的一条流
+struct MediaStreamInfo
+{
+    enum Type { Video, Audio, Subtitle, Other };
+
+    Type type = Other;
+    QString codec;    // 解码器名称，如h264、aac
+    QString language; // 元数据中的语言标签
+    int width = 0;    // 视频流
+    int height = 0;
+    int sampleRate = 0; // 音频流
+    int channels = 0;
+    qint64 bitRate = 0;
+};
+
+// 章节，时间单位为毫秒
+struct MediaChapter
+{
+    qint64 start = 0;
+    qint64 end = 0;
+    QString title;
+};
+
+// 一次打开文件得到的全部元数据
+struct MediaProbeResult
+{
+    bool valid = false;
+    QString title;       // 元数据中的标题，没有时为空
+    qint64 duration = 0; // 毫秒
+    QString formatName;
+    qint64 bitRate = 0;
+    QList<MediaStreamInfo> streams;
+    QList<MediaChapter> chapters;
+    QByteArray coverArt; // 封面图片原始数据(jpg/png)，没有时为空
+
+    bool hasVideo() const;
+    bool hasAudio() const;
+    QSize resolution() const; // 第一个视频流的分辨率
+    QImage coverImage() const;
+};
+
+// 统一的媒体探测服务：一次avformat_find_stream_info提取标题、时长、流、章节和封面
+// 结果按路径+大小+修改时间缓存在内存和磁盘上，已知文件再次添加时不再打开
+// 磁盘缓存的文件数和总大小有上限，超出时按最近使用时间(文件修改时间)淘汰
+// 可在任意线程调用
+class MediaProbe
+{
+public:
+    static MediaProbe &instance();
+
+    MediaProbeResult probe(const QString &filePath); // 文件无法打开时返回valid为false的结果
+    void setMaxCost(qsizetype kilobytes);           // 内存缓存上限
+
+private:
+    MediaProbe();
+
+    static MediaProbeResult probeFile(const QString &filePath);
+    static bool save(const QString &cachePath, const MediaProbeResult &result);
+    static MediaProbeResult load(const QString &cachePath);
+    void pruneDiskCache(); // 在线程池中删掉最久没用的缓存文件
+
+    QMutex m_mutex;
+    QCache<QString, MediaProbeResult> m_cache; // 代价以KB计
+    std::atomic<quint64> m_saves;              // 写入磁盘缓存的次数，每隔一定次数检查一次上限
+    std::atomic_bool m_pruning;
+};
@@ -0,0 +1,235 @@
+#include "mediasniffer.h"
+
+#include <QFile>
+#include <QFileInfo>
+#include <QMutexLocker>
+#include <cstring>
+
+#ifdef Q_OS_UNIX
+#include <sys/stat.h>
+#endif
+
+extern "C" {
+#include <libavformat/avformat.h>
+}
+
+namespace {
+constexpr qint64 kSniffBytes = 8 * 1024; // 读取的文件头大小，足够mpegts判断多个包
+constexpr int kMinScore = AVPROBE_SCORE_MAX / 4;
+constexpr int kMaxCacheEntries = 50000;
+
+QString suffixOf(const QString &fileName)
+{
+    const int dot = fileName.lastIndexOf('.');
+    const int slash = fileName.lastIndexOf('/');
+    if (dot < 0 || dot < slash) return QString();
+    return fileName.mid(dot + 1).toLower();
+}
+
+// 常见容器的文件头，命中时不用再交给FFmpeg
+QString sniffMagic(const QByteArray &head)
+{
+    auto at = [&head](int offset, const char *magic, int size) {
+        return head.size() >= offset + size && std::memcmp(head.constData() + offset, magic, size) == 0;
+    };
+    auto syncAt = [&head](int offset) { return head.size() > offset && head.at(offset) == 0x47; };
+
+    if (at(0, "\x1A\x45\xDF\xA3", 4)) return "matroska"; // mkv/webm
+    if (at(4, "ftyp", 4)) return "mov,mp4";                // mp4/m4v/m4a/mov/3gp
+    if (at(0, "RIFF", 4) && at(8, "AVI ", 4)) return "avi";
+    if (at(0, "RIFF", 4) && at(8, "WAVE", 4)) return "wav";
+    if (at(0, "OggS", 4)) return "ogg";
+    if (at(0, "fLaC", 4)) return "flac";
+    if (at(0, "ID3", 3)) return "mp3";
+    if (at(0, "FLV", 3)) return "flv";
+    if (at(0, "\x30\x26\xB2\x75\x8E\x66\xCF\x11", 8)) return "asf"; // wmv/wma
+    if (at(0, "\x00\x00\x01\xBA", 4)) return "mpeg";
+    if (syncAt(0) && syncAt(188) && syncAt(376)) return "mpegts";  // 188字节的TS包
+    if (syncAt(4) && syncAt(196) && syncAt(388)) return "mpegts";  // 192字节的M2TS包
+    return QString();
+}
+
+// ftyp的主品牌，HEIC/HEIF/AVIF图片与mp4共用ftyp文件头
+QByteArray majorBrand(const QByteArray &head)
+{
+    return head.size() >= 12 && head.mid(4, 4) == "ftyp" ? head.mid(8, 4) : QByteArray();
+}
+
+bool isImageBrand(const QByteArray &brand)
+{
+    static const QList<QByteArray> images{"heic", "heix", "heim", "heis", "hevc", "hevx", "mif1", "msf1", "avif", "avis"};
+    return images.contains(brand);
+}
+
+// 只能装音频的格式；mp4族按主品牌区分m4a/m4b
+bool isAudioFormat(const QString &format, const QByteArray &brand)
+{
+    static const QStringList audio{"mp3", "flac", "wav", "aac", "ac3", "eac3", "dts", "truehd", "ape", "wv", "tta",
+                                   "aiff", "amr", "au", "mpc", "mpc8", "dsf", "w64", "caf"};
+    if (format == "mov,mp4") return brand == "M4A " || brand == "M4B " || brand == "M4P ";
+    return audio.contains(format);
+}
+
+// FFmpeg能识别但不是音视频的格式：图片、字幕、文本和播放列表
+bool isRejectedFormat(const char *name)
+{
+    static const QList<QByteArray> rejected{"image2", "tty", "srt", "ass", "webvtt", "subviewer", "subviewer1",
+                                            "microdvd", "sami", "jacosub", "mpl2", "pjs", "realtext", "vplayer",
+                                            "stl", "lrc", "aqtitle", "mpsub", "scc", "hls", "concat", "ffmetadata"};
+    const QByteArray format(name);
+    return format.endsWith("_pipe") || rejected.contains(format);
+}
+} // namespace
+
+MediaSniffer &MediaSniffer::instance()
+{
+    static MediaSniffer sniffer;
+    return sniffer;
+}
+
+MediaSniffResult MediaSniffer::sniff(const QString &filePath)
+{
+    qint64 mtime = 0;
+    qint64 size = 0;
+    bool regular = false;
+    const QByteArray key = fileKey(filePath, mtime, size, regular);
+    if (key.isEmpty() || !regular) return MediaSniffResult();
+
+    {
+        QMutexLocker locker(&m_mutex);
+        auto it = m_cache.constFind(key);
+        if (it != m_cache.cend() && it->mtime == mtime && it->size == size) return it->result;
+    }
+
+    // 读文件时不持锁，其它线程的缓存命中不被阻塞
+    const MediaSniffResult result = sniffFile(filePath);
+
+    QMutexLocker locker(&m_mutex);
+    if (m_cache.size() >= kMaxCacheEntries) m_cache.clear();
+    m_cache.insert(key, Entry{mtime, size, result});
+    return result;
+}
+
+bool MediaSniffer::isMedia(const QString &filePath, bool trustSuffix)
+{
+    if (trustSuffix) {
+        static const QStringList skipped{"jpg", "jpeg", "png", "gif", "bmp", "webp", "svg", "heic", "heif", "avif",
+                                         "txt", "nfo", "srt", "ass", "ssa", "vtt", "sub", "idx", "lrc", "cue",
+                                         "m3u", "m3u8", "xspf", "vppl", "pdf"};
+        // .ts也是TypeScript源文件的扩展名，这几种必须按内容判断(188/192字节同步字节的检查很便宜)
+        static const QStringList ambiguous{"ts", "m2ts", "mts"};
+        const QString suffix = suffixOf(filePath);
+        if (ambiguous.contains(suffix)) return sniff(filePath).media;
+        if (mediaSuffixes().contains(suffix)) return true;
+        if (skipped.contains(suffix)) return false;
+    }
+    return sniff(filePath).media;
+}
+
+QByteArray MediaSniffer::fileKey(const QString &filePath, qint64 &mtime, qint64 &size, bool &regular)
+{
+#ifdef Q_OS_UNIX
+    struct stat st;
+    if (::stat(QFile::encodeName(filePath).constData(), &st) != 0) return QByteArray();
+    mtime = qint64(st.st_mtime);
+    size = qint64(st.st_size);
+    regular = S_ISREG(st.st_mode);
+    // 按inode缓存，重命名或通过不同路径访问的同一个文件不再读取
+    return QByteArray::number(quint64(st.st_dev)) + ':' + QByteArray::number(quint64(st.st_ino));
+#else
+    const QFileInfo info(filePath);
+    if (!info.exists()) return QByteArray();
+    mtime = info.lastModified().toMSecsSinceEpoch();
+    size = info.size();
+    regular = info.isFile();
+    return info.absoluteFilePath().toUtf8();
+#endif
+}
+
+MediaSniffResult MediaSniffer::sniffFile(const QString &filePath)
+{
+    MediaSniffResult result;
+    QFile file(filePath);
+    if (!file.open(QIODevice::ReadOnly)) return result;
+    const QByteArray head = file.read(kSniffBytes);
+    if (head.isEmpty()) return result;
+    const QByteArray brand = majorBrand(head);
+    if (isImageBrand(brand)) return result; // FFmpeg的mov解复用器也能打开，但只是图片
+
+    result.format = sniffMagic(head);
+    if (!result.format.isEmpty()) {
+        result.media = true;
+        result.audio = isAudioFormat(result.format, brand);
+        return result;
+    }
+
+    // 只按内容判断，不传文件名，扩展名不影响得分
+    QByteArray buffer = head;
+    buffer.append(QByteArray(AVPROBE_PADDING_SIZE, '\0'));
+    AVProbeData probe{};
+    probe.filename = "";
+    probe.buf = reinterpret_cast<unsigned char *>(buffer.data());
+    probe.buf_size = int(head.size());
+    int score = 0;
+    const AVInputFormat *format = av_probe_input_format3(&probe, 1, &score);
+    if (!format || score < kMinScore || isRejectedFormat(format->name)) return result;
+
+    result.media = true;
+    result.format = QString::fromLatin1(format->name);
+    result.audio = isAudioFormat(result.format, brand);
+    return result;
+}
+
+const QStringList &MediaSniffer::videoSuffixes()
+{
+    static const QStringList suffixes{"mp4", "m4v", "mkv", "webm", "avi", "mov", "wmv", "flv",
+                                      "ts", "m2ts", "mts", "mpg", "mpeg", "3gp"};
+    return suffixes;
+}
+
+const QStringList &MediaSniffer::audioSuffixes()
+{
+    static const QStringList suffixes{"mp3", "wav", "flac", "ogg", "oga", "opus", "m4a", "aac", "wma"};
+    return suffixes;
+}
+
+const QStringList &MediaSniffer::mediaSuffixes()
+{
+    static const QStringList suffixes = videoSuffixes() + audioSuffixes();
+    return suffixes;
+}
+
+bool MediaSniffer::hasMediaSuffix(const QString &fileName)
+{
+    return mediaSuffixes().contains(suffixOf(fileName));
+}
+
+bool MediaSniffer::isAudioSuffix(const QString &fileName)
+{
+    return audioSuffixes().contains(suffixOf(fileName));
+}
+
+QStringList MediaSniffer::nameFilters(const QStringList &suffixes)
+{
+    QStringList filters;
+    filters.reserve(suffixes.size());
+    for (const QString &suffix : suffixes) filters.append("*." + suffix);
+    return filters;
+}
+
+MediaFormats::MediaFormats(QObject *parent) : QObject(parent) {}
+
+QStringList MediaFormats::nameFilters() const
+{
+    return MediaSniffer::nameFilters(MediaSniffer::mediaSuffixes());
+}
+
+QStringList MediaFormats::videoNameFilters() const
+{
+    return MediaSniffer::nameFilters(MediaSniffer::videoSuffixes());
+}
+
+QStringList MediaFormats::audioNameFilters() const
+{
+    return MediaSniffer::nameFilters(MediaSniffer::audioSuffixes());
+}
@@ -0,0 +1,73 @@
+#pragma once
+
+#include <QByteArray>
+#include <QHash>
+#include <QMutex>
+#include <QObject>
+#include <QQmlEngine>
+#include <QString>
+#include <QStringList>
+
+// 按文件内容判断的媒体类型
+struct MediaSniffResult
+{
+    bool media = false;
+    bool audio = false; // 只能装音频的格式(mp3、flac、m4a等)，扩展名不对时也按音频显示封面
+    QString format;     // 识别出的容器格式，如matroska、mpegts
+};
+
+// 媒体类型识别：先匹配常见容器的文件头，再交给av_probe_input_format判断读到的开头几KB，
+// 扩展名错误或没有扩展名的文件(.ts、.webm、.m4v等)也能正确识别
+// 结果按inode和修改时间缓存，文件不变时不再读取；会读文件，不要在界面线程调用
+// 可在任意线程调用
+class MediaSniffer
+{
+public:
+    static MediaSniffer &instance();
+
+    MediaSniffResult sniff(const QString &filePath);
+    // trustSuffix为true时常见的音视频扩展名直接通过、图片字幕等直接排除，只读取其它文件和.ts等有歧义的扩展名，用于扫描大量文件
+    bool isMedia(const QString &filePath, bool trustSuffix = false);
+
+    // 支持的扩展名(小写，不带点)，文件对话框、文件夹列表和拖放共用这一份
+    static const QStringList &videoSuffixes();
+    static const QStringList &audioSuffixes();
+    static const QStringList &mediaSuffixes();
+    static bool hasMediaSuffix(const QString &fileName);
+    static bool isAudioSuffix(const QString &fileName);
+    static QStringList nameFilters(const QStringList &suffixes); // "*.mp4"形式
+
+private:
+    MediaSniffer() = default;
+
+    struct Entry
+    {
+        qint64 mtime = 0;
+        qint64 size = 0;
+        MediaSniffResult result;
+    };
+
+    static QByteArray fileKey(const QString &filePath, qint64 &mtime, qint64 &size, bool &regular);
+    static MediaSniffResult sniffFile(const QString &filePath);
+
+    QMutex m_mutex;
+    QHash<QByteArray, Entry> m_cache; // 设备:inode -> 结果
+};
+
+// 供QML使用的扩展名过滤器
+class MediaFormats : public QObject
+{
+    Q_OBJECT
+    QML_ELEMENT
+    QML_SINGLETON
+    Q_PROPERTY(QStringList nameFilters READ nameFilters CONSTANT)      // 全部音视频
+    Q_PROPERTY(QStringList videoNameFilters READ videoNameFilters CONSTANT)
+    Q_PROPERTY(QStringList audioNameFilters READ audioNameFilters CONSTANT)
+
+public:
+    explicit MediaFormats(QObject *parent = nullptr);
+
+    QStringList nameFilters() const;
+    QStringList videoNameFilters() const;
+    QStringList audioNameFilters() const;
+};
@@ -0,0 +1,195 @@
+#include "playbacktelemetry.h"
+#include "mediacache.h"
+
+#include <QCoreApplication>
+#include <QDateTime>
+#include <QDebug>
+#include <QDir>
+#include <QFile>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QSysInfo>
+
+extern "C" {
+#include <libavutil/avutil.h>
+}
+
+PlaybackTelemetry::PlaybackTelemetry(QObject *parent)
+    : QObject{parent}
+    , m_enabled{false}
+    , m_renderedFrames{0}
+    , m_lastRendered{0}
+    , m_lastBytesRead{0}
+    , m_renderedFps{0}
+    , m_bitrateKbps{-1}
+{}
+
+bool PlaybackTelemetry::enabled() const
+{
+    return m_enabled;
+}
+
+void PlaybackTelemetry::setEnabled(bool enabled)
+{
+    if (m_enabled == enabled) return;
+    m_enabled = enabled;
+    m_sampleTimer.invalidate(); // 重新开始计算帧率和码率
+    emit enabledChanged();
+}
+
+qint64 PlaybackTelemetry::renderedFrames() const
+{
+    return m_renderedFrames.load(std::memory_order_relaxed);
+}
+
+qint64 PlaybackTelemetry::droppedFrames() const
+{
+    return m_stats.value("droppedFrames", -1).toLongLong();
+}
+
+qreal PlaybackTelemetry::renderedFps() const
+{
+    return m_renderedFps;
+}
+
+qreal PlaybackTelemetry::decodeMs() const
+{
+    return m_stats.value("videoDecodeMs", -1).toDouble();
+}
+
+qreal PlaybackTelemetry::presentLatencyMs() const
+{
+    return m_stats.value("presentLatencyMs", -1).toDouble();
+}
+
+QVariantList PlaybackTelemetry::decodeHistogram() const
+{
+    return m_stats.value("decodeHistogram").toList();
+}
+
+QVariantList PlaybackTelemetry::presentHistogram() const
+{
+    return m_stats.value("presentHistogram").toList();
+}
+
+qint64 PlaybackTelemetry::decodeP95Ms() const
+{
+    return m_stats.value("decodeP95Ms", 0).toLongLong();
+}
+
+qint64 PlaybackTelemetry::presentP95Ms() const
+{
+    return m_stats.value("presentP95Ms", 0).toLongLong();
+}
+
+qreal PlaybackTelemetry::bufferFill() const
+{
+    return m_stats.value("bufferFill", -1).toDouble();
+}
+
+bool PlaybackTelemetry::hasAvDrift() const
+{
+    return m_stats.contains("avDriftMs");
+}
+
+qreal PlaybackTelemetry::avDriftMs() const
+{
+    return m_stats.value("avDriftMs", 0).toDouble();
+}
+
+qreal PlaybackTelemetry::bitrateKbps() const
+{
+    return m_bitrateKbps;
+}
+
+QString PlaybackTelemetry::lastDumpPath() const
+{
+    return m_lastDumpPath;
+}
+
+void PlaybackTelemetry::frameRendered()
+{
+    m_renderedFrames.fetch_add(1, std::memory_order_relaxed);
+}
+
+void PlaybackTelemetry::sample(const QVariantMap &stats)
+{
+    m_stats = stats;
+    const qint64 rendered = renderedFrames();
+    const qint64 bytesRead = stats.value("bytesRead", -1).toLongLong();
+
+    // 帧率和码率都按两次采样之间的增量计算
+    if (m_sampleTimer.isValid() && m_sampleTimer.elapsed() > 0) {
+        const qreal seconds = m_sampleTimer.elapsed() / 1000.0;
+        m_renderedFps = qMax<qint64>(0, rendered - m_lastRendered) / seconds;
+        if (bytesRead >= m_lastBytesRead && m_lastBytesRead >= 0) {
+            m_bitrateKbps = (bytesRead - m_lastBytesRead) * 8 / 1000.0 / seconds;
+        }
+    }
+    // 后端不统计读取字节数时使用元数据中的码率
+    if (bytesRead < 0) m_bitrateKbps = stats.value("bitrateKbps", -1).toDouble();
+
+    m_lastRendered = rendered;
+    m_lastBytesRead = bytesRead;
+    m_sampleTimer.restart();
+    emit updated();
+}
+
+void PlaybackTelemetry::reset()
+{
+    m_renderedFrames.store(0, std::memory_order_relaxed);
+    m_lastRendered = 0;
+    m_lastBytesRead = 0;
+    m_renderedFps = 0;
+    m_bitrateKbps = -1;
+    m_stats.clear();
+    m_sampleTimer.invalidate();
+    emit updated();
+}
+
+QString PlaybackTelemetry::toJson() const
+{
+    QJsonObject build;
+    build["application"] = QCoreApplication::applicationName();
+    build["version"] = QCoreApplication::applicationVersion();
+    build["qt"] = QString::fromLatin1(qVersion());
+    build["ffmpeg"] = QString::fromLatin1(av_version_info());
+    build["os"] = QSysInfo::prettyProductName();
+    build["cpu"] = QSysInfo::currentCpuArchitecture();
+
+    QJsonObject summary;
+    summary["renderedFrames"] = renderedFrames();
+    summary["droppedFrames"] = droppedFrames();
+    summary["renderedFps"] = m_renderedFps;
+    summary["decodeMs"] = decodeMs();
+    summary["presentLatencyMs"] = presentLatencyMs();
+    summary["decodeP95Ms"] = decodeP95Ms();
+    summary["presentP95Ms"] = presentP95Ms();
+    summary["bufferFill"] = bufferFill();
+    if (hasAvDrift()) summary["avDriftMs"] = avDriftMs();
+    summary["bitrateKbps"] = m_bitrateKbps;
+
+    QJsonObject root;
+    root["time"] = QDateTime::currentDateTime().toString(Qt::ISODateWithMs);
+    root["build"] = build;
+    root["summary"] = summary;
+    root["backend"] = QJsonObject::fromVariantMap(m_stats);
+    return QString::fromUtf8(QJsonDocument(root).toJson(QJsonDocument::Indented));
+}
+
+QString PlaybackTelemetry::dump()
+{
+    QDir dir = MediaCache::cacheDir("Video-Player_Telemetry");
+    QString fileName = "telemetry-" + QDateTime::currentDateTime().toString("yyyyMMdd-hhmmss") + ".json";
+    QFile file(dir.filePath(fileName));
+    if (!file.open(QIODevice::WriteOnly | QIODevice::Truncate)) {
+        qWarning() << "PlaybackTelemetry: failed to write" << file.fileName();
+        return QString();
+    }
+    file.write(toJson().toUtf8());
+    file.close();
+
+    m_lastDumpPath = file.fileName();
+    emit dumped();
+    return m_lastDumpPath;
+}
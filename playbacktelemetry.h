@@ -0,0 +1,75 @@
+#pragma once
+
+#include <QObject>
+#include <QQmlEngine>
+#include <QElapsedTimer>
+#include <QVariantList>
+#include <QVariantMap>
+#include <atomic>
+
+// 播放性能遥测：渲染/丢帧数、解码和呈现耗时分布、缓冲水位、音画偏差、实际码率
+// 由MediaEngine定时用播放后端的统计更新，可导出为JSON附到问题报告中
+class PlaybackTelemetry : public QObject
+{
+    Q_OBJECT
+    QML_ELEMENT
+    QML_UNCREATABLE("PlaybackTelemetry is owned by MediaEngine")
+    Q_PROPERTY(bool enabled READ enabled WRITE setEnabled NOTIFY enabledChanged) // 是否采样，显示叠加层时打开
+    Q_PROPERTY(qint64 renderedFrames READ renderedFrames NOTIFY updated)  // 送到画面的帧数
+    Q_PROPERTY(qint64 droppedFrames READ droppedFrames NOTIFY updated)    // 丢帧数，后端不支持时为-1
+    Q_PROPERTY(qreal renderedFps READ renderedFps NOTIFY updated)
+    Q_PROPERTY(qreal decodeMs READ decodeMs NOTIFY updated)                // 平均每帧解码耗时，-1为不支持
+    Q_PROPERTY(qreal presentLatencyMs READ presentLatencyMs NOTIFY updated) // 平均呈现滞后，-1为不支持
+    Q_PROPERTY(QVariantList decodeHistogram READ decodeHistogram NOTIFY updated)   // [{upToMs, count}]
+    Q_PROPERTY(QVariantList presentHistogram READ presentHistogram NOTIFY updated)
+    Q_PROPERTY(qint64 decodeP95Ms READ decodeP95Ms NOTIFY updated)   // p95所在桶的上界，0为没有样本，-1为超出最后一个上界
+    Q_PROPERTY(qint64 presentP95Ms READ presentP95Ms NOTIFY updated)
+    Q_PROPERTY(qreal bufferFill READ bufferFill NOTIFY updated)   // 0~1，-1为不支持
+    Q_PROPERTY(bool hasAvDrift READ hasAvDrift NOTIFY updated)
+    Q_PROPERTY(qreal avDriftMs READ avDriftMs NOTIFY updated)     // 视频相对音频的偏差，正值为视频超前
+    Q_PROPERTY(qreal bitrateKbps READ bitrateKbps NOTIFY updated) // 实际读取码率，-1为未知
+    Q_PROPERTY(QString lastDumpPath READ lastDumpPath NOTIFY dumped)
+
+public:
+    explicit PlaybackTelemetry(QObject *parent = nullptr);
+
+    bool enabled() const;
+    void setEnabled(bool enabled);
+    qint64 renderedFrames() const;
+    qint64 droppedFrames() const;
+    qreal renderedFps() const;
+    qreal decodeMs() const;
+    qreal presentLatencyMs() const;
+    QVariantList decodeHistogram() const;
+    QVariantList presentHistogram() const;
+    qint64 decodeP95Ms() const;
+    qint64 presentP95Ms() const;
+    qreal bufferFill() const;
+    bool hasAvDrift() const;
+    qreal avDriftMs() const;
+    qreal bitrateKbps() const;
+    QString lastDumpPath() const;
+
+    void frameRendered();                  // 任意线程调用，QVideoSink收到新帧
+    void sample(const QVariantMap &stats); // 用播放后端的统计刷新
+    void reset();                          // 切换媒体时清零
+
+    Q_INVOKABLE QString toJson() const; // 当前快照，包含后端原始统计
+    Q_INVOKABLE QString dump();         // 写入Video-Player_Telemetry目录，返回文件路径，失败时返回空字符串
+
+signals:
+    void enabledChanged();
+    void updated();
+    void dumped();
+
+private:
+    bool m_enabled;
+    std::atomic<qint64> m_renderedFrames;
+    qint64 m_lastRendered;   // 上次采样时的渲染帧数
+    qint64 m_lastBytesRead;  // 上次采样时后端读取的字节数
+    QElapsedTimer m_sampleTimer;
+    qreal m_renderedFps;
+    qreal m_bitrateKbps;
+    QVariantMap m_stats; // 最近一次后端统计
+    QString m_lastDumpPath;
+};
@@ -0,0 +1,49 @@
+#pragma once
+
+#include <QObject>
+#include <QMediaPlayer>
+#include <QAudioOutput>
+#include <QUrl>
+#include <QVariantMap>
+#include <QVideoSink>
+#include <memory>
+
+#include "keyframeindex.h"
+#include "decodeprofile.h"
+
+// 播放后端接口，MediaEngine通过它驱动QMediaPlayer或自研的FFmpeg解码管线
+// 接口和信号与QMediaPlayer保持一致，切换后端时QML无需改动
+class PlayerBackend : public QObject
+{
+    Q_OBJECT
+public:
+    using QObject::QObject;
+
+    virtual void setSource(const QUrl &url) = 0;
+    virtual QUrl source() const = 0;
+    virtual void play() = 0;
+    virtual void pause() = 0;
+    virtual void stop() = 0;
+    virtual void setPosition(qint64 position) = 0;
+    virtual qint64 position() const = 0;
+    virtual qint64 duration() const = 0;
+    virtual void setPlaybackRate(qreal rate) = 0;
+    virtual qreal playbackRate() const = 0;
+    virtual QMediaPlayer::PlaybackState playbackState() const = 0;
+    virtual QMediaPlayer::MediaStatus mediaStatus() const = 0;
+    virtual bool hasVideo() const = 0;
+    virtual void setVideoSink(QVideoSink *sink) = 0;
+    virtual void setAudioOutput(QAudioOutput *output) = 0; // 音量和设备跟随该输出
+
+    virtual void setKeyframeIndex(std::shared_ptr<const KeyframeIndex> index) { Q_UNUSED(index) }
+    virtual void setDecodeSettings(const DecodeSettings &settings) { Q_UNUSED(settings) } // QMediaPlayer不支持
+    virtual QVariantMap stats() const { return QVariantMap(); } // 队列深度、解码延迟等统计
+
+signals:
+    void playbackStateChanged(QMediaPlayer::PlaybackState state);
+    void mediaStatusChanged(QMediaPlayer::MediaStatus status);
+    void positionChanged(qint64 position);
+    void durationChanged(qint64 duration);
+    void playbackRateChanged(qreal rate);
+    void errorOccurred(QMediaPlayer::Error error, const QString &errorString);
+};
@@ -0,0 +1,313 @@
+#include "playlistfile.h"
+
+#include <QDebug>
+#include <QDir>
+#include <QFileInfo>
+#include <QSaveFile>
+#include <QTextStream>
+#include <QXmlStreamReader>
+#include <QXmlStreamWriter>
+#include <QtEndian>
+
+namespace {
+constexpr quint32 kPlaylistMagic = 0x5650504C; // "VPPL"
+constexpr quint32 kPlaylistVersion = 1;
+constexpr qint64 kHeaderSize = 32; // magic, version, count, reserved, recordsOffset, stringsOffset
+constexpr qint64 kRecordSize = 40; // 4组(offset, length) + duration
+
+quint32 readU32(const uchar *p)
+{
+    return qFromLittleEndian<quint32>(p);
+}
+
+// 追加字符串到字符串区，返回(offset, length)
+std::pair<quint32, quint32> appendString(QByteArray &strings, const QString &text)
+{
+    const QByteArray utf8 = text.toUtf8();
+    std::pair<quint32, quint32> result{quint32(strings.size()), quint32(utf8.size())};
+    strings.append(utf8);
+    return result;
+}
+
+template<typename T>
+void appendLittleEndian(QByteArray &out, T value)
+{
+    char buffer[sizeof(T)];
+    qToLittleEndian(value, buffer);
+    out.append(buffer, sizeof(T));
+}
+
+// 播放列表里的位置转为URL，相对路径按播放列表所在目录解析
+// encoded为true时位置是编码后的URI(XSPF)：带协议的直接按编码形式解析，%23等不会被当成#、?，只有裸路径先解码
+QUrl resolveLocation(const QString &location, const QDir &baseDir, bool encoded = false)
+{
+    const QString trimmed = location.trimmed();
+    if (trimmed.isEmpty()) return QUrl();
+    if (trimmed.contains("://")) return encoded ? QUrl::fromEncoded(trimmed.toUtf8(), QUrl::TolerantMode) : QUrl(trimmed);
+    QString path = QDir::fromNativeSeparators(encoded ? QUrl::fromPercentEncoding(trimmed.toUtf8()) : trimmed);
+    if (QDir::isRelativePath(path)) path = baseDir.absoluteFilePath(path);
+    return QUrl::fromLocalFile(QDir::cleanPath(path));
+}
+
+QString locationOf(const QUrl &url)
+{
+    return url.isLocalFile() ? QDir::toNativeSeparators(url.toLocalFile()) : url.toString();
+}
+
+bool readM3u(QFile &file, const QDir &baseDir, const std::function<bool(const PlaylistEntry &)> &onEntry)
+{
+    QTextStream in(&file); // M3U8和现代的M3U都是UTF-8
+    PlaylistEntry pending;
+    while (!in.atEnd()) {
+        const QString line = in.readLine().trimmed();
+        if (line.isEmpty()) continue;
+        if (line.startsWith("#EXTINF:")) {
+            // #EXTINF:<秒>[ 属性...],<标题>
+            const int comma = line.indexOf(',');
+            const QString info = line.mid(8, comma < 0 ? -1 : comma - 8).section(' ', 0, 0);
+            bool ok = false;
+            const double seconds = info.toDouble(&ok);
+            pending.duration = ok && seconds >= 0 ? qint64(seconds * 1000) : -1;
+            pending.title = comma < 0 ? QString() : line.mid(comma + 1).trimmed();
+            continue;
+        }
+        if (line.startsWith('#')) continue;
+
+        pending.url = resolveLocation(line, baseDir);
+        if (pending.url.isValid() && !onEntry(pending)) return true;
+        pending = PlaylistEntry();
+    }
+    return in.status() == QTextStream::Ok;
+}
+
+bool readXspf(QFile &file, const QDir &baseDir, const std::function<bool(const PlaylistEntry &)> &onEntry)
+{
+    QXmlStreamReader xml(&file);
+    PlaylistEntry pending;
+    bool inTrack = false;
+    while (!xml.atEnd()) {
+        xml.readNext();
+        if (xml.isStartElement()) {
+            const QStringView name = xml.name();
+            if (name == u"track") {
+                inTrack = true;
+                pending = PlaylistEntry();
+            } else if (inTrack && name == u"location") {
+                // XSPF的location是URI，本地文件为file://，也兼容直接写路径
+                pending.url = resolveLocation(xml.readElementText(), baseDir, true);
+            } else if (inTrack && name == u"title") {
+                pending.title = xml.readElementText().trimmed();
+            } else if (inTrack && name == u"duration") {
+                bool ok = false;
+                qint64 duration = xml.readElementText().trimmed().toLongLong(&ok);
+                pending.duration = ok ? duration : -1;
+            }
+        } else if (xml.isEndElement() && xml.name() == u"track") {
+            inTrack = false;
+            if (pending.url.isValid() && !onEntry(pending)) return true;
+        }
+    }
+    if (xml.hasError()) qWarning() << "PlaylistIO: invalid XSPF" << file.fileName() << xml.errorString();
+    return !xml.hasError();
+}
+
+bool writeM3u(QSaveFile &file, int count, const std::function<PlaylistEntry(int)> &entryAt)
+{
+    QTextStream out(&file);
+    out << "#EXTM3U\n";
+    for (int i = 0; i < count; i++) {
+        const PlaylistEntry entry = entryAt(i);
+        const qint64 seconds = entry.duration >= 0 ? (entry.duration + 500) / 1000 : -1;
+        out << "#EXTINF:" << seconds << ',' << entry.title << '\n' << locationOf(entry.url) << '\n';
+    }
+    out.flush();
+    return out.status() == QTextStream::Ok;
+}
+
+bool writeXspf(QSaveFile &file, int count, const std::function<PlaylistEntry(int)> &entryAt)
+{
+    QXmlStreamWriter xml(&file);
+    xml.setAutoFormatting(true);
+    xml.writeStartDocument();
+    xml.writeStartElement("playlist");
+    xml.writeAttribute("version", "1");
+    xml.writeDefaultNamespace("http://xspf.org/ns/0/");
+    xml.writeStartElement("trackList");
+    for (int i = 0; i < count; i++) {
+        const PlaylistEntry entry = entryAt(i);
+        xml.writeStartElement("track");
+        xml.writeTextElement("location", QString::fromUtf8(entry.url.toEncoded()));
+        if (!entry.title.isEmpty()) xml.writeTextElement("title", entry.title);
+        if (entry.duration >= 0) xml.writeTextElement("duration", QString::number(entry.duration));
+        xml.writeEndElement();
+    }
+    xml.writeEndElement();
+    xml.writeEndElement();
+    xml.writeEndDocument();
+    return !xml.hasError();
+}
+} // namespace
+
+PlaylistFile::~PlaylistFile()
+{
+    close();
+}
+
+bool PlaylistFile::open(const QString &filePath)
+{
+    close();
+    m_file.setFileName(filePath);
+    if (!m_file.open(QIODevice::ReadOnly)) return false;
+    m_size = m_file.size();
+    if (m_size < kHeaderSize) {
+        close();
+        return false;
+    }
+    m_data = m_file.map(0, m_size);
+    if (!m_data) {
+        close();
+        return false;
+    }
+
+    const quint32 magic = readU32(m_data);
+    const quint32 version = readU32(m_data + 4);
+    const quint32 count = readU32(m_data + 8);
+    const quint64 recordsOffset = qFromLittleEndian<quint64>(m_data + 16);
+    const quint64 stringsOffset = qFromLittleEndian<quint64>(m_data + 24);
+    if (magic != kPlaylistMagic || version != kPlaylistVersion || recordsOffset != quint64(kHeaderSize)
+        || stringsOffset != recordsOffset + quint64(count) * kRecordSize || stringsOffset > quint64(m_size)) {
+        qWarning() << "PlaylistFile: invalid playlist" << filePath;
+        close();
+        return false;
+    }
+
+    m_count = int(count);
+    m_records = m_data + recordsOffset;
+    m_strings = m_data + stringsOffset;
+    m_stringsSize = m_size - qint64(stringsOffset);
+    return true;
+}
+
+void PlaylistFile::close()
+{
+    if (m_data) m_file.unmap(const_cast<uchar *>(m_data));
+    m_file.close();
+    m_data = nullptr;
+    m_size = 0;
+    m_count = 0;
+    m_records = nullptr;
+    m_strings = nullptr;
+    m_stringsSize = 0;
+}
+
+bool PlaylistFile::isOpen() const
+{
+    return m_data != nullptr;
+}
+
+int PlaylistFile::count() const
+{
+    return m_count;
+}
+
+PlaylistEntry PlaylistFile::entry(int i) const
+{
+    PlaylistEntry entry;
+    if (i < 0 || i >= m_count) return entry;
+    const uchar *record = m_records + qint64(i) * kRecordSize;
+    entry.url = QUrl::fromEncoded(string(readU32(record), readU32(record + 4)).toUtf8());
+    entry.title = string(readU32(record + 8), readU32(record + 12));
+    entry.metadata = string(readU32(record + 16), readU32(record + 20));
+    entry.thumbnail = string(readU32(record + 24), readU32(record + 28));
+    entry.duration = qFromLittleEndian<qint64>(record + 32);
+    return entry;
+}
+
+QString PlaylistFile::string(quint32 offset, quint32 length) const
+{
+    if (quint64(offset) + length > quint64(m_stringsSize)) return QString();
+    return QString::fromUtf8(reinterpret_cast<const char *>(m_strings + offset), length);
+}
+
+bool PlaylistFile::save(const QString &filePath, int count, const std::function<PlaylistEntry(int)> &entryAt)
+{
+    // 记录表在字符串区之前，先在内存中拼好两部分
+    QByteArray records;
+    QByteArray strings;
+    records.reserve(qsizetype(count) * kRecordSize);
+    for (int i = 0; i < count; i++) {
+        const PlaylistEntry entry = entryAt(i);
+        for (const QString &text : {QString::fromUtf8(entry.url.toEncoded()), entry.title, entry.metadata, entry.thumbnail}) {
+            auto [offset, length] = appendString(strings, text);
+            appendLittleEndian<quint32>(records, offset);
+            appendLittleEndian<quint32>(records, length);
+        }
+        appendLittleEndian<qint64>(records, entry.duration);
+    }
+
+    QByteArray header;
+    appendLittleEndian<quint32>(header, kPlaylistMagic);
+    appendLittleEndian<quint32>(header, kPlaylistVersion);
+    appendLittleEndian<quint32>(header, quint32(count));
+    appendLittleEndian<quint32>(header, 0);
+    appendLittleEndian<quint64>(header, quint64(kHeaderSize));
+    appendLittleEndian<quint64>(header, quint64(kHeaderSize + records.size()));
+
+    QSaveFile file(filePath);
+    if (!file.open(QIODevice::WriteOnly)) return false;
+    if (file.write(header) != header.size() || file.write(records) != records.size()
+        || file.write(strings) != strings.size()) {
+        file.cancelWriting();
+        return false;
+    }
+    return file.commit();
+}
+
+namespace PlaylistIO {
+
+Format formatOf(const QString &filePath)
+{
+    const QString suffix = QFileInfo(filePath).suffix().toLower();
+    if (suffix == "vppl") return Binary;
+    if (suffix == "m3u" || suffix == "m3u8") return M3U;
+    if (suffix == "xspf") return XSPF;
+    return Unknown;
+}
+
+bool read(const QString &filePath, const std::function<bool(const PlaylistEntry &)> &onEntry)
+{
+    const Format format = formatOf(filePath);
+    if (format == Binary) {
+        PlaylistFile playlist;
+        if (!playlist.open(filePath)) return false;
+        for (int i = 0; i < playlist.count(); i++) {
+            if (!onEntry(playlist.entry(i))) break;
+        }
+        return true;
+    }
+
+    QFile file(filePath);
+    if (!file.open(QIODevice::ReadOnly)) return false;
+    const QDir baseDir = QFileInfo(filePath).absoluteDir();
+    if (format == M3U) return readM3u(file, baseDir, onEntry);
+    if (format == XSPF) return readXspf(file, baseDir, onEntry);
+    return false;
+}
+
+bool write(const QString &filePath, int count, const std::function<PlaylistEntry(int)> &entryAt)
+{
+    const Format format = formatOf(filePath);
+    if (format == Binary) return PlaylistFile::save(filePath, count, entryAt);
+    if (format == Unknown) return false;
+
+    QSaveFile file(filePath);
+    if (!file.open(QIODevice::WriteOnly | QIODevice::Text)) return false;
+    const bool ok = format == M3U ? writeM3u(file, count, entryAt) : writeXspf(file, count, entryAt);
+    if (!ok) {
+        file.cancelWriting();
+        return false;
+    }
+    return file.commit();
+}
+
+} // namespace PlaylistIO
@@ -0,0 +1,56 @@
+#pragma once
+
+#include <QFile>
+#include <QString>
+#include <QUrl>
+#include <functional>
+
+// 播放列表文件中的一项，元数据已缓存时不需要重新探测
+struct PlaylistEntry
+{
+    QUrl url;
+    QString title;      // 空字符串表示未知，加载后需要探测
+    QString metadata;   // 搜索用的容器、编码、分辨率、章节文本
+    QString thumbnail;  // 缩略图/预览图集的缓存键(MediaCache::cacheKey)
+    qint64 duration = -1; // 毫秒，-1为未知
+};
+
+// 版本化的二进制播放列表(.vppl)：定长记录表 + UTF-8字符串区
+// 通过内存映射按需读取任意一项，打开时不解析整个文件
+class PlaylistFile
+{
+public:
+    PlaylistFile() = default;
+    ~PlaylistFile();
+    PlaylistFile(const PlaylistFile &) = delete;
+    PlaylistFile &operator=(const PlaylistFile &) = delete;
+
+    bool open(const QString &filePath); // 映射文件并校验文件头和记录表
+    void close();
+    bool isOpen() const;
+    int count() const;
+    PlaylistEntry entry(int i) const; // 只解码这一项
+
+    static bool save(const QString &filePath, int count, const std::function<PlaylistEntry(int)> &entryAt);
+
+private:
+    QString string(quint32 offset, quint32 length) const;
+
+    QFile m_file;
+    const uchar *m_data = nullptr;
+    qint64 m_size = 0;
+    int m_count = 0;
+    const uchar *m_records = nullptr;
+    const uchar *m_strings = nullptr;
+    qint64 m_stringsSize = 0;
+};
+
+// M3U/M3U8/XSPF流式导入导出：边解析边回调，不先在内存中构造整个列表
+namespace PlaylistIO {
+enum Format { Unknown, Binary, M3U, XSPF };
+
+Format formatOf(const QString &filePath); // 按扩展名判断
+// 逐项回调，回调返回false时停止读取；相对路径按播放列表所在目录解析
+bool read(const QString &filePath, const std::function<bool(const PlaylistEntry &)> &onEntry);
+bool write(const QString &filePath, int count, const std::function<PlaylistEntry(int)> &entryAt);
+} // namespace PlaylistIO
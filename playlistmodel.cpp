@@ -1,14 +1,68 @@
 #include "playlistmodel.h"
+#include "mediaprobe.h"
+#include "mediacache.h"
+#include "historyjournal.h"
+#include "folderwatcher.h"
+#include "frameimageprovider.h"
+#include "resumestore.h"
+#include "appsettings.h"
 #include <QDebug>
 #include <QFileInfo>
 #include <QFile>
 #include <QRandomGenerator>
 #include <QStandardPaths>
 #include <QDir>
+#include <QPointer>
+#include <QSet>
+#include <QTextStream>
+#include <algorithm>
+
+namespace {
+constexpr int kLoadChunk = 5000;  // 二进制播放列表每批插入的项数，批次之间让出事件循环
+constexpr int kImportBatch = 1000; // 文本播放列表边解析边插入的批大小
+}
+
+extern "C" {
+#include <libavformat/avformat.h>
+}
 
-PlaylistModel::PlaylistModel(QObject *parent) : QAbstractListModel(parent), m_currentIndex{-1}
+PlaylistModel::PlaylistModel(QObject *parent)
+    : QAbstractListModel(parent)
+    , m_normalizeUrls{false}
+    , m_currentIndex{-1}
+    , m_importCancelled{std::make_shared<std::atomic_bool>(false)}
+    , m_importGeneration{0}
+    , m_importTotal{0}
+    , m_importDone{0}
+    , m_loadOffset{0}
+    , m_loadAdded{0}
+    , m_loadGeneration{0}
+    , m_historyLimit{1000}
+    , m_folderWatcher{nullptr}
+    , m_watchFolders{true}
 {
     avformat_network_init();
+    QSettings settings(kSettingsOrganization, QCoreApplication::applicationName());
+    m_normalizeUrls = settings.value("playlist/normalizeUrls", m_normalizeUrls).toBool();
+    m_historyLimit = settings.value("history/maxEntries", m_historyLimit).toInt();
+    m_watchFolders = settings.value("library/watchFolders", m_watchFolders).toBool();
+    m_probePool.setThreadPriority(QThread::LowPriority);
+
+    // 后台读到的标题每100ms合并成一批更新
+    m_flushTimer = new QTimer(this);
+    m_flushTimer->setSingleShot(true);
+    m_flushTimer->setInterval(100);
+    connect(m_flushTimer, &QTimer::timeout, this, &PlaylistModel::flushTitles);
+
+    m_detailLoader = new MediaDetailLoader(this);
+    connect(m_detailLoader, &MediaDetailLoader::detailsReady, this, &PlaylistModel::onDetailsReady);
+}
+
+PlaylistModel::~PlaylistModel()
+{
+    m_importCancelled->store(true);
+    m_probePool.clear();
+    m_probePool.waitForDone();
 }
 
 int PlaylistModel::rowCount(const QModelIndex &parent) const
@@ -30,6 +84,35 @@ QVariant PlaylistModel::data(const QModelIndex &index, int role) const
         return info.url;
     case TitleRole:
         return info.title;
+    case MetadataRole:
+        return info.metadata;
+    case DurationRole:
+        if (info.duration < 0 && m_details.contains(info.url)) return m_details[info.url].duration;
+        return info.duration;
+    case LastPositionRole: {
+        // 本地文件的续播键就是缩略图缓存键，不再逐行stat和计算哈希；还没探测时没有键
+        const QByteArray key = info.url.isLocalFile() ? QByteArray::fromHex(info.thumbnail.toLatin1())
+                                                      : ResumeStore::keyFor(info.url);
+        return key.isEmpty() ? qint64(-1) : ResumeStore::instance().position(key);
+    }
+    case PlayCountRole:
+        return info.playCount;
+    case FileSizeRole:
+    case ResolutionRole:
+    case CodecRole:
+    case ThumbnailRole: {
+        auto it = m_details.constFind(info.url);
+        if (it == m_details.cend()) return QVariant();
+        if (role == FileSizeRole) return it->fileSize;
+        if (role == ThumbnailRole) return it->thumbnail;
+        if (role == ResolutionRole) {
+            return it->resolution.isEmpty() ? QString() : QString("%1x%2").arg(it->resolution.width()).arg(it->resolution.height());
+        }
+        QStringList codecs;
+        if (!it->videoCodec.isEmpty()) codecs << it->videoCodec;
+        if (!it->audioCodec.isEmpty()) codecs << it->audioCodec;
+        return codecs.join('/');
+    }
     default:
         return QVariant();
     }
@@ -40,6 +123,14 @@ QHash<int, QByteArray> PlaylistModel::roleNames() const
     QHash<int, QByteArray> roles; //用Qbytearray存储数据，比Qstring更轻量
     roles[UrlRole] = "url";
     roles[TitleRole] = "title";
+    roles[MetadataRole] = "metadata";
+    roles[DurationRole] = "duration";
+    roles[LastPositionRole] = "lastPosition";
+    roles[PlayCountRole] = "playCount";
+    roles[FileSizeRole] = "fileSize";
+    roles[ResolutionRole] = "resolution";
+    roles[CodecRole] = "codec";
+    roles[ThumbnailRole] = "thumbnail";
     return roles;
 }
 
@@ -48,29 +139,381 @@ void PlaylistModel::addMedia(const QUrl &url)
     if (url.isEmpty())
         return;
     MediaInfo cur;
-    cur.url = url; //设置url
-
-    QString title = getTitleByFF(url); //设置title
-    cur.title = title == "" ? url.path().section('/', -1) : title;
+    cur.url = url;                    //设置url
+    cur.title = placeholderTitle(url); //标题在后台读取
+    cur.probed = !url.isLocalFile();
     beginInsertRows(QModelIndex(), m_mediaList.size(),
                     m_mediaList.size()); //通知视图数据插入开始了
     m_mediaList.append(cur);
+    m_rowByKey.insert(urlKey(url), m_mediaList.size() - 1);
     endInsertRows(); //通知视图数据插入结束了
+    probeTitles({url});
 }
 
 void PlaylistModel::addMedias(const QList<QUrl> &urls)
 {
     if (urls.isEmpty()) return;
 
-    for (auto &url : urls) {
-        if (indexByUrl(url) == -1) { //如果url在列表里不存在
-            addMedia(url);
-            setCurrentIndex(m_mediaList.size() - 1);
-        } else {
-            setCurrentIndex(indexByUrl(url));
-        }
+    QList<PlaylistEntry> entries;
+    entries.reserve(urls.size());
+    for (const QUrl &url : urls) entries.append(PlaylistEntry{url});
+    appendEntries(entries);
+    setCurrentIndex(indexByUrl(urls.last())); //与逐个添加时一样，停在最后一项
+}
+
+int PlaylistModel::appendEntries(const QList<PlaylistEntry> &entries)
+{
+    // 先用索引去重，再一次性插入全部项，没有缓存元数据的以文件名占位
+    QSet<QString> addedKeys;
+    QList<MediaInfo> added;
+    QList<QUrl> unprobed;
+    for (const PlaylistEntry &entry : entries) {
+        if (entry.url.isEmpty()) continue;
+        QString key = urlKey(entry.url);
+        if (m_rowByKey.contains(key) || addedKeys.contains(key)) continue; //url在列表里已存在
+        addedKeys.insert(key);
+        MediaInfo info = fromEntry(entry);
+        if (!info.probed) unprobed.append(info.url);
+        added.append(info);
     }
+    if (added.isEmpty()) return -1;
+
+    const int first = m_mediaList.size();
+    beginInsertRows(QModelIndex(), first, first + added.size() - 1);
+    m_mediaList.append(added);
+    reindex(first, m_mediaList.size());
+    endInsertRows();
     emit rowCountChanged();
+    probeTitles(unprobed);
+    return first;
+}
+
+void PlaylistModel::addFolder(const QUrl &folder)
+{
+    const QString path = folder.isLocalFile() ? folder.toLocalFile() : folder.toString();
+    if (path.isEmpty()) return;
+    folderWatcher().addFolder(path);
+}
+
+void PlaylistModel::onFolderFilesAdded(const QList<QUrl> &urls)
+{
+    QList<PlaylistEntry> entries;
+    entries.reserve(urls.size());
+    for (const QUrl &url : urls) entries.append(PlaylistEntry{url});
+    const int row = appendEntries(entries);
+    if (row >= 0 && m_currentIndex < 0) setCurrentIndex(row); //没有正在播放的项时从文件夹的第一个文件开始
+}
+
+FolderWatcher &PlaylistModel::folderWatcher()
+{
+    if (!m_folderWatcher) {
+        m_folderWatcher = new FolderWatcher(this);
+        m_folderWatcher->setWatching(m_watchFolders);
+        connect(m_folderWatcher, &FolderWatcher::filesAdded, this, &PlaylistModel::onFolderFilesAdded);
+        connect(m_folderWatcher, &FolderWatcher::filesRemoved, this, &PlaylistModel::removeMedias);
+        connect(m_folderWatcher, &FolderWatcher::scanningChanged, this, &PlaylistModel::scanningChanged);
+    }
+    return *m_folderWatcher;
+}
+
+bool PlaylistModel::scanning() const
+{
+    return m_folderWatcher && m_folderWatcher->scanning();
+}
+
+bool PlaylistModel::watchFolders() const
+{
+    return m_watchFolders;
+}
+
+void PlaylistModel::setWatchFolders(bool watch)
+{
+    if (m_watchFolders == watch) return;
+    m_watchFolders = watch;
+    if (m_folderWatcher) m_folderWatcher->setWatching(watch);
+
+    QSettings settings(kSettingsOrganization, QCoreApplication::applicationName());
+    settings.setValue("library/watchFolders", watch);
+    emit watchFoldersChanged();
+}
+
+bool PlaylistModel::loadPlaylist(const QUrl &url)
+{
+    const QString filePath = url.isLocalFile() ? url.toLocalFile() : url.toString();
+    const PlaylistIO::Format format = PlaylistIO::formatOf(filePath);
+
+    if (format == PlaylistIO::Binary) {
+        // 映射后分批插入，每批之间回到事件循环，大列表打开时界面不卡住
+        cancelLoading();
+        auto file = std::make_unique<PlaylistFile>();
+        if (!file->open(filePath)) {
+            qDebug() << "loadPlaylist failed" << filePath;
+            return false;
+        }
+        m_playlistFile = std::move(file);
+        m_loadOffset = 0;
+        m_loadAdded = 0;
+        emit loadingChanged();
+        loadNextChunk(m_loadGeneration); //第一批同步插入
+        return true;
+    }
+
+    // 文本格式边解析边插入，不在内存中保存整个文件
+    const int sizeBefore = m_mediaList.size();
+    int firstRow = -1;
+    QList<PlaylistEntry> batch;
+    auto flush = [&]() {
+        int row = appendEntries(batch);
+        if (firstRow < 0) firstRow = row;
+        batch.clear();
+    };
+    bool ok = PlaylistIO::read(filePath, [&](const PlaylistEntry &entry) {
+        batch.append(entry);
+        if (batch.size() >= kImportBatch) flush();
+        return true;
+    });
+    flush();
+    if (!ok) qDebug() << "loadPlaylist failed" << filePath;
+
+    if (firstRow >= 0) setCurrentIndex(firstRow); //从播放列表的第一项开始播放
+    if (ok) emit playlistLoaded(m_mediaList.size() - sizeBefore);
+    return ok;
+}
+
+void PlaylistModel::loadNextChunk(quint64 generation)
+{
+    if (generation != m_loadGeneration || !m_playlistFile) return;
+
+    const int end = qMin(m_loadOffset + kLoadChunk, m_playlistFile->count());
+    QList<PlaylistEntry> entries;
+    entries.reserve(end - m_loadOffset);
+    for (int i = m_loadOffset; i < end; i++) entries.append(m_playlistFile->entry(i));
+    m_loadOffset = end;
+
+    const bool first = m_loadAdded == 0;
+    const int sizeBefore = m_mediaList.size();
+    const int row = appendEntries(entries);
+    m_loadAdded += m_mediaList.size() - sizeBefore;
+    if (first && row >= 0) setCurrentIndex(row); //从播放列表的第一项开始播放
+    if (generation != m_loadGeneration) return; //切换当前项时列表被清空
+
+    if (m_loadOffset < m_playlistFile->count()) {
+        QTimer::singleShot(0, this, [this, generation]() { loadNextChunk(generation); });
+        return;
+    }
+    m_playlistFile.reset();
+    emit loadingChanged();
+    emit playlistLoaded(m_loadAdded);
+}
+
+void PlaylistModel::cancelLoading()
+{
+    ++m_loadGeneration;
+    if (!m_playlistFile) return;
+    m_playlistFile.reset();
+    emit loadingChanged();
+}
+
+bool PlaylistModel::loading() const
+{
+    return m_playlistFile != nullptr;
+}
+
+bool PlaylistModel::savePlaylist(const QUrl &url) const
+{
+    const QString filePath = url.isLocalFile() ? url.toLocalFile() : url.toString();
+    bool ok = PlaylistIO::write(filePath, m_mediaList.size(), [this](int i) { return toEntry(m_mediaList.at(i)); });
+    if (!ok) qDebug() << "savePlaylist failed" << filePath;
+    return ok;
+}
+
+void PlaylistModel::cancelImport()
+{
+    flushTitles(); //已经读到的标题仍然生效
+    if (!importing()) return;
+    m_importCancelled->store(true);
+    m_importCancelled = std::make_shared<std::atomic_bool>(false);
+    ++m_importGeneration;
+    m_probePool.clear();
+
+    m_importTotal = 0;
+    m_importDone = 0;
+    emit importProgressChanged();
+    emit importCancelled();
+}
+
+void PlaylistModel::probeTitles(const QList<QUrl> &urls)
+{
+    const quint64 generation = m_importGeneration;
+    const std::shared_ptr<std::atomic_bool> cancelled = m_importCancelled;
+    QPointer<PlaylistModel> self(this);
+    int queued = 0;
+
+    for (const QUrl &url : urls) {
+        if (!url.isLocalFile()) continue; //网络URL的标题就是文件名，不需要探测
+        ++queued;
+        m_probePool.start([=]() {
+            if (cancelled->load()) return;
+            MediaInfo info = probeMedia(url);
+            QMetaObject::invokeMethod(
+                self, [self, generation, info]() {
+                    if (self) self->onMediaProbed(generation, info);
+                }, Qt::QueuedConnection);
+        });
+    }
+    if (queued == 0) return;
+    m_importTotal += queued;
+    emit importProgressChanged();
+}
+
+void PlaylistModel::onMediaProbed(quint64 generation, const MediaInfo &info)
+{
+    if (generation != m_importGeneration) return;
+    m_probed.insert(info.url, info);
+    ++m_importDone;
+    if (!m_flushTimer->isActive()) m_flushTimer->start();
+}
+
+void PlaylistModel::flushTitles()
+{
+    m_flushTimer->stop();
+    if (m_probed.isEmpty()) return;
+
+    // 更新标题并把相邻的行合并成一个dataChanged
+    QList<int> rows;
+    for (auto it = m_probed.cbegin(); it != m_probed.cend(); ++it) {
+        int row = indexByUrl(it.key());
+        if (row < 0) continue; //已经移除的项
+        if (!applyProbed(m_mediaList[row], it.value())) continue;
+        if (m_history) m_history->updateMedia(toEntry(m_mediaList[row]));
+        rows.append(row);
+    }
+    m_probed.clear();
+    std::sort(rows.begin(), rows.end());
+    if (m_currentIndex >= 0 && std::binary_search(rows.cbegin(), rows.cend(), m_currentIndex)) {
+        emit currentTitleChanged(m_mediaList[m_currentIndex].title);
+    }
+
+    for (int first = 0; first < rows.size();) {
+        int last = first;
+        while (last + 1 < rows.size() && rows[last + 1] == rows[last] + 1) last++;
+        emit dataChanged(index(rows[first]), index(rows[last]), {TitleRole, MetadataRole, DurationRole, LastPositionRole});
+        first = last + 1;
+    }
+
+    if (m_importTotal > 0 && m_importDone >= m_importTotal) {
+        m_importTotal = 0;
+        m_importDone = 0;
+        emit importProgressChanged();
+        emit importFinished();
+    } else {
+        emit importProgressChanged();
+    }
+}
+
+void PlaylistModel::setVisibleRange(int first, int last)
+{
+    if (m_mediaList.isEmpty()) return;
+    first = qBound(0, first, m_mediaList.size() - 1);
+    last = qBound(first, last, m_mediaList.size() - 1);
+
+    // 可见的行从中间向两边排，之后是上下各半屏的预读
+    QList<int> rows;
+    const int center = (first + last) / 2;
+    for (int distance = 0; center - distance >= first || center + distance <= last; distance++) {
+        if (center + distance <= last) rows.append(center + distance);
+        if (distance > 0 && center - distance >= first) rows.append(center - distance);
+    }
+    const int margin = (last - first + 1) / 2;
+    for (int i = 1; i <= margin; i++) {
+        if (last + i < m_mediaList.size()) rows.append(last + i);
+        if (first - i >= 0) rows.append(first - i);
+    }
+    requestDetails(rows);
+}
+
+void PlaylistModel::requestDetails(const QList<int> &rows)
+{
+    QList<QUrl> urls;
+    for (int row : rows) {
+        if (row < 0 || row >= m_mediaList.size()) continue;
+        const QUrl &url = m_mediaList[row].url;
+        if (!url.isLocalFile()) continue;
+        auto it = m_details.find(url);
+        if (it == m_details.end()) {
+            urls.append(url);
+        } else if (!it->thumbnail.isEmpty() && !FrameCache::instance().contains(MediaDetailLoader::thumbnailId(url))) {
+            //缩略图已被FrameCache淘汰：先清空地址让视图放弃旧图片，读回后再设置
+            it->thumbnail.clear();
+            emit dataChanged(index(row), index(row), {ThumbnailRole});
+            urls.append(url);
+        }
+    }
+    m_detailLoader->request(urls); //空列表也要提交，取消滚出视图的请求
+}
+
+void PlaylistModel::onDetailsReady(const QUrl &url, const MediaDetails &details)
+{
+    m_details.insert(url, details);
+    int row = indexByUrl(url);
+    if (row < 0) return;
+    emit dataChanged(index(row), index(row), {DurationRole, FileSizeRole, ResolutionRole, CodecRole, ThumbnailRole});
+}
+
+bool PlaylistModel::applyProbed(MediaInfo &info, const MediaInfo &probed)
+{
+    if (info.probed) return false;
+    if (info.title == placeholderTitle(info.url)) info.title = probed.title; //播放列表文件里带的标题优先
+    info.metadata = probed.metadata;
+    info.duration = probed.duration;
+    info.thumbnail = probed.thumbnail;
+    info.probed = true;
+    return true;
+}
+
+void PlaylistModel::ensureProbed(int index)
+{
+    if (index < 0 || index >= m_mediaList.size() || m_mediaList[index].probed) return;
+    const QUrl url = m_mediaList[index].url;
+    if (!url.isLocalFile()) {
+        applyProbed(m_mediaList[index], probeMedia(url)); //网络URL不读文件，标题就是文件名
+        emit dataChanged(this->index(index), this->index(index), {TitleRole, MetadataRole, DurationRole, LastPositionRole});
+        return;
+    }
+
+    // 优先级高于导入时排队的标题探测；取消导入清空队列时一并丢弃，下次切到这一项再读取
+    QPointer<PlaylistModel> self(this);
+    m_probePool.start([self, url]() {
+        MediaInfo info = probeMedia(url);
+        QMetaObject::invokeMethod(
+            self, [self, info]() {
+                if (self) self->onCurrentProbed(info);
+            }, Qt::QueuedConnection);
+    }, 1);
+}
+
+void PlaylistModel::onCurrentProbed(const MediaInfo &probed)
+{
+    const int row = indexByUrl(probed.url);
+    if (row < 0 || !applyProbed(m_mediaList[row], probed)) return; //已经移除或由导入的探测填好
+    if (m_history) m_history->updateMedia(toEntry(m_mediaList[row])); //历史列表：把标题和时长写进日志
+    emit dataChanged(index(row), index(row), {TitleRole, MetadataRole, DurationRole, LastPositionRole});
+    if (row == m_currentIndex) emit currentTitleChanged(m_mediaList[row].title);
+}
+
+bool PlaylistModel::importing() const
+{
+    return m_importTotal > 0;
+}
+
+int PlaylistModel::importTotal() const
+{
+    return m_importTotal;
+}
+
+int PlaylistModel::importDone() const
+{
+    return m_importDone;
 }
 
 void PlaylistModel::removeMedia(int index)
@@ -78,7 +521,21 @@ void PlaylistModel::removeMedia(int index)
     if (index < 0 || index >= m_mediaList.size()) return;
 
     beginRemoveRows(QModelIndex(), index, index); //通知视图数据删除开始了
+    const QString key = urlKey(m_mediaList[index].url);
+    m_rowByKey.remove(key);
+    const QUrl url = m_mediaList[index].url;
     m_mediaList.removeAt(index);
+    reindex(index, m_mediaList.size()); //后面的行号前移
+    if (!m_rowByKey.contains(key)) { //前面还有同一个url时让键指向它
+        for (int i = index - 1; i >= 0; i--) {
+            if (urlKey(m_mediaList[i].url) == key) {
+                m_rowByKey.insert(key, i);
+                break;
+            }
+        }
+    }
+    if (!m_rowByKey.contains(key)) m_details.remove(url); //没有其它行用到这份附加信息
+    endRemoveRows();
     emit rowCountChanged();
 
     if (m_mediaList.isEmpty()) {
@@ -88,10 +545,60 @@ void PlaylistModel::removeMedia(int index)
     }
 }
 
+void PlaylistModel::removeMedias(const QList<QUrl> &urls)
+{
+    QList<int> rows;
+    for (const QUrl &url : urls) {
+        int row = indexByUrl(url);
+        if (row >= 0) rows.append(row);
+    }
+    if (rows.isEmpty()) return;
+    std::sort(rows.begin(), rows.end());
+    rows.erase(std::unique(rows.begin(), rows.end()), rows.end());
+
+    // 从后往前按连续的行段删除，最后只重建一次索引
+    const bool currentRemoved = std::binary_search(rows.cbegin(), rows.cend(), m_currentIndex);
+    const int removedBefore = std::lower_bound(rows.cbegin(), rows.cend(), m_currentIndex) - rows.cbegin();
+    for (int last = rows.size() - 1; last >= 0;) {
+        int first = last;
+        while (first > 0 && rows[first - 1] == rows[first] - 1) first--;
+        beginRemoveRows(QModelIndex(), rows[first], rows[last]);
+        m_mediaList.remove(rows[first], rows[last] - rows[first] + 1);
+        endRemoveRows();
+        last = first - 1;
+    }
+    m_rowByKey.clear();
+    reindex(0, m_mediaList.size());
+    for (const QUrl &url : urls) {
+        if (indexByUrl(url) < 0) m_details.remove(url);
+    }
+    emit rowCountChanged();
+
+    if (m_currentIndex < 0) return;
+    if (!currentRemoved) {
+        // 正在播放的项还在，只修正行号；界面看到同一个媒体时不重新打开
+        if (removedBefore > 0) emit currentIndexChanged(m_currentIndex -= removedBefore);
+        return;
+    }
+    if (m_mediaList.isEmpty()) {
+        setCurrentIndex(-1);
+        return;
+    }
+    const int next = qMin<int>(m_currentIndex - removedBefore, m_mediaList.size() - 1);
+    m_currentIndex = -1; //行号可能不变，先复位保证发出currentIndexChanged
+    setCurrentIndex(next); //正在播放的项被删除，播放它后面的一项
+}
+
 void PlaylistModel::clear()
 {
+    if (m_folderWatcher) m_folderWatcher->clear();
+    cancelLoading();
+    cancelImport();
+    m_detailLoader->cancel();
+    m_details.clear();
     beginResetModel(); //通知视图数据开始清除
     m_mediaList.clear();
+    m_rowByKey.clear();
     endResetModel(); //通知视图数据结束清除
     emit rowCountChanged();
     setCurrentIndex(-1);
@@ -119,11 +626,28 @@ void PlaylistModel::move(int preIndex, int newIndex, int num)
                   newIndex > preIndex ? newIndex + 1 : newIndex);  //通知视图要开始移动元素了
     QList<MediaInfo> movingItems = m_mediaList.mid(preIndex, num); // 创建临时列表保存要移动的元素
 
+    // 只有[first, last)这一段的行号变化，段内的行移动前后是同一批
+    const int first = qMin(preIndex, newIndex);
+    const int last = qMin<int>(m_mediaList.size(), qMax(preIndex, newIndex) + num);
+    QSet<QString> keys;
+    for (int i = first; i < last; i++) keys.insert(urlKey(m_mediaList[i].url));
+
     m_mediaList.remove(preIndex, num); //将已存入的元素删除
     // 插入元素到新位置
     for (int i = 0; i < num; i++) {
         m_mediaList.insert(newIndex, movingItems[i]);
     }
+
+    // 重复的键指向最后一行：原来的最后一行在段后则不变，否则在段内重新找最后一行
+    for (const QString &key : std::as_const(keys)) {
+        if (m_rowByKey.value(key, -1) >= last) continue;
+        for (int i = last - 1; i >= first; i--) {
+            if (urlKey(m_mediaList[i].url) == key) {
+                m_rowByKey.insert(key, i);
+                break;
+            }
+        }
+    }
     endMoveRows(); //通知视图元素移动结束了
 
     //根据preIndex和newIndex修改m_current
@@ -138,125 +662,190 @@ void PlaylistModel::move(int preIndex, int newIndex, int num)
     }
 }
 
-QList<QUrl> PlaylistModel::search(
-    QString text)
+void PlaylistModel::histroy()
 {
-    QList<QUrl> ans;
-    for (int i = 0; i < m_mediaList.size(); i++) {
-        if (isMatch(m_mediaList[i].title, text)) {
-            ans.append(m_mediaList[i].url);
+    HistoryJournal &journal = historyJournal();
+    QList<HistoryEntry> history = journal.load();
+    if (history.isEmpty()) {
+        // 旧版本的历史记录导入日志后删除
+        QList<PlaylistEntry> legacy = readLegacyHistory();
+        if (!legacy.isEmpty()) {
+            journal.importEntries(legacy);
+            history = journal.load();
+            QDir dir = QFileInfo(generateFilePath()).dir();
+            QFile::remove(dir.filePath("history.vppl"));
+            QFile::remove(dir.filePath("history.txt"));
         }
     }
-    return ans;
-}
 
-void PlaylistModel::histroy()
-{
-    QFile file(generateFilePath());
-    QList<QUrl> readFile;
-    if (file.open(QIODevice::ReadOnly | QIODevice::Text)) {
-        QTextStream in(&file);
-        while (!in.atEnd()) {
-            QString line = in.readLine().trimmed();
-            QUrl url(line);
-
-            // 检查 URL 类型
-            if (url.isLocalFile()) {
-                // 本地文件：检查文件是否存在
-                if (QFile::exists(url.toLocalFile())) { readFile.append(url); }
-            } else {
-                // 网络 URL：直接添加
-                readFile.append(url);
-            }
-        }
-        file.close();
+    QList<MediaInfo> items;
+    QList<QUrl> unprobed;
+    for (const HistoryEntry &entry : std::as_const(history)) {
+        // 本地文件：检查文件是否存在；网络 URL：直接添加
+        const QUrl &url = entry.media.url;
+        if (url.isLocalFile() && !QFile::exists(url.toLocalFile())) continue;
+        items.append(fromHistory(entry));
+        if (!items.last().probed) unprobed.append(url);
     }
-    if (!readFile.empty()) addMedias(readFile);
+
+    cancelLoading();
+    cancelImport();
+    beginResetModel();
+    m_mediaList = items;
+    m_rowByKey.clear();
+    reindex(0, m_mediaList.size());
+    endResetModel();
+    emit rowCountChanged();
+    probeTitles(unprobed); //只有旧格式迁移过来的项需要探测
 }
 
 void PlaylistModel::setHistroy(QUrl url)
 {
-    //读入数据
-    QFile file(generateFilePath());
-    QList<QUrl> readFile;
-    if (file.open(QIODevice::ReadOnly | QIODevice::Text)) {
-        QTextStream in(&file);
-        while (!in.atEnd()) {
-            QString line = in.readLine();
-            readFile.append(line);
-        }
-        file.close();
+    // 只在日志末尾追加一条记录，列表里只移动或插入这一行
+    // 不在界面线程探测：已有的行沿用它的元数据，新文件先按文件名记录，后台探测完成后再补上
+    int row = indexByUrl(url);
+    const MediaInfo known = row >= 0 ? m_mediaList.at(row) : MediaInfo{url, placeholderTitle(url)};
+    HistoryEntry entry = historyJournal().recordPlayed(toEntry(known));
+    const MediaInfo info = fromHistory(entry);
+
+    if (row > 0) move(row, 0, 1);
+    if (row >= 0) {
+        m_mediaList[0] = info;
+        emit dataChanged(index(0), index(0));
     } else {
-        qDebug() << "setHistroy read failed";
+        beginInsertRows(QModelIndex(), 0, 0);
+        m_mediaList.prepend(info);
+        reindex(0, m_mediaList.size());
+        endInsertRows();
+        emit rowCountChanged();
+        if (m_currentIndex >= 0) emit currentIndexChanged(++m_currentIndex);
+        trimHistory();
     }
-    //移除已存在的相同的url
-    if (readFile.contains(url)) {
-        readFile.removeOne(url);
-    }
-    readFile.prepend(url);
+    ensureProbed(0);
+}
+
+int PlaylistModel::historyLimit() const
+{
+    return m_historyLimit;
+}
 
-    //清除超出范围的数据
-    while (readFile.length() > 5) {
-        readFile.removeLast();
+void PlaylistModel::setHistoryLimit(int limit)
+{
+    limit = qBound(1, limit, 100000);
+    if (m_historyLimit == limit) return;
+    m_historyLimit = limit;
+    if (m_history) {
+        m_history->setMaxEntries(limit);
+        trimHistory();
     }
-    //写入文件
-    if (file.open(QIODevice::WriteOnly | QIODevice::Text | QIODevice::Truncate)) {
-        QTextStream out(&file);
-        for (auto &i : readFile) {
-            out << i.toString() << '\n';
-        }
-        file.close();
-    } else {
-        qDebug() << "setHistory write failed";
+
+    QSettings settings(kSettingsOrganization, QCoreApplication::applicationName());
+    settings.setValue("history/maxEntries", limit);
+    emit historyLimitChanged();
+}
+
+void PlaylistModel::trimHistory()
+{
+    const int size = m_mediaList.size();
+    if (size <= m_historyLimit) return;
+
+    beginRemoveRows(QModelIndex(), m_historyLimit, size - 1);
+    for (int i = m_historyLimit; i < size; i++) {
+        const QString key = urlKey(m_mediaList[i].url);
+        if (m_rowByKey.value(key) == i) m_rowByKey.remove(key);
     }
+    m_mediaList.remove(m_historyLimit, size - m_historyLimit);
+    endRemoveRows();
+    emit rowCountChanged();
+    if (m_currentIndex >= m_historyLimit) setCurrentIndex(-1);
+}
 
-    clear();             //清空列表
-    addMedias(readFile); //重新读取列表
+HistoryJournal &PlaylistModel::historyJournal()
+{
+    if (!m_history) m_history = std::make_unique<HistoryJournal>(generateFilePath(), m_historyLimit);
+    return *m_history;
 }
 
-int PlaylistModel::indexByUrl(QUrl url)
+MediaInfo PlaylistModel::fromHistory(const HistoryEntry &entry)
 {
-    for (int i = 0; i < m_mediaList.size(); i++) {
-        if (m_mediaList[i].url == url) {
-            return i;
-        }
+    MediaInfo info = fromEntry(entry.media);
+    info.playCount = entry.playCount;
+    return info;
+}
+
+QList<PlaylistEntry> PlaylistModel::readLegacyHistory() const
+{
+    QList<PlaylistEntry> entries;
+    const QDir dir = QFileInfo(generateFilePath()).dir();
+    PlaylistFile file;
+    if (file.open(dir.filePath("history.vppl"))) {
+        for (int i = 0; i < file.count(); i++) entries.append(file.entry(i));
+        return entries;
+    }
+
+    // 更早的history.txt每行一个url
+    QFile legacy(dir.filePath("history.txt"));
+    if (!legacy.open(QIODevice::ReadOnly | QIODevice::Text)) return entries;
+    QTextStream in(&legacy);
+    while (!in.atEnd()) {
+        QString line = in.readLine().trimmed();
+        if (!line.isEmpty()) entries.append(PlaylistEntry{QUrl(line)});
     }
-    return -1;
+    return entries;
 }
 
-bool PlaylistModel::isMatch(
-    QString title, QString text)
+int PlaylistModel::indexByUrl(QUrl url) const
 {
-    int m = title.size(), n = text.size();
-    QVector<int> match(n, 0);
-    int j = 0;
-    for (int i = 1; i < n; i++) {
-        if (text[j] == text[i]) {
-            match[i] = j + 1;
-            j++;
-        } else {
-            while (j > 0 && text[j] != text[i]) {
-                j = match[j - 1];
-            }
-            if (text[j] == text[i]) {
-                j++;
-            }
-            match[i] = j;
-        }
+    return m_rowByKey.value(urlKey(url), -1);
+}
+
+bool PlaylistModel::normalizeUrls() const
+{
+    return m_normalizeUrls;
+}
+
+void PlaylistModel::setNormalizeUrls(bool normalize)
+{
+    if (m_normalizeUrls == normalize) return;
+    m_normalizeUrls = normalize;
+    // 已有的重复项保留，只重建索引，重复的键指向后面的行
+    m_rowByKey.clear();
+    reindex(0, m_mediaList.size());
+
+    QSettings settings(kSettingsOrganization, QCoreApplication::applicationName());
+    settings.setValue("playlist/normalizeUrls", normalize);
+    emit normalizeUrlsChanged();
+}
+
+QString PlaylistModel::urlKey(const QUrl &url) const
+{
+    if (!m_normalizeUrls) return url.toString(QUrl::FullyEncoded);
+
+    // 没有scheme的绝对路径按本地文件处理
+    QString localPath;
+    if (url.isLocalFile()) {
+        localPath = url.toLocalFile();
+    } else if (url.scheme().isEmpty() && QDir::isAbsolutePath(url.path())) {
+        localPath = url.path();
     }
-    j = 0;
-    for (int i = 0; i < m; i++) {
-        if (text[j] == title[i]) {
-            j++;
-            if (j == n) {
-                return true;
-            }
-        } else {
-            if (j != 0)
-                j = match[j - 1];
-        }
+    if (!localPath.isEmpty()) {
+        localPath = QDir::cleanPath(localPath);
+#ifdef Q_OS_WIN
+        localPath = localPath.toLower(); //Windows路径不区分大小写
+#endif
+        return "file:" + localPath;
+    }
+
+    // 网络URL统一解码百分号编码并规范化路径
+    QUrl adjusted = url.adjusted(QUrl::NormalizePathSegments | QUrl::StripTrailingSlash);
+    return QUrl::fromPercentEncoding(adjusted.toEncoded());
+}
+
+void PlaylistModel::reindex(int from, int to)
+{
+    for (int i = from; i < to; i++) {
+        m_rowByKey.insert(urlKey(m_mediaList[i].url), i);
     }
-    return false;
 }
 
 QString PlaylistModel::generateFilePath() const
@@ -269,23 +858,27 @@ QString PlaylistModel::generateFilePath() const
     dirPath += "Video-Player_History";
     QDir dir(dirPath);
     if (!dir.exists()) { dir.mkpath("."); }
-    return dir.filePath("history.txt");
+    return dir.filePath("history.journal");
 }
 
 void PlaylistModel::clearHistory() {
     // 清除内存中的历史记录
+    cancelLoading();
+    cancelImport();
+    m_detailLoader->cancel();
+    m_details.clear();
     beginResetModel();
     m_mediaList.clear();
+    m_rowByKey.clear();
     endResetModel();
     emit rowCountChanged();
     setCurrentIndex(-1);
 
-    // 删除历史记录文件
-    QString filePath = generateFilePath();
-    QFile file(filePath);
-    if (file.exists()) {
-        file.remove();
-    }
+    // 删除历史记录文件(包括还没迁移的旧版本文件)
+    historyJournal().clear();
+    QDir dir = QFileInfo(generateFilePath()).dir();
+    QFile::remove(dir.filePath("history.vppl"));
+    QFile::remove(dir.filePath("history.txt"));
 }
 
 int PlaylistModel::currentIndex() const
@@ -301,55 +894,65 @@ void PlaylistModel::setCurrentIndex(int index)
         return;
     }
     m_currentIndex = index;
+    ensureProbed(index);
 
     //如果属性的值没有变化则不发送变化信号
     if (m_currentIndex != preIndex)
         emit currentIndexChanged(m_currentIndex);
 }
 
-QString PlaylistModel::getTitleByFF(QUrl url) const
+MediaInfo PlaylistModel::probeMedia(const QUrl &url)
 {
-    if (url.isLocalFile()) {
-        QString localPath = url.toLocalFile(); // 获取本地文件路径
-        if (localPath.isEmpty()) return "";
-
-        QByteArray utf8 = localPath.toUtf8();
-        const char *fileName = utf8.constData();
-        AVFormatContext *fmt_ctx = NULL;
-        QString ans{};
-
-        // 打开媒体文件
-        if (avformat_open_input(&fmt_ctx, fileName, NULL, NULL) < 0) {
-            av_log(NULL, AV_LOG_ERROR, "avformat_open_input failed\n");
-            return ans;
-        }
+    MediaInfo info{url, placeholderTitle(url), true};
+    QString localPath = url.toLocalFile(); // 获取本地文件路径
+    if (!url.isLocalFile() || localPath.isEmpty()) return info; // 网络URL - 使用URL的文件名部分
+
+    // 元数据来自MediaProbe，已探测过的文件直接读缓存
+    MediaProbeResult result = MediaProbe::instance().probe(localPath);
+    if (!result.title.isEmpty()) info.title = result.title;
+    if (result.valid) info.duration = result.duration;
+    info.thumbnail = MediaCache::cacheKey(localPath); //缩略图和预览图集按这个键缓存
+
+    // 搜索用的元数据文本：容器、编码、分辨率、章节标题
+    QStringList parts;
+    if (!result.formatName.isEmpty()) parts << result.formatName;
+    for (const MediaStreamInfo &stream : std::as_const(result.streams)) {
+        if (!stream.codec.isEmpty()) parts << stream.codec;
+        if (!stream.language.isEmpty()) parts << stream.language;
+    }
+    QSize resolution = result.resolution();
+    if (resolution.isValid() && !resolution.isEmpty()) {
+        parts << QString("%1x%2").arg(resolution.width()).arg(resolution.height()) << QString("%1p").arg(resolution.height());
+    }
+    for (const MediaChapter &chapter : std::as_const(result.chapters)) {
+        if (!chapter.title.isEmpty()) parts << chapter.title;
+    }
+    parts.removeDuplicates();
+    info.metadata = parts.join(' ');
+    return info;
+}
 
-        // 获取流信息
-        if (avformat_find_stream_info(fmt_ctx, NULL) < 0) {
-            av_log(NULL, AV_LOG_ERROR, "avformat_find_stream_info failed\n");
-            avformat_close_input(&fmt_ctx);
-            return ans;
-        }
+QString PlaylistModel::placeholderTitle(const QUrl &url)
+{
+    QString name = url.path().section('/', -1);
+    return name.isEmpty() ? url.toString() : name;
+}
 
-        // 获取标题元数据
-        AVDictionaryEntry *tag = av_dict_get(fmt_ctx->metadata, "title", NULL, 0);
-        if (tag && tag->value) {
-            ans = QString::fromUtf8(tag->value); // 正确处理UTF-8编码
-        } else {
-            // 使用文件名作为标题
-            QFileInfo fileInfo(localPath);
-            ans = fileInfo.fileName();
-        }
+PlaylistEntry PlaylistModel::toEntry(const MediaInfo &info)
+{
+    return PlaylistEntry{info.url, info.title, info.metadata, info.thumbnail, info.duration};
+}
 
-        avformat_close_input(&fmt_ctx);
-        return ans;
-    } else {
-        // 网络URL - 使用URL的文件名部分
-        QString path = url.path();
-        int lastSlash = path.lastIndexOf('/');
-        if (lastSlash != -1) { return path.mid(lastSlash + 1); }
-        return url.toString();
-    }
+MediaInfo PlaylistModel::fromEntry(const PlaylistEntry &entry)
+{
+    MediaInfo info;
+    info.url = entry.url;
+    info.title = entry.title.isEmpty() ? placeholderTitle(entry.url) : entry.title;
+    info.metadata = entry.metadata;
+    info.duration = entry.duration;
+    info.thumbnail = entry.thumbnail;
+    info.probed = !entry.url.isLocalFile() || !entry.thumbnail.isEmpty(); //探测过的本地文件一定有缓存键
+    return info;
 }
 
 int PlaylistModel::getRandomIndex(int min, int max) const
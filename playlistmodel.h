@@ -4,16 +4,29 @@
 #include <QQmlEngine>
 #include <QList>
 #include <QUrl>
+#include <QHash>
+#include <QThreadPool>
+#include <QTimer>
+#include <atomic>
+#include <memory>
 
-extern "C" {
-#include <libavformat/avformat.h>
-#include <libavcodec/avcodec.h>
-}
+#include "playlistfile.h"
+#include "mediadetails.h"
+
+class FolderWatcher;
+
+class HistoryJournal;
+struct HistoryEntry;
 
 struct MediaInfo
 {
     QUrl url;
     QString title;
+    bool probed = false; // 标题是否已从元数据读取，未读取时为文件名
+    QString metadata;    // 容器格式、编码、分辨率、章节标题，供搜索使用
+    qint64 duration = -1; // 毫秒，-1为未知
+    QString thumbnail;   // 缩略图缓存键(MediaCache::cacheKey)，本地文件的续播位置也按这个键查询
+    int playCount = 0;        // 历史记录：播放次数
 };
 
 class PlaylistModel : public QAbstractListModel
@@ -22,12 +35,32 @@ class PlaylistModel : public QAbstractListModel
     QML_ELEMENT
     Q_PROPERTY(int currentIndex READ currentIndex WRITE setCurrentIndex NOTIFY currentIndexChanged)
     Q_PROPERTY(int rowCount READ rowCount NOTIFY rowCountChanged)
+    Q_PROPERTY(bool normalizeUrls READ normalizeUrls WRITE setNormalizeUrls NOTIFY normalizeUrlsChanged) // 按规范化后的路径去重
+    Q_PROPERTY(bool importing READ importing NOTIFY importProgressChanged)     // 是否正在后台读取元数据
+    Q_PROPERTY(int importTotal READ importTotal NOTIFY importProgressChanged)  // 本轮导入的文件数
+    Q_PROPERTY(int importDone READ importDone NOTIFY importProgressChanged)    // 已读取完元数据的文件数
+    Q_PROPERTY(bool loading READ loading NOTIFY loadingChanged)                // 是否正在分批载入播放列表文件
+    Q_PROPERTY(int historyLimit READ historyLimit WRITE setHistoryLimit NOTIFY historyLimitChanged) // 历史记录最多保留的项数
+    Q_PROPERTY(bool scanning READ scanning NOTIFY scanningChanged)             // 是否正在扫描添加的文件夹
+    Q_PROPERTY(bool watchFolders READ watchFolders WRITE setWatchFolders NOTIFY watchFoldersChanged) // 添加的文件夹有变化时同步列表
 
 public:
-    enum Roles { UrlRole = Qt::UserRole + 1, TitleRole }; //设置UrlRole枚举和TitleRole枚举
+    enum Roles {
+        UrlRole = Qt::UserRole + 1,
+        TitleRole,
+        MetadataRole,
+        DurationRole,
+        LastPositionRole, // 上次停止的位置(毫秒)，读取时查询ResumeStore
+        PlayCountRole,
+        FileSizeRole,   // 以下为附加信息，行进入视图后才读取，读取前为空
+        ResolutionRole,
+        CodecRole,
+        ThumbnailRole
+    }; //设置各个角色的枚举
     Q_ENUM(Roles)
 
     explicit PlaylistModel(QObject *parent = nullptr);
+    ~PlaylistModel() override;
 
     int rowCount(const QModelIndex &parent = QModelIndex()) const override; //告知视图 数据项的数目
     QVariant data(const QModelIndex &index,
@@ -35,16 +68,23 @@ public:
     QHash<int, QByteArray> roleNames() const override;        //获取各个角色名
 
     Q_INVOKABLE void addMedia(const QUrl &url);          //添加单个数据项
-    Q_INVOKABLE void addMedias(const QList<QUrl> &urls); //添加多个数据项
+    Q_INVOKABLE void addMedias(const QList<QUrl> &urls); //添加多个数据项，先以文件名占位，标题在后台读取
+    Q_INVOKABLE void cancelImport();                     //取消后台读取，未完成的项保留文件名
+    Q_INVOKABLE void addFolder(const QUrl &folder);      //递归扫描文件夹，找到的文件分批追加
     Q_INVOKABLE void removeMedia(int index);             //根据索引移除数据项
+    Q_INVOKABLE void removeMedias(const QList<QUrl> &urls); //一次移除多个数据项
     Q_INVOKABLE void clear();                            //清空数据项
     Q_INVOKABLE QUrl getUrl(int index) const;            //获取url
     Q_INVOKABLE void move(int preIndex, int newIndex, int num); //移动指定数量的元素到指定位置
-    Q_INVOKABLE QList<QUrl> search(QString text); //按照给定的text筛选title并返回
-    Q_INVOKABLE void histroy();                   //初始化历史列表(最多5项)
-    Q_INVOKABLE void setHistroy(QUrl url);        //设置历史列表 (最多5项)
-    Q_INVOKABLE int indexByUrl(QUrl url);         //通过url寻找对应的下标
+    Q_INVOKABLE void histroy();                   //从历史日志初始化历史列表，最近播放的在前
+    Q_INVOKABLE void setHistroy(QUrl url);        //记录一次播放，只把这一项移到(或插入到)最前面
+    Q_INVOKABLE int indexByUrl(QUrl url) const;   //通过url寻找对应的下标(哈希索引)
     Q_INVOKABLE int getRandomIndex(int min, int max) const; // 生成随机下标
+    Q_INVOKABLE bool loadPlaylist(const QUrl &url);      //按扩展名载入.vppl/.m3u/.m3u8/.xspf播放列表，追加到当前列表
+    Q_INVOKABLE bool savePlaylist(const QUrl &url) const; //按扩展名保存播放列表
+    Q_INVOKABLE void setVisibleRange(int first, int last); //视图中可见的行，只为这些行(和附近的行)读取附加信息
+
+    void requestDetails(const QList<int> &rows); //按给出的先后顺序读取附加信息，替换之前还没开始的请求
 
     Q_INVOKABLE QString generateFilePath() const;
     Q_INVOKABLE void clearHistory();
@@ -52,16 +92,81 @@ public:
     //暴露属性的setter和getter
     int currentIndex() const;
     void setCurrentIndex(int index);
+    bool normalizeUrls() const;
+    void setNormalizeUrls(bool normalize);
+    bool importing() const;
+    int importTotal() const;
+    int importDone() const;
+    bool loading() const;
+    int historyLimit() const;
+    void setHistoryLimit(int limit);
+    bool scanning() const;
+    bool watchFolders() const;
+    void setWatchFolders(bool watch);
 
 signals:
     //通知属性变化
     void currentIndexChanged(int index);
     void rowCountChanged();
+    void normalizeUrlsChanged();
+    void importProgressChanged();
+    void importFinished();  //全部元数据读取完成
+    void importCancelled();
+    void loadingChanged();
+    void historyLimitChanged();
+    void scanningChanged();
+    void watchFoldersChanged();
+    void playlistLoaded(int count); //播放列表文件载入完成，count为新增的项数
+    void currentTitleChanged(const QString &title); //当前项的标题在后台读取完成后更新
 
 private:
-    bool isMatch(QString title, QString text); //返回title是否包含text字符串(KMP算法）
+    static MediaInfo probeMedia(const QUrl &url);   //通过MediaProbe获取文件数据内的标题和元数据，可在工作线程调用
+    static QString placeholderTitle(const QUrl &url); //元数据读取前显示的文件名
+    static PlaylistEntry toEntry(const MediaInfo &info);
+    static MediaInfo fromEntry(const PlaylistEntry &entry); //文件中已有元数据的项不再探测
+    int appendEntries(const QList<PlaylistEntry> &entries); //去重后一次性插入，返回第一项所在行
+    void loadNextChunk(quint64 generation);           //从映射的播放列表文件中取下一批插入
+    void cancelLoading();
+    QList<PlaylistEntry> readLegacyHistory() const;   //读取旧版本的history.vppl/history.txt
+    HistoryJournal &historyJournal();                 //第一次使用历史记录时才打开日志
+    static MediaInfo fromHistory(const HistoryEntry &entry);
+    void trimHistory();                               //删掉超出historyLimit的末尾几行
+    void probeTitles(const QList<QUrl> &urls);        //在线程池中读取标题
+    void onMediaProbed(quint64 generation, const MediaInfo &info);
+    void onDetailsReady(const QUrl &url, const MediaDetails &details);
+    void onFolderFilesAdded(const QList<QUrl> &urls);
+    FolderWatcher &folderWatcher();                   //第一次添加文件夹时才创建
+    void flushTitles();                               //合并一批标题更新后发出dataChanged
+    static bool applyProbed(MediaInfo &info, const MediaInfo &probed); //填入探测结果，已经填过时返回false
+    void ensureProbed(int index);                     //切换到还没读取完的项时优先在线程池中读取，完成后更新标题(弹幕文件名)
+    void onCurrentProbed(const MediaInfo &probed);
+    QString urlKey(const QUrl &url) const;            //索引键，打开normalizeUrls时file://和普通路径、不同的百分号编码视为相同
+    void reindex(int from, int to);                   //重建[from, to)行的索引
 
-    QString getTitleByFF(QUrl url) const; //通过ffmpeg获取文件数据内的标题
     QList<MediaInfo> m_mediaList;
+    QHash<QString, int> m_rowByKey; // urlKey -> 行号，与m_mediaList同步更新
+    bool m_normalizeUrls;
     int m_currentIndex;
+
+    QThreadPool m_probePool;
+    std::shared_ptr<std::atomic_bool> m_importCancelled;
+    quint64 m_importGeneration;   // 取消或清空后递增，丢弃旧的结果
+    int m_importTotal;
+    int m_importDone;
+    QHash<QUrl, MediaInfo> m_probed; // 等待合并发出的标题和元数据
+    QTimer *m_flushTimer;
+
+    MediaDetailLoader *m_detailLoader;
+    QHash<QUrl, MediaDetails> m_details; // 已经读取的附加信息
+
+    std::unique_ptr<PlaylistFile> m_playlistFile; // 正在分批载入的播放列表文件，载入完成后关闭映射
+    int m_loadOffset;        // 下一批的起始项
+    int m_loadAdded;         // 本次载入新增的项数
+    quint64 m_loadGeneration; // 取消或清空后递增，丢弃还在排队的批次
+
+    std::unique_ptr<HistoryJournal> m_history; // 只有作为历史列表使用时才创建
+    int m_historyLimit;
+
+    FolderWatcher *m_folderWatcher; // 只有添加过文件夹时才创建
+    bool m_watchFolders;
 };
@@ -0,0 +1,454 @@
+#include "playlistsearchmodel.h"
+#include "playlistmodel.h"
+#include "fuzzymatcher.h"
+#include "appsettings.h"
+
+#include <QPointer>
+
+namespace {
+constexpr int kMinChunkSize = 2048; // 每个后台任务至少打分这么多条
+}
+
+PlaylistSearchModel::PlaylistSearchModel(QObject *parent)
+    : QSortFilterProxyModel{parent}
+    , m_playlist{nullptr}
+    , m_fuzzy{true}
+    , m_searchBudget{30}
+    , m_cancelled{std::make_shared<std::atomic_bool>(false)}
+    , m_generation{0}
+    , m_pendingChunks{0}
+    , m_searching{false}
+    , m_complete{false}
+{
+    QSettings settings(kSettingsOrganization, QCoreApplication::applicationName());
+    m_fuzzy = settings.value("playlist/fuzzySearch", m_fuzzy).toBool();
+
+    connect(this, &QAbstractItemModel::rowsInserted, this, &PlaylistSearchModel::rowCountChanged);
+    connect(this, &QAbstractItemModel::rowsRemoved, this, &PlaylistSearchModel::rowCountChanged);
+    connect(this, &QAbstractItemModel::modelReset, this, &PlaylistSearchModel::rowCountChanged);
+    // 过滤结果变化后当前项在代理中的下标也会变化
+    connect(this, &QAbstractItemModel::rowsInserted, this, &PlaylistSearchModel::currentIndexChanged);
+    connect(this, &QAbstractItemModel::rowsRemoved, this, &PlaylistSearchModel::currentIndexChanged);
+    connect(this, &QAbstractItemModel::modelReset, this, &PlaylistSearchModel::currentIndexChanged);
+    connect(this, &QAbstractItemModel::layoutChanged, this, &PlaylistSearchModel::currentIndexChanged);
+
+    // 后台打分的结果按预算时间分批合并，避免每个任务完成都重新排序
+    m_publishTimer = new QTimer(this);
+    m_publishTimer->setInterval(m_searchBudget);
+    connect(m_publishTimer, &QTimer::timeout, this, &PlaylistSearchModel::publish);
+}
+
+PlaylistSearchModel::~PlaylistSearchModel()
+{
+    m_cancelled->store(true);
+    m_pool.clear();
+    m_pool.waitForDone();
+}
+
+void PlaylistSearchModel::setSourceModel(QAbstractItemModel *sourceModel)
+{
+    if (QAbstractItemModel *old = this->sourceModel()) old->disconnect(this);
+    m_playlist = qobject_cast<PlaylistModel *>(sourceModel);
+
+    // 先于基类连接，源模型变化时索引先更新，基类重新过滤时才能看到新数据
+    if (sourceModel) {
+        connect(sourceModel, &QAbstractItemModel::rowsInserted, this,
+                [this](const QModelIndex &, int first, int last) { onRowsInserted(first, last); });
+        connect(sourceModel, &QAbstractItemModel::rowsRemoved, this,
+                [this](const QModelIndex &, int first, int last) { onRowsRemoved(first, last); });
+        connect(sourceModel, &QAbstractItemModel::rowsMoved, this,
+                [this](const QModelIndex &, int first, int last, const QModelIndex &, int destination) {
+                    onRowsMoved(first, last, destination);
+                });
+        connect(sourceModel, &QAbstractItemModel::dataChanged, this,
+                [this](const QModelIndex &topLeft, const QModelIndex &bottomRight, const QList<int> &roles) {
+                    if (roles.isEmpty() || roles.contains(PlaylistModel::TitleRole) || roles.contains(PlaylistModel::MetadataRole)) {
+                        indexRows(topLeft.row(), bottomRight.row());
+                    }
+                });
+        connect(sourceModel, &QAbstractItemModel::modelReset, this, &PlaylistSearchModel::rebuildIndex);
+    }
+    if (m_playlist) connect(m_playlist, &PlaylistModel::currentIndexChanged, this, &PlaylistSearchModel::currentIndexChanged);
+
+    QSortFilterProxyModel::setSourceModel(sourceModel);
+    rebuildIndex();
+    refilter();
+}
+
+QString PlaylistSearchModel::query() const
+{
+    return m_rawQuery;
+}
+
+void PlaylistSearchModel::setQuery(const QString &query)
+{
+    if (m_rawQuery == query) return;
+    m_rawQuery = query;
+    emit queryChanged();
+
+    const QString normalized = SearchIndex::normalize(query.trimmed());
+    if (normalized == m_query) return;
+    search(normalized);
+}
+
+int PlaylistSearchModel::currentIndex() const
+{
+    if (!m_playlist) return -1;
+    return mapFromSource(m_playlist->index(m_playlist->currentIndex())).row();
+}
+
+void PlaylistSearchModel::setCurrentIndex(int index)
+{
+    if (!m_playlist) return;
+    int row = sourceRow(index);
+    if (row >= 0) m_playlist->setCurrentIndex(row);
+}
+
+bool PlaylistSearchModel::fuzzy() const
+{
+    return m_fuzzy;
+}
+
+void PlaylistSearchModel::setFuzzy(bool fuzzy)
+{
+    if (m_fuzzy == fuzzy) return;
+    m_fuzzy = fuzzy;
+    QSettings settings(kSettingsOrganization, QCoreApplication::applicationName());
+    settings.setValue("playlist/fuzzySearch", fuzzy);
+    emit fuzzyChanged();
+
+    // 用新的模式重新搜索当前查询
+    const QString normalized = m_query;
+    m_query.clear();
+    search(normalized);
+}
+
+int PlaylistSearchModel::searchBudget() const
+{
+    return m_searchBudget;
+}
+
+void PlaylistSearchModel::setSearchBudget(int milliseconds)
+{
+    milliseconds = qBound(5, milliseconds, 1000);
+    if (m_searchBudget == milliseconds) return;
+    m_searchBudget = milliseconds;
+    m_publishTimer->setInterval(milliseconds);
+    emit searchBudgetChanged();
+}
+
+bool PlaylistSearchModel::searching() const
+{
+    return m_searching;
+}
+
+QUrl PlaylistSearchModel::getUrl(int index) const
+{
+    return data(this->index(index, 0), PlaylistModel::UrlRole).toUrl();
+}
+
+int PlaylistSearchModel::sourceRow(int index) const
+{
+    if (index < 0 || index >= rowCount()) return -1;
+    return mapToSource(this->index(index, 0)).row();
+}
+
+void PlaylistSearchModel::setVisibleRange(int first, int last)
+{
+    const int count = rowCount();
+    if (!m_playlist || count == 0) return;
+    first = qBound(0, first, count - 1);
+    last = qBound(first, last, count - 1);
+
+    // 结果已按相关度排序，从上往下读取，之后预读下面半屏
+    QList<int> rows;
+    const int end = qMin(count - 1, last + (last - first + 1) / 2);
+    for (int i = first; i <= end; i++) rows.append(sourceRow(i));
+    m_playlist->requestDetails(rows);
+}
+
+bool PlaylistSearchModel::filterAcceptsRow(int sourceRow, const QModelIndex &sourceParent) const
+{
+    Q_UNUSED(sourceParent)
+    return m_query.isEmpty() || m_rowScores.value(sourceRow, -1) >= 0;
+}
+
+bool PlaylistSearchModel::lessThan(const QModelIndex &left, const QModelIndex &right) const
+{
+    // 得分高的在前，同分时保持播放列表中的顺序
+    int leftScore = m_rowScores.value(left.row(), -1);
+    int rightScore = m_rowScores.value(right.row(), -1);
+    if (leftScore != rightScore) return leftScore > rightScore;
+    return left.row() < right.row();
+}
+
+QString PlaylistSearchModel::keyAt(int sourceRow) const
+{
+    QAbstractItemModel *source = sourceModel();
+    return source->data(source->index(sourceRow, 0), PlaylistModel::UrlRole).toUrl().toString(QUrl::FullyEncoded);
+}
+
+QString PlaylistSearchModel::textAt(int sourceRow) const
+{
+    QAbstractItemModel *source = sourceModel();
+    QModelIndex index = source->index(sourceRow, 0);
+    QUrl url = index.data(PlaylistModel::UrlRole).toUrl();
+    QString path = url.isLocalFile() ? url.toLocalFile() : url.toDisplayString(QUrl::PreferLocalFile | QUrl::FullyDecoded);
+    // 换行隔开，子串查询不会跨越标题、路径和元数据
+    return index.data(PlaylistModel::TitleRole).toString() + '\n' + path + '\n'
+           + index.data(PlaylistModel::MetadataRole).toString();
+}
+
+int PlaylistSearchModel::scoreOf(const QString &key, const QString &text) const
+{
+    if (m_fuzzy) return FuzzyMatcher::score(text, m_query);
+    return m_index.matches(key, m_query) ? 0 : -1;
+}
+
+void PlaylistSearchModel::setScore(const QString &key, int score)
+{
+    if (score >= 0) {
+        m_scores.insert(key, score);
+    } else {
+        m_scores.remove(key);
+    }
+    for (auto it = m_rowsByKey.constFind(key); it != m_rowsByKey.cend() && it.key() == key; ++it) m_rowScores[it.value()] = score;
+}
+
+void PlaylistSearchModel::applyScores()
+{
+    m_rowScores.fill(-1);
+    for (auto it = m_scores.cbegin(); it != m_scores.cend(); ++it) {
+        for (auto row = m_rowsByKey.constFind(it.key()); row != m_rowsByKey.cend() && row.key() == it.key(); ++row) {
+            m_rowScores[row.value()] = it.value();
+        }
+    }
+}
+
+void PlaylistSearchModel::onRowsInserted(int first, int last)
+{
+    const int count = last - first + 1;
+    const bool appended = first == m_rowKeys.size();
+    m_rowKeys.insert(first, count, QString());
+    m_rowScores.insert(first, count, -1);
+    for (int row = first; row <= last; row++) m_rowKeys[row] = keyAt(row);
+    if (appended) {
+        for (int row = first; row <= last; row++) m_rowsByKey.insert(m_rowKeys[row], row);
+    } else {
+        rebuildRowsByKey(); //后面的行号都变了
+    }
+    indexRows(first, last);
+}
+
+void PlaylistSearchModel::onRowsRemoved(int first, int last)
+{
+    const int count = last - first + 1;
+    const QList<QString> removed = m_rowKeys.mid(first, count);
+    m_rowKeys.remove(first, count);
+    m_rowScores.remove(first, count);
+    rebuildRowsByKey();
+    for (const QString &key : removed) {
+        if (m_rowsByKey.contains(key)) continue; //还有同一个url的其它行，索引项保留
+        m_index.remove(key);
+        m_scores.remove(key);
+    }
+}
+
+void PlaylistSearchModel::onRowsMoved(int first, int last, int destination)
+{
+    const int count = last - first + 1;
+    const QList<QString> keys = m_rowKeys.mid(first, count);
+    const QList<int> scores = m_rowScores.mid(first, count);
+    m_rowKeys.remove(first, count);
+    m_rowScores.remove(first, count);
+    const int to = destination > last ? destination - count : destination;
+    for (int i = 0; i < count; i++) {
+        m_rowKeys.insert(to + i, keys[i]);
+        m_rowScores.insert(to + i, scores[i]);
+    }
+    rebuildRowsByKey();
+}
+
+void PlaylistSearchModel::rebuildRowsByKey()
+{
+    m_rowsByKey.clear();
+    m_rowsByKey.reserve(m_rowKeys.size());
+    for (int row = 0; row < m_rowKeys.size(); row++) m_rowsByKey.insert(m_rowKeys[row], row);
+}
+
+void PlaylistSearchModel::indexRows(int first, int last)
+{
+    for (int row = first; row <= last; row++) {
+        const QString &key = m_rowKeys[row];
+        m_index.insert(key, textAt(row));
+        if (!m_query.isEmpty()) setScore(key, scoreOf(key, m_index.text(key)));
+    }
+}
+
+void PlaylistSearchModel::rebuildIndex()
+{
+    m_index.clear();
+    m_scores.clear();
+    m_rowKeys.clear();
+    m_rowScores.clear();
+    m_rowsByKey.clear();
+    if (!sourceModel()) return;
+    const int rows = sourceModel()->rowCount();
+    m_rowKeys.reserve(rows);
+    for (int row = 0; row < rows; row++) m_rowKeys.append(keyAt(row));
+    m_rowScores.fill(-1, rows);
+    rebuildRowsByKey();
+    indexRows(0, rows - 1);
+}
+
+void PlaylistSearchModel::search(const QString &normalized)
+{
+    const QString previous = m_query;
+    const bool wasComplete = m_complete;
+    cancelFuzzySearch();
+    m_query = normalized;
+
+    if (normalized.isEmpty()) {
+        m_scores.clear();
+        applyScores();
+        sort(-1); // 恢复播放列表顺序
+        refilter();
+        return;
+    }
+
+    const bool narrowing = !previous.isEmpty() && normalized.contains(previous);
+    if (!m_fuzzy) {
+        if (narrowing) {
+            // 查询只是加了字，结果一定是上一次结果的子集
+            for (auto it = m_scores.begin(); it != m_scores.end();) {
+                if (m_index.matches(it.key(), normalized)) {
+                    ++it;
+                } else {
+                    it = m_scores.erase(it);
+                }
+            }
+        } else {
+            m_scores.clear();
+            for (const QString &key : m_index.search(normalized)) m_scores.insert(key, 0);
+        }
+        applyScores();
+        sort(-1);
+        refilter();
+        return;
+    }
+
+    // 子串命中从索引中立即得到，先显示出来
+    QHash<QString, int> previousScores = m_scores;
+    m_scores.clear();
+    for (const QString &key : m_index.search(normalized)) {
+        m_scores.insert(key, FuzzyMatcher::score(m_index.text(key), normalized));
+    }
+    applyScores();
+    sort(0, Qt::AscendingOrder);
+    refilter();
+
+    // 允许的错字数不变时，加字后的匹配一定在上一次的完整结果里；否则对全部条目的共享快照打分
+    if (narrowing && wasComplete
+        && FuzzyMatcher::maxMisses(previous.size()) == FuzzyMatcher::maxMisses(normalized.size())) {
+        std::shared_ptr<Corpus> corpus = std::make_shared<Corpus>();
+        corpus->reserve(previousScores.size());
+        for (auto it = previousScores.cbegin(); it != previousScores.cend(); ++it) {
+            corpus->append({it.key(), m_index.text(it.key())});
+        }
+        startFuzzySearch(corpus);
+    } else {
+        startFuzzySearch(m_index.snapshot());
+    }
+}
+
+void PlaylistSearchModel::startFuzzySearch(std::shared_ptr<const Corpus> corpus)
+{
+    if (corpus->isEmpty()) {
+        m_complete = true;
+        return;
+    }
+
+    const quint64 generation = m_generation;
+    const std::shared_ptr<std::atomic_bool> cancelled = m_cancelled;
+    const QString query = m_query;
+    QPointer<PlaylistSearchModel> self(this);
+
+    // 按线程数切块，每块完成后立即送回
+    const int threads = qMax(1, m_pool.maxThreadCount());
+    const int chunkSize = qMax<int>(kMinChunkSize, (corpus->size() + threads * 4 - 1) / (threads * 4));
+    m_pendingChunks = 0;
+    for (int from = 0; from < corpus->size(); from += chunkSize) {
+        const int to = qMin<int>(corpus->size(), from + chunkSize);
+        ++m_pendingChunks;
+        m_pool.start([=]() {
+            QList<std::pair<QString, int>> scores;
+            for (int i = from; i < to; i++) {
+                if ((i & 255) == 0 && cancelled->load()) return;
+                const std::pair<QString, QString> &entry = corpus->at(i);
+                int score = FuzzyMatcher::score(entry.second, query);
+                if (score >= 0) scores.append({entry.first, score});
+            }
+            QMetaObject::invokeMethod(
+                self, [self, generation, scores]() {
+                    if (self) self->onChunkScored(generation, scores);
+                }, Qt::QueuedConnection);
+        });
+    }
+    setSearching(true);
+    m_publishTimer->start();
+}
+
+void PlaylistSearchModel::cancelFuzzySearch()
+{
+    m_cancelled->store(true);
+    m_cancelled = std::make_shared<std::atomic_bool>(false);
+    ++m_generation;
+    m_pool.clear();
+    m_pendingChunks = 0;
+    m_pendingScores.clear();
+    m_publishTimer->stop();
+    m_complete = false;
+    setSearching(false);
+}
+
+void PlaylistSearchModel::onChunkScored(quint64 generation, const QList<std::pair<QString, int>> &scores)
+{
+    if (generation != m_generation) return;
+    for (const std::pair<QString, int> &score : scores) {
+        // 打分期间被移除的条目不再加入
+        if (m_index.contains(score.first)) m_pendingScores.insert(score.first, score.second);
+    }
+    if (--m_pendingChunks > 0) return;
+
+    m_complete = true;
+    publish();
+    m_publishTimer->stop();
+    setSearching(false);
+}
+
+void PlaylistSearchModel::publish()
+{
+    if (m_pendingScores.isEmpty()) return;
+    for (auto it = m_pendingScores.cbegin(); it != m_pendingScores.cend(); ++it) setScore(it.key(), it.value());
+    m_pendingScores.clear();
+    // 已经显示的行得分不变(子串命中时已按同一个打分函数计算)，只把新匹配的行按得分插入，不重新排序全部结果
+    invalidateRowsFilter();
+    emit currentIndexChanged();
+}
+
+void PlaylistSearchModel::setSearching(bool searching)
+{
+    if (m_searching == searching) return;
+    m_searching = searching;
+    emit searchingChanged();
+}
+
+void PlaylistSearchModel::refilter()
+{
+    if (m_fuzzy && !m_query.isEmpty()) {
+        invalidate(); // 重新过滤并按得分排序
+    } else {
+        invalidateRowsFilter();
+    }
+    emit currentIndexChanged();
+}
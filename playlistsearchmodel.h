@@ -0,0 +1,107 @@
+#pragma once
+
+#include <QSortFilterProxyModel>
+#include <QQmlEngine>
+#include <QHash>
+#include <QMultiHash>
+#include <QThreadPool>
+#include <QTimer>
+#include <QUrl>
+#include <atomic>
+#include <memory>
+#include <utility>
+
+#include "searchindex.h"
+
+class PlaylistModel;
+
+// 播放列表搜索结果：在PlaylistModel上过滤的代理，不复制数据项也不重新读取元数据
+// 标题、路径和容器元数据建立n-gram索引；
+// 精确模式下查询在上一次的基础上加字时只在上一次的结果里缩小，
+// 模糊模式下先立即给出子串命中，再在线程池中对索引的只读快照打分，按打分排序分批送到界面；
+// 每行的key和得分按源模型行号缓存，过滤和排序不经过QVariant，分批的结果按位置插入，不重新排序已有的行
+class PlaylistSearchModel : public QSortFilterProxyModel
+{
+    Q_OBJECT
+    QML_ELEMENT
+    Q_PROPERTY(QString query READ query WRITE setQuery NOTIFY queryChanged)
+    Q_PROPERTY(int currentIndex READ currentIndex WRITE setCurrentIndex NOTIFY currentIndexChanged) // 对应源模型的currentIndex
+    Q_PROPERTY(int rowCount READ rowCount NOTIFY rowCountChanged)
+    Q_PROPERTY(bool fuzzy READ fuzzy WRITE setFuzzy NOTIFY fuzzyChanged)                   // 模糊匹配并按相关度排序
+    Q_PROPERTY(int searchBudget READ searchBudget WRITE setSearchBudget NOTIFY searchBudgetChanged) // 每批结果的最长等待时间(毫秒)
+    Q_PROPERTY(bool searching READ searching NOTIFY searchingChanged)                    // 后台还有未完成的打分
+
+public:
+    explicit PlaylistSearchModel(QObject *parent = nullptr);
+    ~PlaylistSearchModel() override;
+
+    void setSourceModel(QAbstractItemModel *sourceModel) override;
+
+    QString query() const;
+    void setQuery(const QString &query);
+    int currentIndex() const;
+    void setCurrentIndex(int index);
+    bool fuzzy() const;
+    void setFuzzy(bool fuzzy);
+    int searchBudget() const;
+    void setSearchBudget(int milliseconds);
+    bool searching() const;
+
+    Q_INVOKABLE QUrl getUrl(int index) const;
+    Q_INVOKABLE int sourceRow(int index) const; // 搜索结果在播放列表中的下标
+    Q_INVOKABLE void setVisibleRange(int first, int last); // 可见的搜索结果，换算成播放列表的行后请求附加信息
+
+signals:
+    void queryChanged();
+    void currentIndexChanged();
+    void rowCountChanged();
+    void fuzzyChanged();
+    void searchBudgetChanged();
+    void searchingChanged();
+
+protected:
+    bool filterAcceptsRow(int sourceRow, const QModelIndex &sourceParent) const override;
+    bool lessThan(const QModelIndex &left, const QModelIndex &right) const override;
+
+private:
+    using Corpus = SearchIndex::Entries;
+
+    QString keyAt(int sourceRow) const;
+    QString textAt(int sourceRow) const; // 标题 + 文件路径 + 元数据
+    int scoreOf(const QString &key, const QString &text) const; // 当前模式下的得分，不匹配时为-1
+    void setScore(const QString &key, int score); // 同时更新这个key所有行的得分
+    void applyScores();                           // 按m_scores重新填写每行的得分
+    void onRowsInserted(int first, int last);
+    void onRowsRemoved(int first, int last);
+    void onRowsMoved(int first, int last, int destination);
+    void rebuildRowsByKey();
+    void indexRows(int first, int last);
+    void rebuildIndex();
+    void search(const QString &normalized);
+    void startFuzzySearch(std::shared_ptr<const Corpus> corpus);
+    void cancelFuzzySearch();
+    void onChunkScored(quint64 generation, const QList<std::pair<QString, int>> &scores);
+    void publish(); // 把后台的打分结果合并进来，新匹配的行按得分插入
+    void setSearching(bool searching);
+    void refilter(); // 查询变化后重新过滤并排序全部结果
+
+    PlaylistModel *m_playlist;
+    SearchIndex m_index;
+    QString m_query;                // 规范化后的查询
+    QString m_rawQuery;
+    QHash<QString, int> m_scores;   // 当前查询匹配的key及得分
+    QList<QString> m_rowKeys;       // 源模型行号 -> key
+    QList<int> m_rowScores;         // 源模型行号 -> 得分，-1为不匹配
+    QMultiHash<QString, int> m_rowsByKey; // key -> 源模型行号，重复的url对应多行
+    bool m_fuzzy;
+    int m_searchBudget;
+
+    QThreadPool m_pool;
+    std::shared_ptr<std::atomic_bool> m_cancelled;
+    quint64 m_generation;
+    int m_pendingChunks;
+    bool m_searching;
+    bool m_complete;                        // 上一次模糊搜索已经完整打分，可以在其结果中缩小
+    QHash<QString, int> m_pendingScores;    // 还没合并到界面的打分
+    QTimer *m_publishTimer;
+};
@@ -0,0 +1,117 @@
+#include "qtplayerbackend.h"
+
+#include <QMediaMetaData>
+
+QtPlayerBackend::QtPlayerBackend(QObject *parent)
+    : PlayerBackend{parent}
+    , m_pendingPosition{-1}
+{
+    m_player = new QMediaPlayer(this);
+
+    // 先于转发的信号执行，收到LoadedMedia的一方看到的已经是跳转后的位置
+    connect(m_player, &QMediaPlayer::mediaStatusChanged, this, [this](QMediaPlayer::MediaStatus status) {
+        if (m_pendingPosition < 0 || status == QMediaPlayer::LoadingMedia) return;
+        qint64 position = m_pendingPosition;
+        m_pendingPosition = -1;
+        if (status == QMediaPlayer::LoadedMedia || status == QMediaPlayer::BufferedMedia) m_player->setPosition(position);
+    });
+
+    connect(m_player, &QMediaPlayer::playbackStateChanged, this, &PlayerBackend::playbackStateChanged);
+    connect(m_player, &QMediaPlayer::mediaStatusChanged, this, &PlayerBackend::mediaStatusChanged);
+    connect(m_player, &QMediaPlayer::positionChanged, this, &PlayerBackend::positionChanged);
+    connect(m_player, &QMediaPlayer::durationChanged, this, &PlayerBackend::durationChanged);
+    connect(m_player, &QMediaPlayer::playbackRateChanged, this, &PlayerBackend::playbackRateChanged);
+    connect(m_player, &QMediaPlayer::errorOccurred, this, &PlayerBackend::errorOccurred);
+}
+
+void QtPlayerBackend::setSource(const QUrl &url)
+{
+    m_pendingPosition = -1;
+    m_player->setSource(url);
+}
+
+QUrl QtPlayerBackend::source() const
+{
+    return m_player->source();
+}
+
+void QtPlayerBackend::play()
+{
+    m_player->play();
+}
+
+void QtPlayerBackend::pause()
+{
+    m_player->pause();
+}
+
+void QtPlayerBackend::stop()
+{
+    m_player->stop();
+}
+
+void QtPlayerBackend::setPosition(qint64 position)
+{
+    // QMediaPlayer在打开完成前会忽略跳转
+    if (m_player->mediaStatus() == QMediaPlayer::LoadingMedia) {
+        m_pendingPosition = position;
+        emit positionChanged(position);
+        return;
+    }
+    m_player->setPosition(position);
+}
+
+qint64 QtPlayerBackend::position() const
+{
+    return m_pendingPosition >= 0 ? m_pendingPosition : m_player->position();
+}
+
+qint64 QtPlayerBackend::duration() const
+{
+    return m_player->duration();
+}
+
+void QtPlayerBackend::setPlaybackRate(qreal rate)
+{
+    m_player->setPlaybackRate(rate);
+}
+
+qreal QtPlayerBackend::playbackRate() const
+{
+    return m_player->playbackRate();
+}
+
+QMediaPlayer::PlaybackState QtPlayerBackend::playbackState() const
+{
+    return m_player->playbackState();
+}
+
+QMediaPlayer::MediaStatus QtPlayerBackend::mediaStatus() const
+{
+    return m_player->mediaStatus();
+}
+
+bool QtPlayerBackend::hasVideo() const
+{
+    return m_player->hasVideo();
+}
+
+void QtPlayerBackend::setVideoSink(QVideoSink *sink)
+{
+    m_player->setVideoOutput(sink);
+}
+
+void QtPlayerBackend::setAudioOutput(QAudioOutput *output)
+{
+    m_player->setAudioOutput(output);
+}
+
+QVariantMap QtPlayerBackend::stats() const
+{
+    QVariantMap stats;
+    stats["bufferFill"] = m_player->bufferProgress();
+    QMediaMetaData metaData = m_player->metaData();
+    int bitrate = metaData.value(QMediaMetaData::VideoBitRate).toInt() + metaData.value(QMediaMetaData::AudioBitRate).toInt();
+    if (bitrate > 0) stats["bitrateKbps"] = bitrate / 1000.0;
+    return stats;
+}
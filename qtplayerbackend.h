@@ -0,0 +1,32 @@
+#pragma once
+
+#include "playerbackend.h"
+
+// 基于QMediaPlayer的默认播放后端
+class QtPlayerBackend : public PlayerBackend
+{
+    Q_OBJECT
+public:
+    explicit QtPlayerBackend(QObject *parent = nullptr);
+
+    void setSource(const QUrl &url) override;
+    QUrl source() const override;
+    void play() override;
+    void pause() override;
+    void stop() override;
+    void setPosition(qint64 position) override;
+    qint64 position() const override;
+    qint64 duration() const override;
+    void setPlaybackRate(qreal rate) override;
+    qreal playbackRate() const override;
+    QMediaPlayer::PlaybackState playbackState() const override;
+    QMediaPlayer::MediaStatus mediaStatus() const override;
+    bool hasVideo() const override;
+    void setVideoSink(QVideoSink *sink) override;
+    void setAudioOutput(QAudioOutput *output) override;
+    QVariantMap stats() const override; // 只有缓冲进度和元数据中的码率
+
+private:
+    QMediaPlayer *m_player;
+    qint64 m_pendingPosition; // 打开完成前设置的位置，LoadedMedia时再跳转，-1为没有
+};
@@ -0,0 +1,176 @@
+#include "resumestore.h"
+#include "mediacache.h"
+
+#include <QCoreApplication>
+#include <QCryptographicHash>
+#include <QDateTime>
+#include <QDebug>
+#include <QFile>
+#include <QSaveFile>
+#include <QtEndian>
+#include <algorithm>
+
+namespace {
+constexpr quint32 kResumeMagic = 0x56505253; // "VPRS"
+constexpr quint32 kResumeVersion = 1;
+constexpr int kHeaderSize = 8;
+constexpr int kKeySize = 20;                  // SHA1
+constexpr int kRecordSize = kKeySize + 8 + 8; // 键 + 位置 + 更新时间
+constexpr int kMaxEntries = 50000;            // 超出后淘汰最久没有更新的项
+constexpr int kCompactSlack = 1024;
+constexpr int kFlushInterval = 5000;          // 改动最多在内存中停留5秒
+
+void appendRecord(QByteArray &out, const QByteArray &key, qint64 position, qint64 updated)
+{
+    char buffer[16];
+    qToLittleEndian<qint64>(position, buffer);
+    qToLittleEndian<qint64>(updated, buffer + 8);
+    out.append(key.left(kKeySize));
+    out.append(buffer, sizeof(buffer));
+}
+
+QByteArray header()
+{
+    char buffer[kHeaderSize];
+    qToLittleEndian<quint32>(kResumeMagic, buffer);
+    qToLittleEndian<quint32>(kResumeVersion, buffer + 4);
+    return QByteArray(buffer, kHeaderSize);
+}
+} // namespace
+
+ResumeStore::ResumeStore(QObject *parent)
+    : QObject(parent)
+    , m_filePath{MediaCache::cacheDir("Video-Player_Resume").filePath("positions.log")}
+    , m_logRecords{0}
+{
+    m_writer.setMaxThreadCount(1);
+    m_flushTimer = new QTimer(this);
+    m_flushTimer->setSingleShot(true);
+    m_flushTimer->setInterval(kFlushInterval);
+    connect(m_flushTimer, &QTimer::timeout, this, &ResumeStore::flush);
+    load();
+}
+
+ResumeStore::~ResumeStore()
+{
+    flush();
+    m_writer.waitForDone();
+}
+
+ResumeStore &ResumeStore::instance()
+{
+    static ResumeStore *store = new ResumeStore(QCoreApplication::instance());
+    return *store;
+}
+
+QByteArray ResumeStore::keyFor(const QUrl &url)
+{
+    if (url.isEmpty()) return QByteArray();
+    if (url.isLocalFile()) return QByteArray::fromHex(MediaCache::cacheKey(url.toLocalFile()).toLatin1()); // 文件不存在时为空
+    return QCryptographicHash::hash(url.toEncoded(), QCryptographicHash::Sha1);
+}
+
+qint64 ResumeStore::position(const QByteArray &key) const
+{
+    auto it = m_records.constFind(key);
+    return it == m_records.cend() ? -1 : it->position;
+}
+
+void ResumeStore::setPosition(const QByteArray &key, qint64 position)
+{
+    if (key.size() != kKeySize || position < 0) return;
+    auto it = m_records.find(key);
+    if (it != m_records.end() && it->position == position) return;
+
+    Record record{position, QDateTime::currentMSecsSinceEpoch()};
+    m_records.insert(key, record);
+    m_pending.insert(key, record);
+    if (!m_flushTimer->isActive()) m_flushTimer->start();
+}
+
+void ResumeStore::remove(const QByteArray &key)
+{
+    if (!m_records.remove(key)) return;
+    m_pending.insert(key, Record{-1, QDateTime::currentMSecsSinceEpoch()});
+    if (!m_flushTimer->isActive()) m_flushTimer->start();
+}
+
+void ResumeStore::flush()
+{
+    m_flushTimer->stop();
+    if (m_pending.isEmpty()) return;
+
+    const bool evict = m_records.size() > kMaxEntries + kMaxEntries / 10;
+    if (evict) {
+        // 超出一成后按更新时间淘汰到上限，之后整体重写，不会每加一项就重写一次
+        QList<std::pair<qint64, QByteArray>> byAge;
+        byAge.reserve(m_records.size());
+        for (auto it = m_records.cbegin(); it != m_records.cend(); ++it) byAge.append({it->updated, it.key()});
+        std::nth_element(byAge.begin(), byAge.begin() + (byAge.size() - kMaxEntries), byAge.end());
+        for (int i = 0; i < byAge.size() - kMaxEntries; i++) m_records.remove(byAge[i].second);
+    }
+
+    m_logRecords += m_pending.size();
+    const bool compact = evict || m_logRecords > 2 * qint64(m_records.size()) + kCompactSlack;
+    QHash<QByteArray, Record> records = compact ? m_records : m_pending;
+    if (compact) m_logRecords = m_records.size();
+    m_pending.clear();
+
+    const QString filePath = m_filePath;
+    m_writer.start([filePath, records, compact]() { writeRecords(filePath, records, compact); });
+}
+
+void ResumeStore::load()
+{
+    QFile file(m_filePath);
+    if (!file.open(QIODevice::ReadOnly)) return;
+    const QByteArray data = file.readAll();
+    if (data.size() < kHeaderSize || qFromLittleEndian<quint32>(data.constData()) != kResumeMagic
+        || qFromLittleEndian<quint32>(data.constData() + 4) != kResumeVersion) {
+        qWarning() << "ResumeStore: invalid position log" << m_filePath;
+        file.close();
+        QFile::remove(m_filePath);
+        return;
+    }
+
+    // 定长记录，末尾写到一半的记录直接忽略
+    const qint64 count = (data.size() - kHeaderSize) / kRecordSize;
+    m_records.reserve(count);
+    for (qint64 i = 0; i < count; i++) {
+        const char *record = data.constData() + kHeaderSize + i * kRecordSize;
+        QByteArray key(record, kKeySize);
+        const qint64 position = qFromLittleEndian<qint64>(record + kKeySize);
+        const qint64 updated = qFromLittleEndian<qint64>(record + kKeySize + 8);
+        if (position < 0) m_records.remove(key);
+        else m_records.insert(key, Record{position, updated});
+    }
+    m_logRecords = count;
+
+    // 截掉末尾写到一半的记录，之后追加的记录才能对齐
+    file.close();
+    if (data.size() != kHeaderSize + count * kRecordSize) QFile::resize(m_filePath, kHeaderSize + count * kRecordSize);
+}
+
+void ResumeStore::writeRecords(const QString &filePath, const QHash<QByteArray, Record> &records, bool compact)
+{
+    QByteArray data;
+    data.reserve(kHeaderSize + records.size() * kRecordSize);
+    if (compact) data.append(header());
+    for (auto it = records.cbegin(); it != records.cend(); ++it) appendRecord(data, it.key(), it->position, it->updated);
+
+    if (compact) {
+        QSaveFile file(filePath);
+        if (!file.open(QIODevice::WriteOnly) || file.write(data) != data.size() || !file.commit()) {
+            qWarning() << "ResumeStore: failed to rewrite" << filePath;
+        }
+        return;
+    }
+
+    QFile file(filePath);
+    if (!file.open(QIODevice::WriteOnly | QIODevice::Append)) {
+        qWarning() << "ResumeStore: cannot open" << filePath << file.errorString();
+        return;
+    }
+    if (file.size() == 0) data.prepend(header());
+    file.write(data); // 一批改动一次写入
+}
@@ -0,0 +1,47 @@
+#pragma once
+
+#include <QObject>
+#include <QHash>
+#include <QThreadPool>
+#include <QTimer>
+#include <QUrl>
+
+// 续播位置存储：媒体 -> 上次播放到的位置
+// 内存中是以20字节键索引的哈希表，查询不读盘；
+// 写入先在内存中合并，每隔一段时间由后台线程把变化的项追加到日志文件，
+// 日志中的过期记录多于有效项时整体重写，文件大小和写盘次数都有上限
+// 整个程序只有这一份位置记录，播放引擎写入，历史列表读取
+class ResumeStore : public QObject
+{
+    Q_OBJECT
+public:
+    ~ResumeStore() override; // 写出还没落盘的位置
+
+    static ResumeStore &instance(); // 挂在QCoreApplication下，随程序退出析构
+
+    static QByteArray keyFor(const QUrl &url); // 本地文件按路径+大小+修改时间，网络URL按地址
+
+    qint64 position(const QByteArray &key) const; // 没有记录时返回-1
+    void setPosition(const QByteArray &key, qint64 position);
+    void remove(const QByteArray &key);           // 播放完毕后不再续播
+    void flush();                                 // 立即把合并中的改动交给后台写入
+
+private:
+    explicit ResumeStore(QObject *parent);
+
+    struct Record
+    {
+        qint64 position = -1; // -1表示删除
+        qint64 updated = 0;   // 毫秒时间戳，超出上限时先淘汰最旧的
+    };
+
+    void load();
+    static void writeRecords(const QString &filePath, const QHash<QByteArray, Record> &records, bool compact); // 在后台线程执行
+
+    QString m_filePath;
+    QHash<QByteArray, Record> m_records; // 全部有效的位置
+    QHash<QByteArray, Record> m_pending; // 还没交给后台的改动
+    qint64 m_logRecords;                 // 日志中的记录条数(包括过期的)
+    QTimer *m_flushTimer;
+    QThreadPool m_writer;                // 单线程，保证追加和重写按顺序执行
+};
@@ -0,0 +1,188 @@
+#include "searchindex.h"
+
+#include <algorithm>
+
+namespace {
+// 在排好序的列表中插入/删除，保持有序以便求交
+void insertSorted(QList<int> &list, int id)
+{
+    auto it = std::lower_bound(list.begin(), list.end(), id);
+    if (it == list.end() || *it != id) list.insert(it, id);
+}
+
+void removeSorted(QList<int> &list, int id)
+{
+    auto it = std::lower_bound(list.begin(), list.end(), id);
+    if (it != list.end() && *it == id) list.erase(it);
+}
+
+QList<int> intersect(const QList<int> &a, const QList<int> &b)
+{
+    QList<int> result;
+    std::set_intersection(a.begin(), a.end(), b.begin(), b.end(), std::back_inserter(result));
+    return result;
+}
+} // namespace
+
+QString SearchIndex::normalize(const QString &text)
+{
+    // NFKD把全角字母、合字等拆成基本字符，再去掉拉丁、希腊、西里尔字母拆出来的变音符号；
+    // 其它文字的组合符号要保留，例如日文的浊点和半浊点(が≠か，ぱ≠は)，之后再组合回去
+    const QString decomposed = text.normalized(QString::NormalizationForm_KD);
+    QString result;
+    result.reserve(decomposed.size());
+    bool foldMarks = false; // 前一个基本字符的变音符号是否去掉
+    for (QChar ch : decomposed) {
+        if (ch.category() == QChar::Mark_NonSpacing) {
+            if (!foldMarks) result.append(ch);
+            continue;
+        }
+        const QChar::Script script = ch.script();
+        foldMarks = script == QChar::Script_Latin || script == QChar::Script_Greek || script == QChar::Script_Cyrillic;
+        result.append(ch);
+    }
+    return result.normalized(QString::NormalizationForm_C).toCaseFolded();
+}
+
+void SearchIndex::insert(const QString &key, const QString &text)
+{
+    if (key.isEmpty()) return;
+    const QString normalized = normalize(text);
+    auto existing = m_ids.constFind(key);
+    if (existing != m_ids.cend() && m_texts[existing.value()] == normalized) return; //文本没变，快照继续有效
+    remove(key);
+
+    int id;
+    if (!m_freeIds.isEmpty()) {
+        id = m_freeIds.takeLast();
+        m_keys[id] = key;
+        m_texts[id] = normalized;
+    } else {
+        id = m_keys.size();
+        m_keys.append(key);
+        m_texts.append(normalized);
+    }
+    m_ids.insert(key, id);
+    addPostings(id);
+    m_snapshot.reset();
+}
+
+void SearchIndex::remove(const QString &key)
+{
+    auto it = m_ids.find(key);
+    if (it == m_ids.end()) return;
+    const int id = it.value();
+    m_ids.erase(it);
+    removePostings(id);
+    m_keys[id].clear();
+    m_texts[id].clear();
+    m_freeIds.append(id);
+    m_snapshot.reset();
+}
+
+void SearchIndex::clear()
+{
+    m_ids.clear();
+    m_keys.clear();
+    m_texts.clear();
+    m_freeIds.clear();
+    m_trigrams.clear();
+    m_unigrams.clear();
+    m_snapshot.reset();
+}
+
+bool SearchIndex::contains(const QString &key) const
+{
+    return m_ids.contains(key);
+}
+
+int SearchIndex::size() const
+{
+    return m_ids.size();
+}
+
+QSet<QString> SearchIndex::search(const QString &normalizedQuery) const
+{
+    QSet<QString> result;
+    if (normalizedQuery.isEmpty()) return result;
+
+    // 从最短的倒排表开始求交，候选集合会很快变小
+    const bool unigram = normalizedQuery.toUcs4().size() < 3;
+    const QHash<quint64, QList<int>> &postings = unigram ? m_unigrams : m_trigrams;
+    QList<const QList<int> *> lists;
+    for (quint64 gram : grams(normalizedQuery, unigram)) {
+        auto it = postings.constFind(gram);
+        if (it == postings.constEnd()) return result;
+        lists.append(&it.value());
+    }
+    std::sort(lists.begin(), lists.end(), [](const QList<int> *a, const QList<int> *b) { return a->size() < b->size(); });
+
+    QList<int> candidates = *lists.first();
+    for (int i = 1; i < lists.size() && !candidates.isEmpty(); i++) candidates = intersect(candidates, *lists[i]);
+
+    // n-gram只能说明可能包含，需要确认是连续的子串
+    for (int id : std::as_const(candidates)) {
+        if (m_texts[id].contains(normalizedQuery)) result.insert(m_keys[id]);
+    }
+    return result;
+}
+
+bool SearchIndex::matches(const QString &key, const QString &normalizedQuery) const
+{
+    auto it = m_ids.constFind(key);
+    if (it == m_ids.constEnd()) return false;
+    return m_texts[it.value()].contains(normalizedQuery);
+}
+
+QString SearchIndex::text(const QString &key) const
+{
+    auto it = m_ids.constFind(key);
+    return it == m_ids.constEnd() ? QString() : m_texts[it.value()];
+}
+
+std::shared_ptr<const SearchIndex::Entries> SearchIndex::snapshot() const
+{
+    if (m_snapshot) return m_snapshot;
+    auto entries = std::make_shared<Entries>();
+    entries->reserve(m_ids.size());
+    for (auto it = m_ids.cbegin(); it != m_ids.cend(); ++it) entries->append({it.key(), m_texts[it.value()]});
+    m_snapshot = entries;
+    return m_snapshot;
+}
+
+QList<quint64> SearchIndex::grams(const QString &normalized, bool unigram)
+{
+    const QList<uint> ucs4 = normalized.toUcs4();
+    QSet<quint64> unique;
+    if (unigram) {
+        for (uint ch : ucs4) unique.insert(ch);
+    } else {
+        // 每个码位不超过21位，三个拼成一个64位整数
+        for (int i = 0; i + 2 < ucs4.size(); i++) {
+            unique.insert((quint64(ucs4[i]) << 42) | (quint64(ucs4[i + 1]) << 21) | quint64(ucs4[i + 2]));
+        }
+    }
+    return QList<quint64>(unique.cbegin(), unique.cend());
+}
+
+void SearchIndex::addPostings(int id)
+{
+    for (quint64 gram : grams(m_texts[id], false)) insertSorted(m_trigrams[gram], id);
+    for (quint64 gram : grams(m_texts[id], true)) insertSorted(m_unigrams[gram], id);
+}
+
+void SearchIndex::removePostings(int id)
+{
+    for (quint64 gram : grams(m_texts[id], false)) {
+        auto it = m_trigrams.find(gram);
+        if (it == m_trigrams.end()) continue;
+        removeSorted(it.value(), id);
+        if (it.value().isEmpty()) m_trigrams.erase(it);
+    }
+    for (quint64 gram : grams(m_texts[id], true)) {
+        auto it = m_unigrams.find(gram);
+        if (it == m_unigrams.end()) continue;
+        removeSorted(it.value(), id);
+        if (it.value().isEmpty()) m_unigrams.erase(it);
+    }
+}
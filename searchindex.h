@@ -0,0 +1,43 @@
+#pragma once
+
+#include <QHash>
+#include <QList>
+#include <QSet>
+#include <QString>
+#include <memory>
+#include <utility>
+
+// 标题/路径的n-gram倒排索引
+// 文本先规范化(兼容分解、去掉拉丁/希腊/西里尔字母的变音符号、大小写折叠)，查询长度不少于3时用三元组求交，
+// 更短的查询(常见于中日韩文字)用单字求交，最后对候选逐个确认子串
+class SearchIndex
+{
+public:
+    using Entries = QList<std::pair<QString, QString>>; // (key, 规范化文本)
+
+    static QString normalize(const QString &text); // 全角转半角、é转e、大小写折叠
+
+    void insert(const QString &key, const QString &text); // key已存在时替换文本
+    void remove(const QString &key);
+    void clear();
+    bool contains(const QString &key) const;
+    int size() const;
+
+    QSet<QString> search(const QString &normalizedQuery) const;      // 返回匹配的key
+    bool matches(const QString &key, const QString &normalizedQuery) const; // 单个key是否匹配
+    QString text(const QString &key) const;                                 // 规范化后的文本
+    std::shared_ptr<const Entries> snapshot() const;                        // 全部条目的只读快照，索引不变时各次查询共用，供后台线程模糊搜索
+
+private:
+    static QList<quint64> grams(const QString &normalized, bool unigram); // 去重后的n-gram
+    void addPostings(int id);
+    void removePostings(int id);
+
+    QHash<QString, int> m_ids;   // key -> 文档id
+    QList<QString> m_keys;       // 文档id -> key，空字符串为已释放
+    QList<QString> m_texts;      // 文档id -> 规范化后的文本
+    QList<int> m_freeIds;
+    QHash<quint64, QList<int>> m_trigrams; // 三元组 -> 按id排序的文档
+    QHash<quint64, QList<int>> m_unigrams; // 单字 -> 按id排序的文档
+    mutable std::shared_ptr<const Entries> m_snapshot; // 索引变化时丢弃，下次需要时重建
+};
@@ -0,0 +1,65 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <utility>
+#include <vector>
+
+// 有界单生产者单消费者无锁队列
+// push只能在生产者线程调用，pop/front只能在消费者线程调用，size可在任意线程读取
+template<typename T>
+class SpscQueue
+{
+public:
+    explicit SpscQueue(std::size_t capacity) : m_slots(capacity + 1), m_head{0}, m_tail{0} {}
+    SpscQueue(const SpscQueue &) = delete;
+    SpscQueue &operator=(const SpscQueue &) = delete;
+
+    // 队列满时返回false，item保持不变
+    bool push(T &&item)
+    {
+        const std::size_t tail = m_tail.load(std::memory_order_relaxed);
+        const std::size_t next = increment(tail);
+        if (next == m_head.load(std::memory_order_acquire)) return false;
+        m_slots[tail] = std::move(item);
+        m_tail.store(next, std::memory_order_release);
+        return true;
+    }
+
+    // 队列空时返回false
+    bool pop(T &item)
+    {
+        const std::size_t head = m_head.load(std::memory_order_relaxed);
+        if (head == m_tail.load(std::memory_order_acquire)) return false;
+        item = std::move(m_slots[head]);
+        m_slots[head] = T();
+        m_head.store(increment(head), std::memory_order_release);
+        return true;
+    }
+
+    // 查看队首元素，队列空时返回nullptr
+    T *front()
+    {
+        const std::size_t head = m_head.load(std::memory_order_relaxed);
+        if (head == m_tail.load(std::memory_order_acquire)) return nullptr;
+        return &m_slots[head];
+    }
+
+    std::size_t size() const
+    {
+        const std::size_t head = m_head.load(std::memory_order_acquire);
+        const std::size_t tail = m_tail.load(std::memory_order_acquire);
+        return tail >= head ? tail - head : tail + m_slots.size() - head;
+    }
+
+    std::size_t capacity() const { return m_slots.size() - 1; }
+    bool isFull() const { return size() == capacity(); }
+    bool isEmpty() const { return size() == 0; }
+
+private:
+    std::size_t increment(std::size_t i) const { return i + 1 == m_slots.size() ? 0 : i + 1; }
+
+    std::vector<T> m_slots;
+    alignas(64) std::atomic<std::size_t> m_head; // 消费者位置
+    alignas(64) std::atomic<std::size_t> m_tail; // 生产者位置
+};
@@ -0,0 +1,121 @@
+#include "thumbnailengine.h"
+
+ThumbnailWorker::ThumbnailWorker(const std::atomic<quint64> *latestRequest, QObject *parent)
+    : QObject{parent}
+    , m_latestRequest{latestRequest}
+{}
+
+ThumbnailWorker::~ThumbnailWorker()
+{
+    closeMedia();
+}
+
+void ThumbnailWorker::openMedia(const QString &filePath)
+{
+    if (filePath.isEmpty()) {
+        closeMedia();
+        return;
+    }
+    m_decoder.open(filePath);
+}
+
+void ThumbnailWorker::closeMedia()
+{
+    m_decoder.close();
+}
+
+void ThumbnailWorker::setKeyframeIndex(std::shared_ptr<const KeyframeIndex> index)
+{
+    m_decoder.setKeyframeIndex(std::move(index));
+}
+
+void ThumbnailWorker::setDecodeSettings(const DecodeSettings &settings)
+{
+    m_decoder.setDecodeSettings(settings);
+}
+
+bool ThumbnailWorker::isStale(quint64 requestId) const
+{
+    return requestId != m_latestRequest->load(std::memory_order_acquire);
+}
+
+void ThumbnailWorker::decodeFrame(quint64 requestId, qint64 position, QSize size)
+{
+    // 拖动时请求堆积，只处理最新的一个
+    if (isStale(requestId) || !m_decoder.isOpen()) return;
+
+    QImage image = m_decoder.decodeAt(position, size);
+    if (!image.isNull()) emit frameDecoded(requestId, position, image);
+}
+
+ThumbnailEngine::ThumbnailEngine(QObject *parent)
+    : QObject{parent}
+    , m_worker{nullptr}
+    , m_latestRequest{0}
+    , m_lastDelivered{0}
+    , m_size{320, 180}
+{
+    m_worker = new ThumbnailWorker(&m_latestRequest);
+    m_worker->moveToThread(&m_thread);
+    connect(m_worker, &ThumbnailWorker::frameDecoded, this, &ThumbnailEngine::onFrameDecoded);
+    m_thread.setObjectName("ThumbnailEngine");
+    m_thread.start(QThread::LowPriority);
+}
+
+ThumbnailEngine::~ThumbnailEngine()
+{
+    cancel();
+    m_thread.quit();
+    m_thread.wait();
+    delete m_worker; // 线程已结束，可直接在当前线程释放
+}
+
+void ThumbnailEngine::setMedia(const QString &filePath)
+{
+    cancel();
+    QMetaObject::invokeMethod(m_worker, "openMedia", Qt::QueuedConnection, Q_ARG(QString, filePath));
+}
+
+void ThumbnailEngine::requestFrame(qint64 position)
+{
+    quint64 requestId = m_latestRequest.fetch_add(1, std::memory_order_acq_rel) + 1;
+    QMetaObject::invokeMethod(m_worker,
+                              "decodeFrame",
+                              Qt::QueuedConnection,
+                              Q_ARG(quint64, requestId),
+                              Q_ARG(qint64, position),
+                              Q_ARG(QSize, m_size));
+}
+
+void ThumbnailEngine::cancel()
+{
+    // 使所有已排队的请求失效，正在解码的结果也不再送出
+    m_lastDelivered = m_latestRequest.fetch_add(1, std::memory_order_acq_rel) + 1;
+}
+
+void ThumbnailEngine::setThumbnailSize(QSize size)
+{
+    if (size.isValid()) m_size = size;
+}
+
+void ThumbnailEngine::setKeyframeIndex(std::shared_ptr<const KeyframeIndex> index)
+{
+    ThumbnailWorker *worker = m_worker;
+    QMetaObject::invokeMethod(
+        m_worker, [worker, index]() { worker->setKeyframeIndex(index); }, Qt::QueuedConnection);
+}
+
+void ThumbnailEngine::setDecodeSettings(const DecodeSettings &settings)
+{
+    ThumbnailWorker *worker = m_worker;
+    QMetaObject::invokeMethod(
+        m_worker, [worker, settings]() { worker->setDecodeSettings(settings); }, Qt::QueuedConnection);
+}
+
+void ThumbnailEngine::onFrameDecoded(quint64 requestId, qint64 position, const QImage &image)
+{
+    // 只送出比已显示结果更新的帧，避免乱序回退
+    if (requestId <= m_lastDelivered) return;
+    m_lastDelivered = requestId;
+    emit frameReady(position, image);
+}
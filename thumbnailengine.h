@@ -0,0 +1,64 @@
+#pragma once
+
+#include <QObject>
+#include <QThread>
+#include <QImage>
+#include <QSize>
+#include <QString>
+#include <atomic>
+
+#include "framedecoder.h"
+
+// 缩略图解码器，运行在工作线程中，对当前媒体保持解复用器和解码器常开
+class ThumbnailWorker : public QObject
+{
+    Q_OBJECT
+public:
+    explicit ThumbnailWorker(const std::atomic<quint64> *latestRequest, QObject *parent = nullptr);
+    ~ThumbnailWorker() override;
+
+public slots:
+    void openMedia(const QString &filePath);                       // 打开媒体并保持打开状态
+    void closeMedia();                                             // 关闭当前媒体
+    void setKeyframeIndex(std::shared_ptr<const KeyframeIndex> index); // 设置当前媒体的关键帧索引
+    void setDecodeSettings(const DecodeSettings &settings);         // 设置预览解码参数
+    void decodeFrame(quint64 requestId, qint64 position, QSize size); // 解码指定位置最近关键帧
+
+signals:
+    void frameDecoded(quint64 requestId, qint64 position, const QImage &image);
+
+private:
+    bool isStale(quint64 requestId) const; // 请求是否已被更新的请求取代
+
+    const std::atomic<quint64> *m_latestRequest; // 最新请求编号(由ThumbnailEngine维护)
+    FrameDecoder m_decoder;
+};
+
+// 异步缩略图服务：请求立即返回，结果通过frameReady信号送回
+class ThumbnailEngine : public QObject
+{
+    Q_OBJECT
+public:
+    explicit ThumbnailEngine(QObject *parent = nullptr);
+    ~ThumbnailEngine() override;
+
+    void setMedia(const QString &filePath); // 切换媒体，空路径表示关闭
+    void requestFrame(qint64 position);     // 请求缩略图，旧的未处理请求会被丢弃
+    void cancel();                          // 取消所有未完成的请求
+    void setThumbnailSize(QSize size);      // 设置缩略图最大尺寸
+    void setKeyframeIndex(std::shared_ptr<const KeyframeIndex> index); // 用关键帧索引定位GOP
+    void setDecodeSettings(const DecodeSettings &settings);         // 预览解码的lowres、去块滤波等
+
+signals:
+    void frameReady(qint64 position, const QImage &image);
+
+private slots:
+    void onFrameDecoded(quint64 requestId, qint64 position, const QImage &image);
+
+private:
+    QThread m_thread;
+    ThumbnailWorker *m_worker;
+    std::atomic<quint64> m_latestRequest; // 最新请求编号
+    quint64 m_lastDelivered;              // 最近一次送出的请求编号
+    QSize m_size;
+};
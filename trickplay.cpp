@@ -0,0 +1,269 @@
+#include "trickplay.h"
+#include "framedecoder.h"
+#include "mediacache.h"
+
+#include <QDataStream>
+#include <QDebug>
+#include <QPainter>
+#include <QPointer>
+
+namespace {
+constexpr quint32 kIndexMagic = 0x56505450; // "VPTP"
+constexpr quint32 kIndexVersion = 1;
+constexpr qint64 kIndexHeaderSize = 28; // magic, version, tileWidth, tileHeight, interval, tileCount
+constexpr int kTileWidth = 160;
+constexpr int kTileHeight = 90;
+constexpr qsizetype kTileBytesPerLine = kTileWidth * 2; // RGB16
+constexpr qsizetype kTileBytes = kTileBytesPerLine * kTileHeight;
+constexpr int kMaxTiles = 720;   // 单个媒体最多的图块数，超过时自动增大间隔
+constexpr int kPasses = 8;       // 先生成间隔较大的图块，让整条进度条尽快可用
+constexpr int kMaxThreads = 2;   // 后台生成最多占用的线程数
+
+enum TileState : char { TileMissing = 0, TileReady = 1, TileFailed = 2 };
+} // namespace
+
+TrickplayGenerator::TrickplayGenerator(QObject *parent)
+    : QObject{parent}
+    , m_cancelled{std::make_shared<std::atomic_bool>(false)}
+    , m_generation{0}
+    , m_sprite{nullptr}
+    , m_interval{10000}
+    , m_tileInterval{10000}
+    , m_tileCount{0}
+    , m_doneCount{0}
+{
+    m_pool.setMaxThreadCount(kMaxThreads);
+    m_pool.setThreadPriority(QThread::LowestPriority);
+}
+
+TrickplayGenerator::~TrickplayGenerator()
+{
+    stop();
+    m_pool.waitForDone();
+}
+
+void TrickplayGenerator::setInterval(qint64 interval)
+{
+    if (interval > 0) m_interval = interval;
+}
+
+qint64 TrickplayGenerator::interval() const
+{
+    return m_interval;
+}
+
+bool TrickplayGenerator::isComplete() const
+{
+    return m_tileCount > 0 && m_doneCount == m_tileCount;
+}
+
+void TrickplayGenerator::setKeyframeIndex(std::shared_ptr<const KeyframeIndex> index)
+{
+    QMutexLocker locker(&m_indexMutex);
+    m_keyframeIndex = std::move(index);
+}
+
+std::shared_ptr<const KeyframeIndex> TrickplayGenerator::keyframeIndex() const
+{
+    QMutexLocker locker(&m_indexMutex);
+    return m_keyframeIndex;
+}
+
+void TrickplayGenerator::setDecodeSettings(const DecodeSettings &settings)
+{
+    QMutexLocker locker(&m_indexMutex);
+    m_decodeSettings = settings;
+}
+
+DecodeSettings TrickplayGenerator::decodeSettings() const
+{
+    QMutexLocker locker(&m_indexMutex);
+    return m_decodeSettings;
+}
+
+void TrickplayGenerator::start(const QString &filePath, qint64 duration)
+{
+    if (duration <= 0) return;
+    QString key = MediaCache::cacheKey(filePath);
+    if (key.isEmpty()) return;
+    if (key == m_key && m_sprite) return; // 已经在处理同一个文件
+
+    stop();
+    m_filePath = filePath;
+    m_key = key;
+
+    if (!openIndex(duration) || !openSprite()) {
+        stop();
+        return;
+    }
+
+    emit progressChanged(m_doneCount, m_tileCount);
+    if (isComplete()) {
+        emit finished();
+        return;
+    }
+    scheduleMissingTiles();
+}
+
+void TrickplayGenerator::stop()
+{
+    // 通知正在运行的任务退出，不在界面线程等待它们结束：
+    // 工作线程通过自己的QFile写图集，不使用这里的映射和索引文件，旧任务的结果按generation丢弃
+    m_cancelled->store(true);
+    m_cancelled = std::make_shared<std::atomic_bool>(false);
+    ++m_generation;
+    m_pool.clear();
+
+    if (m_sprite) {
+        m_spriteFile.unmap(m_sprite);
+        m_sprite = nullptr;
+    }
+    m_spriteFile.close();
+    m_indexFile.close();
+    m_tileStates.clear();
+    m_tileCount = 0;
+    m_doneCount = 0;
+    m_filePath.clear();
+    m_key.clear();
+    setKeyframeIndex(nullptr);
+}
+
+QImage TrickplayGenerator::tileAt(qint64 position) const
+{
+    if (!m_sprite || m_tileCount == 0 || position < 0) return QImage();
+
+    int tile = qMin<qint64>((position + m_tileInterval / 2) / m_tileInterval, m_tileCount - 1);
+    if (m_tileStates.at(tile) != TileReady) return QImage();
+
+    return QImage(m_sprite + tile * kTileBytes, kTileWidth, kTileHeight, kTileBytesPerLine, QImage::Format_RGB16);
+}
+
+bool TrickplayGenerator::openIndex(qint64 duration)
+{
+    m_tileInterval = qMax(m_interval, (duration + kMaxTiles - 1) / kMaxTiles);
+    m_tileCount = static_cast<int>(duration / m_tileInterval) + 1;
+
+    QDir dir = MediaCache::cacheDir("Video-Player_Trickplay");
+    m_indexFile.setFileName(dir.filePath(m_key + ".index"));
+    m_spriteFile.setFileName(dir.filePath(m_key + ".sprite"));
+    if (!m_indexFile.open(QIODevice::ReadWrite)) {
+        qWarning() << "Trickplay: failed to open index" << m_indexFile.fileName();
+        return false;
+    }
+
+    // 读取已有索引，参数一致时沿用已完成的图块
+    bool reuse = false;
+    if (m_indexFile.size() == kIndexHeaderSize + m_tileCount) {
+        QDataStream in(&m_indexFile);
+        quint32 magic, version;
+        qint32 tileWidth, tileHeight, tileCount;
+        qint64 interval;
+        in >> magic >> version >> tileWidth >> tileHeight >> interval >> tileCount;
+        reuse = magic == kIndexMagic && version == kIndexVersion && tileWidth == kTileWidth
+                && tileHeight == kTileHeight && interval == m_tileInterval && tileCount == m_tileCount
+                && m_spriteFile.size() == m_tileCount * kTileBytes;
+    }
+
+    if (reuse) {
+        m_tileStates = m_indexFile.read(m_tileCount);
+        reuse = m_tileStates.size() == m_tileCount;
+    }
+
+    if (!reuse) {
+        m_indexFile.resize(0);
+        m_indexFile.seek(0);
+        QDataStream out(&m_indexFile);
+        out << kIndexMagic << kIndexVersion << qint32(kTileWidth) << qint32(kTileHeight) << m_tileInterval
+            << qint32(m_tileCount);
+        m_tileStates = QByteArray(m_tileCount, TileMissing);
+        m_indexFile.write(m_tileStates);
+        m_indexFile.flush();
+        QFile::remove(m_spriteFile.fileName());
+    }
+
+    m_doneCount = 0;
+    for (char state : std::as_const(m_tileStates)) {
+        if (state != TileMissing) ++m_doneCount;
+    }
+    return true;
+}
+
+bool TrickplayGenerator::openSprite()
+{
+    if (!m_spriteFile.open(QIODevice::ReadWrite)) {
+        qWarning() << "Trickplay: failed to open sprite" << m_spriteFile.fileName();
+        return false;
+    }
+    if (m_spriteFile.size() != m_tileCount * kTileBytes && !m_spriteFile.resize(m_tileCount * kTileBytes)) {
+        return false;
+    }
+    m_sprite = m_spriteFile.map(0, m_spriteFile.size());
+    return m_sprite != nullptr;
+}
+
+void TrickplayGenerator::scheduleMissingTiles()
+{
+    const quint64 generation = m_generation;
+    const std::shared_ptr<std::atomic_bool> cancelled = m_cancelled;
+    const QString filePath = m_filePath;
+    const QString spritePath = m_spriteFile.fileName();
+    const qint64 tileInterval = m_tileInterval;
+    QPointer<TrickplayGenerator> self(this);
+
+    for (int pass = 0; pass < kPasses; ++pass) {
+        QList<int> tiles;
+        for (int tile = pass; tile < m_tileCount; tile += kPasses) {
+            if (m_tileStates.at(tile) == TileMissing) tiles.append(tile);
+        }
+        if (tiles.isEmpty()) continue;
+
+        m_pool.start([=]() {
+            FrameDecoder decoder;
+            if (self) decoder.setDecodeSettings(self->decodeSettings());
+            if (!decoder.open(filePath)) return;
+            if (self) decoder.setKeyframeIndex(self->keyframeIndex());
+            QFile sprite(spritePath);
+            if (!sprite.open(QIODevice::ReadWrite)) return;
+
+            for (int tile : tiles) {
+                if (cancelled->load()) return;
+
+                QImage frame = decoder.decodeAt(tile * tileInterval, QSize(kTileWidth, kTileHeight), QImage::Format_RGB16);
+                bool ok = !frame.isNull();
+                if (ok) {
+                    // 保持比例居中放入固定尺寸的图块
+                    QImage image(kTileWidth, kTileHeight, QImage::Format_RGB16);
+                    image.fill(Qt::black);
+                    QPainter painter(&image);
+                    painter.drawImage((kTileWidth - frame.width()) / 2, (kTileHeight - frame.height()) / 2, frame);
+                    painter.end();
+                    // 先把QFile的缓冲交给系统再通知界面，映射的图集读到的才是写完的数据
+                    ok = sprite.seek(tile * kTileBytes)
+                         && sprite.write(reinterpret_cast<const char *>(image.constBits()), kTileBytes) == kTileBytes
+                         && sprite.flush();
+                }
+                if (cancelled->load()) return;
+                QMetaObject::invokeMethod(
+                    self, [self, generation, tile, ok]() {
+                        if (self) self->onTileDone(generation, tile, ok);
+                    }, Qt::QueuedConnection);
+            }
+            sprite.close();
+        });
+    }
+}
+
+void TrickplayGenerator::onTileDone(quint64 generation, int tile, bool ok)
+{
+    if (generation != m_generation || tile < 0 || tile >= m_tileCount) return;
+    if (m_tileStates.at(tile) != TileMissing) return;
+
+    // 图块数据写入后才记录状态，中断时不会把未写完的图块当成已生成
+    char state = ok ? TileReady : TileFailed;
+    m_tileStates[tile] = state;
+    if (m_indexFile.seek(kIndexHeaderSize + tile) && m_indexFile.write(&state, 1) == 1) m_indexFile.flush(); //中断后保留已完成的图块
+
+    ++m_doneCount;
+    emit progressChanged(m_doneCount, m_tileCount);
+    if (isComplete()) emit finished();
+}
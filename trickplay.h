@@ -0,0 +1,66 @@
+#pragma once
+
+#include <QObject>
+#include <QFile>
+#include <QImage>
+#include <QMutex>
+#include <QSize>
+#include <QString>
+#include <QThreadPool>
+#include <atomic>
+#include <memory>
+
+#include "keyframeindex.h"
+#include "decodeprofile.h"
+
+// 进度条预览图集(trickplay)生成器
+// 每隔固定时间截取一帧低分辨率缩略图，按顺序存放在<key>.sprite中，生成状态记录在<key>.index中，
+// 中断后再次打开同一文件会从未完成的图块继续生成
+class TrickplayGenerator : public QObject
+{
+    Q_OBJECT
+public:
+    explicit TrickplayGenerator(QObject *parent = nullptr);
+    ~TrickplayGenerator() override;
+
+    void start(const QString &filePath, qint64 duration); // 开始（或继续）为媒体生成预览图集
+    void stop();                                           // 停止生成并释放映射，不等待正在解码的任务
+    void setInterval(qint64 interval);                     // 设置截取间隔，单位为毫秒
+    qint64 interval() const;
+    bool isComplete() const;
+    void setKeyframeIndex(std::shared_ptr<const KeyframeIndex> index); // 之后开始的生成任务用索引定位GOP
+    void setDecodeSettings(const DecodeSettings &settings);            // 之后开始的生成任务使用的解码参数
+
+    // 返回位置对应的预览图，图像直接引用内存映射的数据，不能在stop()之后继续使用
+    QImage tileAt(qint64 position) const;
+
+signals:
+    void progressChanged(int done, int total);
+    void finished();
+
+private:
+    bool openIndex(qint64 duration);                    // 打开或新建索引文件，参数不一致时重新生成
+    bool openSprite();                                  // 打开并映射图集文件
+    void scheduleMissingTiles();                        // 把未完成的图块交给线程池
+    void onTileDone(quint64 generation, int tile, bool ok); // 图块完成（在主线程中执行）
+    std::shared_ptr<const KeyframeIndex> keyframeIndex() const; // 供工作线程读取
+    DecodeSettings decodeSettings() const;
+
+    QThreadPool m_pool; // 有界线程池
+    std::shared_ptr<std::atomic_bool> m_cancelled;
+    quint64 m_generation; // 每次start递增，用于丢弃过期任务的结果
+
+    QString m_filePath;
+    QString m_key;
+    QFile m_indexFile;
+    QFile m_spriteFile;
+    uchar *m_sprite;         // 图集文件的内存映射
+    QByteArray m_tileStates; // 每个图块的状态：0 未生成，1 已生成，2 解码失败
+    qint64 m_interval;       // 用户设置的截取间隔
+    qint64 m_tileInterval;   // 当前媒体实际使用的截取间隔
+    int m_tileCount;
+    int m_doneCount;
+    mutable QMutex m_indexMutex; // 保护关键帧索引和解码参数
+    std::shared_ptr<const KeyframeIndex> m_keyframeIndex;
+    DecodeSettings m_decodeSettings;
+};
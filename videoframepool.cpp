@@ -0,0 +1,246 @@
+#include "videoframepool.h"
+
+#include <QMutexLocker>
+
+extern "C" {
+#include <libavutil/frame.h>
+#include <libavutil/imgutils.h>
+#include <libavutil/pixdesc.h>
+#include <libswscale/swscale.h>
+}
+
+namespace {
+constexpr size_t kMaxPooledFrames = 32; // 池中最多保留的空闲帧
+}
+
+AVFrameVideoBuffer::AVFrameVideoBuffer(std::shared_ptr<VideoFramePool> pool,
+                                       AVFrame *frame,
+                                       const QVideoFrameFormat &format,
+                                       bool scratch)
+    : m_pool{std::move(pool)}
+    , m_frame{frame}
+    , m_format{format}
+    , m_scratch{scratch}
+{}
+
+AVFrameVideoBuffer::~AVFrameVideoBuffer()
+{
+    m_pool->release(m_frame, m_scratch);
+}
+
+QAbstractVideoBuffer::MapData AVFrameVideoBuffer::map(QVideoFrame::MapMode mode)
+{
+    MapData data;
+    // 解码器的缓冲区可能被参考帧共享，只允许只读映射
+    if ((mode & QVideoFrame::WriteOnly) && !av_frame_is_writable(m_frame)) return data;
+
+    const AVPixFmtDescriptor *desc = av_pix_fmt_desc_get(static_cast<AVPixelFormat>(m_frame->format));
+    if (!desc) return data;
+
+    data.planeCount = qMin(av_pix_fmt_count_planes(static_cast<AVPixelFormat>(m_frame->format)), 4);
+    for (int plane = 0; plane < data.planeCount; ++plane) {
+        const bool chroma = plane == 1 || plane == 2;
+        const int height = chroma ? -((-m_frame->height) >> desc->log2_chroma_h) : m_frame->height;
+        data.bytesPerLine[plane] = m_frame->linesize[plane];
+        data.data[plane] = m_frame->data[plane];
+        data.dataSize[plane] = m_frame->linesize[plane] * height;
+    }
+    return data;
+}
+
+QVideoFrameFormat AVFrameVideoBuffer::format() const
+{
+    return m_format;
+}
+
+std::shared_ptr<VideoFramePool> VideoFramePool::create()
+{
+    return std::shared_ptr<VideoFramePool>(new VideoFramePool);
+}
+
+VideoFramePool::~VideoFramePool()
+{
+    for (AVFrame *frame : m_free) av_frame_free(&frame);
+    for (AVFrame *frame : m_scratch) av_frame_free(&frame);
+}
+
+QVideoFrameFormat::PixelFormat VideoFramePool::pixelFormat(int avFormat)
+{
+    switch (avFormat) {
+    case AV_PIX_FMT_YUV420P:
+    case AV_PIX_FMT_YUVJ420P:
+        return QVideoFrameFormat::Format_YUV420P;
+    case AV_PIX_FMT_YUV422P:
+    case AV_PIX_FMT_YUVJ422P:
+        return QVideoFrameFormat::Format_YUV422P;
+    case AV_PIX_FMT_YUV420P10LE:
+        return QVideoFrameFormat::Format_YUV420P10;
+    case AV_PIX_FMT_NV12:
+        return QVideoFrameFormat::Format_NV12;
+    case AV_PIX_FMT_NV21:
+        return QVideoFrameFormat::Format_NV21;
+    case AV_PIX_FMT_P010LE:
+        return QVideoFrameFormat::Format_P010;
+    case AV_PIX_FMT_GRAY8:
+        return QVideoFrameFormat::Format_Y8;
+    default:
+        return QVideoFrameFormat::Format_Invalid;
+    }
+}
+
+QVideoFrame VideoFramePool::wrap(const AVFrame *frame)
+{
+    QVideoFrameFormat::PixelFormat format = pixelFormat(frame->format);
+    if (format == QVideoFrameFormat::Format_Invalid) return QVideoFrame();
+
+    // 只增加引用计数，不拷贝平面数据
+    AVFrame *ref = acquire();
+    if (av_frame_ref(ref, frame) < 0) {
+        release(ref, false);
+        return QVideoFrame();
+    }
+    return QVideoFrame(
+        std::make_unique<AVFrameVideoBuffer>(shared_from_this(), ref, frameFormat(frame, format), false));
+}
+
+AVFrame *VideoFramePool::acquireScratch(int avFormat, int width, int height)
+{
+    {
+        QMutexLocker locker(&m_mutex);
+        for (auto it = m_scratch.begin(); it != m_scratch.end(); ++it) {
+            AVFrame *frame = *it;
+            if (frame->format == avFormat && frame->width == width && frame->height == height) {
+                m_scratch.erase(it);
+                ++m_hits;
+                ++m_outstanding;
+                return frame;
+            }
+        }
+    }
+
+    ++m_misses;
+    AVFrame *frame = av_frame_alloc();
+    frame->format = avFormat;
+    frame->width = width;
+    frame->height = height;
+    if (av_frame_get_buffer(frame, 0) < 0) {
+        av_frame_free(&frame);
+        return nullptr;
+    }
+    ++m_outstanding;
+    return frame;
+}
+
+QVideoFrame VideoFramePool::wrapScratch(AVFrame *scratch, const AVFrame *source)
+{
+    QVideoFrameFormat::PixelFormat format = pixelFormat(scratch->format);
+    if (format == QVideoFrameFormat::Format_Invalid) {
+        release(scratch, true);
+        return QVideoFrame();
+    }
+    m_bytesCopied += av_image_get_buffer_size(static_cast<AVPixelFormat>(scratch->format), scratch->width, scratch->height, 1);
+
+    // 色彩信息沿用源帧
+    scratch->colorspace = source->colorspace;
+    scratch->color_range = source->color_range;
+    return QVideoFrame(
+        std::make_unique<AVFrameVideoBuffer>(shared_from_this(), scratch, frameFormat(scratch, format), true));
+}
+
+QVideoFrame VideoFramePool::toVideoFrame(const AVFrame *frame, SwsContext **swsCtx)
+{
+    // Qt能直接渲染的像素格式只引用解码器的缓冲区，不拷贝
+    QVideoFrame videoFrame = wrap(frame);
+    if (videoFrame.isValid()) return videoFrame;
+
+    // 其他像素格式转换为YUV420P，目标帧同样从池中复用
+    AVFrame *scratch = acquireScratch(AV_PIX_FMT_YUV420P, frame->width, frame->height);
+    if (!scratch) return QVideoFrame();
+    *swsCtx = sws_getCachedContext(*swsCtx,
+                                   frame->width,
+                                   frame->height,
+                                   static_cast<AVPixelFormat>(frame->format),
+                                   frame->width,
+                                   frame->height,
+                                   AV_PIX_FMT_YUV420P,
+                                   SWS_BILINEAR,
+                                   nullptr,
+                                   nullptr,
+                                   nullptr);
+    if (*swsCtx) sws_scale(*swsCtx, frame->data, frame->linesize, 0, frame->height, scratch->data, scratch->linesize);
+    return wrapScratch(scratch, frame);
+}
+
+qint64 VideoFramePool::frameBytes(const AVFrame *frame)
+{
+    int size = av_image_get_buffer_size(static_cast<AVPixelFormat>(frame->format), frame->width, frame->height, 1);
+    return qMax(size, 0);
+}
+
+VideoFramePool::Stats VideoFramePool::stats() const
+{
+    Stats stats;
+    stats.hits = m_hits.load();
+    stats.misses = m_misses.load();
+    stats.bytesCopied = m_bytesCopied.load();
+    stats.outstanding = m_outstanding.load();
+    return stats;
+}
+
+QVariantMap VideoFramePool::Stats::toVariantMap() const
+{
+    QVariantMap map;
+    map["poolHits"] = hits;
+    map["poolMisses"] = misses;
+    map["bytesCopied"] = bytesCopied;
+    map["framesInFlight"] = outstanding;
+    return map;
+}
+
+AVFrame *VideoFramePool::acquire()
+{
+    ++m_outstanding;
+    {
+        QMutexLocker locker(&m_mutex);
+        if (!m_free.empty()) {
+            AVFrame *frame = m_free.back();
+            m_free.pop_back();
+            ++m_hits;
+            return frame;
+        }
+    }
+    ++m_misses;
+    return av_frame_alloc();
+}
+
+void VideoFramePool::release(AVFrame *frame, bool scratch)
+{
+    --m_outstanding;
+    // 解码器输出的帧归还时释放引用，缓冲区回到解码器自己的缓冲池；转换帧保留缓冲区下次复用
+    if (!scratch) av_frame_unref(frame);
+
+    QMutexLocker locker(&m_mutex);
+    std::vector<AVFrame *> &list = scratch ? m_scratch : m_free;
+    if (list.size() < kMaxPooledFrames) {
+        list.push_back(frame);
+        return;
+    }
+    locker.unlock();
+    av_frame_free(&frame);
+}
+
+QVideoFrameFormat VideoFramePool::frameFormat(const AVFrame *frame, QVideoFrameFormat::PixelFormat pixelFormat)
+{
+    QVideoFrameFormat format(QSize(frame->width, frame->height), pixelFormat);
+    bool bt709 = frame->colorspace == AVCOL_SPC_BT709
+                 || (frame->colorspace == AVCOL_SPC_UNSPECIFIED && frame->height >= 720);
+    if (frame->colorspace == AVCOL_SPC_BT2020_NCL || frame->colorspace == AVCOL_SPC_BT2020_CL) {
+        format.setColorSpace(QVideoFrameFormat::ColorSpace_BT2020);
+    } else {
+        format.setColorSpace(bt709 ? QVideoFrameFormat::ColorSpace_BT709 : QVideoFrameFormat::ColorSpace_BT601);
+    }
+    bool fullRange = frame->color_range == AVCOL_RANGE_JPEG || frame->format == AV_PIX_FMT_YUVJ420P
+                     || frame->format == AV_PIX_FMT_YUVJ422P;
+    format.setColorRange(fullRange ? QVideoFrameFormat::ColorRange_Full : QVideoFrameFormat::ColorRange_Video);
+    return format;
+}
@@ -0,0 +1,79 @@
+#pragma once
+
+#include <QAbstractVideoBuffer>
+#include <QMutex>
+#include <QVariantMap>
+#include <QVideoFrame>
+#include <QVideoFrameFormat>
+#include <atomic>
+#include <memory>
+#include <vector>
+
+struct AVFrame;
+struct SwsContext;
+
+class VideoFramePool;
+
+// 直接引用AVFrame平面数据的视频缓冲，析构时把AVFrame还给帧池
+class AVFrameVideoBuffer : public QAbstractVideoBuffer
+{
+public:
+    AVFrameVideoBuffer(std::shared_ptr<VideoFramePool> pool, AVFrame *frame, const QVideoFrameFormat &format, bool scratch);
+    ~AVFrameVideoBuffer() override;
+
+    MapData map(QVideoFrame::MapMode mode) override;
+    QVideoFrameFormat format() const override;
+
+private:
+    std::shared_ptr<VideoFramePool> m_pool;
+    AVFrame *m_frame;
+    QVideoFrameFormat m_format;
+    bool m_scratch; // 像素格式转换用的帧，回收时保留缓冲区
+};
+
+// AVFrame复用池，解码线程取帧，渲染线程释放QVideoFrame时归还
+// 稳定播放时不再分配AVFrame和平面缓冲区，解码器输出的YUV数据不经拷贝直接送到QVideoSink
+class VideoFramePool : public std::enable_shared_from_this<VideoFramePool>
+{
+public:
+    struct Stats
+    {
+        qint64 hits = 0;        // 从池中取到帧
+        qint64 misses = 0;      // 池为空时新分配
+        qint64 bytesCopied = 0; // 不支持的像素格式转换时写入的字节数
+        qint64 outstanding = 0; // 仍被QVideoFrame引用的帧
+        QVariantMap toVariantMap() const;
+    };
+
+    static std::shared_ptr<VideoFramePool> create();
+    ~VideoFramePool();
+
+    static QVideoFrameFormat::PixelFormat pixelFormat(int avFormat); // 没有对应格式时返回Format_Invalid
+
+    // 引用frame的缓冲区生成QVideoFrame，像素格式不受支持时返回无效帧
+    QVideoFrame wrap(const AVFrame *frame);
+    // 取得给定格式和尺寸的转换目标帧，写入后用wrapScratch交出
+    AVFrame *acquireScratch(int avFormat, int width, int height);
+    QVideoFrame wrapScratch(AVFrame *scratch, const AVFrame *source);
+    // 能直接渲染的格式走wrap，其他格式用swsCtx转换为YUV420P，swsCtx由调用方所在线程持有
+    QVideoFrame toVideoFrame(const AVFrame *frame, SwsContext **swsCtx);
+    static qint64 frameBytes(const AVFrame *frame); // 帧平面数据的字节数
+
+    Stats stats() const;
+
+private:
+    friend class AVFrameVideoBuffer;
+
+    VideoFramePool() = default;
+    AVFrame *acquire();
+    void release(AVFrame *frame, bool scratch);
+    static QVideoFrameFormat frameFormat(const AVFrame *frame, QVideoFrameFormat::PixelFormat pixelFormat);
+
+    mutable QMutex m_mutex;
+    std::vector<AVFrame *> m_free;    // 空帧，用于引用解码器输出
+    std::vector<AVFrame *> m_scratch; // 带缓冲区的转换帧
+    std::atomic<qint64> m_hits{0};
+    std::atomic<qint64> m_misses{0};
+    std::atomic<qint64> m_bytesCopied{0};
+    std::atomic<qint64> m_outstanding{0};
+};